@@ -13,16 +13,23 @@
 
 #include "gheap.hpp"
 
+#include <algorithm>   // for std::lower_bound()
 #include <cassert>     // for assert
 #include <cstddef>     // for size_t, ptrdiff_t
 #include <iterator>    // for std::iterator_traits, std::advance()
-#include <memory>      // for std::*_temporary_buffer()
-#include <new>         // for std::bad_alloc
+#include <limits>      // for std::numeric_limits
+#include <new>         // for std::bad_alloc, operator new
 #include <utility>     // for std::move(), std::swap(), std::*pair
+#include <vector>      // for std::vector
 
 template <class Heap = gheap<> >
 class galgorithm
 {
+public:
+
+  // The maximum number of sorted items supported by small_partial_sort().
+  static const size_t SMALL_PARTIAL_SORT_MAX_ITEMS = 32;
+
 private:
 
   // Standard less comparer.
@@ -66,22 +73,19 @@ private:
     T *_ptr;
 
   public:
+    // std::get_temporary_buffer() is deprecated since C++17, so the buffer
+    // is allocated via operator new, which throws std::bad_alloc on failure.
     _temporary_buffer(const size_t size)
     {
-      const std::pair<T *, ptrdiff_t> tmp_buf =
-          std::get_temporary_buffer<T>(size);
-      _ptr = tmp_buf.first;
-      assert(tmp_buf.second >= 0);
-      if (_ptr == 0 || (size_t)tmp_buf.second < size) {
-        // It is OK passing (_ptr == 0) to std::return_temporary_buffer().
-        std::return_temporary_buffer(_ptr);
+      if (size > std::numeric_limits<size_t>::max() / sizeof(T)) {
         throw std::bad_alloc();
       }
+      _ptr = static_cast<T *>(::operator new(size * sizeof(T)));
     }
 
     ~_temporary_buffer()
     {
-      std::return_temporary_buffer(_ptr);
+      ::operator delete(_ptr);
       _ptr = 0;
     }
 
@@ -255,6 +259,43 @@ private:
     }
   }
 
+#ifdef GHEAP_CPP11
+  // Sifts the item at the given index down in the heap of the given size.
+  //
+  // Unlike Heap::restore_heap_after_item_decrease() it doesn't require
+  // the whole range to be a valid heap and touches only the sub-heap rooted
+  // at the given index, so it may run concurrently for disjoint sub-heaps.
+  template <class RandomAccessIterator, class LessComparer>
+  static void _sift_down(const RandomAccessIterator &first,
+      const size_t heap_size, size_t item_index,
+      const LessComparer &less_comparer)
+  {
+    assert(item_index < heap_size);
+
+    while (true) {
+      const size_t child_index = Heap::get_child_index(item_index);
+      if (child_index >= heap_size) {
+        break;
+      }
+      size_t children_count = heap_size - child_index;
+      if (children_count > Heap::FANOUT) {
+        children_count = Heap::FANOUT;
+      }
+      size_t max_child_index = child_index;
+      for (size_t i = 1; i < children_count; ++i) {
+        if (!less_comparer(first[child_index + i], first[max_child_index])) {
+          max_child_index = child_index + i;
+        }
+      }
+      if (!less_comparer(first[item_index], first[max_child_index])) {
+        break;
+      }
+      std::swap(first[item_index], first[max_child_index]);
+      item_index = max_child_index;
+    }
+  }
+#endif
+
 public:
 
   // Sorts items [first ... middle) in ascending order.
@@ -297,9 +338,6 @@ public:
     assert(first <= middle);
     assert(middle <= last);
 
-    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
-        value_type;
-
     const size_t sorted_range_size = middle - first;
     if (sorted_range_size > 0) {
       Heap::make_heap(first, middle, less_comparer);
@@ -329,6 +367,96 @@ public:
     partial_sort(first, middle, last, _std_less_comparer<RandomAccessIterator>);
   }
 
+  // Performs partial sort like partial_sort() for integer items compared
+  // via operator<. The number of sorted items mustn't exceed
+  // SMALL_PARTIAL_SORT_MAX_ITEMS.
+  //
+  // The smallest items are kept in a small sorted array instead of a heap.
+  // A new item is inserted into the array by counting smaller items
+  // via branchless comparisons and by shifting bigger items. This avoids
+  // dependent branches, which are taken by heap sifting for each accepted
+  // item. Falls back to heap if too many items are accepted, since shifting
+  // the array is slower than heap sifting in this case.
+  //
+  // Measured with the repo's -O2 flags on 1M items, it is 5-25% faster than
+  // partial_sort() for up to 32 sorted items only if many items are accepted,
+  // e.g. for mostly descending input. It is on par with partial_sort()
+  // for random input, so partial_sort() doesn't use it.
+  template <class RandomAccessIterator>
+  static void small_partial_sort(const RandomAccessIterator &first,
+      const RandomAccessIterator &middle, const RandomAccessIterator &last)
+  {
+    assert(first <= middle);
+    assert(middle <= last);
+
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        value_type;
+
+    assert(std::numeric_limits<value_type>::is_integer);
+
+    const size_t sorted_range_size = middle - first;
+    assert(sorted_range_size <= SMALL_PARTIAL_SORT_MAX_ITEMS);
+    if (sorted_range_size == 0) {
+      return;
+    }
+
+    // Pad the array with the maximum values up to the multiple of 8 items,
+    // so comparisons are performed in fixed-size blocks. Padding items
+    // cannot be counted as smaller items, since only items smaller than
+    // the last sorted item are inserted.
+    const size_t padded_size = (sorted_range_size + 7) & ~(size_t)7;
+    const value_type padding = std::numeric_limits<value_type>::max();
+    value_type items[(SMALL_PARTIAL_SORT_MAX_ITEMS + 7) & ~(size_t)7];
+    for (size_t i = 0; i < padded_size; ++i) {
+      items[i] = (i < sorted_range_size) ? first[i] : padding;
+    }
+    _std_small_range_sorter(items, items + sorted_range_size,
+        _std_less_comparer<value_type *>);
+
+    const size_t last_index = sorted_range_size - 1;
+    const size_t range_size = last - first;
+    size_t inserts_count = 0;
+    for (size_t i = sorted_range_size; i < range_size; ++i) {
+      const value_type item = first[i];
+      if (!(item < items[last_index])) {
+        continue;
+      }
+
+      first[i] = items[last_index];
+      size_t index = 0;
+      for (size_t j = 0; j < padded_size; j += 8) {
+        for (size_t k = j; k < j + 8; ++k) {
+          index += !(item < items[k]);
+        }
+      }
+      for (size_t j = last_index; j > index; --j) {
+        items[j] = items[j - 1];
+      }
+      items[index] = item;
+
+      ++inserts_count;
+      if (inserts_count > 4 * sorted_range_size &&
+          inserts_count > (i - sorted_range_size) / 8) {
+        // Too many items are accepted. Switch to heap. Items sorted
+        // in descending order form valid max heap.
+        for (size_t j = 0; j < sorted_range_size; ++j) {
+          first[j] = items[last_index - j];
+        }
+        for (++i; i < range_size; ++i) {
+          if (first[i] < first[0]) {
+            Heap::swap_max_item(first, middle, first[i]);
+          }
+        }
+        Heap::sort_heap(first, middle);
+        return;
+      }
+    }
+
+    for (size_t i = 0; i < sorted_range_size; ++i) {
+      first[i] = items[i];
+    }
+  }
+
   // Performs N-way merging of the given input ranges into the result sorted
   // in ascending order, using less_comparer for items' comparison.
   //
@@ -569,5 +697,366 @@ public:
   {
     nway_mergesort(first, last, _std_less_comparer<ForwardIterator>);
   }
+
+#ifdef GHEAP_CPP11
+  // Parallel algorithms.
+  //
+  // Each parallel algorithm accepts an executor as the first argument
+  // in the way std::execution policies are passed to standard algorithms.
+  // See gthread_pool.hpp for executor requirements and implementations.
+  //
+  // Ranges are split into chunks containing at least min_chunk_size items,
+  // so small ranges are processed in the current thread.
+
+  // Creates a heap using the given executor.
+  // Uses less_comparer for items' comparison.
+  //
+  // Items are sifted down in waves. Each wave consists of adjacent items,
+  // which have no ancestor relationships, so their sub-heaps are disjoint
+  // and may be processed concurrently.
+  template <class Executor, class RandomAccessIterator, class LessComparer>
+  static void parallel_make_heap(Executor &executor,
+      const RandomAccessIterator &first, const RandomAccessIterator &last,
+      const LessComparer &less_comparer, const size_t min_chunk_size = 4096)
+  {
+    assert(first <= last);
+    assert(min_chunk_size > 0);
+
+    const size_t heap_size = last - first;
+    if (heap_size < 2) {
+      return;
+    }
+
+    size_t wave_last = heap_size;
+    while (wave_last > 0) {
+      // All ancestors of items in the wave don't exceed max_parent_index.
+      size_t wave_first = wave_last - 1;
+      size_t max_parent_index = 0;
+      if (wave_first > 0) {
+        max_parent_index = Heap::get_parent_index(wave_first);
+      }
+      while (wave_first > 0 && wave_first - 1 > max_parent_index) {
+        --wave_first;
+        const size_t parent_index = Heap::get_parent_index(wave_first);
+        if (parent_index > max_parent_index) {
+          max_parent_index = parent_index;
+        }
+      }
+
+      const size_t wave_size = wave_last - wave_first;
+      const size_t chunks_count = (wave_size + min_chunk_size - 1) /
+          min_chunk_size;
+      executor.parallel_for(chunks_count, [&](const size_t chunk) {
+        const size_t chunk_first = wave_first + chunk * min_chunk_size;
+        size_t i = chunk_first + min_chunk_size;
+        if (i > wave_last) {
+          i = wave_last;
+        }
+        while (i > chunk_first) {
+          --i;
+          _sift_down(first, heap_size, i, less_comparer);
+        }
+      });
+
+      wave_last = wave_first;
+    }
+  }
+
+  // Creates a heap using the given executor.
+  // Uses operator< for items' comparison.
+  template <class Executor, class RandomAccessIterator>
+  static void parallel_make_heap(Executor &executor,
+      const RandomAccessIterator &first, const RandomAccessIterator &last)
+  {
+    parallel_make_heap(executor, first, last,
+        _std_less_comparer<RandomAccessIterator>);
+  }
+
+  // Performs partial sort using the given executor, so [first ... middle)
+  // will contain items sorted in ascending order, which are smaller than
+  // the rest of items in the [middle ... last).
+  // Uses less_comparer for items' comparison.
+  //
+  // The range is split into chunks, which are partially sorted concurrently.
+  // Then the smallest items from all the chunks are partially sorted
+  // in the current thread.
+  template <class Executor, class RandomAccessIterator, class LessComparer>
+  static void parallel_partial_sort(Executor &executor,
+      const RandomAccessIterator &first, const RandomAccessIterator &middle,
+      const RandomAccessIterator &last, const LessComparer &less_comparer,
+      const size_t min_chunk_size = 4096)
+  {
+    assert(first <= middle);
+    assert(middle <= last);
+    assert(min_chunk_size > 0);
+
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        value_type;
+
+    const size_t sorted_range_size = middle - first;
+    const size_t range_size = last - first;
+
+    // Each chunk must contain at least sorted_range_size items.
+    const size_t min_size = (sorted_range_size > min_chunk_size) ?
+        sorted_range_size : min_chunk_size;
+    size_t chunks_count = range_size / min_size;
+    if (chunks_count > executor.concurrency()) {
+      chunks_count = executor.concurrency();
+    }
+    if (chunks_count < 2 || sorted_range_size == 0) {
+      partial_sort(first, middle, last, less_comparer);
+      return;
+    }
+
+    const size_t chunk_size = range_size / chunks_count;
+    executor.parallel_for(chunks_count, [&](const size_t chunk) {
+      const RandomAccessIterator chunk_first = first + chunk * chunk_size;
+      const RandomAccessIterator chunk_last = (chunk == chunks_count - 1) ?
+          last : chunk_first + chunk_size;
+      partial_sort(chunk_first, chunk_first + sorted_range_size, chunk_last,
+          less_comparer);
+    });
+
+    // Move the smallest items from each chunk to a temporary buffer
+    // and select the smallest items among them.
+    std::vector<value_type> tmp;
+    tmp.reserve(chunks_count * sorted_range_size);
+    for (size_t chunk = 0; chunk < chunks_count; ++chunk) {
+      const RandomAccessIterator chunk_first = first + chunk * chunk_size;
+      for (size_t i = 0; i < sorted_range_size; ++i) {
+        tmp.push_back(std::move(chunk_first[i]));
+      }
+    }
+    partial_sort(tmp.begin(), tmp.begin() + sorted_range_size, tmp.end(),
+        less_comparer);
+
+    // The first chunk starts at first, so the smallest items go to
+    // [first ... middle), while the rest of items fill the gaps
+    // in other chunks.
+    for (size_t chunk = 0; chunk < chunks_count; ++chunk) {
+      const RandomAccessIterator chunk_first = first + chunk * chunk_size;
+      _move_items(tmp.begin() + chunk * sorted_range_size,
+          tmp.begin() + (chunk + 1) * sorted_range_size, chunk_first);
+    }
+  }
+
+  // Performs partial sort using the given executor.
+  // Uses operator< for items' comparison.
+  template <class Executor, class RandomAccessIterator>
+  static void parallel_partial_sort(Executor &executor,
+      const RandomAccessIterator &first, const RandomAccessIterator &middle,
+      const RandomAccessIterator &last)
+  {
+    parallel_partial_sort(executor, first, middle, last,
+        _std_less_comparer<RandomAccessIterator>);
+  }
+
+  // Performs N-way merging of the given input ranges into the result sorted
+  // in ascending order using the given executor.
+  // Uses less_comparer for items' comparison.
+  //
+  // Input ranges must be defined as in nway_merge(), but unlike nway_merge()
+  // input ranges may be empty. Both input and output iterators must be
+  // random access iterators.
+  //
+  // The output is split into parts by splitter items sampled from input
+  // ranges. Each part is merged independently via nway_merge().
+  //
+  // Returns an iterator pointing to the next element in the result after
+  // the merge.
+  //
+  // As a side effect the function sets the first iterator for each input
+  // range to the end of the corresponding range.
+  template <class Executor, class RandomAccessIterator,
+      class OutputIterator, class LessComparer>
+  static OutputIterator parallel_nway_merge(Executor &executor,
+      const RandomAccessIterator &input_ranges_first,
+      const RandomAccessIterator &input_ranges_last,
+      const OutputIterator &result, const LessComparer &less_comparer,
+      const size_t min_chunk_size = 4096)
+  {
+    assert(input_ranges_first <= input_ranges_last);
+    assert(min_chunk_size > 0);
+
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        input_range;
+    typedef typename input_range::first_type input_iterator;
+    typedef typename std::iterator_traits<input_iterator>::value_type
+        value_type;
+
+    const size_t ranges_count = input_ranges_last - input_ranges_first;
+    size_t items_count = 0;
+    for (size_t i = 0; i < ranges_count; ++i) {
+      const input_range &r = input_ranges_first[i];
+      items_count += r.second - r.first;
+    }
+
+    size_t parts_count = items_count / min_chunk_size;
+    if (parts_count > executor.concurrency()) {
+      parts_count = executor.concurrency();
+    }
+    if (parts_count < 2) {
+      std::vector<input_range> ranges;
+      for (size_t i = 0; i < ranges_count; ++i) {
+        input_range &r = input_ranges_first[i];
+        if (r.first != r.second) {
+          ranges.push_back(r);
+        }
+        r.first = r.second;
+      }
+      if (ranges.empty()) {
+        return result;
+      }
+      return nway_merge(ranges.begin(), ranges.end(), result, less_comparer);
+    }
+
+    // Sample items from input ranges in order to obtain splitters,
+    // which divide the output into parts of approximately equal sizes.
+    static const size_t SAMPLES_PER_PART = 16;
+    size_t sample_step = items_count / (parts_count * SAMPLES_PER_PART);
+    if (sample_step == 0) {
+      sample_step = 1;
+    }
+    std::vector<value_type> samples;
+    size_t sample_index = sample_step / 2;
+    size_t range_offset = 0;
+    for (size_t i = 0; i < ranges_count; ++i) {
+      const input_range &r = input_ranges_first[i];
+      const size_t range_size = r.second - r.first;
+      while (sample_index < range_offset + range_size) {
+        samples.push_back(r.first[sample_index - range_offset]);
+        sample_index += sample_step;
+      }
+      range_offset += range_size;
+    }
+    assert(!samples.empty());
+    heapsort(samples.begin(), samples.end(), less_comparer);
+
+    // bounds[part * ranges_count + i] points to the first item of the i-th
+    // input range belonging to the given part.
+    std::vector<input_iterator> bounds((parts_count + 1) * ranges_count);
+    for (size_t i = 0; i < ranges_count; ++i) {
+      const input_range &r = input_ranges_first[i];
+      bounds[i] = r.first;
+      bounds[parts_count * ranges_count + i] = r.second;
+    }
+    executor.parallel_for(parts_count - 1, [&](const size_t j) {
+      const size_t part = j + 1;
+      const value_type &splitter =
+          samples[samples.size() * part / parts_count];
+      for (size_t i = 0; i < ranges_count; ++i) {
+        const input_range &r = input_ranges_first[i];
+        bounds[part * ranges_count + i] = std::lower_bound(r.first, r.second,
+            splitter, less_comparer);
+      }
+    });
+
+    executor.parallel_for(parts_count, [&](const size_t part) {
+      std::vector<input_range> ranges;
+      size_t output_offset = 0;
+      for (size_t i = 0; i < ranges_count; ++i) {
+        const input_range &r = input_ranges_first[i];
+        const input_iterator part_first = bounds[part * ranges_count + i];
+        const input_iterator part_last = bounds[(part + 1) * ranges_count + i];
+        output_offset += part_first - r.first;
+        if (part_first != part_last) {
+          ranges.push_back(input_range(part_first, part_last));
+        }
+      }
+      if (!ranges.empty()) {
+        nway_merge(ranges.begin(), ranges.end(), result + output_offset,
+            less_comparer);
+      }
+    });
+
+    for (size_t i = 0; i < ranges_count; ++i) {
+      input_range &r = input_ranges_first[i];
+      r.first = r.second;
+    }
+    return result + items_count;
+  }
+
+  // Performs N-way merging of the given input ranges into the result sorted
+  // in ascending order using the given executor.
+  // Uses operator< for items' comparison.
+  template <class Executor, class RandomAccessIterator, class OutputIterator>
+  static OutputIterator parallel_nway_merge(Executor &executor,
+      const RandomAccessIterator &input_ranges_first,
+      const RandomAccessIterator &input_ranges_last,
+      const OutputIterator &result)
+  {
+    typedef typename std::iterator_traits<RandomAccessIterator
+        >::value_type::first_type input_iterator;
+
+    return parallel_nway_merge(executor, input_ranges_first,
+        input_ranges_last, result, _std_less_comparer<input_iterator>);
+  }
+
+  // Performs n-way mergesort using the given executor.
+  // Uses less_comparer for items' comparison.
+  //
+  // The range is split into chunks, which are sorted concurrently
+  // via nway_mergesort(). Then sorted chunks are merged back via
+  // parallel_nway_merge().
+  //
+  // May raise std::bad_alloc on unsuccessful attempt to allocate a temporary
+  // buffer for (last - first) items.
+  template <class Executor, class RandomAccessIterator, class LessComparer>
+  static void parallel_nway_mergesort(Executor &executor,
+      const RandomAccessIterator &first, const RandomAccessIterator &last,
+      const LessComparer &less_comparer, const size_t min_chunk_size = 4096)
+  {
+    assert(first <= last);
+    assert(min_chunk_size > 0);
+
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        value_type;
+    typedef typename std::vector<value_type>::iterator tmp_iterator;
+    typedef std::pair<tmp_iterator, tmp_iterator> tmp_range;
+
+    const size_t range_size = last - first;
+    size_t chunks_count = range_size / min_chunk_size;
+    if (chunks_count > executor.concurrency()) {
+      chunks_count = executor.concurrency();
+    }
+    if (chunks_count < 2) {
+      nway_mergesort(first, last, less_comparer);
+      return;
+    }
+
+    const size_t chunk_size = range_size / chunks_count;
+    executor.parallel_for(chunks_count, [&](const size_t chunk) {
+      const RandomAccessIterator chunk_first = first + chunk * chunk_size;
+      const RandomAccessIterator chunk_last = (chunk == chunks_count - 1) ?
+          last : chunk_first + chunk_size;
+      nway_mergesort(chunk_first, chunk_last, less_comparer);
+    });
+
+    std::vector<value_type> tmp(std::make_move_iterator(first),
+        std::make_move_iterator(last));
+    std::vector<tmp_range> input_ranges;
+    for (size_t chunk = 0; chunk < chunks_count; ++chunk) {
+      const tmp_iterator chunk_first = tmp.begin() + chunk * chunk_size;
+      const tmp_iterator chunk_last = (chunk == chunks_count - 1) ?
+          tmp.end() : chunk_first + chunk_size;
+      input_ranges.push_back(tmp_range(chunk_first, chunk_last));
+    }
+    parallel_nway_merge(executor, input_ranges.begin(), input_ranges.end(),
+        first, less_comparer, min_chunk_size);
+  }
+
+  // Performs n-way mergesort using the given executor.
+  // Uses operator< for items' comparison.
+  //
+  // May raise std::bad_alloc on unsuccessful attempt to allocate a temporary
+  // buffer for (last - first) items.
+  template <class Executor, class RandomAccessIterator>
+  static void parallel_nway_mergesort(Executor &executor,
+      const RandomAccessIterator &first, const RandomAccessIterator &last)
+  {
+    parallel_nway_mergesort(executor, first, last,
+        _std_less_comparer<RandomAccessIterator>);
+  }
+#endif
 };
 #endif
@@ -0,0 +1,432 @@
+#ifndef GASYNC_ALGORITHM_H
+#define GASYNC_ALGORITHM_H
+
+// Asynchronous algorithms based on Heap, which use C++20 coroutines.
+//
+// gasync_generator<T> is an asynchronous generator. It is a coroutine,
+// which passes values to its consumer via co_yield and may co_await
+// arbitrary awaitables (I/O completions, timers, etc.) between values.
+// The consumer obtains values in a coroutine via the following loop:
+//
+//   bool has_value = co_await g.next();
+//   while (has_value) {
+//     consume(g.value());
+//     has_value = co_await g.next();
+//   }
+//
+// Avoid co_await in if and while conditions if the coroutine may be resumed
+// on another thread: GCC 12 doesn't keep the awaiter there in the coroutine
+// frame.
+//
+// The consumer may call g.prefetch() after consuming a value, so
+// the generator starts producing the next value (for example, issues
+// the next read) while the consumer processes the current one.
+// The prefetched generator may be resumed on another thread (for example,
+// by an I/O completion thread). It resumes the consumer on that thread
+// if the consumer already waits for the value.
+//
+// gasync_algorithm<Heap>::nway_merge() merges asynchronous inputs yielding
+// blocks of sorted items into an asynchronous generator yielding blocks
+// of merged items. So merging overlaps with I/O performed by the inputs:
+// the next block of each input is prefetched while its current block
+// is being merged.
+//
+// The implementation requires C++20 coroutines, so pass -std=c++20
+// and -DGHEAP_CPP11 to compiler.
+//
+// Don't forget passing -DNDEBUG option to the compiler when creating optimized
+// builds. This significantly speeds up the code by removing debug assertions.
+
+#ifndef GHEAP_CPP11
+#  error "gasync_algorithm.hpp requires C++11 (-DGHEAP_CPP11)"
+#endif
+
+#ifndef __cpp_impl_coroutine
+#  error "gasync_algorithm.hpp requires C++20 coroutines (-std=c++20)"
+#endif
+
+#include "gheap.hpp"
+
+#include <atomic>       // for std::atomic
+#include <cassert>      // for assert
+#include <coroutine>    // for std::coroutine_handle, std::suspend_always
+#include <cstddef>      // for size_t
+#include <exception>    // for std::exception_ptr
+#include <functional>   // for std::less
+#include <utility>      // for std::move(), std::swap()
+#include <vector>       // for std::vector
+
+template <class T>
+class gasync_generator
+{
+public:
+
+  typedef T value_type;
+
+  class promise_type
+  {
+  private:
+
+    friend class gasync_generator;
+
+    // Resumes the consumer after the generator suspends on co_yield
+    // or finishes, unless the consumer hasn't been suspended on next() yet.
+    struct _consumer_awaiter
+    {
+      bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> h) const noexcept
+      {
+        promise_type &p = h.promise();
+        if (p._is_handed_off.exchange(true, std::memory_order_acq_rel)) {
+          return p._consumer;
+        }
+        // The consumer obtains the value when it calls next().
+        return std::noop_coroutine();
+      }
+
+      void await_resume() const noexcept {}
+    };
+
+    // Points to the yielded value, which lives in the generator frame
+    // until the generator is resumed.
+    T *_value = 0;
+    std::coroutine_handle<> _consumer = std::noop_coroutine();
+    std::exception_ptr _exception;
+
+    // Whether the generator has been resumed via prefetch() and the value
+    // hasn't been obtained via next() yet. It is accessed only
+    // by the consumer.
+    bool _is_prefetched = false;
+
+    // Whether either the consumer has been suspended on next() or
+    // the generator has yielded a value or finished. The other party
+    // resumes the consumer. The prefetched generator may run on another
+    // thread, so the consumer handle is passed via this flag.
+    std::atomic<bool> _is_handed_off{false};
+
+  public:
+
+    gasync_generator get_return_object()
+    {
+      return gasync_generator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept
+    {
+      return std::suspend_always();
+    }
+
+    _consumer_awaiter final_suspend() const noexcept
+    {
+      return _consumer_awaiter();
+    }
+
+    _consumer_awaiter yield_value(T &value) noexcept
+    {
+      _value = &value;
+      return _consumer_awaiter();
+    }
+
+    _consumer_awaiter yield_value(T &&value) noexcept
+    {
+      _value = &value;
+      return _consumer_awaiter();
+    }
+
+    void return_void() noexcept {}
+
+    void unhandled_exception() noexcept
+    {
+      _exception = std::current_exception();
+    }
+  };
+
+private:
+
+  // Resumes the generator until the next value or the end.
+  // Doesn't resume the generator if it has been resumed via prefetch().
+  class _next_awaiter
+  {
+  private:
+    std::coroutine_handle<promise_type> _h;
+
+  public:
+    explicit _next_awaiter(const std::coroutine_handle<promise_type> h) :
+        _h(h) {}
+
+    bool await_ready() const noexcept
+    {
+      const promise_type &p = _h.promise();
+      return (p._is_prefetched &&
+          p._is_handed_off.load(std::memory_order_acquire));
+    }
+
+    std::coroutine_handle<> await_suspend(
+        const std::coroutine_handle<> consumer) noexcept
+    {
+      promise_type &p = _h.promise();
+      p._consumer = consumer;
+      if (!p._is_prefetched) {
+        p._is_handed_off.store(true, std::memory_order_relaxed);
+        return _h;
+      }
+      if (p._is_handed_off.exchange(true, std::memory_order_acq_rel)) {
+        // The generator has yielded the value since await_ready().
+        return consumer;
+      }
+      // The generator is suspended on something else. It resumes
+      // the consumer when it yields the value.
+      return std::noop_coroutine();
+    }
+
+    bool await_resume() const
+    {
+      promise_type &p = _h.promise();
+      p._is_prefetched = false;
+      p._is_handed_off.store(false, std::memory_order_relaxed);
+      if (p._exception) {
+        std::rethrow_exception(p._exception);
+      }
+      return !_h.done();
+    }
+  };
+
+  std::coroutine_handle<promise_type> _h;
+
+  explicit gasync_generator(const std::coroutine_handle<promise_type> h) :
+      _h(h) {}
+
+public:
+
+  gasync_generator() : _h() {}
+
+  gasync_generator(gasync_generator &&g) noexcept : _h(g._h)
+  {
+    g._h = std::coroutine_handle<promise_type>();
+  }
+
+  gasync_generator &operator = (gasync_generator &&g) noexcept
+  {
+    std::swap(_h, g._h);
+    return *this;
+  }
+
+  ~gasync_generator()
+  {
+    if (_h) {
+      _h.destroy();
+    }
+  }
+
+  gasync_generator(const gasync_generator &) = delete;
+  gasync_generator &operator = (const gasync_generator &) = delete;
+
+  // Returns an awaitable, which resumes the generator until it yields
+  // the next value. co_await returns false if the generator is finished.
+  //
+  // The generator may finish during prefetch(), so the following next()
+  // is allowed on the finished generator.
+  //
+  // Rethrows exceptions thrown by the generator.
+  _next_awaiter next()
+  {
+    assert(_h);
+    assert(_h.promise()._is_prefetched || !_h.done());
+
+    return _next_awaiter(_h);
+  }
+
+  // Resumes the generator until it yields the next value, finishes
+  // or suspends on something else, and returns without waiting
+  // for the value. The value is obtained via the following next().
+  //
+  // The current value is invalidated, so move it out before calling
+  // prefetch().
+  void prefetch()
+  {
+    assert(_h);
+    assert(!_h.done());
+    assert(!_h.promise()._is_prefetched);
+
+    promise_type &p = _h.promise();
+    p._is_prefetched = true;
+    _h.resume();
+  }
+
+  // Returns true if the value requested via prefetch() is available,
+  // so the following next() completes without suspending.
+  bool is_ready() const
+  {
+    assert(_h);
+
+    const promise_type &p = _h.promise();
+    return (p._is_prefetched &&
+        p._is_handed_off.load(std::memory_order_acquire));
+  }
+
+  // Returns the value yielded by the generator.
+  //
+  // The consumer may move the value out until the next call to next()
+  // or prefetch().
+  T &value() const
+  {
+    assert(_h);
+    assert(!_h.done());
+
+    return *(_h.promise()._value);
+  }
+};
+
+template <class Heap = gheap<> >
+class gasync_algorithm
+{
+private:
+
+  // Sorted block obtained from an input and the position of the next item
+  // in the block.
+  template <class T>
+  struct _window
+  {
+    std::vector<T> block;
+    size_t position;
+  };
+
+  // Less comparer for windows' indexes in nway_merge().
+  template <class T, class LessComparer>
+  class _window_less_comparer
+  {
+  private:
+    const std::vector<_window<T> > &_windows;
+    const LessComparer &_less_comparer;
+
+  public:
+    _window_less_comparer(const std::vector<_window<T> > &windows,
+        const LessComparer &less_comparer) :
+            _windows(windows), _less_comparer(less_comparer) {}
+
+    bool operator() (const size_t a, const size_t b) const
+    {
+      const _window<T> &window_a = _windows[a];
+      const _window<T> &window_b = _windows[b];
+      assert(window_a.position < window_a.block.size());
+      assert(window_b.position < window_b.block.size());
+
+      return _less_comparer(window_b.block[window_b.position],
+          window_a.block[window_a.position]);
+    }
+  };
+
+public:
+
+  // Performs N-way merging of the given asynchronous inputs into
+  // an asynchronous generator yielding blocks of items sorted
+  // in ascending order.
+  // Uses less_comparer for items' comparison.
+  //
+  // Each input must yield blocks of items sorted in ascending order,
+  // so the concatenation of all the blocks yielded by the input is sorted.
+  // Inputs may yield empty blocks. Yielded blocks are moved out of inputs.
+  //
+  // The merge keeps the current block of each input as a buffered window
+  // and prefetches the next block of the input while the window is being
+  // merged. So the merge suspends on an input only when its window drains
+  // before the next block is ready.
+  //
+  // Output blocks contain up to output_block_size items. The consumer
+  // may move output blocks out.
+  template <class T, class LessComparer>
+  static gasync_generator<std::vector<T> > nway_merge(
+      std::vector<gasync_generator<std::vector<T> > > inputs,
+      const LessComparer less_comparer, const size_t output_block_size)
+  {
+    assert(output_block_size > 0);
+
+    const size_t inputs_count = inputs.size();
+    std::vector<_window<T> > windows(inputs_count);
+    const _window_less_comparer<T, LessComparer> less(windows, less_comparer);
+
+    // Indexes of inputs with non-empty windows ordered by the next item.
+    std::vector<size_t> heap;
+    heap.reserve(inputs_count);
+    for (size_t i = 0; i < inputs_count; ++i) {
+      // Start fetching first blocks from all the inputs at once.
+      inputs[i].prefetch();
+    }
+    for (size_t i = 0; i < inputs_count; ++i) {
+      bool has_block = co_await inputs[i].next();
+      while (has_block) {
+        windows[i].block = std::move(inputs[i].value());
+        windows[i].position = 0;
+        if (!windows[i].block.empty()) {
+          inputs[i].prefetch();
+          heap.push_back(i);
+          break;
+        }
+        has_block = co_await inputs[i].next();
+      }
+    }
+    Heap::make_heap(heap.begin(), heap.end(), less);
+
+    std::vector<T> output;
+    output.reserve(output_block_size);
+    while (!heap.empty()) {
+      const size_t i = heap[0];
+      _window<T> &window = windows[i];
+      output.push_back(std::move(window.block[window.position]));
+      ++window.position;
+
+      if (window.position == window.block.size()) {
+        // Suspend until the input provides the next non-empty block
+        // unless it has been already prefetched.
+        bool is_drained = true;
+        bool has_block = co_await inputs[i].next();
+        while (has_block) {
+          window.block = std::move(inputs[i].value());
+          window.position = 0;
+          if (!window.block.empty()) {
+            inputs[i].prefetch();
+            is_drained = false;
+            break;
+          }
+          has_block = co_await inputs[i].next();
+        }
+        if (is_drained) {
+          heap[0] = heap.back();
+          heap.pop_back();
+        }
+      }
+      if (!heap.empty()) {
+        Heap::restore_heap_after_item_decrease(heap.begin(), heap.begin(),
+            heap.end(), less);
+      }
+
+      if (output.size() == output_block_size) {
+        co_yield output;
+        output.clear();
+        output.reserve(output_block_size);
+      }
+    }
+    if (!output.empty()) {
+      co_yield output;
+    }
+  }
+
+  // Performs N-way merging of the given asynchronous inputs into
+  // an asynchronous generator yielding blocks of items sorted
+  // in ascending order.
+  // Uses operator< for items' comparison.
+  template <class T>
+  static gasync_generator<std::vector<T> > nway_merge(
+      std::vector<gasync_generator<std::vector<T> > > inputs,
+      const size_t output_block_size)
+  {
+    return nway_merge(std::move(inputs), std::less<T>(), output_block_size);
+  }
+};
+#endif
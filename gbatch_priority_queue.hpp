@@ -0,0 +1,233 @@
+#ifndef GBATCH_PRIORITY_QUEUE_H
+#define GBATCH_PRIORITY_QUEUE_H
+
+// Priority queue on top of Heap with batch-parallel operations.
+//
+// Besides gpriority_queue interface, the queue supports inserting
+// a batch of items via insert_batch() and extracting the k top items
+// via extract_k(). Batch operations are executed by parallel algorithms
+// from galgorithm.hpp on the executor passed to the constructor.
+// See gthread_pool.hpp for executors.
+//
+// Batch operations choose between per-item heap operations and parallel
+// algorithms depending on batch size:
+// - insert_batch() rebuilds the heap via parallel_make_heap() if the batch
+//   is big enough, so per-item push_heap() calls would cost more than
+//   the rebuild.
+// - extract_k() selects the k top items via parallel_partial_sort()
+//   and rebuilds the heap from the rest of items via parallel_make_heap()
+//   if k is big enough, so per-item pop_heap() calls would cost more.
+//   The rebuild is O(n), but it is performed only if k * log2(n) > n,
+//   i.e. it costs O(log n) per extracted item like pop_heap().
+//   Selecting the k top items from the frontier of candidates at the top
+//   of the heap and restoring only the affected part of the heap doesn't
+//   pay off: the selection needs a heap of up to Fanout * k candidates,
+//   so it was measured to be 1.5-2.5x slower than k pop_heap() calls.
+// Results are exact in both cases.
+//
+// The implementation requires C++11, so pass -DGHEAP_CPP11 to compiler.
+//
+// Don't forget passing -DNDEBUG option to the compiler when creating optimized
+// builds. This significantly speeds up the code by removing debug assertions.
+
+#ifndef GHEAP_CPP11
+#  error "gbatch_priority_queue.hpp requires C++11 (-DGHEAP_CPP11)"
+#endif
+
+#include "galgorithm.hpp"
+
+#include <cassert>
+#include <cstddef>      // for size_t
+#include <functional>   // for std::less
+#include <utility>      // for std::swap(), std::move()
+#include <vector>
+
+template <class Heap, class T, class Executor,
+    class Container = std::vector<T>,
+    class LessComparer = std::less<typename Container::value_type> >
+class gbatch_priority_queue
+{
+public:
+
+  typedef Container container_type;
+  typedef typename Container::value_type value_type;
+  typedef typename Container::size_type size_type;
+  typedef typename Container::reference reference;
+  typedef typename Container::const_reference const_reference;
+
+  LessComparer comp;
+  Container c;
+
+private:
+
+  typedef galgorithm<Heap> _algorithm;
+
+  // Inverts the given less comparer, so partial sort puts the top items
+  // first.
+  class _greater_comparer
+  {
+  private:
+    const LessComparer &_less_comparer;
+
+  public:
+    _greater_comparer(const LessComparer &less_comparer) :
+        _less_comparer(less_comparer) {}
+
+    bool operator() (const value_type &a, const value_type &b) const
+    {
+      return _less_comparer(b, a);
+    }
+  };
+
+  Executor *_executor;
+  size_t _min_chunk_size;
+
+  // Returns floor(log2(n)) for n > 0.
+  static size_t _log2(size_t n)
+  {
+    assert(n > 0);
+
+    size_t log2 = 0;
+    while (n > 1) {
+      n >>= 1;
+      ++log2;
+    }
+    return log2;
+  }
+
+  // Returns true if items_count per-item heap operations on a heap
+  // containing heap_size items cost more than rebuilding the heap.
+  static bool _should_rebuild(const size_t items_count, const size_t heap_size)
+  {
+    return (heap_size > 0 && items_count * _log2(heap_size) > heap_size);
+  }
+
+  void _make_heap()
+  {
+    _algorithm::parallel_make_heap(*_executor, c.begin(), c.end(), comp,
+        _min_chunk_size);
+  }
+
+public:
+
+  // Creates a queue, which runs batch operations on the given executor.
+  // Ranges are split into chunks containing at least min_chunk_size items
+  // as described in galgorithm.hpp.
+  explicit gbatch_priority_queue(Executor &executor,
+      const LessComparer &less_comparer = LessComparer(),
+      const Container &container = Container(),
+      const size_t min_chunk_size = 4096) :
+          comp(less_comparer), c(container), _executor(&executor),
+          _min_chunk_size(min_chunk_size)
+  {
+    assert(min_chunk_size > 0);
+
+    _make_heap();
+  }
+
+  bool empty() const
+  {
+    return c.empty();
+  }
+
+  size_type size() const
+  {
+    return c.size();
+  }
+
+  const_reference top() const
+  {
+    assert(!empty());
+
+    return c.front();
+  }
+
+  void push(const T &v)
+  {
+    c.push_back(v);
+    Heap::push_heap(c.begin(), c.end(), comp);
+  }
+
+  void push(T &&v)
+  {
+    c.push_back(std::move(v));
+    Heap::push_heap(c.begin(), c.end(), comp);
+  }
+
+  void pop()
+  {
+    assert(!empty());
+
+    Heap::pop_heap(c.begin(), c.end(), comp);
+    c.pop_back();
+  }
+
+  // Inserts items from the [first ... last) range into the queue.
+  template <class InputIterator>
+  void insert_batch(const InputIterator &first, const InputIterator &last)
+  {
+    const size_t old_size = c.size();
+    c.insert(c.end(), first, last);
+    const size_t new_size = c.size();
+
+    if (_should_rebuild(new_size - old_size, new_size)) {
+      _make_heap();
+      return;
+    }
+    for (size_t i = old_size; i < new_size; ++i) {
+      Heap::push_heap(c.begin(), c.begin() + (i + 1), comp);
+    }
+  }
+
+  // Moves the k top items into the result in descending order
+  // and removes them from the queue.
+  // Returns the iterator pointing to the end of the result.
+  template <class OutputIterator>
+  OutputIterator extract_k(const size_t k, OutputIterator result)
+  {
+    assert(k <= size());
+
+    if (!_should_rebuild(k, c.size())) {
+      for (size_t i = 0; i < k; ++i) {
+        Heap::pop_heap(c.begin(), c.end(), comp);
+        *result = std::move(c.back());
+        ++result;
+        c.pop_back();
+      }
+      return result;
+    }
+
+    _algorithm::parallel_partial_sort(*_executor, c.begin(), c.begin() + k,
+        c.end(), _greater_comparer(comp), _min_chunk_size);
+    for (size_t i = 0; i < k; ++i) {
+      *result = std::move(c[i]);
+      ++result;
+    }
+    c.erase(c.begin(), c.begin() + k);
+    _make_heap();
+    return result;
+  }
+
+  void swap(gbatch_priority_queue &q)
+  {
+    std::swap(c, q.c);
+    std::swap(comp, q.comp);
+    std::swap(_executor, q._executor);
+    std::swap(_min_chunk_size, q._min_chunk_size);
+  }
+
+  // Copy constructors and assignment operators are implicitly defined.
+};
+
+namespace std
+{
+  template <class Heap, class T, class Executor, class Container,
+      class LessComparer>
+  void swap(
+      gbatch_priority_queue<Heap, T, Executor, Container, LessComparer> &a,
+      gbatch_priority_queue<Heap, T, Executor, Container, LessComparer> &b)
+  {
+    a.swap(b);
+  }
+}
+#endif
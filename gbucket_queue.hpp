@@ -0,0 +1,341 @@
+#ifndef GBUCKET_QUEUE_H
+#define GBUCKET_QUEUE_H
+
+// Bucket queue for items with small integer priorities.
+//
+// See http://en.wikipedia.org/wiki/Bucket_queue .
+//
+// Priorities must be in the range [0 ... PriorityLevels). Each priority
+// has a FIFO bucket, so items with equal priorities are popped in the order
+// they were pushed. Non-empty buckets are tracked by hierarchical bitmap
+// with 64 bits per word, so the bucket with the maximum priority is found
+// in O(log64(PriorityLevels)) time, i.e. in a few instructions for priority
+// domains such as [0 ... 256) or [0 ... 4096).
+// Buckets are backed by a shared arena of list nodes, so push() and pop()
+// don't allocate memory after the arena grows to the queue's peak size.
+// Popped items remain in the arena until their nodes are reused.
+//
+// Items are copy-constructed into new nodes and assigned to reused nodes,
+// so T must be copyable, but needn't be default constructible.
+//
+// The queue exposes the same interface as gpriority_queue, so it can be used
+// as a drop-in replacement in cases when priorities fit small integer domain.
+//
+// Pass -DGHEAP_CPP11 to compiler for enabling C++11 optimization,
+// otherwise C++03 optimization will be enabled.
+
+#include <algorithm>   // for std::swap()
+#include <cassert>     // for assert
+#include <cstddef>     // for size_t
+#include <stdint.h>    // for uint64_t (<cstdint> is missing in C++03).
+#include <vector>      // for std::vector
+
+#ifdef GHEAP_CPP11
+#  include <utility>   // for std::move()
+#endif
+
+// Default priority getter for gbucket_queue. It is suitable for integer items,
+// which are priorities on their own.
+template <class T>
+struct gbucket_queue_priority_getter
+{
+  size_t operator() (const T &item) const
+  {
+    return (size_t)item;
+  }
+};
+
+template <size_t PriorityLevels, class T,
+    class PriorityGetter = gbucket_queue_priority_getter<T> >
+class gbucket_queue
+{
+public:
+
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef T &reference;
+  typedef const T &const_reference;
+
+  static const size_t PRIORITY_LEVELS = PriorityLevels;
+
+  PriorityGetter get_priority;
+
+private:
+
+  // The number of words at each bitmap level. The bitmap may contain up to
+  // 4 levels, so up to 64^4 priority levels are supported.
+  static const size_t _L0_WORDS = (PriorityLevels + 63) / 64;
+  static const size_t _L1_WORDS = (_L0_WORDS + 63) / 64;
+  static const size_t _L2_WORDS = (_L1_WORDS + 63) / 64;
+  static const size_t _L3_WORDS = (_L2_WORDS + 63) / 64;
+
+  static const size_t _LEVELS = (_L0_WORDS == 1) ? 1 :
+      ((_L1_WORDS == 1) ? 2 : ((_L2_WORDS == 1) ? 3 : 4));
+  static const size_t _BITMAP_WORDS =
+      _L0_WORDS + _L1_WORDS + _L2_WORDS + _L3_WORDS;
+
+  // Compile-time check for PriorityLevels.
+  typedef char _priority_levels_must_be_in_range[
+      (PriorityLevels > 0 && _L3_WORDS == 1) ? 1 : -1];
+
+  // An empty list terminator.
+  static const size_t _NIL = ~(size_t)0;
+
+  struct _node
+  {
+    T item;
+    size_t next;
+  };
+
+  struct _bucket
+  {
+    size_t head;
+    size_t tail;
+  };
+
+  // The arena of list nodes shared among all the buckets.
+  std::vector<_node> _nodes;
+
+  // The list of free nodes in the arena.
+  size_t _free_head;
+
+  std::vector<_bucket> _buckets;
+
+  // Hierarchical bitmap of non-empty buckets. Level 0 contains a bit per
+  // bucket. Each bit at level N+1 is set if the corresponding word at level N
+  // is non-zero.
+  uint64_t _bitmap[_BITMAP_WORDS];
+
+  size_t _size;
+
+  // The maximum priority among items in the queue.
+  size_t _top_priority;
+
+  static size_t _get_level_offset(const size_t level)
+  {
+    assert(level < 4);
+
+    const size_t offsets[4] = {
+        0, _L0_WORDS, _L0_WORDS + _L1_WORDS,
+        _L0_WORDS + _L1_WORDS + _L2_WORDS};
+    return offsets[level];
+  }
+
+  // Returns the index of the most significant non-zero bit in the word.
+  static size_t _get_max_bit(const uint64_t word)
+  {
+    assert(word != 0);
+
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(word);
+#else
+    size_t bit = 0;
+    for (uint64_t w = word; w > 1; w >>= 1) {
+      ++bit;
+    }
+    return bit;
+#endif
+  }
+
+  void _set_bucket_bit(size_t priority)
+  {
+    for (size_t level = 0; level < _LEVELS; ++level) {
+      uint64_t &word = _bitmap[_get_level_offset(level) + priority / 64];
+      const uint64_t old_word = word;
+      word |= ((uint64_t)1) << (priority % 64);
+      if (old_word != 0) {
+        break;
+      }
+      priority /= 64;
+    }
+  }
+
+  void _clear_bucket_bit(size_t priority)
+  {
+    for (size_t level = 0; level < _LEVELS; ++level) {
+      uint64_t &word = _bitmap[_get_level_offset(level) + priority / 64];
+      word &= ~(((uint64_t)1) << (priority % 64));
+      if (word != 0) {
+        break;
+      }
+      priority /= 64;
+    }
+  }
+
+  // Returns the maximum priority of non-empty buckets.
+  size_t _find_top_priority() const
+  {
+    assert(_size > 0);
+
+    size_t priority = 0;
+    for (size_t level = _LEVELS; level > 0; --level) {
+      const uint64_t word =
+          _bitmap[_get_level_offset(level - 1) + priority];
+      priority = priority * 64 + _get_max_bit(word);
+    }
+    assert(priority < PriorityLevels);
+    return priority;
+  }
+
+  // Stores the item in a free node of the arena. Returns the node index.
+  size_t _alloc_node(const T &v)
+  {
+    if (_free_head != _NIL) {
+      const size_t node_index = _free_head;
+      _free_head = _nodes[node_index].next;
+      _nodes[node_index].item = v;
+      return node_index;
+    }
+    const _node node = {v, _NIL};
+    _nodes.push_back(node);
+    return _nodes.size() - 1;
+  }
+
+#ifdef GHEAP_CPP11
+  size_t _alloc_node(T &&v)
+  {
+    if (_free_head != _NIL) {
+      const size_t node_index = _free_head;
+      _free_head = _nodes[node_index].next;
+      _nodes[node_index].item = std::move(v);
+      return node_index;
+    }
+    _nodes.push_back(_node{std::move(v), _NIL});
+    return _nodes.size() - 1;
+  }
+#endif
+
+  // Appends the node to the bucket for the given priority.
+  void _push_node(const size_t node_index, const size_t priority)
+  {
+    assert(priority < PriorityLevels);
+
+    _nodes[node_index].next = _NIL;
+    _bucket &b = _buckets[priority];
+    if (b.head == _NIL) {
+      b.head = node_index;
+      _set_bucket_bit(priority);
+    }
+    else {
+      _nodes[b.tail].next = node_index;
+    }
+    b.tail = node_index;
+
+    if (_size == 0 || priority > _top_priority) {
+      _top_priority = priority;
+    }
+    ++_size;
+  }
+
+  void _init()
+  {
+    _free_head = _NIL;
+    _bucket empty_bucket;
+    empty_bucket.head = _NIL;
+    empty_bucket.tail = _NIL;
+    _buckets.assign(PriorityLevels, empty_bucket);
+    for (size_t i = 0; i < _BITMAP_WORDS; ++i) {
+      _bitmap[i] = 0;
+    }
+    _size = 0;
+    _top_priority = 0;
+  }
+
+public:
+
+  explicit gbucket_queue(
+      const PriorityGetter &priority_getter = PriorityGetter()) :
+          get_priority(priority_getter)
+  {
+    _init();
+  }
+
+  template <class InputIterator>
+  gbucket_queue(const InputIterator &first, const InputIterator &last,
+      const PriorityGetter &priority_getter = PriorityGetter()) :
+          get_priority(priority_getter)
+  {
+    _init();
+    for (InputIterator it = first; it != last; ++it) {
+      push(*it);
+    }
+  }
+
+  bool empty() const
+  {
+    return (_size == 0);
+  }
+
+  size_type size() const
+  {
+    return _size;
+  }
+
+  const_reference top() const
+  {
+    assert(!empty());
+
+    return _nodes[_buckets[_top_priority].head].item;
+  }
+
+  void push(const T &v)
+  {
+    const size_t node_index = _alloc_node(v);
+    _push_node(node_index, get_priority(v));
+  }
+
+  void pop()
+  {
+    assert(!empty());
+
+    _bucket &b = _buckets[_top_priority];
+    const size_t node_index = b.head;
+    b.head = _nodes[node_index].next;
+    _nodes[node_index].next = _free_head;
+    _free_head = node_index;
+    --_size;
+
+    if (b.head == _NIL) {
+      b.tail = _NIL;
+      _clear_bucket_bit(_top_priority);
+      if (_size > 0) {
+        _top_priority = _find_top_priority();
+      }
+    }
+  }
+
+  void swap(gbucket_queue &q)
+  {
+    std::swap(get_priority, q.get_priority);
+    _nodes.swap(q._nodes);
+    std::swap(_free_head, q._free_head);
+    _buckets.swap(q._buckets);
+    for (size_t i = 0; i < _BITMAP_WORDS; ++i) {
+      std::swap(_bitmap[i], q._bitmap[i]);
+    }
+    std::swap(_size, q._size);
+    std::swap(_top_priority, q._top_priority);
+  }
+
+#ifdef GHEAP_CPP11
+  void push(T &&v)
+  {
+    const size_t node_index = _alloc_node(std::move(v));
+    _push_node(node_index, get_priority(_nodes[node_index].item));
+  }
+#endif
+
+  // Copy constructors and assignment operators are implicitly defined.
+};
+
+namespace std
+{
+  template <size_t PriorityLevels, class T, class PriorityGetter>
+  void swap(
+      gbucket_queue<PriorityLevels, T, PriorityGetter> &a,
+      gbucket_queue<PriorityLevels, T, PriorityGetter> &b)
+  {
+    a.swap(b);
+  }
+}
+#endif
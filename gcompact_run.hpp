@@ -0,0 +1,765 @@
+#ifndef GCOMPACT_RUN_HPP
+#define GCOMPACT_RUN_HPP
+
+// Compact file format for sorted runs of integer keys.
+//
+// External sorts and spilling queues write runs of sorted items, which are
+// highly compressible, since deltas between adjacent items are small.
+// The format splits a run into blocks. Each block stores its first key
+// and deltas between adjacent keys bit-packed with the minimum bit width
+// required by the biggest delta in the block. Blocks are followed by
+// the index containing offset, min and max key of each block, so readers
+// may seek to the block containing the given key without reading preceding
+// blocks. Every block and the index are protected by CRC-32.
+//
+// File layout. All integers are little-endian:
+//
+//   block:  u32 items_count, u8 bit_width, u8 reserved[3], u64 first_key,
+//           u32 payload_size, u32 crc32 (of the preceding 20 bytes
+//           and the payload), payload (items_count - 1 bit-packed deltas)
+//   index:  u64 offset, u64 min_key, u64 max_key, u32 items_count
+//           for each block
+//   footer: u64 index_offset, u64 blocks_count, u64 items_count,
+//           u32 index_crc32, u32 reserved, u8 magic[8] ("GHEAPRUN")
+//
+// Signed keys are stored with flipped sign bit, so stored keys preserve
+// the order of original keys.
+//
+// gcompact_run_writer<T> may be used as the output of galgorithm::nway_merge()
+// and galgorithm::nway_mergesort() via std::back_inserter().
+// gcompact_run_reader<T> provides input ranges for galgorithm::nway_merge().
+//
+// Usage:
+//
+//   gcompact_run_writer<int> writer(file);
+//   galgorithm<Heap>::nway_merge(input_ranges.begin(), input_ranges.end(),
+//       std::back_inserter(writer));
+//   writer.finish();
+//
+//   gcompact_run_reader<int> reader(file);
+//   input_ranges.push_back(reader.get_input_range());
+//
+// Both classes throw std::runtime_error on I/O errors and on corrupted data.
+
+#include <cassert>
+#include <cstddef>     // for size_t, ptrdiff_t
+#include <cstdio>      // for std::FILE, std::fread(), std::fwrite(), ...
+#include <cstring>     // for memcmp()
+#include <iterator>    // for std::input_iterator_tag
+#include <limits>      // for std::numeric_limits
+#include <stdexcept>   // for std::runtime_error
+#include <stdint.h>    // for uint8_t, uint32_t, uint64_t, int64_t
+#include <utility>     // for std::pair
+#include <vector>      // for std::vector
+
+// Internal constants and helpers shared by the reader and the writer.
+struct _gcompact_run
+{
+  static const size_t block_header_size = 24;
+  static const size_t index_entry_size = 28;
+  static const size_t footer_size = 40;
+
+  // The maximum number of bits processed at once by bit packing routines.
+  // Bit accumulators contain less than 8 bits between steps, so the step
+  // never overflows 64-bit accumulators.
+  static const unsigned max_bits_step = 56;
+
+  static const char *get_magic()
+  {
+    return "GHEAPRUN";
+  }
+
+  static unsigned get_bits_step(const unsigned bits)
+  {
+    return (bits < max_bits_step) ? bits : unsigned(max_bits_step);
+  }
+
+  static uint64_t get_mask(const unsigned bits)
+  {
+    assert(bits <= max_bits_step);
+    return (static_cast<uint64_t>(1) << bits) - 1;
+  }
+
+  static unsigned get_bit_width(const uint64_t value)
+  {
+    unsigned bits = 0;
+    while (bits < 64 && (value >> bits) != 0) {
+      ++bits;
+    }
+    return bits;
+  }
+
+  static void put_u32(std::vector<uint8_t> &buffer, const uint32_t value)
+  {
+    for (unsigned i = 0; i < 4; ++i) {
+      buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  static void put_u64(std::vector<uint8_t> &buffer, const uint64_t value)
+  {
+    for (unsigned i = 0; i < 8; ++i) {
+      buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  static uint32_t get_u32(const uint8_t *const data)
+  {
+    uint32_t value = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+      value |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  static uint64_t get_u64(const uint8_t *const data)
+  {
+    uint64_t value = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+      value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  static size_t get_payload_size(const uint32_t items_count,
+      const unsigned bit_width)
+  {
+    assert(items_count > 0);
+    return static_cast<size_t>(
+        (static_cast<uint64_t>(items_count - 1) * bit_width + 7) / 8);
+  }
+};
+
+// CRC-32 (IEEE 802.3) with lookup table.
+struct _gcompact_run_crc32
+{
+  // Updates crc with the given data. Start with zero crc.
+  static uint32_t update(uint32_t crc, const uint8_t *const data,
+      const size_t size)
+  {
+    // The table for the reversed polynomial 0xedb88320. It is constant
+    // initialized, so it is shared by all the readers and writers.
+    static const uint32_t table[256] = {
+      0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
+      0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+      0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
+      0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+      0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
+      0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+      0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
+      0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+      0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
+      0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+      0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
+      0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+      0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
+      0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+      0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
+      0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+      0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
+      0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+      0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
+      0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+      0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
+      0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+      0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
+      0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+      0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
+      0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+      0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
+      0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+      0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
+      0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+      0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
+      0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+      0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+      0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+      0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
+      0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+      0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
+      0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+      0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
+      0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+      0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
+      0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+      0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+      crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+  }
+};
+
+// Order-preserving conversion between keys and unsigned 64-bit integers.
+template <class T, bool IsSigned = std::numeric_limits<T>::is_signed>
+struct _gcompact_run_key
+{
+  static uint64_t encode(const T &key)
+  {
+    return static_cast<uint64_t>(key);
+  }
+
+  static T decode(const uint64_t key)
+  {
+    return static_cast<T>(key);
+  }
+};
+
+template <class T>
+struct _gcompact_run_key<T, true>
+{
+  static uint64_t encode(const T &key)
+  {
+    return static_cast<uint64_t>(static_cast<int64_t>(key)) ^
+        (static_cast<uint64_t>(1) << 63);
+  }
+
+  static T decode(const uint64_t key)
+  {
+    return static_cast<T>(static_cast<int64_t>(
+        key ^ (static_cast<uint64_t>(1) << 63)));
+  }
+};
+
+// Writes a sorted run of items in compact format to the given file.
+//
+// T must be an integer type not wider than 64 bits. Items must be pushed
+// in ascending order. Call finish() after the last item, otherwise
+// the file is left incomplete.
+template <class T>
+class gcompact_run_writer
+{
+public:
+
+  typedef T value_type;
+  typedef T &reference;
+  typedef const T &const_reference;
+
+private:
+
+  typedef _gcompact_run_key<T> _key;
+
+  // Compile-time check for T.
+  typedef char _t_must_be_integer[(std::numeric_limits<T>::is_integer &&
+      sizeof(T) <= sizeof(uint64_t)) ? 1 : -1];
+
+  struct _index_entry
+  {
+    uint64_t offset;
+    uint64_t min_key;
+    uint64_t max_key;
+    uint32_t items_count;
+  };
+
+  std::FILE *_file;
+  size_t _block_items;
+
+  // Encoded keys for the current block.
+  std::vector<uint64_t> _keys;
+  std::vector<uint8_t> _buffer;
+  std::vector<_index_entry> _index;
+  uint64_t _offset;
+  uint64_t _items_count;
+  bool _is_finished;
+
+  // Disable copying.
+  gcompact_run_writer(const gcompact_run_writer &);
+  gcompact_run_writer &operator = (const gcompact_run_writer &);
+
+  void _write(const std::vector<uint8_t> &buffer)
+  {
+    if (!buffer.empty() &&
+        std::fwrite(&buffer[0], 1, buffer.size(), _file) != buffer.size()) {
+      throw std::runtime_error("gcompact_run_writer: cannot write");
+    }
+    _offset += buffer.size();
+  }
+
+  void _flush_block()
+  {
+    assert(!_keys.empty());
+
+    const uint32_t items_count = static_cast<uint32_t>(_keys.size());
+    uint64_t max_delta = 0;
+    for (size_t i = 1; i < _keys.size(); ++i) {
+      assert(_keys[i] >= _keys[i - 1]);
+      const uint64_t delta = _keys[i] - _keys[i - 1];
+      if (delta > max_delta) {
+        max_delta = delta;
+      }
+    }
+    const unsigned bit_width = _gcompact_run::get_bit_width(max_delta);
+    const size_t payload_size = _gcompact_run::get_payload_size(
+        items_count, bit_width);
+
+    _buffer.clear();
+    _gcompact_run::put_u32(_buffer, items_count);
+    _buffer.push_back(static_cast<uint8_t>(bit_width));
+    _buffer.insert(_buffer.end(), 3, 0);
+    _gcompact_run::put_u64(_buffer, _keys[0]);
+    _gcompact_run::put_u32(_buffer, static_cast<uint32_t>(payload_size));
+    _gcompact_run::put_u32(_buffer, 0);
+    assert(_buffer.size() == _gcompact_run::block_header_size);
+
+    // Pack deltas starting from the least significant bits.
+    uint64_t acc = 0;
+    unsigned acc_bits = 0;
+    for (size_t i = 1; i < _keys.size(); ++i) {
+      uint64_t delta = _keys[i] - _keys[i - 1];
+      unsigned bits = bit_width;
+      while (bits > 0) {
+        const unsigned step = _gcompact_run::get_bits_step(bits);
+        acc |= (delta & _gcompact_run::get_mask(step)) << acc_bits;
+        acc_bits += step;
+        delta >>= step;
+        bits -= step;
+        while (acc_bits >= 8) {
+          _buffer.push_back(static_cast<uint8_t>(acc));
+          acc >>= 8;
+          acc_bits -= 8;
+        }
+      }
+    }
+    if (acc_bits > 0) {
+      _buffer.push_back(static_cast<uint8_t>(acc));
+    }
+    assert(_buffer.size() == _gcompact_run::block_header_size + payload_size);
+
+    uint32_t crc = _gcompact_run_crc32::update(0, &_buffer[0], 20);
+    if (payload_size > 0) {
+      crc = _gcompact_run_crc32::update(crc,
+          &_buffer[_gcompact_run::block_header_size], payload_size);
+    }
+    for (unsigned i = 0; i < 4; ++i) {
+      _buffer[20 + i] = static_cast<uint8_t>(crc >> (8 * i));
+    }
+
+    _index_entry entry;
+    entry.offset = _offset;
+    entry.min_key = _keys[0];
+    entry.max_key = _keys.back();
+    entry.items_count = items_count;
+    _index.push_back(entry);
+
+    _write(_buffer);
+    _items_count += items_count;
+    _keys.clear();
+  }
+
+public:
+
+  // Creates the writer, which writes the run to the beginning of the given
+  // file, so the file position must be zero. Block offsets in the index
+  // are relative to the beginning of the file, and gcompact_run_reader
+  // expects the run there. The file must be opened in binary mode.
+  //
+  // block_items is the maximum number of items per block. Bigger blocks
+  // compress better, while smaller blocks speed up seeking.
+  explicit gcompact_run_writer(std::FILE *const file,
+      const size_t block_items = 4096) :
+      _file(file), _block_items(block_items), _offset(0), _items_count(0),
+      _is_finished(false)
+  {
+    assert(file != 0);
+    // Non-seekable streams such as pipes have no position.
+    assert(std::ftell(file) <= 0);
+    assert(block_items > 0);
+    assert(block_items <= std::numeric_limits<uint32_t>::max());
+
+    _keys.reserve(block_items);
+  }
+
+  void push_back(const T &item)
+  {
+    assert(!_is_finished);
+
+    const uint64_t key = _key::encode(item);
+    // The last pushed key is in the previous block if the current block
+    // is empty.
+    assert(_keys.empty() ?
+        (_index.empty() || key >= _index.back().max_key) :
+        key >= _keys.back());
+
+    _keys.push_back(key);
+    if (_keys.size() == _block_items) {
+      _flush_block();
+    }
+  }
+
+  // Writes the last block, the index and the footer, then flushes the file.
+  void finish()
+  {
+    assert(!_is_finished);
+
+    if (!_keys.empty()) {
+      _flush_block();
+    }
+    const uint64_t index_offset = _offset;
+
+    _buffer.clear();
+    for (size_t i = 0; i < _index.size(); ++i) {
+      const _index_entry &entry = _index[i];
+      _gcompact_run::put_u64(_buffer, entry.offset);
+      _gcompact_run::put_u64(_buffer, entry.min_key);
+      _gcompact_run::put_u64(_buffer, entry.max_key);
+      _gcompact_run::put_u32(_buffer, entry.items_count);
+    }
+    const uint32_t index_crc = _buffer.empty() ?
+        0 : _gcompact_run_crc32::update(0, &_buffer[0], _buffer.size());
+    _gcompact_run::put_u64(_buffer, index_offset);
+    _gcompact_run::put_u64(_buffer, _index.size());
+    _gcompact_run::put_u64(_buffer, _items_count);
+    _gcompact_run::put_u32(_buffer, index_crc);
+    _gcompact_run::put_u32(_buffer, 0);
+    const char *const magic = _gcompact_run::get_magic();
+    _buffer.insert(_buffer.end(), magic, magic + 8);
+
+    _write(_buffer);
+    if (std::fflush(_file) != 0) {
+      throw std::runtime_error("gcompact_run_writer: cannot flush");
+    }
+    _is_finished = true;
+  }
+
+  uint64_t get_items_count() const
+  {
+    return _items_count + _keys.size();
+  }
+
+  // Returns the number of bytes written so far.
+  uint64_t get_bytes_written() const
+  {
+    return _offset;
+  }
+};
+
+template <class T>
+class gcompact_run_reader;
+
+// Input iterator over items of a compact run.
+// All iterators of the same reader share its position.
+// The end iterator doesn't refer to any reader.
+template <class T>
+class gcompact_run_iterator
+{
+public:
+
+  typedef std::input_iterator_tag iterator_category;
+  typedef T value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const T *pointer;
+  typedef const T &reference;
+
+private:
+
+  gcompact_run_reader<T> *_reader;
+
+public:
+
+  gcompact_run_iterator() : _reader(0) {}
+
+  explicit gcompact_run_iterator(gcompact_run_reader<T> *const reader) :
+      _reader(reader) {}
+
+  reference operator * () const
+  {
+    return _reader->_get();
+  }
+
+  pointer operator -> () const
+  {
+    return &_reader->_get();
+  }
+
+  gcompact_run_iterator &operator ++ ()
+  {
+    if (!_reader->_next()) {
+      _reader = 0;
+    }
+    return *this;
+  }
+
+  bool operator == (const gcompact_run_iterator &it) const
+  {
+    return (_reader == it._reader);
+  }
+
+  bool operator != (const gcompact_run_iterator &it) const
+  {
+    return (_reader != it._reader);
+  }
+};
+
+// Reads a run written by gcompact_run_writer<T> from the given file.
+//
+// The constructor reads and verifies the index. Blocks are read and verified
+// lazily while iterating.
+template <class T>
+class gcompact_run_reader
+{
+public:
+
+  typedef gcompact_run_iterator<T> iterator;
+  typedef std::pair<iterator, iterator> input_range;
+
+private:
+
+  friend class gcompact_run_iterator<T>;
+
+  typedef _gcompact_run_key<T> _key;
+
+  struct _index_entry
+  {
+    uint64_t offset;
+    uint64_t min_key;
+    uint64_t max_key;
+    uint32_t items_count;
+  };
+
+  std::FILE *_file;
+  std::vector<_index_entry> _index;
+  uint64_t _items_count;
+
+  // Decoded items of the current block.
+  std::vector<T> _items;
+  std::vector<uint8_t> _buffer;
+  size_t _block_index;
+  size_t _position;
+
+  // Disable copying.
+  gcompact_run_reader(const gcompact_run_reader &);
+  gcompact_run_reader &operator = (const gcompact_run_reader &);
+
+  static void _throw_corrupted()
+  {
+    throw std::runtime_error("gcompact_run_reader: corrupted run");
+  }
+
+  void _read(const uint64_t offset, const size_t size)
+  {
+    _buffer.resize(size);
+    if (offset > static_cast<uint64_t>(std::numeric_limits<long>::max()) ||
+        std::fseek(_file, static_cast<long>(offset), SEEK_SET) != 0 ||
+        (size > 0 && std::fread(&_buffer[0], 1, size, _file) != size)) {
+      throw std::runtime_error("gcompact_run_reader: cannot read");
+    }
+  }
+
+  // Reads, verifies and decodes the block with the given index.
+  void _load_block(const size_t block_index)
+  {
+    assert(block_index < _index.size());
+
+    const _index_entry &entry = _index[block_index];
+    _read(entry.offset, _gcompact_run::block_header_size);
+    const uint32_t items_count = _gcompact_run::get_u32(&_buffer[0]);
+    const unsigned bit_width = _buffer[4];
+    const uint64_t first_key = _gcompact_run::get_u64(&_buffer[8]);
+    const size_t payload_size = _gcompact_run::get_u32(&_buffer[16]);
+    const uint32_t crc = _gcompact_run::get_u32(&_buffer[20]);
+    if (items_count != entry.items_count || bit_width > 64 ||
+        first_key != entry.min_key || payload_size !=
+            _gcompact_run::get_payload_size(items_count, bit_width)) {
+      _throw_corrupted();
+    }
+    uint32_t actual_crc = _gcompact_run_crc32::update(0, &_buffer[0], 20);
+
+    _read(entry.offset + _gcompact_run::block_header_size, payload_size);
+    if (payload_size > 0) {
+      actual_crc = _gcompact_run_crc32::update(actual_crc, &_buffer[0],
+          payload_size);
+    }
+    if (actual_crc != crc) {
+      _throw_corrupted();
+    }
+
+    // Unpack deltas starting from the least significant bits.
+    _items.resize(items_count);
+    _items[0] = _key::decode(first_key);
+    uint64_t key = first_key;
+    uint64_t acc = 0;
+    unsigned acc_bits = 0;
+    size_t pos = 0;
+    for (uint32_t i = 1; i < items_count; ++i) {
+      uint64_t delta = 0;
+      unsigned shift = 0;
+      unsigned bits = bit_width;
+      while (bits > 0) {
+        const unsigned step = _gcompact_run::get_bits_step(bits);
+        while (acc_bits < step) {
+          acc |= static_cast<uint64_t>(_buffer[pos]) << acc_bits;
+          ++pos;
+          acc_bits += 8;
+        }
+        delta |= (acc & _gcompact_run::get_mask(step)) << shift;
+        acc >>= step;
+        acc_bits -= step;
+        shift += step;
+        bits -= step;
+      }
+      key += delta;
+      _items[i] = _key::decode(key);
+    }
+    if (key != entry.max_key) {
+      _throw_corrupted();
+    }
+
+    _block_index = block_index;
+    _position = 0;
+  }
+
+  const T &_get() const
+  {
+    assert(_position < _items.size());
+    return _items[_position];
+  }
+
+  bool _next()
+  {
+    assert(_position < _items.size());
+    ++_position;
+    if (_position < _items.size()) {
+      return true;
+    }
+    if (_block_index + 1 >= _index.size()) {
+      return false;
+    }
+    _load_block(_block_index + 1);
+    return true;
+  }
+
+public:
+
+  // Creates the reader for the run ending at the end of the given file.
+  // The run must start at the beginning of the file. The file must be
+  // opened in binary mode.
+  explicit gcompact_run_reader(std::FILE *const file) :
+      _file(file), _items_count(0), _block_index(0), _position(0)
+  {
+    assert(file != 0);
+
+    if (std::fseek(_file, 0, SEEK_END) != 0) {
+      throw std::runtime_error("gcompact_run_reader: cannot seek");
+    }
+    const long file_size = std::ftell(_file);
+    if (file_size < static_cast<long>(_gcompact_run::footer_size)) {
+      _throw_corrupted();
+    }
+    const uint64_t footer_offset = file_size - _gcompact_run::footer_size;
+    _read(footer_offset, _gcompact_run::footer_size);
+    const uint64_t index_offset = _gcompact_run::get_u64(&_buffer[0]);
+    const uint64_t blocks_count = _gcompact_run::get_u64(&_buffer[8]);
+    _items_count = _gcompact_run::get_u64(&_buffer[16]);
+    const uint32_t index_crc = _gcompact_run::get_u32(&_buffer[24]);
+    if (std::memcmp(&_buffer[32], _gcompact_run::get_magic(), 8) != 0 ||
+        index_offset > footer_offset ||
+        (footer_offset - index_offset) % _gcompact_run::index_entry_size ||
+        blocks_count !=
+            (footer_offset - index_offset) / _gcompact_run::index_entry_size) {
+      _throw_corrupted();
+    }
+
+    _read(index_offset, footer_offset - index_offset);
+    if (!_buffer.empty() &&
+        _gcompact_run_crc32::update(0, &_buffer[0], _buffer.size()) !=
+            index_crc) {
+      _throw_corrupted();
+    }
+    uint64_t items_count = 0;
+    _index.resize(static_cast<size_t>(blocks_count));
+    for (size_t i = 0; i < _index.size(); ++i) {
+      const uint8_t *const data = &_buffer[i * _gcompact_run::index_entry_size];
+      _index_entry &entry = _index[i];
+      entry.offset = _gcompact_run::get_u64(data);
+      entry.min_key = _gcompact_run::get_u64(data + 8);
+      entry.max_key = _gcompact_run::get_u64(data + 16);
+      entry.items_count = _gcompact_run::get_u32(data + 24);
+      if (entry.items_count == 0 || entry.min_key > entry.max_key ||
+          (i > 0 && entry.min_key < _index[i - 1].max_key)) {
+        _throw_corrupted();
+      }
+      items_count += entry.items_count;
+    }
+    if (items_count != _items_count) {
+      _throw_corrupted();
+    }
+
+    if (!_index.empty()) {
+      _load_block(0);
+    }
+  }
+
+  uint64_t get_items_count() const
+  {
+    return _items_count;
+  }
+
+  size_t get_blocks_count() const
+  {
+    return _index.size();
+  }
+
+  T get_block_min(const size_t block_index) const
+  {
+    assert(block_index < _index.size());
+    return _key::decode(_index[block_index].min_key);
+  }
+
+  T get_block_max(const size_t block_index) const
+  {
+    assert(block_index < _index.size());
+    return _key::decode(_index[block_index].max_key);
+  }
+
+  // Positions the reader at the first item not less than the given key.
+  // Reads only the block containing the item.
+  void seek(const T &key)
+  {
+    const uint64_t encoded_key = _key::encode(key);
+
+    // Find the first block with max key not less than the key.
+    size_t first = 0, last = _index.size();
+    while (first < last) {
+      const size_t middle = first + (last - first) / 2;
+      if (_index[middle].max_key < encoded_key) {
+        first = middle + 1;
+      }
+      else {
+        last = middle;
+      }
+    }
+
+    if (first == _index.size()) {
+      _items.clear();
+      _block_index = _index.size();
+      _position = 0;
+      return;
+    }
+    _load_block(first);
+    while (_key::encode(_items[_position]) < encoded_key) {
+      ++_position;
+    }
+  }
+
+  // Returns an iterator pointing to the current position of the reader.
+  iterator begin()
+  {
+    return (_position < _items.size()) ? iterator(this) : iterator();
+  }
+
+  iterator end()
+  {
+    return iterator();
+  }
+
+  // Returns the input range for galgorithm::nway_merge(). The range is
+  // empty if the run is empty.
+  input_range get_input_range()
+  {
+    return input_range(begin(), end());
+  }
+};
+#endif
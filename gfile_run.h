@@ -0,0 +1,1084 @@
+#ifndef GFILE_RUN_H
+#define GFILE_RUN_H
+
+/*
+ * Readers for sorted runs stored in files, which are used as inputs
+ * for N-way merge.
+ *
+ * Each run is a file containing an array of fixed-size items sorted
+ * in ascending order. Runs are read in blocks. Each run owns two aligned
+ * block buffers. While the merge consumes items from one buffer,
+ * the next block is read into the other buffer in background. So the merge
+ * doesn't wait for I/O at steady state if a block is read faster than
+ * it is consumed.
+ *
+ * Background reads for all the runs are submitted to a single io_uring
+ * instance via raw syscalls, so liburing isn't required. If io_uring
+ * is unavailable, background reads are performed via pread() by a pool
+ * of threads.
+ *
+ * Runs may be opened with O_DIRECT flag. In this case block_size must be
+ * a multiple of the logical block size of the underlying device.
+ * Block buffers are aligned to GFILE_RUN_BUFFER_ALIGNMENT bytes.
+ *
+ * The reader may be used from both C99 and C++. galgorithm_nway_merge()
+ * input adapter is available in C, while gfile_run.hpp provides
+ * galgorithm::nway_merge() input ranges for C++.
+ *
+ * Requires POSIX. io_uring is used on Linux only. Define _GNU_SOURCE
+ * before including system headers in C. Link with -pthread.
+ */
+
+
+/*******************************************************************************
+ * Interface.
+ ******************************************************************************/
+
+#include <stddef.h>     /* for size_t */
+
+/*
+ * Alignment of block buffers in bytes.
+ */
+#define GFILE_RUN_BUFFER_ALIGNMENT 4096
+
+/*
+ * Flag for gfile_runs_create(), which disables io_uring, so background reads
+ * are performed by the pool of threads.
+ */
+#define GFILE_RUNS_NO_IO_URING 1
+
+/*
+ * Opaque type for a collection of runs sharing background I/O.
+ */
+struct gfile_runs;
+
+/*
+ * Opaque type for a single run.
+ */
+struct gfile_run;
+
+/*
+ * Creates readers for runs stored in files with the given descriptors
+ * and submits background reads for the first two blocks of each run.
+ *
+ * block_size must be a multiple of item_size. threads_count is the number
+ * of threads for pread() fallback.
+ *
+ * File descriptors must remain open until gfile_runs_delete() call.
+ *
+ * Returns NULL and sets errno on error.
+ */
+static inline struct gfile_runs *gfile_runs_create(const int *fds,
+    size_t runs_count, size_t item_size, size_t block_size,
+    size_t threads_count, int flags);
+
+/*
+ * Deletes the given runs. Waits for pending background reads.
+ */
+static inline void gfile_runs_delete(struct gfile_runs *runs);
+
+/*
+ * Returns non-zero if background reads are performed via io_uring.
+ */
+static inline int gfile_runs_is_io_uring(const struct gfile_runs *runs);
+
+/*
+ * Returns errno value for the first read error or zero if there were
+ * no errors. Runs are truncated on read errors, so check the error
+ * after the merge.
+ */
+static inline int gfile_runs_get_error(const struct gfile_runs *runs);
+
+/*
+ * Returns the number of runs.
+ */
+static inline size_t gfile_runs_get_count(const struct gfile_runs *runs);
+
+/*
+ * Returns the run with the given index.
+ */
+static inline struct gfile_run *gfile_runs_get_run(struct gfile_runs *runs,
+    size_t run_index);
+
+/*
+ * Waits for the first block of the given run.
+ * Returns non-zero if the run contains at least one item.
+ */
+static inline int gfile_run_start(struct gfile_run *run);
+
+/*
+ * Returns a pointer to the current item.
+ *
+ * The pointer remains valid until the next gfile_run_next() call.
+ */
+static inline const void *gfile_run_get(const struct gfile_run *run);
+
+/*
+ * Advances the run to the next item.
+ * Returns non-zero on success or 0 on the end of the run.
+ *
+ * Waits for the next block only if its background read isn't finished yet.
+ */
+static inline int gfile_run_next(struct gfile_run *run);
+
+#ifndef __cplusplus
+
+#include "galgorithm.h"  /* for galgorithm_nway_merge_input */
+
+/*
+ * Initializes input for galgorithm_nway_merge() with non-empty runs.
+ * Waits for the first block of each run.
+ *
+ * galgorithm_nway_merge() mustn't be called if input->ctxs_count is zero
+ * after the call.
+ *
+ * The input remains valid until gfile_runs_delete() call.
+ */
+static inline void gfile_runs_init_nway_merge_input(struct gfile_runs *runs,
+    struct galgorithm_nway_merge_input *input);
+
+#endif
+
+
+/*******************************************************************************
+ * Implementation.
+ ******************************************************************************/
+
+#include <assert.h>     /* for assert */
+#include <errno.h>      /* for errno, E* */
+#include <pthread.h>    /* for pthread_* */
+#include <stdint.h>     /* for uint*_t, SIZE_MAX */
+#include <stdlib.h>     /* for malloc(), free(), posix_memalign() */
+#include <string.h>     /* for memset() */
+#include <sys/types.h>  /* for off_t */
+#include <unistd.h>     /* for pread() */
+
+#ifdef __linux__
+#  include <sys/mman.h>     /* for mmap(), munmap() */
+#  include <sys/syscall.h>  /* for syscall numbers */
+#  include <sys/uio.h>      /* for struct iovec */
+#  include <time.h>         /* for nanosleep() */
+#endif
+
+/* Block buffer states. */
+#define _GFILE_RUN_BUFFER_IDLE 0
+#define _GFILE_RUN_BUFFER_PENDING 1
+#define _GFILE_RUN_BUFFER_READY 2
+
+struct _gfile_run_buffer
+{
+  char *data;
+
+  /*
+   * The number of bytes read into the buffer. io_uring reads accumulate
+   * the number of bytes read so far while the read is pending.
+   */
+  size_t size;
+
+  /* The offset of the block in the file. */
+  uint64_t offset;
+
+  /*
+   * The buffer state. It is protected by gfile_runs mutex in the pread()
+   * fallback, since background threads change it.
+   */
+  int state;
+
+#ifdef __linux__
+  /* io_uring reads the block via readv with this iovec. */
+  struct iovec iov;
+#endif
+};
+
+struct gfile_run
+{
+  struct gfile_runs *runs;
+  int fd;
+
+  struct _gfile_run_buffer buffers[2];
+
+  /* The index of the buffer containing the current item. */
+  size_t current_buffer;
+
+  /* The position of the current item in the current buffer. */
+  size_t position;
+
+  /* The offset of the next block to read. */
+  uint64_t next_offset;
+
+  /* Set after the last block of the file is read. */
+  int is_eof;
+};
+
+/* Background read request for the pread() fallback. */
+struct _gfile_run_request
+{
+  struct gfile_run *run;
+  size_t buffer_index;
+};
+
+#ifdef __linux__
+
+/*
+ * io_uring ABI definitions. They mirror linux/io_uring.h, which cannot be
+ * included in C99 and C++03, since it uses anonymous unions.
+ */
+
+#ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter 426
+#endif
+
+#define _GFILE_RUN_IORING_OP_READV 1
+#define _GFILE_RUN_IORING_ENTER_GETEVENTS 1
+#define _GFILE_RUN_IORING_OFF_SQ_RING 0
+#define _GFILE_RUN_IORING_OFF_CQ_RING 0x8000000
+#define _GFILE_RUN_IORING_OFF_SQES 0x10000000
+
+struct _gfile_run_io_sqring_offsets
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct _gfile_run_io_cqring_offsets
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct _gfile_run_io_uring_params
+{
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t resv[3];
+  struct _gfile_run_io_sqring_offsets sq_off;
+  struct _gfile_run_io_cqring_offsets cq_off;
+};
+
+struct _gfile_run_io_uring_sqe
+{
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t rw_flags;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+
+struct _gfile_run_io_uring_cqe
+{
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+struct _gfile_run_io_uring
+{
+  int fd;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  struct _gfile_run_io_uring_sqe *sqes;
+  size_t sqes_size;
+
+  uint32_t *sq_head;
+  uint32_t *sq_tail;
+  uint32_t *sq_mask;
+  uint32_t *sq_array;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t *cq_mask;
+  struct _gfile_run_io_uring_cqe *cqes;
+
+  /* The number of queued, but not submitted yet entries. */
+  uint32_t to_submit;
+};
+
+#endif
+
+struct gfile_runs
+{
+  size_t item_size;
+  size_t block_size;
+
+  struct gfile_run *runs;
+  size_t runs_count;
+
+  /* Pointers to non-empty runs for galgorithm_nway_merge() input. */
+  struct gfile_run **run_ptrs;
+
+  /* The number of background reads in flight. */
+  size_t pending_reads;
+
+  int error;
+  int is_io_uring;
+
+#ifdef __linux__
+  struct _gfile_run_io_uring ring;
+
+  /* Set after the ring fails. Blocks are read synchronously since then. */
+  int is_ring_broken;
+#endif
+
+  /*
+   * pread() fallback state. Requests are buffers waiting for reads.
+   * Each buffer has at most one pending read, so the queue holds
+   * at most 2 * runs_count requests.
+   */
+  pthread_t *threads;
+  size_t threads_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t request_cond;
+  pthread_cond_t ready_cond;
+  struct _gfile_run_request *requests;
+  size_t requests_head;
+  size_t requests_count;
+  int is_stopped;
+};
+
+static inline void _gfile_runs_set_error(struct gfile_runs *const runs,
+    const int error)
+{
+  if (runs->error == 0) {
+    runs->error = error;
+  }
+}
+
+/*
+ * Marks the buffer as ready after its background read is finished.
+ * res is the number of bytes read or negative errno.
+ */
+static inline void _gfile_run_complete_read(struct gfile_run *const run,
+    struct _gfile_run_buffer *const buffer, const int64_t res)
+{
+  struct gfile_runs *const runs = run->runs;
+
+  assert(buffer->state == _GFILE_RUN_BUFFER_PENDING);
+  assert(runs->pending_reads > 0);
+  --runs->pending_reads;
+
+  buffer->size = 0;
+  if (res < 0) {
+    _gfile_runs_set_error(runs, (int)-res);
+  }
+  else if ((uint64_t)res % runs->item_size != 0) {
+    /* The run is truncated in the middle of an item. */
+    _gfile_runs_set_error(runs, EINVAL);
+  }
+  else {
+    buffer->size = (size_t)res;
+  }
+  buffer->state = _GFILE_RUN_BUFFER_READY;
+}
+
+#ifdef __linux__
+
+static inline int _gfile_run_io_uring_enter(const int fd,
+    const uint32_t to_submit, const uint32_t min_complete, const uint32_t flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+      (void *)0, (size_t)0);
+}
+
+static inline void _gfile_run_io_uring_destroy(
+    struct _gfile_run_io_uring *const ring)
+{
+  if (ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (ring->sq_ring != MAP_FAILED) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  close(ring->fd);
+}
+
+/*
+ * Creates io_uring instance capable of holding the given number of reads
+ * in flight. Returns zero on success.
+ */
+static inline int _gfile_run_io_uring_init(
+    struct _gfile_run_io_uring *const ring, const size_t entries)
+{
+  struct _gfile_run_io_uring_params p;
+  char *sq_ring;
+  char *cq_ring;
+
+  if (entries > 32768) {
+    return -1;
+  }
+  memset(&p, 0, sizeof(p));
+  ring->fd = (int)syscall(__NR_io_uring_setup, (uint32_t)entries, &p);
+  if (ring->fd < 0) {
+    return -1;
+  }
+
+  ring->sq_ring = MAP_FAILED;
+  ring->cq_ring = MAP_FAILED;
+  ring->sqes = (struct _gfile_run_io_uring_sqe *)MAP_FAILED;
+  ring->to_submit = 0;
+
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  ring->cq_ring_size = p.cq_off.cqes +
+      p.cq_entries * sizeof(struct _gfile_run_io_uring_cqe);
+  ring->sqes_size = p.sq_entries * sizeof(struct _gfile_run_io_uring_sqe);
+
+  /* Map both rings at once if the kernel supports IORING_FEAT_SINGLE_MMAP. */
+  const int is_single_mmap = ((p.features & 1) != 0);
+  if (is_single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+    ring->sq_ring_size = ring->cq_ring_size;
+  }
+  ring->sq_ring = mmap(0, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring->fd, _GFILE_RUN_IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED) {
+    _gfile_run_io_uring_destroy(ring);
+    return -1;
+  }
+  if (is_single_mmap) {
+    ring->cq_ring = ring->sq_ring;
+  }
+  else {
+    ring->cq_ring = mmap(0, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->fd, _GFILE_RUN_IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) {
+      _gfile_run_io_uring_destroy(ring);
+      return -1;
+    }
+  }
+  ring->sqes = (struct _gfile_run_io_uring_sqe *)mmap(0, ring->sqes_size,
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+      _GFILE_RUN_IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    _gfile_run_io_uring_destroy(ring);
+    return -1;
+  }
+
+  sq_ring = (char *)ring->sq_ring;
+  cq_ring = (char *)ring->cq_ring;
+  ring->sq_head = (uint32_t *)(sq_ring + p.sq_off.head);
+  ring->sq_tail = (uint32_t *)(sq_ring + p.sq_off.tail);
+  ring->sq_mask = (uint32_t *)(sq_ring + p.sq_off.ring_mask);
+  ring->sq_array = (uint32_t *)(sq_ring + p.sq_off.array);
+  ring->cq_head = (uint32_t *)(cq_ring + p.cq_off.head);
+  ring->cq_tail = (uint32_t *)(cq_ring + p.cq_off.tail);
+  ring->cq_mask = (uint32_t *)(cq_ring + p.cq_off.ring_mask);
+  ring->cqes = (struct _gfile_run_io_uring_cqe *)(cq_ring + p.cq_off.cqes);
+  return 0;
+}
+
+/*
+ * Queues readv for the rest of the block in the given buffer, i.e.
+ * for the block without the first buffer->size bytes, which are read
+ * already. The ring has enough entries for all the buffers, so it never
+ * overflows.
+ */
+static inline void _gfile_run_io_uring_queue_read(
+    struct _gfile_run_io_uring *const ring, const int fd,
+    struct _gfile_run_buffer *const buffer, const size_t block_size,
+    const uint64_t user_data)
+{
+  const uint32_t tail = *ring->sq_tail;
+  const uint32_t index = tail & *ring->sq_mask;
+  struct _gfile_run_io_uring_sqe *const sqe = &ring->sqes[index];
+
+  assert(buffer->size < block_size);
+  buffer->iov.iov_base = buffer->data + buffer->size;
+  buffer->iov.iov_len = block_size - buffer->size;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = _GFILE_RUN_IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->off = buffer->offset + buffer->size;
+  sqe->addr = (uint64_t)(uintptr_t)&buffer->iov;
+  sqe->len = 1;
+  sqe->user_data = user_data;
+  ring->sq_array[index] = index;
+
+  /* The kernel must observe the entry before the new tail. */
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++ring->to_submit;
+}
+
+/*
+ * Submits queued reads. Waits for at least one completion if must_wait
+ * is set. Returns zero on success.
+ */
+static inline int _gfile_run_io_uring_submit(
+    struct _gfile_run_io_uring *const ring, const int must_wait)
+{
+  while (ring->to_submit > 0 || must_wait) {
+    const int n = _gfile_run_io_uring_enter(ring->fd, ring->to_submit,
+        must_wait ? 1 : 0, must_wait ? _GFILE_RUN_IORING_ENTER_GETEVENTS : 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    assert((uint32_t)n <= ring->to_submit);
+    ring->to_submit -= (uint32_t)n;
+    if (ring->to_submit == 0) {
+      break;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Marks buffers for completed reads as ready.
+ *
+ * Short reads are resubmitted for the rest of the block like in
+ * _gfile_run_pread_block(), so only a read returning 0 bytes, i.e.
+ * the end of file, or an error completes the block early. Resubmitted
+ * reads are queued and must be submitted by the caller.
+ */
+static inline void _gfile_run_io_uring_reap(struct gfile_runs *const runs)
+{
+  struct _gfile_run_io_uring *const ring = &runs->ring;
+  uint32_t head = *ring->cq_head;
+
+  /* Completion entries must be read after the tail. */
+  const uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const struct _gfile_run_io_uring_cqe *const cqe =
+        &ring->cqes[head & *ring->cq_mask];
+    const uint64_t user_data = cqe->user_data;
+    const int32_t res = cqe->res;
+    struct gfile_run *const run = &runs->runs[user_data / 2];
+    struct _gfile_run_buffer *const buffer = &run->buffers[user_data % 2];
+    ++head;
+
+    if (res == -EINTR || res == -EAGAIN ||
+        (res > 0 && buffer->size + (size_t)res < runs->block_size)) {
+      if (res > 0) {
+        buffer->size += (size_t)res;
+      }
+      _gfile_run_io_uring_queue_read(ring, run->fd, buffer, runs->block_size,
+          user_data);
+      continue;
+    }
+    _gfile_run_complete_read(run, buffer,
+        (res < 0) ? res : (int64_t)(buffer->size + (size_t)res));
+  }
+
+  /* The kernel may reuse entries after the new head. */
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+#endif
+
+/*
+ * Reads the block into the buffer via pread() in the current thread.
+ * Returns the number of bytes read or negative errno.
+ */
+static inline int64_t _gfile_run_pread_block(const int fd,
+    const struct _gfile_run_buffer *const buffer, const size_t block_size)
+{
+  size_t size = 0;
+  while (size < block_size) {
+    const ssize_t n = pread(fd, buffer->data + size, block_size - size,
+        (off_t)(buffer->offset + size));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -(int64_t)errno;
+    }
+    if (n == 0) {
+      break;
+    }
+    size += (size_t)n;
+  }
+  return (int64_t)size;
+}
+
+#ifdef __linux__
+
+/*
+ * Stops using the ring after it fails to submit reads or to wait for their
+ * completions. Reads queued, but not consumed by the kernel yet, are
+ * withdrawn. The kernel may write into buffers until their reads in flight
+ * complete, so these reads are waited for. Then all the pending reads are
+ * performed via pread() in the current thread.
+ */
+static inline void _gfile_run_io_uring_abandon(struct gfile_runs *const runs)
+{
+  struct _gfile_run_io_uring *const ring = &runs->ring;
+  const uint32_t sq_head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  const uint32_t sq_tail = *ring->sq_tail;
+  size_t in_flight;
+  size_t i;
+
+  assert(runs->pending_reads >= (size_t)(sq_tail - sq_head));
+  in_flight = runs->pending_reads - (size_t)(sq_tail - sq_head);
+  __atomic_store_n(ring->sq_tail, sq_head, __ATOMIC_RELEASE);
+  ring->to_submit = 0;
+  runs->is_ring_broken = 1;
+
+  while (in_flight > 0) {
+    const uint32_t head = *ring->cq_head;
+    const uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      if (_gfile_run_io_uring_enter(ring->fd, 0, 1,
+          _GFILE_RUN_IORING_ENTER_GETEVENTS) < 0) {
+        /* The kernel posts completions on return from any syscall. */
+        const struct timespec delay = {0, 1000000};
+        nanosleep(&delay, 0);
+      }
+      continue;
+    }
+    assert((size_t)(tail - head) <= in_flight);
+    in_flight -= (size_t)(tail - head);
+    __atomic_store_n(ring->cq_head, tail, __ATOMIC_RELEASE);
+  }
+
+  for (i = 0; i < runs->runs_count; ++i) {
+    struct gfile_run *const run = &runs->runs[i];
+    for (size_t j = 0; j < 2; ++j) {
+      struct _gfile_run_buffer *const buffer = &run->buffers[j];
+      if (buffer->state == _GFILE_RUN_BUFFER_PENDING) {
+        _gfile_run_complete_read(run, buffer,
+            _gfile_run_pread_block(run->fd, buffer, runs->block_size));
+      }
+    }
+  }
+}
+
+#endif
+
+static inline void *_gfile_runs_thread_func(void *const arg)
+{
+  struct gfile_runs *const runs = (struct gfile_runs *)arg;
+  const size_t capacity = 2 * runs->runs_count;
+
+  pthread_mutex_lock(&runs->mutex);
+  while (1) {
+    while (runs->requests_count == 0 && !runs->is_stopped) {
+      pthread_cond_wait(&runs->request_cond, &runs->mutex);
+    }
+    if (runs->is_stopped) {
+      break;
+    }
+
+    const struct _gfile_run_request request =
+        runs->requests[runs->requests_head];
+    runs->requests_head = (runs->requests_head + 1) % capacity;
+    --runs->requests_count;
+    struct gfile_run *const run = request.run;
+    struct _gfile_run_buffer *const buffer =
+        &run->buffers[request.buffer_index];
+    pthread_mutex_unlock(&runs->mutex);
+
+    const int64_t res = _gfile_run_pread_block(run->fd, buffer,
+        runs->block_size);
+
+    pthread_mutex_lock(&runs->mutex);
+    _gfile_run_complete_read(run, buffer, res);
+    pthread_cond_broadcast(&runs->ready_cond);
+  }
+  pthread_mutex_unlock(&runs->mutex);
+  return 0;
+}
+
+/*
+ * Starts background read of the next block into the given buffer.
+ */
+static inline void _gfile_run_read_block(struct gfile_run *const run,
+    const size_t buffer_index)
+{
+  struct gfile_runs *const runs = run->runs;
+  struct _gfile_run_buffer *const buffer = &run->buffers[buffer_index];
+
+  assert(buffer->state == _GFILE_RUN_BUFFER_IDLE);
+  buffer->offset = run->next_offset;
+  buffer->size = 0;
+  buffer->state = _GFILE_RUN_BUFFER_PENDING;
+  run->next_offset += runs->block_size;
+
+#ifdef __linux__
+  if (runs->is_io_uring) {
+    ++runs->pending_reads;
+    if (runs->is_ring_broken) {
+      _gfile_run_complete_read(run, buffer,
+          _gfile_run_pread_block(run->fd, buffer, runs->block_size));
+      return;
+    }
+    _gfile_run_io_uring_queue_read(&runs->ring, run->fd, buffer,
+        runs->block_size, (uint64_t)((run - runs->runs) * 2 + buffer_index));
+    return;
+  }
+#endif
+
+  const size_t capacity = 2 * runs->runs_count;
+  pthread_mutex_lock(&runs->mutex);
+  ++runs->pending_reads;
+  assert(runs->requests_count < capacity);
+  struct _gfile_run_request *const request =
+      &runs->requests[(runs->requests_head + runs->requests_count) % capacity];
+  request->run = run;
+  request->buffer_index = buffer_index;
+  ++runs->requests_count;
+  pthread_cond_signal(&runs->request_cond);
+  pthread_mutex_unlock(&runs->mutex);
+}
+
+/*
+ * Starts queued background reads.
+ */
+static inline void _gfile_runs_flush(struct gfile_runs *const runs)
+{
+#ifdef __linux__
+  if (runs->is_io_uring && !runs->is_ring_broken &&
+      _gfile_run_io_uring_submit(&runs->ring, 0) != 0) {
+    _gfile_runs_set_error(runs, errno);
+  }
+#else
+  (void)runs;
+#endif
+}
+
+/*
+ * Waits until the background read into the given buffer is finished
+ * and marks the buffer as idle.
+ * Returns zero if the read wasn't started, since the end of file
+ * was reached.
+ */
+static inline int _gfile_run_wait_buffer(struct gfile_run *const run,
+    struct _gfile_run_buffer *const buffer)
+{
+  struct gfile_runs *const runs = run->runs;
+  int is_started;
+
+#ifdef __linux__
+  if (runs->is_io_uring) {
+    /* Buffers are changed only by the current thread. */
+    if (buffer->state == _GFILE_RUN_BUFFER_IDLE) {
+      return 0;
+    }
+    _gfile_run_io_uring_reap(runs);
+    while (buffer->state != _GFILE_RUN_BUFFER_READY) {
+      if (_gfile_run_io_uring_submit(&runs->ring, 1) != 0) {
+        /* The ring is broken. Read the rest of blocks synchronously. */
+        _gfile_runs_set_error(runs, errno);
+        _gfile_run_io_uring_abandon(runs);
+        break;
+      }
+      _gfile_run_io_uring_reap(runs);
+    }
+    /* Submit reads resubmitted by the reap for other buffers. */
+    _gfile_runs_flush(runs);
+    buffer->state = _GFILE_RUN_BUFFER_IDLE;
+    return 1;
+  }
+#endif
+
+  pthread_mutex_lock(&runs->mutex);
+  is_started = (buffer->state != _GFILE_RUN_BUFFER_IDLE);
+  while (buffer->state == _GFILE_RUN_BUFFER_PENDING) {
+    pthread_cond_wait(&runs->ready_cond, &runs->mutex);
+  }
+  buffer->state = _GFILE_RUN_BUFFER_IDLE;
+  pthread_mutex_unlock(&runs->mutex);
+  return is_started;
+}
+
+/*
+ * Switches the run to the given buffer after waiting for its read.
+ * Returns non-zero if the buffer contains items.
+ */
+static inline int _gfile_run_switch_buffer(struct gfile_run *const run,
+    const size_t buffer_index)
+{
+  struct gfile_runs *const runs = run->runs;
+  struct _gfile_run_buffer *const buffer = &run->buffers[buffer_index];
+
+  if (!_gfile_run_wait_buffer(run, buffer)) {
+    return 0;
+  }
+  run->current_buffer = buffer_index;
+  run->position = 0;
+  if (buffer->size < runs->block_size) {
+    /*
+     * Short reads are continued until the block is full, so a short block
+     * means the end of file or an error.
+     */
+    run->is_eof = 1;
+  }
+  return (buffer->size > 0);
+}
+
+static inline struct gfile_runs *gfile_runs_create(const int *const fds,
+    const size_t runs_count, const size_t item_size, const size_t block_size,
+    const size_t threads_count, const int flags)
+{
+  struct gfile_runs *runs;
+  size_t i;
+
+  if (runs_count == 0 || item_size == 0 || block_size == 0 ||
+      block_size % item_size != 0 || runs_count > SIZE_MAX / 4) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  runs = (struct gfile_runs *)malloc(sizeof(*runs));
+  if (runs == 0) {
+    errno = ENOMEM;
+    return 0;
+  }
+  memset(runs, 0, sizeof(*runs));
+  runs->item_size = item_size;
+  runs->block_size = block_size;
+  runs->runs_count = runs_count;
+  runs->runs = (struct gfile_run *)calloc(runs_count, sizeof(runs->runs[0]));
+  runs->run_ptrs = (struct gfile_run **)calloc(runs_count,
+      sizeof(runs->run_ptrs[0]));
+  if (runs->runs == 0 || runs->run_ptrs == 0) {
+    free(runs->run_ptrs);
+    free(runs->runs);
+    free(runs);
+    errno = ENOMEM;
+    return 0;
+  }
+
+  for (i = 0; i < runs_count; ++i) {
+    struct gfile_run *const run = &runs->runs[i];
+    run->runs = runs;
+    run->fd = fds[i];
+    for (size_t j = 0; j < 2; ++j) {
+      void *data;
+      if (posix_memalign(&data, GFILE_RUN_BUFFER_ALIGNMENT, block_size) != 0) {
+        runs->runs_count = i + 1;
+        gfile_runs_delete(runs);
+        errno = ENOMEM;
+        return 0;
+      }
+      run->buffers[j].data = (char *)data;
+    }
+  }
+
+#ifdef __linux__
+  if ((flags & GFILE_RUNS_NO_IO_URING) == 0 &&
+      _gfile_run_io_uring_init(&runs->ring, 2 * runs_count) == 0) {
+    runs->is_io_uring = 1;
+  }
+#else
+  (void)flags;
+#endif
+
+  if (!runs->is_io_uring) {
+    runs->threads_count = (threads_count == 0) ? 1 : threads_count;
+    runs->requests = (struct _gfile_run_request *)malloc(
+        2 * runs_count * sizeof(runs->requests[0]));
+    runs->threads = (pthread_t *)malloc(
+        runs->threads_count * sizeof(runs->threads[0]));
+    if (runs->requests == 0 || runs->threads == 0) {
+      runs->threads_count = 0;
+      gfile_runs_delete(runs);
+      errno = ENOMEM;
+      return 0;
+    }
+    pthread_mutex_init(&runs->mutex, 0);
+    pthread_cond_init(&runs->request_cond, 0);
+    pthread_cond_init(&runs->ready_cond, 0);
+    for (i = 0; i < runs->threads_count; ++i) {
+      if (pthread_create(&runs->threads[i], 0, &_gfile_runs_thread_func,
+          runs) != 0) {
+        runs->threads_count = i;
+        gfile_runs_delete(runs);
+        errno = EAGAIN;
+        return 0;
+      }
+    }
+  }
+
+  for (i = 0; i < runs_count; ++i) {
+    _gfile_run_read_block(&runs->runs[i], 0);
+    _gfile_run_read_block(&runs->runs[i], 1);
+  }
+  _gfile_runs_flush(runs);
+
+  return runs;
+}
+
+static inline void gfile_runs_delete(struct gfile_runs *const runs)
+{
+  size_t i;
+
+#ifdef __linux__
+  if (runs->is_io_uring) {
+    /* The kernel may write into buffers until their reads are finished. */
+    while (runs->pending_reads > 0) {
+      if (_gfile_run_io_uring_submit(&runs->ring, 1) != 0) {
+        _gfile_run_io_uring_abandon(runs);
+        break;
+      }
+      _gfile_run_io_uring_reap(runs);
+    }
+    _gfile_run_io_uring_destroy(&runs->ring);
+  }
+#endif
+
+  if (runs->threads != 0) {
+    pthread_mutex_lock(&runs->mutex);
+    runs->is_stopped = 1;
+    pthread_cond_broadcast(&runs->request_cond);
+    pthread_mutex_unlock(&runs->mutex);
+    for (i = 0; i < runs->threads_count; ++i) {
+      pthread_join(runs->threads[i], 0);
+    }
+    pthread_cond_destroy(&runs->ready_cond);
+    pthread_cond_destroy(&runs->request_cond);
+    pthread_mutex_destroy(&runs->mutex);
+  }
+  free(runs->threads);
+  free(runs->requests);
+
+  for (i = 0; i < runs->runs_count; ++i) {
+    free(runs->runs[i].buffers[0].data);
+    free(runs->runs[i].buffers[1].data);
+  }
+  free(runs->run_ptrs);
+  free(runs->runs);
+  free(runs);
+}
+
+static inline int gfile_runs_is_io_uring(const struct gfile_runs *const runs)
+{
+  return runs->is_io_uring;
+}
+
+static inline int gfile_runs_get_error(const struct gfile_runs *const runs)
+{
+  return runs->error;
+}
+
+static inline size_t gfile_runs_get_count(const struct gfile_runs *const runs)
+{
+  return runs->runs_count;
+}
+
+static inline struct gfile_run *gfile_runs_get_run(
+    struct gfile_runs *const runs, const size_t run_index)
+{
+  assert(run_index < runs->runs_count);
+  return &runs->runs[run_index];
+}
+
+static inline int gfile_run_start(struct gfile_run *const run)
+{
+  return _gfile_run_switch_buffer(run, 0);
+}
+
+static inline const void *gfile_run_get(const struct gfile_run *const run)
+{
+  const struct _gfile_run_buffer *const buffer =
+      &run->buffers[run->current_buffer];
+
+  assert(run->position < buffer->size);
+  return buffer->data + run->position;
+}
+
+static inline int gfile_run_next(struct gfile_run *const run)
+{
+  struct gfile_runs *const runs = run->runs;
+  const size_t current_buffer = run->current_buffer;
+  const struct _gfile_run_buffer *const buffer =
+      &run->buffers[current_buffer];
+
+  assert(run->position < buffer->size);
+  run->position += runs->item_size;
+  if (run->position < buffer->size) {
+    return 1;
+  }
+
+  /*
+   * The current buffer is drained. Reuse it for read-ahead of the block
+   * after the next one, which must be already read in background.
+   */
+  if (run->is_eof) {
+    return 0;
+  }
+  _gfile_run_read_block(run, current_buffer);
+  _gfile_runs_flush(runs);
+  return _gfile_run_switch_buffer(run, 1 - current_buffer);
+}
+
+#ifndef __cplusplus
+
+static inline int _gfile_runs_nway_merge_input_next(void *const ctx)
+{
+  return gfile_run_next(*(struct gfile_run **)ctx);
+}
+
+static inline const void *_gfile_runs_nway_merge_input_get(
+    const void *const ctx)
+{
+  return gfile_run_get(*(struct gfile_run *const *)ctx);
+}
+
+static inline void _gfile_runs_nway_merge_input_ctx_mover(void *const dst,
+    const void *const src)
+{
+  *(struct gfile_run **)dst = *(struct gfile_run *const *)src;
+}
+
+static const struct galgorithm_nway_merge_input_vtable
+    _gfile_runs_nway_merge_input_vtable = {
+  .next = &_gfile_runs_nway_merge_input_next,
+  .get = &_gfile_runs_nway_merge_input_get,
+};
+
+static inline void gfile_runs_init_nway_merge_input(
+    struct gfile_runs *const runs,
+    struct galgorithm_nway_merge_input *const input)
+{
+  size_t ctxs_count = 0;
+
+  for (size_t i = 0; i < runs->runs_count; ++i) {
+    struct gfile_run *const run = &runs->runs[i];
+    if (gfile_run_start(run)) {
+      runs->run_ptrs[ctxs_count] = run;
+      ++ctxs_count;
+    }
+  }
+
+  input->vtable = &_gfile_runs_nway_merge_input_vtable;
+  input->ctxs = runs->run_ptrs;
+  input->ctxs_count = ctxs_count;
+  input->ctx_size = sizeof(runs->run_ptrs[0]);
+  input->ctx_mover = &_gfile_runs_nway_merge_input_ctx_mover;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef GFILE_RUN_HPP
+#define GFILE_RUN_HPP
+
+// Input ranges over sorted runs stored in files for galgorithm::nway_merge().
+//
+// gfile_run_reader<T> wraps readers from gfile_run.h. Each run is a file
+// containing an array of items of type T sorted in ascending order.
+// Items must be trivially copyable. Blocks of all the runs are read ahead
+// in background via io_uring or via the pool of pread() threads,
+// so the merge doesn't wait for I/O at steady state.
+//
+// Usage:
+//
+//   gfile_run_reader<int> reader(fds, block_size);
+//   std::vector<gfile_run_reader<int>::input_range> input_ranges;
+//   reader.get_input_ranges(input_ranges);
+//   if (!input_ranges.empty()) {
+//     galgorithm<Heap>::nway_merge(input_ranges.begin(), input_ranges.end(),
+//         output);
+//   }
+//   if (reader.get_error() != 0) {
+//     // Runs were truncated due to read errors.
+//   }
+//
+// See gfile_run.h for details.
+
+#include "gfile_run.h"
+
+#include <cerrno>      // for errno
+#include <cstddef>     // for size_t, ptrdiff_t
+#include <cstring>     // for strerror()
+#include <iterator>    // for std::input_iterator_tag
+#include <stdexcept>   // for std::runtime_error
+#include <string>      // for std::string
+#include <utility>     // for std::pair
+#include <vector>      // for std::vector
+
+// Input iterator over items of a single run.
+// The end iterator doesn't refer to any run.
+template <class T>
+class gfile_run_iterator
+{
+public:
+
+  typedef std::input_iterator_tag iterator_category;
+  typedef T value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const T *pointer;
+  typedef const T &reference;
+
+private:
+
+  gfile_run *_run;
+
+public:
+
+  gfile_run_iterator() : _run(0) {}
+
+  // The run must be started via gfile_run_start() and must be non-empty.
+  explicit gfile_run_iterator(gfile_run *const run) : _run(run) {}
+
+  reference operator * () const
+  {
+    return *static_cast<const T *>(gfile_run_get(_run));
+  }
+
+  pointer operator -> () const
+  {
+    return static_cast<const T *>(gfile_run_get(_run));
+  }
+
+  gfile_run_iterator &operator ++ ()
+  {
+    if (!gfile_run_next(_run)) {
+      _run = 0;
+    }
+    return *this;
+  }
+
+  bool operator == (const gfile_run_iterator &it) const
+  {
+    return (_run == it._run);
+  }
+
+  bool operator != (const gfile_run_iterator &it) const
+  {
+    return (_run != it._run);
+  }
+};
+
+template <class T>
+class gfile_run_reader
+{
+public:
+
+  typedef gfile_run_iterator<T> iterator;
+  typedef std::pair<iterator, iterator> input_range;
+
+private:
+
+  gfile_runs *_runs;
+
+  // Disable copying.
+  gfile_run_reader(const gfile_run_reader &);
+  gfile_run_reader &operator = (const gfile_run_reader &);
+
+public:
+
+  // Creates readers for runs stored in files with the given descriptors.
+  // See gfile_runs_create() for arguments' description.
+  //
+  // Throws std::runtime_error on error.
+  explicit gfile_run_reader(const std::vector<int> &fds,
+      const size_t block_size, const size_t threads_count = 4,
+      const int flags = 0)
+  {
+    if (fds.empty()) {
+      throw std::runtime_error("gfile_run_reader: no runs");
+    }
+    _runs = gfile_runs_create(&fds[0], fds.size(), sizeof(T), block_size,
+        threads_count, flags);
+    if (_runs == 0) {
+      throw std::runtime_error(std::string("gfile_run_reader: ") +
+          strerror(errno));
+    }
+  }
+
+  ~gfile_run_reader()
+  {
+    gfile_runs_delete(_runs);
+  }
+
+  bool is_io_uring() const
+  {
+    return (gfile_runs_is_io_uring(_runs) != 0);
+  }
+
+  // Returns errno value for the first read error or zero if there were
+  // no errors.
+  int get_error() const
+  {
+    return gfile_runs_get_error(_runs);
+  }
+
+  // Appends input ranges for non-empty runs to input_ranges.
+  // Waits for the first block of each run.
+  //
+  // Must be called only once.
+  void get_input_ranges(std::vector<input_range> &input_ranges)
+  {
+    const size_t runs_count = gfile_runs_get_count(_runs);
+    for (size_t i = 0; i < runs_count; ++i) {
+      gfile_run *const run = gfile_runs_get_run(_runs, i);
+      if (gfile_run_start(run)) {
+        input_ranges.push_back(input_range(iterator(run), iterator()));
+      }
+    }
+  }
+};
+#endif
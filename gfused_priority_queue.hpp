@@ -0,0 +1,164 @@
+#ifndef GFUSED_PRIORITY_QUEUE_H
+#define GFUSED_PRIORITY_QUEUE_H
+
+// Priority queue on top of Heap, which fuses pop() with the subsequent push().
+//
+// pop() doesn't restore heap invariant immediately. It marks the top item
+// as a hole instead. If the next operation is push(), the new item fills
+// the hole with a single sift-down, i.e. pop() + push() pair costs the same
+// as Heap::swap_max_item(). Otherwise the deferred sift is performed
+// before the next top() or pop().
+//
+// This allows transparently speeding up code with pop() + push() patterns
+// (for example, event loops), which cannot be rewritten to swap_max_item(),
+// since pop() and push() are called from distinct places.
+//
+// The popped item remains in the underlying container until it is overwritten
+// by the next push() or removed by the deferred sift.
+//
+// The queue exposes the same interface as gpriority_queue except for
+// the underlying container, which isn't public, since it may contain a hole,
+// and top(), which isn't const, since it may need filling the hole.
+//
+// Pass -DGHEAP_CPP11 to compiler for enabling C++11 optimization,
+// otherwise C++03 optimization will be enabled.
+
+#include <cassert>
+#include <functional>   // for std::less
+#include <vector>
+
+#ifdef GHEAP_CPP11
+#  include <utility>    // for std::swap(), std::move()
+#else
+#  include <algorithm>  // for std::swap()
+#endif
+
+template <class Heap, class T, class Container = std::vector<T>,
+    class LessComparer = std::less<typename Container::value_type> >
+class gfused_priority_queue
+{
+public:
+
+  typedef Container container_type;
+  typedef typename Container::value_type value_type;
+  typedef typename Container::size_type size_type;
+  typedef typename Container::reference reference;
+  typedef typename Container::const_reference const_reference;
+
+  LessComparer comp;
+
+private:
+
+  Container _c;
+
+  // Whether the top item in the container has been popped.
+  bool _has_hole;
+
+  // Removes the hole from the top of the heap.
+  void _fill_hole()
+  {
+    assert(_has_hole);
+
+    Heap::pop_heap(_c.begin(), _c.end(), comp);
+    _c.pop_back();
+    _has_hole = false;
+  }
+
+public:
+  explicit gfused_priority_queue(
+      const LessComparer &less_comparer = LessComparer(),
+      const Container &container = Container()) :
+          comp(less_comparer), _c(container), _has_hole(false)
+  {
+    Heap::make_heap(_c.begin(), _c.end(), comp);
+  }
+
+  template <class InputIterator>
+  gfused_priority_queue(const InputIterator &first, const InputIterator &last,
+      const LessComparer &less_comparer = LessComparer(),
+      const Container &container = Container()) :
+          comp(less_comparer), _c(container), _has_hole(false)
+  {
+    _c.insert(_c.end(), first, last);
+    Heap::make_heap(_c.begin(), _c.end(), comp);
+  }
+
+  bool empty() const
+  {
+    return (size() == 0);
+  }
+
+  size_type size() const
+  {
+    return _c.size() - (_has_hole ? 1 : 0);
+  }
+
+  const_reference top()
+  {
+    assert(!empty());
+
+    if (_has_hole) {
+      _fill_hole();
+    }
+    return _c.front();
+  }
+
+  void push(const T &v)
+  {
+    if (_has_hole) {
+      _c.front() = v;
+      Heap::restore_heap_after_item_decrease(_c.begin(), _c.begin(), _c.end(),
+          comp);
+      _has_hole = false;
+      return;
+    }
+    _c.push_back(v);
+    Heap::push_heap(_c.begin(), _c.end(), comp);
+  }
+
+  void pop()
+  {
+    assert(!empty());
+
+    if (_has_hole) {
+      _fill_hole();
+    }
+    _has_hole = true;
+  }
+
+  void swap(gfused_priority_queue &q)
+  {
+    std::swap(_c, q._c);
+    std::swap(_has_hole, q._has_hole);
+    std::swap(comp, q.comp);
+  }
+
+#ifdef GHEAP_CPP11
+  void push(T &&v)
+  {
+    if (_has_hole) {
+      _c.front() = std::move(v);
+      Heap::restore_heap_after_item_decrease(_c.begin(), _c.begin(), _c.end(),
+          comp);
+      _has_hole = false;
+      return;
+    }
+    _c.push_back(std::move(v));
+    Heap::push_heap(_c.begin(), _c.end(), comp);
+  }
+#endif
+
+  // Copy constructors and assignment operators are implicitly defined.
+};
+
+namespace std
+{
+  template <class Heap, class T, class Container, class LessComparer>
+  void swap(
+      gfused_priority_queue<Heap, T, Container, LessComparer> &a,
+      gfused_priority_queue<Heap, T, Container, LessComparer> &b)
+  {
+    a.swap(b);
+  }
+}
+#endif
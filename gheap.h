@@ -6,6 +6,7 @@
  *
  * Don't forget passing -DNDEBUG option to the compiler when creating optimized
  * builds. This significantly speeds up gheap code by removing debug assertions.
+ * See gheap_check.h for lighter heap invariant checks in debug builds.
  *
  * Author: Aliaksandr Valialkin <valyala@gmail.com>.
  */
@@ -162,6 +163,8 @@ static inline void gheap_remove_from_heap(const struct gheap_ctx *ctx,
  * ( http://en.wikipedia.org/wiki/Constant_folding ).
  *****************************************************************************/
 
+#include "gheap_check.h"
+
 #include <assert.h>     /* for assert */
 #include <stddef.h>     /* for size_t */
 #include <stdint.h>     /* for uintptr_t, SIZE_MAX and UINTPTR_MAX */
@@ -319,8 +322,10 @@ static inline size_t _gheap_move_up_max_child(const struct gheap_ctx *const ctx,
 /*
  * Sifts the given item down in the heap of the given size starting
  * from the hole_index.
+ * Returns the index of the leaf the hole has been moved to before the item
+ * is sifted up. Only items on the path from hole_index to the leaf are moved.
  */
-static inline void _gheap_sift_down(const struct gheap_ctx *const ctx,
+static inline size_t _gheap_sift_down(const struct gheap_ctx *const ctx,
     void *const base, const size_t heap_size, size_t hole_index,
     const void *const item)
 {
@@ -346,6 +351,7 @@ static inline void _gheap_sift_down(const struct gheap_ctx *const ctx,
         child_index);
   }
   _gheap_sift_up(ctx, base, root_index, hole_index, item);
+  return hole_index;
 }
 
 /*
@@ -382,6 +388,97 @@ static inline int gheap_is_heap(const struct gheap_ctx *const ctx,
   return (gheap_is_heap_until(ctx, base, heap_size) == heap_size);
 }
 
+/*
+ * Returns non-zero if the item at index u isn't less than its children
+ * in the heap of the given size.
+ */
+static inline int _gheap_is_heap_node(const struct gheap_ctx *const ctx,
+    const void *const base, const size_t heap_size, const size_t u)
+{
+  const size_t fanout = ctx->fanout;
+  const gheap_less_comparer_t less_comparer = ctx->less_comparer;
+  const void *const less_comparer_ctx = ctx->less_comparer_ctx;
+
+  const size_t child_index = gheap_get_child_index(ctx, u);
+  if (child_index >= heap_size) {
+    return 1;
+  }
+  const size_t children_count = (heap_size - child_index < fanout) ?
+      (heap_size - child_index) : fanout;
+  const void *const item = _gheap_get_item_ptr(ctx, base, u);
+  for (size_t i = 0; i < children_count; ++i) {
+    const void *const child = _gheap_get_item_ptr(ctx, base, child_index + i);
+    if (less_comparer(less_comparer_ctx, item, child)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Returns non-zero if the heap invariant holds for the items on the path
+ * from the root to the item at index u, i.e. these items aren't less than
+ * their children.
+ */
+static inline int _gheap_is_heap_path(const struct gheap_ctx *const ctx,
+    const void *const base, const size_t heap_size, size_t u)
+{
+  assert(u < heap_size);
+
+  while (_gheap_is_heap_node(ctx, base, heap_size, u)) {
+    if (u == 0) {
+      return 1;
+    }
+    u = gheap_get_parent_index(ctx, u);
+  }
+  return 0;
+}
+
+/*
+ * Returns non-zero if the whole heap must be checked according
+ * to GHEAP_CHECK_LEVEL.
+ */
+static inline int _gheap_is_full_check_needed(void)
+{
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_FULL
+  return 1;
+#elif GHEAP_CHECK_LEVEL == GHEAP_CHECK_SAMPLED
+  static size_t checks_count = 0;
+  return (++checks_count % GHEAP_CHECK_SAMPLE_PERIOD == 0);
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Checks the heap invariant for the whole heap according
+ * to GHEAP_CHECK_LEVEL.
+ */
+static inline int _gheap_check_heap(const struct gheap_ctx *const ctx,
+    const void *const base, const size_t heap_size)
+{
+  return (!_gheap_is_full_check_needed() ||
+      gheap_is_heap(ctx, base, heap_size));
+}
+
+/*
+ * Checks the heap invariant after items on the path from the root
+ * to the item at index u have been moved according to GHEAP_CHECK_LEVEL.
+ * Sifting down moves items on the path to the leaf returned
+ * by _gheap_sift_down(), while sifting up moves items on the path
+ * to the start index.
+ */
+static inline int _gheap_check_heap_path(const struct gheap_ctx *const ctx,
+    const void *const base, const size_t heap_size, const size_t u)
+{
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_LOCAL
+  return (heap_size == 0 || _gheap_is_heap_path(ctx, base, heap_size, u));
+#else
+  (void)u;
+  return _gheap_check_heap(ctx, base, heap_size);
+#endif
+}
+
 static inline void gheap_make_heap(const struct gheap_ctx *const ctx,
     void *const base, const size_t heap_size)
 {
@@ -404,14 +501,15 @@ static inline void gheap_make_heap(const struct gheap_ctx *const ctx,
     } while (i-- > 0);
   }
 
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(GHEAP_CHECK_LEVEL == GHEAP_CHECK_OFF ||
+      gheap_is_heap(ctx, base, heap_size));
 }
 
 static inline void gheap_push_heap(const struct gheap_ctx *const ctx,
     void *const base, const size_t heap_size)
 {
   assert(heap_size > 0);
-  assert(gheap_is_heap(ctx, base, heap_size - 1));
+  assert(_gheap_check_heap(ctx, base, heap_size - 1));
 
   const size_t item_size = ctx->item_size;
   const gheap_item_mover_t item_mover = ctx->item_mover;
@@ -423,20 +521,20 @@ static inline void gheap_push_heap(const struct gheap_ctx *const ctx,
     _gheap_sift_up(ctx, base, 0, u, tmp);
   }
 
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap_path(ctx, base, heap_size, heap_size - 1));
 }
 
 static inline void gheap_pop_heap(const struct gheap_ctx *const ctx,
     void *const base, const size_t heap_size)
 {
   assert(heap_size > 0);
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap(ctx, base, heap_size));
 
   if (heap_size > 1) {
     _gheap_pop_max_item(ctx, base, heap_size - 1);
   }
 
-  assert(gheap_is_heap(ctx, base, heap_size - 1));
+  assert(_gheap_check_heap_path(ctx, base, heap_size - 1, 0));
 }
 
 static inline void gheap_sort_heap(const struct gheap_ctx *const ctx,
@@ -451,7 +549,7 @@ static inline void gheap_swap_max_item(const struct gheap_ctx *const ctx,
     void *const base, const size_t heap_size, void *item)
 {
   assert(heap_size > 0);
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap(ctx, base, heap_size));
 
   const size_t item_size = ctx->item_size;
   const gheap_item_mover_t item_mover = ctx->item_mover;
@@ -459,9 +557,10 @@ static inline void gheap_swap_max_item(const struct gheap_ctx *const ctx,
   char tmp[item_size];
   item_mover(tmp, item);
   item_mover(item, base);
-  _gheap_sift_down(ctx, base, heap_size, 0, tmp);
+  const size_t leaf_index = _gheap_sift_down(ctx, base, heap_size, 0, tmp);
 
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap_path(ctx, base, heap_size, leaf_index));
+  (void)leaf_index;
 }
 
 static inline void gheap_restore_heap_after_item_increase(
@@ -470,7 +569,7 @@ static inline void gheap_restore_heap_after_item_increase(
 {
   assert(heap_size > 0);
   assert(modified_item_index < heap_size);
-  assert(gheap_is_heap(ctx, base, modified_item_index));
+  assert(_gheap_check_heap(ctx, base, modified_item_index));
 
   const size_t item_size = ctx->item_size;
   const gheap_item_mover_t item_mover = ctx->item_mover;
@@ -481,7 +580,7 @@ static inline void gheap_restore_heap_after_item_increase(
     _gheap_sift_up(ctx, base, 0, modified_item_index, tmp);
   }
 
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap_path(ctx, base, heap_size, modified_item_index));
   (void)heap_size;
 }
 
@@ -491,16 +590,18 @@ static inline void gheap_restore_heap_after_item_decrease(
 {
   assert(heap_size > 0);
   assert(modified_item_index < heap_size);
-  assert(gheap_is_heap(ctx, base, modified_item_index));
+  assert(_gheap_check_heap(ctx, base, modified_item_index));
 
   const size_t item_size = ctx->item_size;
   const gheap_item_mover_t item_mover = ctx->item_mover;
 
   char tmp[item_size];
   item_mover(tmp, _gheap_get_item_ptr(ctx, base, modified_item_index));
-  _gheap_sift_down(ctx, base, heap_size, modified_item_index, tmp);
+  const size_t leaf_index = _gheap_sift_down(ctx, base, heap_size,
+      modified_item_index, tmp);
 
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap_path(ctx, base, heap_size, leaf_index));
+  (void)leaf_index;
 }
 
 static inline void gheap_remove_from_heap(const struct gheap_ctx *const ctx,
@@ -508,7 +609,7 @@ static inline void gheap_remove_from_heap(const struct gheap_ctx *const ctx,
 {
   assert(heap_size > 0);
   assert(item_index < heap_size);
-  assert(gheap_is_heap(ctx, base, heap_size));
+  assert(_gheap_check_heap(ctx, base, heap_size));
 
   const size_t item_size = ctx->item_size;
   const gheap_less_comparer_t less_comparer = ctx->less_comparer;
@@ -516,20 +617,24 @@ static inline void gheap_remove_from_heap(const struct gheap_ctx *const ctx,
   const gheap_item_mover_t item_mover = ctx->item_mover;
 
   const size_t new_heap_size = heap_size - 1;
+  size_t path_index = 0;
   if (item_index < new_heap_size) {
     char tmp[item_size];
     void *const hole = _gheap_get_item_ptr(ctx, base, new_heap_size);
     item_mover(tmp, hole);
     item_mover(hole, _gheap_get_item_ptr(ctx, base, item_index));
     if (less_comparer(less_comparer_ctx, tmp, hole)) {
-      _gheap_sift_down(ctx, base, new_heap_size, item_index, tmp);
+      path_index = _gheap_sift_down(ctx, base, new_heap_size, item_index,
+          tmp);
     }
     else {
       _gheap_sift_up(ctx, base, 0, item_index, tmp);
+      path_index = item_index;
     }
   }
 
-  assert(gheap_is_heap(ctx, base, new_heap_size));
+  assert(_gheap_check_heap_path(ctx, base, new_heap_size, path_index));
+  (void)path_index;
 }
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef GHEAP_CHECK_H
+#define GHEAP_CHECK_H
+
+/*
+ * Heap invariant checking levels for gheap.h, gheap_cpp03.hpp
+ * and gheap_cpp11.hpp.
+ *
+ * Heap operations verify the heap invariant via assert(), so checks
+ * are disabled by -DNDEBUG regardless of the level. Full checks are O(n)
+ * per O(log n) operation, which makes debug builds with big heaps unusably
+ * slow. So the level may be lowered by passing -DGHEAP_CHECK_LEVEL=<level>
+ * to the compiler:
+ *
+ * - GHEAP_CHECK_OFF - heap invariant isn't checked. Other assertions,
+ *   such as index bounds checks, remain enabled.
+ * - GHEAP_CHECK_LOCAL - only items touched by the operation are checked,
+ *   i.e. the path the item has been sifted along, together with children
+ *   of items on the path. This is O(Fanout * log n) per operation.
+ *   Preconditions for the whole heap aren't checked.
+ * - GHEAP_CHECK_SAMPLED - every GHEAP_CHECK_SAMPLE_PERIOD-th check
+ *   verifies the whole heap, while the rest of checks are skipped.
+ *   The checks counter is thread-local in C++11 and global in C++03 and C.
+ * - GHEAP_CHECK_FULL - the whole heap is checked before and after each
+ *   operation. This is the default.
+ *
+ * make_heap() is O(n), so it checks the whole heap at all the levels
+ * except GHEAP_CHECK_OFF.
+ */
+
+#define GHEAP_CHECK_OFF 0
+#define GHEAP_CHECK_LOCAL 1
+#define GHEAP_CHECK_SAMPLED 2
+#define GHEAP_CHECK_FULL 3
+
+#ifndef GHEAP_CHECK_LEVEL
+#  define GHEAP_CHECK_LEVEL GHEAP_CHECK_FULL
+#endif
+
+#ifndef GHEAP_CHECK_SAMPLE_PERIOD
+#  define GHEAP_CHECK_SAMPLE_PERIOD 1024
+#endif
+
+#endif
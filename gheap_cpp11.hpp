@@ -15,9 +15,12 @@
 //
 // Don't forget passing -DNDEBUG option to the compiler when creating optimized
 // builds. This significantly speeds up gheap code by removing debug assertions.
+// See gheap_check.h for lighter heap invariant checks in debug builds.
 //
 // Author: Aliaksandr Valialkin <valyala@gmail.com>.
 
+#include "gheap_check.h"
+
 #include <cassert>     // for assert
 #include <cstddef>     // for size_t
 #include <cstdint>     // for SIZE_MAX
@@ -176,8 +179,11 @@ private:
 
   // Sifts the given item down in the heap of the given size starting
   // from the hole_index.
+  // Returns the index of the leaf the hole has been moved to before the item
+  // is sifted up. Only items on the path from hole_index to the leaf
+  // are moved.
   template <class RandomAccessIterator, class LessComparer>
-  static void _sift_down(const RandomAccessIterator &first,
+  static size_t _sift_down(const RandomAccessIterator &first,
       const LessComparer &less_comparer,
       const size_t heap_size, size_t hole_index,
       const typename std::iterator_traits<RandomAccessIterator>::value_type
@@ -203,6 +209,7 @@ private:
           hole_index, child_index);
     }
     _sift_up(first, less_comparer, root_index, hole_index, item);
+    return hole_index;
   }
 
   // Standard less comparer.
@@ -216,8 +223,9 @@ private:
 
   // Pops max item from the heap [first[0] ... first[heap_size-1]]
   // into first[heap_size].
+  // Returns the index of the leaf returned by _sift_down().
   template <class RandomAccessIterator, class LessComparer>
-  static void _pop_max_item(const RandomAccessIterator &first,
+  static size_t _pop_max_item(const RandomAccessIterator &first,
       const LessComparer &less_comparer, const size_t heap_size)
   {
     assert(heap_size > 0);
@@ -227,7 +235,7 @@ private:
 
     value_type tmp = std::move(first[heap_size]);
     _move(first[heap_size], first[0]);
-    _sift_down(first, less_comparer, heap_size, 0, tmp);
+    return _sift_down(first, less_comparer, heap_size, 0, tmp);
   }
 
 public:
@@ -306,7 +314,8 @@ public:
       } while (i-- > 0);
     }
 
-    assert(is_heap(first, last, less_comparer));
+    assert(GHEAP_CHECK_LEVEL == GHEAP_CHECK_OFF ||
+        is_heap(first, last, less_comparer));
   }
 
   // Makes max heap from items [first ... last) using operator< for items'
@@ -325,7 +334,7 @@ public:
       const RandomAccessIterator &last, const LessComparer &less_comparer)
   {
     assert(last > first);
-    assert(is_heap(first, last - 1, less_comparer));
+    assert(_check_heap(first, last - 1, less_comparer));
 
     typedef typename std::iterator_traits<RandomAccessIterator>::value_type
         value_type;
@@ -337,7 +346,7 @@ public:
       _sift_up(first, less_comparer, 0, u, item);
     }
 
-    assert(is_heap(first, last, less_comparer));
+    assert(_check_heap_path(first, last, less_comparer, heap_size - 1));
   }
 
   // Pushes the item *(last - 1) into max heap [first ... last - 1)
@@ -356,14 +365,16 @@ public:
       const RandomAccessIterator &last, const LessComparer &less_comparer)
   {
     assert(last > first);
-    assert(is_heap(first, last, less_comparer));
+    assert(_check_heap(first, last, less_comparer));
 
     const size_t heap_size = last - first;
+    size_t leaf_index = 0;
     if (heap_size > 1) {
-      _pop_max_item(first, less_comparer, heap_size - 1);
+      leaf_index = _pop_max_item(first, less_comparer, heap_size - 1);
     }
 
-    assert(is_heap(first, last - 1, less_comparer));
+    assert(_check_heap_path(first, last - 1, less_comparer, leaf_index));
+    (void)leaf_index;
   }
 
   // Pops the maximum item from max heap [first ... last) into
@@ -409,7 +420,7 @@ public:
       const LessComparer &less_comparer)
   {
     assert(first < last);
-    assert(is_heap(first, last, less_comparer));
+    assert(_check_heap(first, last, less_comparer));
 
     typedef typename std::iterator_traits<RandomAccessIterator>::value_type
         value_type;
@@ -418,9 +429,11 @@ public:
 
     value_type tmp = std::move(item);
     _move(item, first[0]);
-    _sift_down(first, less_comparer, heap_size, 0, tmp);
+    const size_t leaf_index = _sift_down(first, less_comparer, heap_size, 0,
+        tmp);
 
-    assert(is_heap(first, last, less_comparer));
+    assert(_check_heap_path(first, last, less_comparer, leaf_index));
+    (void)leaf_index;
   }
 
   // Swaps the item outside the heap with the maximum item inside
@@ -442,7 +455,7 @@ public:
       const LessComparer &less_comparer)
   {
     assert(item >= first);
-    assert(is_heap(first, item, less_comparer));
+    assert(_check_heap(first, item, less_comparer));
 
     typedef typename std::iterator_traits<RandomAccessIterator>::value_type
         value_type;
@@ -453,7 +466,7 @@ public:
       _sift_up(first, less_comparer, 0, hole_index, tmp);
     }
 
-    assert(is_heap(first, item + 1, less_comparer));
+    assert(_check_heap_path(first, item + 1, less_comparer, hole_index));
   }
 
   // Restores max heap invariant after item's value has been increased,
@@ -476,7 +489,7 @@ public:
     assert(last > first);
     assert(item >= first);
     assert(item < last);
-    assert(is_heap(first, item, less_comparer));
+    assert(_check_heap(first, item, less_comparer));
 
     typedef typename std::iterator_traits<RandomAccessIterator>::value_type
         value_type;
@@ -484,9 +497,11 @@ public:
     const size_t heap_size = last - first;
     const size_t hole_index = item - first;
     value_type tmp = std::move(*item);
-    _sift_down(first, less_comparer, heap_size, hole_index, tmp);
+    const size_t leaf_index = _sift_down(first, less_comparer, heap_size,
+        hole_index, tmp);
 
-    assert(is_heap(first, last, less_comparer));
+    assert(_check_heap_path(first, last, less_comparer, leaf_index));
+    (void)leaf_index;
   }
 
   // Restores max heap invariant after item's value has been decreased,
@@ -510,25 +525,29 @@ public:
     assert(last > first);
     assert(item >= first);
     assert(item < last);
-    assert(is_heap(first, last, less_comparer));
+    assert(_check_heap(first, last, less_comparer));
 
     typedef typename std::iterator_traits<RandomAccessIterator>::value_type
         value_type;
 
     const size_t new_heap_size = last - first - 1;
     const size_t hole_index = item - first;
+    size_t path_index = 0;
     if (hole_index < new_heap_size) {
       value_type tmp = std::move(first[new_heap_size]);
       _move(first[new_heap_size], *item);
       if (less_comparer(tmp, first[new_heap_size])) {
-        _sift_down(first, less_comparer, new_heap_size, hole_index, tmp);
+        path_index = _sift_down(first, less_comparer, new_heap_size,
+            hole_index, tmp);
       }
       else {
         _sift_up(first, less_comparer, 0, hole_index, tmp);
+        path_index = hole_index;
       }
     }
 
-    assert(is_heap(first, last - 1, less_comparer));
+    assert(_check_heap_path(first, last - 1, less_comparer, path_index));
+    (void)path_index;
   }
 
   // Removes the given item from the heap and puts it into *(last - 1).
@@ -540,5 +559,88 @@ public:
     remove_from_heap(first, item, last,
         _std_less_comparer<RandomAccessIterator>);
   }
+
+private:
+
+  // Returns true if the item at index u isn't less than its children
+  // in the heap of the given size.
+  template <class RandomAccessIterator, class LessComparer>
+  static bool _is_heap_node(const RandomAccessIterator &first,
+      const LessComparer &less_comparer, const size_t heap_size,
+      const size_t u)
+  {
+    const size_t child_index = get_child_index(u);
+    if (child_index >= heap_size) {
+      return true;
+    }
+    const size_t children_count = (heap_size - child_index < Fanout) ?
+        (heap_size - child_index) : Fanout;
+    for (size_t i = 0; i < children_count; ++i) {
+      if (less_comparer(first[u], first[child_index + i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns true if the heap invariant holds for the items on the path
+  // from the root to the item at index u, i.e. these items aren't less
+  // than their children.
+  template <class RandomAccessIterator, class LessComparer>
+  static bool _is_heap_path(const RandomAccessIterator &first,
+      const LessComparer &less_comparer, const size_t heap_size, size_t u)
+  {
+    assert(u < heap_size);
+
+    while (_is_heap_node(first, less_comparer, heap_size, u)) {
+      if (u == 0) {
+        return true;
+      }
+      u = get_parent_index(u);
+    }
+    return false;
+  }
+
+  // Returns true if the whole heap must be checked according
+  // to GHEAP_CHECK_LEVEL.
+  static bool _is_full_check_needed()
+  {
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_FULL
+    return true;
+#elif GHEAP_CHECK_LEVEL == GHEAP_CHECK_SAMPLED
+    static thread_local size_t checks_count = 0;
+    return (++checks_count % GHEAP_CHECK_SAMPLE_PERIOD == 0);
+#else
+    return false;
+#endif
+  }
+
+  // Checks the heap invariant for the whole heap [first ... last)
+  // according to GHEAP_CHECK_LEVEL.
+  template <class RandomAccessIterator, class LessComparer>
+  static bool _check_heap(const RandomAccessIterator &first,
+      const RandomAccessIterator &last, const LessComparer &less_comparer)
+  {
+    return (!_is_full_check_needed() || is_heap(first, last, less_comparer));
+  }
+
+  // Checks the heap invariant for the heap [first ... last) after items
+  // on the path from the root to the item at index u have been moved
+  // according to GHEAP_CHECK_LEVEL. Sifting down moves items on the path
+  // to the leaf returned by _sift_down(), while sifting up moves items
+  // on the path to the start index.
+  template <class RandomAccessIterator, class LessComparer>
+  static bool _check_heap_path(const RandomAccessIterator &first,
+      const RandomAccessIterator &last, const LessComparer &less_comparer,
+      const size_t u)
+  {
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_LOCAL
+    return (first == last ||
+        _is_heap_path(first, less_comparer, last - first, u));
+#else
+    (void)u;
+    return _check_heap(first, last, less_comparer);
+#endif
+  }
 };
 #endif
@@ -0,0 +1,364 @@
+#ifndef GHEAVY_HITTERS_H
+#define GHEAVY_HITTERS_H
+
+// Heavy hitters (the most frequent keys) stream summary on top of Heap.
+//
+// Implements SpaceSaving algorithm - see
+// http://www.cs.ucsb.edu/research/tech_reports/reports/2005-23.pdf .
+// The summary holds up to capacity counters. Counters are kept in a min-heap
+// ordered by count, while gkey_table maps keys to counters. Heap positions
+// of counters are tracked, so counter increments are handled by a single sift
+// in the heap.
+//
+// Pass -DGHEAP_CPP11 to compiler for enabling C++11 optimization,
+// otherwise C++03 optimization will be enabled.
+//
+// Don't forget passing -DNDEBUG option to the compiler when creating optimized
+// builds. This significantly speeds up the code by removing debug assertions.
+
+#include "galgorithm.hpp"
+#include "gheap.hpp"
+#include "gkey_table.hpp"
+
+#include <algorithm>   // for std::swap()
+#include <cassert>     // for assert
+#include <cstddef>     // for size_t
+#include <functional>  // for std::equal_to
+#include <vector>      // for std::vector
+
+// Default hasher for gheavy_hitters. It is suitable for integer keys only.
+// Provide custom hasher for other key types.
+template <class Key>
+struct gheavy_hitters_hasher
+{
+  size_t operator() (const Key &key) const
+  {
+    return (size_t)key;
+  }
+};
+
+template <class Heap, class Key, class Hasher = gheavy_hitters_hasher<Key>,
+    class KeyEqual = std::equal_to<Key> >
+class gheavy_hitters
+{
+public:
+
+  typedef Key key_type;
+  typedef size_t size_type;
+
+  // Counter for the given key.
+  // The real number of key occurrences in the stream is in the range
+  // [count - error ... count].
+  struct counter
+  {
+    Key key;
+    size_t count;
+    size_t error;
+  };
+
+private:
+
+  struct _entry
+  {
+    counter c;
+    size_t heap_index;
+  };
+
+  // Less comparer for the heap of entry indexes. Entries with smaller counts
+  // go to the top of the heap.
+  class _count_less_comparer
+  {
+  private:
+    const std::vector<_entry> *_entries;
+
+  public:
+    _count_less_comparer(const std::vector<_entry> &entries) :
+        _entries(&entries) {}
+
+    bool operator() (const size_t &a, const size_t &b) const
+    {
+      return ((*_entries)[b].c.count < (*_entries)[a].c.count);
+    }
+  };
+
+  // Less comparer for counters, which puts counters with bigger counts
+  // to the beginning of sorted ranges.
+  static bool _counter_less_comparer(const counter &a, const counter &b)
+  {
+    return (b.count < a.count);
+  }
+
+  // Returns keys of entries for the key table.
+  class _entry_key_getter
+  {
+  private:
+    const std::vector<_entry> *_entries;
+
+  public:
+    _entry_key_getter(const std::vector<_entry> &entries) :
+        _entries(&entries) {}
+
+    const Key &operator() (const size_t i) const
+    {
+      return (*_entries)[i].c.key;
+    }
+  };
+
+  typedef gkey_table<Key, Hasher, KeyEqual> _key_table;
+
+  size_t _capacity;
+  size_t _total;
+
+  std::vector<_entry> _entries;
+  std::vector<size_t> _heap;
+  _key_table _slots;
+
+  // Returns the slot containing the given key or an empty slot
+  // if the key is missing.
+  size_t _find_slot(const Key &key) const
+  {
+    return _slots.find_slot(key, _entry_key_getter(_entries));
+  }
+
+  void _fix_heap_indexes(const size_t heap_index)
+  {
+    gkey_table_fix_heap_indexes(_entries, _heap, heap_index);
+  }
+
+  // Restores heap invariant after count increase for the entry
+  // at the given heap index.
+  void _restore_heap_after_count_increase(const size_t heap_index)
+  {
+    // Counts increase means item decrease in the heap, since the heap
+    // holds entries with the smallest counts at the top.
+    Heap::restore_heap_after_item_decrease(_heap.begin(),
+        _heap.begin() + heap_index, _heap.end(),
+        _count_less_comparer(_entries));
+    _fix_heap_indexes(heap_index);
+  }
+
+  // Adds new counter to the summary, which must contain less than capacity
+  // counters.
+  void _push_counter(const counter &c)
+  {
+    assert(_entries.size() < _capacity);
+
+    const size_t entry_index = _entries.size();
+    const size_t i = _find_slot(c.key);
+    assert(_slots[i] == _key_table::EMPTY_SLOT);
+    _slots[i] = entry_index;
+
+    _entry e;
+    e.c = c;
+    e.heap_index = _heap.size();
+    _entries.push_back(e);
+    _heap.push_back(entry_index);
+    Heap::push_heap(_heap.begin(), _heap.end(),
+        _count_less_comparer(_entries));
+    _fix_heap_indexes(_heap.size() - 1);
+  }
+
+  // Returns a count for keys missing in the summary.
+  size_t _get_missing_count() const
+  {
+    return (_entries.size() < _capacity) ? 0 : min_count();
+  }
+
+public:
+
+  // Creates an empty summary, which may hold up to capacity counters.
+  // The summary finds all the keys with frequencies exceeding
+  // total() / capacity.
+  explicit gheavy_hitters(const size_t capacity,
+      const Hasher &hasher = Hasher(), const KeyEqual &key_equal = KeyEqual()) :
+          _capacity(capacity), _total(0), _slots(hasher, key_equal)
+  {
+    assert(capacity > 0);
+
+    _entries.reserve(capacity);
+    _heap.reserve(capacity);
+    _slots.reserve(capacity, 0, _entry_key_getter(_entries));
+  }
+
+  // Returns the maximum number of counters in the summary.
+  size_t capacity() const
+  {
+    return _capacity;
+  }
+
+  // Returns the number of counters in the summary.
+  size_t size() const
+  {
+    return _entries.size();
+  }
+
+  bool empty() const
+  {
+    return _entries.empty();
+  }
+
+  // Returns the sum of all the increments passed to add().
+  size_t total() const
+  {
+    return _total;
+  }
+
+  // Returns the minimum count in the summary.
+  // Keys missing in the full summary occurred no more than min_count() times.
+  size_t min_count() const
+  {
+    assert(!empty());
+
+    return _entries[_heap[0]].c.count;
+  }
+
+  // Registers increment occurrences of the given key.
+  void add(const Key &key, const size_t increment = 1)
+  {
+    _total += increment;
+
+    const size_t i = _find_slot(key);
+    if (_slots[i] != _key_table::EMPTY_SLOT) {
+      _entry &e = _entries[_slots[i]];
+      e.c.count += increment;
+      _restore_heap_after_count_increase(e.heap_index);
+      return;
+    }
+
+    if (_entries.size() < _capacity) {
+      counter c;
+      c.key = key;
+      c.count = increment;
+      c.error = 0;
+      _push_counter(c);
+      return;
+    }
+
+    // Replace the counter with the minimum count by the given key.
+    const size_t entry_index = _heap[0];
+    _entry &e = _entries[entry_index];
+    _slots.erase_slot(_find_slot(e.c.key), _entry_key_getter(_entries));
+    e.c.key = key;
+    e.c.error = e.c.count;
+    e.c.count += increment;
+    _slots[_find_slot(key)] = entry_index;
+    _restore_heap_after_count_increase(0);
+  }
+
+  // Returns a pointer to the counter for the given key.
+  // Returns 0 if the summary has no counter for the given key.
+  const counter *find(const Key &key) const
+  {
+    const size_t i = _find_slot(key);
+    if (_slots[i] == _key_table::EMPTY_SLOT) {
+      return 0;
+    }
+    return &_entries[_slots[i]].c;
+  }
+
+  // Returns an upper bound for the number of the given key occurrences.
+  size_t estimate(const Key &key) const
+  {
+    const counter *const c = find(key);
+    return (c == 0) ? _get_missing_count() : c->count;
+  }
+
+  // Copies up to k counters with the biggest counts into the output
+  // in descending order of counts.
+  // Returns an iterator pointing to the next element in the output.
+  template <class OutputIterator>
+  OutputIterator top(const size_t k, const OutputIterator &output) const
+  {
+    std::vector<counter> counters;
+    counters.reserve(_entries.size());
+    for (size_t i = 0; i < _entries.size(); ++i) {
+      counters.push_back(_entries[i].c);
+    }
+    const size_t n = (k < counters.size()) ? k : counters.size();
+    galgorithm<Heap>::partial_sort(counters.begin(), counters.begin() + n,
+        counters.end(), _counter_less_comparer);
+    return std::copy(counters.begin(), counters.begin() + n, output);
+  }
+
+  // Merges the given summary into this summary.
+  //
+  // Summaries built on distinct parts of the stream (for example,
+  // by distinct threads) may be merged into a summary for the whole stream.
+  // See 'Mergeable summaries' paper for details -
+  // http://www.cs.utah.edu/~jeffp/papers/merge-summ.pdf .
+  void merge(const gheavy_hitters &h)
+  {
+    assert(this != &h);
+
+    const size_t missing_count = _get_missing_count();
+    const size_t h_missing_count = h._get_missing_count();
+
+    std::vector<counter> counters;
+    counters.reserve(_entries.size() + h._entries.size());
+    for (size_t i = 0; i < _entries.size(); ++i) {
+      counter c = _entries[i].c;
+      const counter *const h_c = h.find(c.key);
+      if (h_c == 0) {
+        c.count += h_missing_count;
+        c.error += h_missing_count;
+      }
+      else {
+        c.count += h_c->count;
+        c.error += h_c->error;
+      }
+      counters.push_back(c);
+    }
+    for (size_t i = 0; i < h._entries.size(); ++i) {
+      counter c = h._entries[i].c;
+      if (find(c.key) == 0) {
+        c.count += missing_count;
+        c.error += missing_count;
+        counters.push_back(c);
+      }
+    }
+
+    const size_t n = (_capacity < counters.size()) ?
+        _capacity : counters.size();
+    galgorithm<Heap>::partial_sort(counters.begin(), counters.begin() + n,
+        counters.end(), _counter_less_comparer);
+
+    const size_t total = _total + h._total;
+    clear();
+    _total = total;
+    for (size_t i = 0; i < n; ++i) {
+      _push_counter(counters[i]);
+    }
+  }
+
+  // Removes all the counters from the summary.
+  void clear()
+  {
+    _total = 0;
+    _entries.clear();
+    _heap.clear();
+    _slots.clear();
+  }
+
+  void swap(gheavy_hitters &h)
+  {
+    std::swap(_capacity, h._capacity);
+    std::swap(_total, h._total);
+    _entries.swap(h._entries);
+    _heap.swap(h._heap);
+    _slots.swap(h._slots);
+  }
+
+  // Copy constructors and assignment operators are implicitly defined.
+};
+
+namespace std
+{
+  template <class Heap, class Key, class Hasher, class KeyEqual>
+  void swap(
+      gheavy_hitters<Heap, Key, Hasher, KeyEqual> &a,
+      gheavy_hitters<Heap, Key, Hasher, KeyEqual> &b)
+  {
+    a.swap(b);
+  }
+}
+#endif
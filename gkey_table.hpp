@@ -0,0 +1,166 @@
+#ifndef GKEY_TABLE_HPP
+#define GKEY_TABLE_HPP
+
+// Internal helpers shared by gheavy_hitters.hpp and gkeyed_priority_queue.hpp.
+//
+// These containers store entries in a vector and keep a heap of entry
+// indexes. gkey_table maps keys to entry indexes, while
+// gkey_table_fix_heap_indexes() keeps heap positions stored in entries
+// up to date after heap operations.
+
+#include "gheap.hpp"   // for SIZE_MAX in C++03
+
+#include <algorithm>   // for std::swap()
+#include <cstddef>     // for size_t
+#include <vector>      // for std::vector
+
+// Open-addressing hash table with linear probing, which maps keys to indexes
+// of entries owned by the caller. Slots contain entry indexes or EMPTY_SLOT.
+//
+// The table doesn't store keys, so methods, which need keys of stored entries,
+// accept KeyGetter functor returning the key for the given entry index.
+template <class Key, class Hasher, class KeyEqual>
+class gkey_table
+{
+public:
+
+  static const size_t EMPTY_SLOT = SIZE_MAX;
+
+private:
+
+  Hasher _hasher;
+  KeyEqual _key_equal;
+
+  std::vector<size_t> _slots;
+  size_t _slots_shift;
+
+  // Returns the home slot for the given key.
+  size_t _get_home_slot(const Key &key) const
+  {
+    // Fibonacci hashing. See http://en.wikipedia.org/wiki/Hash_function .
+    // The multiplier is 2^N / golden_ratio, where N is the bit size of size_t.
+    const size_t multiplier =
+        ((size_t)((double)SIZE_MAX / 1.6180339887498949)) | 1;
+    return (_hasher(key) * multiplier) >> _slots_shift;
+  }
+
+public:
+
+  gkey_table(const Hasher &hasher, const KeyEqual &key_equal) :
+      _hasher(hasher), _key_equal(key_equal), _slots_shift(0) {}
+
+  // Returns the number of slots in the table.
+  size_t size() const
+  {
+    return _slots.size();
+  }
+
+  size_t &operator [] (const size_t i)
+  {
+    return _slots[i];
+  }
+
+  const size_t &operator [] (const size_t i) const
+  {
+    return _slots[i];
+  }
+
+  // Returns the slot containing the given key or an empty slot
+  // if the key is missing.
+  template <class KeyGetter>
+  size_t find_slot(const Key &key, const KeyGetter &get_key) const
+  {
+    const size_t mask = _slots.size() - 1;
+    size_t i = _get_home_slot(key);
+    while (_slots[i] != EMPTY_SLOT && !_key_equal(get_key(_slots[i]), key)) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  // Removes entry index from the given slot, shifting back subsequent
+  // entries from the same probe sequence.
+  template <class KeyGetter>
+  void erase_slot(size_t i, const KeyGetter &get_key)
+  {
+    const size_t mask = _slots.size() - 1;
+    size_t j = i;
+    while (true) {
+      j = (j + 1) & mask;
+      if (_slots[j] == EMPTY_SLOT) {
+        break;
+      }
+      const size_t k = _get_home_slot(get_key(_slots[j]));
+      if ((i < j) ? (k <= i || k > j) : (k <= i && k > j)) {
+        _slots[i] = _slots[j];
+        i = j;
+      }
+    }
+    _slots[i] = EMPTY_SLOT;
+  }
+
+  // Resizes the table, so it can hold capacity entries with load factor
+  // not exceeding 1/2. Entries [0 ... entries_count) are re-inserted
+  // into the resized table.
+  template <class KeyGetter>
+  void reserve(const size_t capacity, const size_t entries_count,
+      const KeyGetter &get_key)
+  {
+    if (!_slots.empty() && capacity <= _slots.size() / 2) {
+      return;
+    }
+
+    size_t slots_count = 2;
+    _slots_shift = sizeof(size_t) * 8 - 1;
+    while (slots_count < 2 * capacity) {
+      slots_count *= 2;
+      --_slots_shift;
+    }
+    _slots.assign(slots_count, EMPTY_SLOT);
+    for (size_t i = 0; i < entries_count; ++i) {
+      _slots[find_slot(get_key(i), get_key)] = i;
+    }
+  }
+
+  // Removes all the entry indexes from the table.
+  void clear()
+  {
+    _slots.assign(_slots.size(), EMPTY_SLOT);
+  }
+
+  void swap(gkey_table &t)
+  {
+    std::swap(_hasher, t._hasher);
+    std::swap(_key_equal, t._key_equal);
+    _slots.swap(t._slots);
+    std::swap(_slots_shift, t._slots_shift);
+  }
+
+  // Copy constructors and assignment operators are implicitly defined.
+};
+
+template <class Key, class Hasher, class KeyEqual>
+const size_t gkey_table<Key, Hasher, KeyEqual>::EMPTY_SLOT;
+
+// Updates heap_index members of entries moved by the last heap operation
+// on the heap of entry indexes, which started at the given heap index.
+//
+// Heap operations move entries along a single cycle, which passes through
+// the given heap index, so it is enough following stale heap indexes
+// until the cycle is closed.
+template <class Entry>
+void gkey_table_fix_heap_indexes(std::vector<Entry> &entries,
+    const std::vector<size_t> &heap, size_t heap_index)
+{
+  while (true) {
+    Entry &e = entries[heap[heap_index]];
+    const size_t old_heap_index = e.heap_index;
+    e.heap_index = heap_index;
+    if (old_heap_index == heap_index) {
+      break;
+    }
+    heap_index = old_heap_index;
+  }
+}
+
+#endif
@@ -0,0 +1,552 @@
+#ifndef GKEYED_PRIORITY_QUEUE_H
+#define GKEYED_PRIORITY_QUEUE_H
+
+/*
+ * Keyed priority queue on top of gheap for C99.
+ *
+ * The queue holds at most one entry per key. Pushing already existing key
+ * updates its priority in place, so the queue doesn't accumulate stale
+ * duplicates. Heap positions of entries are tracked via hash table, so
+ * priority updates and removals by key take O(log(n)) time.
+ *
+ * Don't forget passing -DNDEBUG option to the compiler when creating optimized
+ * builds. This significantly speeds up gheap code by removing debug assertions.
+ */
+
+
+/******************************************************************************
+ * Interface.
+ *****************************************************************************/
+
+#include "gheap.h"
+
+#include <stddef.h>    /* for size_t */
+
+/*
+ * Must return hash value for the given key.
+ */
+typedef size_t (*gkeyed_priority_queue_key_hasher_t)(const void *key);
+
+/*
+ * Must return non-zero value if the given keys are equal.
+ * Otherwise it must return 0.
+ */
+typedef int (*gkeyed_priority_queue_key_equal_t)(const void *a,
+    const void *b);
+
+/*
+ * Key context for keyed priority queue.
+ */
+struct gkeyed_priority_queue_key_ctx
+{
+  /* The size of each key in bytes. */
+  size_t key_size;
+
+  gkeyed_priority_queue_key_hasher_t key_hasher;
+  gkeyed_priority_queue_key_equal_t key_equal;
+  gheap_item_mover_t key_mover;
+};
+
+/*
+ * Opaque type for keyed priority queue.
+ */
+struct gkeyed_priority_queue;
+
+/*
+ * Creates an empty keyed priority queue.
+ *
+ * ctx describes priorities, i.e. ctx->item_size is the size of priority
+ * and ctx->less_comparer compares priorities.
+ *
+ * The contexts pointed by ctx and key_ctx must remain valid until
+ * gkeyed_priority_queue_delete() call.
+ *
+ * Returns NULL on allocation failure.
+ */
+static inline struct gkeyed_priority_queue *gkeyed_priority_queue_create(
+    const struct gheap_ctx *ctx,
+    const struct gkeyed_priority_queue_key_ctx *key_ctx);
+
+/*
+ * Deletes the given keyed priority queue.
+ */
+static inline void gkeyed_priority_queue_delete(
+    struct gkeyed_priority_queue *q);
+
+/*
+ * Returns non-zero if the given keyed priority queue is empty.
+ * Otherwise returns zero.
+ */
+static inline int gkeyed_priority_queue_empty(
+    struct gkeyed_priority_queue *q);
+
+/*
+ * Returns the size of the given keyed priority queue.
+ */
+static inline size_t gkeyed_priority_queue_size(
+    struct gkeyed_priority_queue *q);
+
+/*
+ * Returns a pointer to the key of the top entry in the queue.
+ */
+static inline const void *gkeyed_priority_queue_top_key(
+    struct gkeyed_priority_queue *q);
+
+/*
+ * Returns a pointer to the priority of the top entry in the queue.
+ */
+static inline const void *gkeyed_priority_queue_top_priority(
+    struct gkeyed_priority_queue *q);
+
+/*
+ * Returns a pointer to the priority for the given key.
+ * Returns NULL if the key is missing in the queue.
+ */
+static inline const void *gkeyed_priority_queue_find(
+    struct gkeyed_priority_queue *q, const void *key);
+
+/*
+ * Pushes a copy of the key with a copy of the given priority into the queue.
+ * Updates the priority if the key already exists in the queue.
+ *
+ * Returns 1 if the key has been inserted.
+ * Returns 0 if the priority for the existing key has been updated.
+ * Returns -1 if the queue cannot grow due to size overflow or allocation
+ * failure. The queue remains unchanged in this case.
+ */
+static inline int gkeyed_priority_queue_upsert(
+    struct gkeyed_priority_queue *q, const void *key, const void *priority);
+
+/*
+ * Removes the given key from the queue.
+ * Returns zero if the key is missing in the queue.
+ */
+static inline int gkeyed_priority_queue_erase(
+    struct gkeyed_priority_queue *q, const void *key);
+
+/*
+ * Pops the top entry from the queue and moves its key and priority
+ * into the given locations. NULL locations are ignored.
+ */
+static inline void gkeyed_priority_queue_pop(
+    struct gkeyed_priority_queue *q, void *key, void *priority);
+
+
+/******************************************************************************
+ * Implementation.
+ *****************************************************************************/
+
+#include <assert.h>   /* for assert */
+#include <stdint.h>   /* for SIZE_MAX */
+#include <stdlib.h>   /* for malloc(), free(), realloc() */
+
+struct gkeyed_priority_queue
+{
+  const struct gheap_ctx *ctx;
+  const struct gkeyed_priority_queue_key_ctx *key_ctx;
+
+  /* Gheap context for the heap of entry indexes. */
+  struct gheap_ctx heap_ctx;
+
+  /*
+   * Entries are stored in parallel arrays of keys, priorities
+   * and heap indexes.
+   */
+  void *keys;
+  void *priorities;
+  size_t *heap_indexes;
+  size_t size;
+  size_t capacity;
+
+  /* The heap of entry indexes. */
+  size_t *heap;
+
+  /*
+   * Open-addressing hash table with linear probing. Slots contain indexes
+   * of entries or SIZE_MAX for empty slots.
+   */
+  size_t *slots;
+  size_t slots_count;
+  size_t slots_shift;
+};
+
+static inline void *_gkeyed_priority_queue_get_key(
+    const struct gkeyed_priority_queue *const q, const size_t entry_index)
+{
+  return ((char *)q->keys) + entry_index * q->key_ctx->key_size;
+}
+
+static inline void *_gkeyed_priority_queue_get_priority(
+    const struct gkeyed_priority_queue *const q, const size_t entry_index)
+{
+  return ((char *)q->priorities) + entry_index * q->ctx->item_size;
+}
+
+/* Less comparer for the heap of entry indexes. */
+static inline int _gkeyed_priority_queue_less_comparer(const void *const ctx,
+    const void *const a, const void *const b)
+{
+  const struct gkeyed_priority_queue *const q = ctx;
+
+  return q->ctx->less_comparer(q->ctx->less_comparer_ctx,
+      _gkeyed_priority_queue_get_priority(q, *(const size_t *)a),
+      _gkeyed_priority_queue_get_priority(q, *(const size_t *)b));
+}
+
+static inline void _gkeyed_priority_queue_index_mover(void *const dst,
+    const void *const src)
+{
+  *(size_t *)dst = *(const size_t *)src;
+}
+
+/* Returns the home slot for the given key. */
+static inline size_t _gkeyed_priority_queue_get_home_slot(
+    const struct gkeyed_priority_queue *const q, const void *const key)
+{
+  /*
+   * Fibonacci hashing. See http://en.wikipedia.org/wiki/Hash_function .
+   * The multiplier is 2^N / golden_ratio, where N is the bit size of size_t.
+   */
+  const size_t multiplier =
+      ((size_t)((double)SIZE_MAX / 1.6180339887498949)) | 1;
+  return (q->key_ctx->key_hasher(key) * multiplier) >> q->slots_shift;
+}
+
+/*
+ * Returns the slot containing the given key or an empty slot
+ * if the key is missing.
+ */
+static inline size_t _gkeyed_priority_queue_find_slot(
+    const struct gkeyed_priority_queue *const q, const void *const key)
+{
+  const gkeyed_priority_queue_key_equal_t key_equal = q->key_ctx->key_equal;
+  const size_t mask = q->slots_count - 1;
+
+  size_t i = _gkeyed_priority_queue_get_home_slot(q, key);
+  while (q->slots[i] != SIZE_MAX &&
+      !key_equal(_gkeyed_priority_queue_get_key(q, q->slots[i]), key)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/*
+ * Removes entry index from the given slot, shifting back subsequent
+ * entries from the same probe sequence.
+ */
+static inline void _gkeyed_priority_queue_erase_slot(
+    struct gkeyed_priority_queue *const q, size_t i)
+{
+  size_t *const slots = q->slots;
+  const size_t mask = q->slots_count - 1;
+
+  size_t j = i;
+  while (1) {
+    j = (j + 1) & mask;
+    if (slots[j] == SIZE_MAX) {
+      break;
+    }
+    const size_t k = _gkeyed_priority_queue_get_home_slot(q,
+        _gkeyed_priority_queue_get_key(q, slots[j]));
+    if ((i < j) ? (k <= i || k > j) : (k <= i && k > j)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i] = SIZE_MAX;
+}
+
+/*
+ * Grows entries' storage and hash table, so they can hold at least
+ * one more entry.
+ *
+ * Returns 0 on success. Returns -1 on size overflow or allocation failure.
+ * The queue remains unchanged on failure.
+ */
+static inline int _gkeyed_priority_queue_grow(
+    struct gkeyed_priority_queue *const q)
+{
+  if (q->capacity > SIZE_MAX / 4 / q->ctx->item_size ||
+      q->capacity > SIZE_MAX / 4 / q->key_ctx->key_size ||
+      q->capacity > SIZE_MAX / 4 / sizeof(size_t)) {
+    return -1;
+  }
+  const size_t capacity = q->capacity * 2;
+
+  /*
+   * Arrays are reallocated one by one. Arrays reallocated before a failure
+   * are just bigger than needed, so the queue remains consistent.
+   */
+  void *const keys = realloc(q->keys, capacity * q->key_ctx->key_size);
+  if (keys == NULL) {
+    return -1;
+  }
+  q->keys = keys;
+  void *const priorities = realloc(q->priorities,
+      capacity * q->ctx->item_size);
+  if (priorities == NULL) {
+    return -1;
+  }
+  q->priorities = priorities;
+  size_t *const heap_indexes = realloc(q->heap_indexes,
+      capacity * sizeof(q->heap_indexes[0]));
+  if (heap_indexes == NULL) {
+    return -1;
+  }
+  q->heap_indexes = heap_indexes;
+  size_t *const heap = realloc(q->heap, capacity * sizeof(q->heap[0]));
+  if (heap == NULL) {
+    return -1;
+  }
+  q->heap = heap;
+  size_t *const slots = malloc(2 * capacity * sizeof(q->slots[0]));
+  if (slots == NULL) {
+    return -1;
+  }
+
+  q->capacity = capacity;
+  free(q->slots);
+  q->slots = slots;
+  q->slots_count *= 2;
+  --(q->slots_shift);
+  assert(q->slots_count == 2 * q->capacity);
+  for (size_t i = 0; i < q->slots_count; ++i) {
+    q->slots[i] = SIZE_MAX;
+  }
+  for (size_t i = 0; i < q->size; ++i) {
+    const size_t slot = _gkeyed_priority_queue_find_slot(q,
+        _gkeyed_priority_queue_get_key(q, i));
+    q->slots[slot] = i;
+  }
+  return 0;
+}
+
+/*
+ * Updates heap indexes of entries moved by the last heap operation,
+ * which started at the given heap index.
+ *
+ * Heap operations move entries along a single cycle, which passes through
+ * the given heap index, so it is enough following stale heap indexes
+ * until the cycle is closed.
+ */
+static inline void _gkeyed_priority_queue_fix_heap_indexes(
+    struct gkeyed_priority_queue *const q, size_t heap_index)
+{
+  while (1) {
+    size_t *const entry_heap_index = &q->heap_indexes[q->heap[heap_index]];
+    const size_t old_heap_index = *entry_heap_index;
+    *entry_heap_index = heap_index;
+    if (old_heap_index == heap_index) {
+      break;
+    }
+    heap_index = old_heap_index;
+  }
+}
+
+/*
+ * Removes the entry at the given heap index from the queue and moves its key
+ * and priority into the given locations. NULL locations are ignored.
+ */
+static inline void _gkeyed_priority_queue_remove(
+    struct gkeyed_priority_queue *const q, const size_t heap_index,
+    void *const key, void *const priority)
+{
+  assert(heap_index < q->size);
+
+  gheap_remove_from_heap(&q->heap_ctx, q->heap, q->size, heap_index);
+  _gkeyed_priority_queue_fix_heap_indexes(q, heap_index);
+
+  --(q->size);
+  const size_t entry_index = q->heap[q->size];
+  void *const entry_key = _gkeyed_priority_queue_get_key(q, entry_index);
+  void *const entry_priority =
+      _gkeyed_priority_queue_get_priority(q, entry_index);
+
+  _gkeyed_priority_queue_erase_slot(q,
+      _gkeyed_priority_queue_find_slot(q, entry_key));
+  if (key != NULL) {
+    q->key_ctx->key_mover(key, entry_key);
+  }
+  if (priority != NULL) {
+    q->ctx->item_mover(priority, entry_priority);
+  }
+
+  /* Fill the gap in entries with the last entry. */
+  const size_t last_entry_index = q->size;
+  if (entry_index != last_entry_index) {
+    const void *const last_key =
+        _gkeyed_priority_queue_get_key(q, last_entry_index);
+    const size_t slot = _gkeyed_priority_queue_find_slot(q, last_key);
+    q->slots[slot] = entry_index;
+    q->key_ctx->key_mover(entry_key, last_key);
+    q->ctx->item_mover(entry_priority,
+        _gkeyed_priority_queue_get_priority(q, last_entry_index));
+    const size_t last_heap_index = q->heap_indexes[last_entry_index];
+    q->heap_indexes[entry_index] = last_heap_index;
+    q->heap[last_heap_index] = entry_index;
+  }
+}
+
+static inline struct gkeyed_priority_queue *gkeyed_priority_queue_create(
+    const struct gheap_ctx *const ctx,
+    const struct gkeyed_priority_queue_key_ctx *const key_ctx)
+{
+  struct gkeyed_priority_queue *const q = malloc(sizeof(*q));
+  if (q == NULL) {
+    return NULL;
+  }
+
+  q->ctx = ctx;
+  q->key_ctx = key_ctx;
+
+  q->heap_ctx.fanout = ctx->fanout;
+  q->heap_ctx.page_chunks = ctx->page_chunks;
+  q->heap_ctx.item_size = sizeof(q->heap[0]);
+  q->heap_ctx.less_comparer = &_gkeyed_priority_queue_less_comparer;
+  q->heap_ctx.less_comparer_ctx = q;
+  q->heap_ctx.item_mover = &_gkeyed_priority_queue_index_mover;
+
+  q->size = 0;
+  q->capacity = 1;
+  q->keys = malloc(key_ctx->key_size);
+  q->priorities = malloc(ctx->item_size);
+  q->heap_indexes = malloc(sizeof(q->heap_indexes[0]));
+  q->heap = malloc(sizeof(q->heap[0]));
+
+  q->slots_count = 2;
+  q->slots_shift = sizeof(size_t) * 8 - 1;
+  q->slots = malloc(q->slots_count * sizeof(q->slots[0]));
+
+  if (q->keys == NULL || q->priorities == NULL || q->heap_indexes == NULL ||
+      q->heap == NULL || q->slots == NULL) {
+    gkeyed_priority_queue_delete(q);
+    return NULL;
+  }
+  q->slots[0] = SIZE_MAX;
+  q->slots[1] = SIZE_MAX;
+
+  return q;
+}
+
+static inline void gkeyed_priority_queue_delete(
+    struct gkeyed_priority_queue *const q)
+{
+  free(q->slots);
+  free(q->heap);
+  free(q->heap_indexes);
+  free(q->priorities);
+  free(q->keys);
+  free(q);
+}
+
+static inline int gkeyed_priority_queue_empty(
+    struct gkeyed_priority_queue *const q)
+{
+  return (q->size == 0);
+}
+
+static inline size_t gkeyed_priority_queue_size(
+    struct gkeyed_priority_queue *const q)
+{
+  return q->size;
+}
+
+static inline const void *gkeyed_priority_queue_top_key(
+    struct gkeyed_priority_queue *const q)
+{
+  assert(q->size > 0);
+
+  return _gkeyed_priority_queue_get_key(q, q->heap[0]);
+}
+
+static inline const void *gkeyed_priority_queue_top_priority(
+    struct gkeyed_priority_queue *const q)
+{
+  assert(q->size > 0);
+
+  return _gkeyed_priority_queue_get_priority(q, q->heap[0]);
+}
+
+static inline const void *gkeyed_priority_queue_find(
+    struct gkeyed_priority_queue *const q, const void *const key)
+{
+  const size_t slot = _gkeyed_priority_queue_find_slot(q, key);
+  if (q->slots[slot] == SIZE_MAX) {
+    return NULL;
+  }
+  return _gkeyed_priority_queue_get_priority(q, q->slots[slot]);
+}
+
+static inline int gkeyed_priority_queue_upsert(
+    struct gkeyed_priority_queue *const q, const void *const key,
+    const void *const priority)
+{
+  const gheap_less_comparer_t less_comparer = q->ctx->less_comparer;
+  const void *const less_comparer_ctx = q->ctx->less_comparer_ctx;
+
+  size_t slot = _gkeyed_priority_queue_find_slot(q, key);
+  if (q->slots[slot] != SIZE_MAX) {
+    const size_t entry_index = q->slots[slot];
+    const size_t heap_index = q->heap_indexes[entry_index];
+    void *const entry_priority =
+        _gkeyed_priority_queue_get_priority(q, entry_index);
+    if (less_comparer(less_comparer_ctx, entry_priority, priority)) {
+      q->ctx->item_mover(entry_priority, priority);
+      gheap_restore_heap_after_item_increase(&q->heap_ctx, q->heap, q->size,
+          heap_index);
+    }
+    else if (less_comparer(less_comparer_ctx, priority, entry_priority)) {
+      q->ctx->item_mover(entry_priority, priority);
+      gheap_restore_heap_after_item_decrease(&q->heap_ctx, q->heap, q->size,
+          heap_index);
+    }
+    else {
+      q->ctx->item_mover(entry_priority, priority);
+    }
+    _gkeyed_priority_queue_fix_heap_indexes(q, heap_index);
+    return 0;
+  }
+
+  if (q->size == q->capacity) {
+    if (_gkeyed_priority_queue_grow(q) != 0) {
+      return -1;
+    }
+    slot = _gkeyed_priority_queue_find_slot(q, key);
+  }
+
+  assert(q->size < q->capacity);
+  const size_t entry_index = q->size;
+  q->slots[slot] = entry_index;
+  q->key_ctx->key_mover(_gkeyed_priority_queue_get_key(q, entry_index), key);
+  q->ctx->item_mover(_gkeyed_priority_queue_get_priority(q, entry_index),
+      priority);
+  q->heap_indexes[entry_index] = q->size;
+  q->heap[q->size] = entry_index;
+  ++(q->size);
+  gheap_push_heap(&q->heap_ctx, q->heap, q->size);
+  _gkeyed_priority_queue_fix_heap_indexes(q, q->size - 1);
+  return 1;
+}
+
+static inline int gkeyed_priority_queue_erase(
+    struct gkeyed_priority_queue *const q, const void *const key)
+{
+  const size_t slot = _gkeyed_priority_queue_find_slot(q, key);
+  if (q->slots[slot] == SIZE_MAX) {
+    return 0;
+  }
+  _gkeyed_priority_queue_remove(q, q->heap_indexes[q->slots[slot]],
+      NULL, NULL);
+  return 1;
+}
+
+static inline void gkeyed_priority_queue_pop(
+    struct gkeyed_priority_queue *const q, void *const key,
+    void *const priority)
+{
+  assert(q->size > 0);
+
+  _gkeyed_priority_queue_remove(q, 0, key, priority);
+}
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef GKEYED_PRIORITY_QUEUE_HPP
+#define GKEYED_PRIORITY_QUEUE_HPP
+
+// Keyed priority queue on top of Heap.
+//
+// The queue holds at most one entry per key. Pushing already existing key
+// updates its priority in place, so the queue doesn't accumulate stale
+// duplicates. Heap positions of entries are tracked via gkey_table, so
+// priority updates and removals by key take O(log(n)) time.
+//
+// Pass -DGHEAP_CPP11 to compiler for enabling C++11 optimization,
+// otherwise C++03 optimization will be enabled.
+//
+// Don't forget passing -DNDEBUG option to the compiler when creating optimized
+// builds. This significantly speeds up the code by removing debug assertions.
+
+#include "gheap.hpp"
+#include "gkey_table.hpp"
+
+#include <algorithm>   // for std::swap()
+#include <cassert>     // for assert
+#include <cstddef>     // for size_t
+#include <functional>  // for std::equal_to, std::less
+#include <utility>     // for std::pair
+#include <vector>      // for std::vector
+
+// Default hasher for gkeyed_priority_queue. It is suitable for integer
+// keys only. Provide custom hasher for other key types.
+template <class Key>
+struct gkeyed_priority_queue_hasher
+{
+  size_t operator() (const Key &key) const
+  {
+    return (size_t)key;
+  }
+};
+
+template <class Heap, class Key, class Priority,
+    class Hasher = gkeyed_priority_queue_hasher<Key>,
+    class KeyEqual = std::equal_to<Key>,
+    class LessComparer = std::less<Priority> >
+class gkeyed_priority_queue
+{
+public:
+
+  typedef Key key_type;
+  typedef Priority priority_type;
+  typedef std::pair<Key, Priority> value_type;
+  typedef size_t size_type;
+
+  LessComparer comp;
+
+private:
+
+  struct _entry
+  {
+    Key key;
+    Priority priority;
+    size_t heap_index;
+  };
+
+  // Less comparer for the heap of entry indexes.
+  class _priority_less_comparer
+  {
+  private:
+    const std::vector<_entry> &_entries;
+    const LessComparer &_less_comparer;
+
+  public:
+    _priority_less_comparer(const std::vector<_entry> &entries,
+        const LessComparer &less_comparer) :
+            _entries(entries), _less_comparer(less_comparer) {}
+
+    bool operator() (const size_t &a, const size_t &b) const
+    {
+      return _less_comparer(_entries[a].priority, _entries[b].priority);
+    }
+  };
+
+  // Returns keys of entries for the key table.
+  class _entry_key_getter
+  {
+  private:
+    const std::vector<_entry> &_entries;
+
+  public:
+    _entry_key_getter(const std::vector<_entry> &entries) :
+        _entries(entries) {}
+
+    const Key &operator() (const size_t i) const
+    {
+      return _entries[i].key;
+    }
+  };
+
+  typedef gkey_table<Key, Hasher, KeyEqual> _key_table;
+
+  std::vector<_entry> _entries;
+  std::vector<size_t> _heap;
+  _key_table _slots;
+
+  // Returns the slot containing the given key or an empty slot
+  // if the key is missing.
+  size_t _find_slot(const Key &key) const
+  {
+    return _slots.find_slot(key, _entry_key_getter(_entries));
+  }
+
+  void _fix_heap_indexes(const size_t heap_index)
+  {
+    gkey_table_fix_heap_indexes(_entries, _heap, heap_index);
+  }
+
+  // Removes the entry at the given heap index from the queue and returns it.
+  value_type _remove(const size_t heap_index)
+  {
+    assert(heap_index < _heap.size());
+
+    Heap::remove_from_heap(_heap.begin(), _heap.begin() + heap_index,
+        _heap.end(), _priority_less_comparer(_entries, comp));
+    _fix_heap_indexes(heap_index);
+
+    const size_t entry_index = _heap.back();
+    _heap.pop_back();
+
+    _entry &e = _entries[entry_index];
+    _slots.erase_slot(_find_slot(e.key), _entry_key_getter(_entries));
+    const value_type v(e.key, e.priority);
+
+    // Fill the gap in entries with the last entry.
+    const size_t last_entry_index = _entries.size() - 1;
+    if (entry_index != last_entry_index) {
+      const _entry &last_entry = _entries[last_entry_index];
+      _slots[_find_slot(last_entry.key)] = entry_index;
+      _heap[last_entry.heap_index] = entry_index;
+      e = last_entry;
+    }
+    _entries.pop_back();
+
+    return v;
+  }
+
+public:
+
+  explicit gkeyed_priority_queue(
+      const LessComparer &less_comparer = LessComparer(),
+      const Hasher &hasher = Hasher(), const KeyEqual &key_equal = KeyEqual()) :
+          comp(less_comparer), _slots(hasher, key_equal)
+  {
+    _slots.reserve(0, 0, _entry_key_getter(_entries));
+  }
+
+  bool empty() const
+  {
+    return _heap.empty();
+  }
+
+  size_type size() const
+  {
+    return _heap.size();
+  }
+
+  // Returns the key of the top entry.
+  const Key &top_key() const
+  {
+    assert(!empty());
+
+    return _entries[_heap[0]].key;
+  }
+
+  // Returns the priority of the top entry.
+  const Priority &top_priority() const
+  {
+    assert(!empty());
+
+    return _entries[_heap[0]].priority;
+  }
+
+  // Returns a pointer to the priority for the given key.
+  // Returns 0 if the key is missing in the queue.
+  const Priority *find(const Key &key) const
+  {
+    const size_t i = _find_slot(key);
+    if (_slots[i] == _key_table::EMPTY_SLOT) {
+      return 0;
+    }
+    return &_entries[_slots[i]].priority;
+  }
+
+  // Pushes the key with the given priority into the queue. Updates
+  // the priority if the key already exists in the queue.
+  //
+  // Returns true if the key has been inserted.
+  // Returns false if the priority for the existing key has been updated.
+  bool upsert(const Key &key, const Priority &priority)
+  {
+    size_t i = _find_slot(key);
+    if (_slots[i] != _key_table::EMPTY_SLOT) {
+      _entry &e = _entries[_slots[i]];
+      const size_t heap_index = e.heap_index;
+      const _priority_less_comparer less(_entries, comp);
+      if (comp(e.priority, priority)) {
+        e.priority = priority;
+        Heap::restore_heap_after_item_increase(_heap.begin(),
+            _heap.begin() + heap_index, less);
+      }
+      else if (comp(priority, e.priority)) {
+        e.priority = priority;
+        Heap::restore_heap_after_item_decrease(_heap.begin(),
+            _heap.begin() + heap_index, _heap.end(), less);
+      }
+      else {
+        e.priority = priority;
+      }
+      _fix_heap_indexes(heap_index);
+      return false;
+    }
+
+    if (_entries.size() + 1 > _slots.size() / 2) {
+      _slots.reserve(_entries.size() + 1, _entries.size(),
+          _entry_key_getter(_entries));
+      i = _find_slot(key);
+    }
+
+    const size_t entry_index = _entries.size();
+    _slots[i] = entry_index;
+
+    _entry e;
+    e.key = key;
+    e.priority = priority;
+    e.heap_index = _heap.size();
+    _entries.push_back(e);
+    _heap.push_back(entry_index);
+    Heap::push_heap(_heap.begin(), _heap.end(),
+        _priority_less_comparer(_entries, comp));
+    _fix_heap_indexes(_heap.size() - 1);
+    return true;
+  }
+
+  // Removes the given key from the queue.
+  // Returns false if the key is missing in the queue.
+  bool erase(const Key &key)
+  {
+    const size_t i = _find_slot(key);
+    if (_slots[i] == _key_table::EMPTY_SLOT) {
+      return false;
+    }
+    _remove(_entries[_slots[i]].heap_index);
+    return true;
+  }
+
+  // Pops the top entry from the queue and returns its (key, priority) pair.
+  value_type pop()
+  {
+    assert(!empty());
+
+    return _remove(0);
+  }
+
+  // Removes all the entries from the queue.
+  void clear()
+  {
+    _entries.clear();
+    _heap.clear();
+    _slots.clear();
+  }
+
+  void swap(gkeyed_priority_queue &q)
+  {
+    std::swap(comp, q.comp);
+    _entries.swap(q._entries);
+    _heap.swap(q._heap);
+    _slots.swap(q._slots);
+  }
+
+  // Copy constructors and assignment operators are implicitly defined.
+};
+
+namespace std
+{
+  template <class Heap, class Key, class Priority, class Hasher,
+      class KeyEqual, class LessComparer>
+  void swap(
+      gkeyed_priority_queue<Heap, Key, Priority, Hasher, KeyEqual,
+          LessComparer> &a,
+      gkeyed_priority_queue<Heap, Key, Priority, Hasher, KeyEqual,
+          LessComparer> &b)
+  {
+    a.swap(b);
+  }
+}
+#endif
@@ -0,0 +1,517 @@
+#ifndef GMAPPED_RUN_H
+#define GMAPPED_RUN_H
+
+/*
+ * Zero-copy inputs and output for N-way merge of sorted runs stored
+ * in files.
+ *
+ * Each run is a file containing an array of fixed-size items sorted
+ * in ascending order. Runs are mapped into memory via mmap(), so the merge
+ * reads items directly from page cache without copying them into
+ * intermediate buffers. Mappings are advised with MADV_SEQUENTIAL, so
+ * the kernel reads ahead aggressively and drops pages behind the merge.
+ * Additionally the next readahead_size bytes of each run are requested
+ * in background via MADV_WILLNEED while the merge advances.
+ *
+ * The merged output is written into the output file mapped via mmap().
+ * The output file is resized to the total size of runs in advance.
+ *
+ * The reader may be used from both C99 and C++. galgorithm_nway_merge()
+ * input and output adapters are available in C, while gmapped_run.hpp
+ * provides galgorithm::nway_merge() input ranges of gmapped_run_iterator
+ * for C++.
+ *
+ * Requires POSIX. Define _GNU_SOURCE or _DEFAULT_SOURCE before including
+ * system headers in C.
+ */
+
+
+/*******************************************************************************
+ * Interface.
+ ******************************************************************************/
+
+#include <stddef.h>     /* for size_t */
+
+/*
+ * Opaque type for a collection of memory-mapped runs.
+ */
+struct gmapped_runs;
+
+/*
+ * Opaque type for memory-mapped output file.
+ */
+struct gmapped_output;
+
+/*
+ * Maps runs stored in files with the given descriptors into memory.
+ *
+ * File sizes must be multiples of item_size. readahead_size is the number
+ * of bytes requested ahead of the current item of each run via
+ * MADV_WILLNEED. Zero readahead_size leaves readahead to the kernel.
+ *
+ * File descriptors may be closed after the call.
+ *
+ * Returns NULL and sets errno on error.
+ */
+static inline struct gmapped_runs *gmapped_runs_create(const int *fds,
+    size_t runs_count, size_t item_size, size_t readahead_size);
+
+/*
+ * Unmaps the given runs.
+ */
+static inline void gmapped_runs_delete(struct gmapped_runs *runs);
+
+/*
+ * Returns the number of runs.
+ */
+static inline size_t gmapped_runs_get_count(const struct gmapped_runs *runs);
+
+/*
+ * Returns a pointer to the first item of the run with the given index.
+ * Returns NULL for empty runs.
+ */
+static inline const void *gmapped_runs_get_data(
+    const struct gmapped_runs *runs, size_t run_index);
+
+/*
+ * Returns the number of items in the run with the given index.
+ */
+static inline size_t gmapped_runs_get_items_count(
+    const struct gmapped_runs *runs, size_t run_index);
+
+/*
+ * Returns the total number of items in all the runs.
+ */
+static inline size_t gmapped_runs_get_total_items_count(
+    const struct gmapped_runs *runs);
+
+/*
+ * Advances background readahead of the run with the given index, which
+ * is read at the given offset in bytes.
+ *
+ * Returns the offset, which must be reached before the next call,
+ * or the run size if there is nothing to read ahead.
+ *
+ * galgorithm_nway_merge() input calls it automatically, while iterators
+ * from gmapped_run.hpp call it for C++ input ranges.
+ */
+static inline size_t gmapped_runs_readahead(struct gmapped_runs *runs,
+    size_t run_index, size_t offset);
+
+/*
+ * Resizes the file with the given descriptor to size bytes and maps it
+ * into memory for writing. The file must be opened for reading and writing.
+ *
+ * The file descriptor may be closed after the call.
+ *
+ * Returns NULL and sets errno on error.
+ */
+static inline struct gmapped_output *gmapped_output_create(int fd,
+    size_t size);
+
+/*
+ * Returns a pointer to the beginning of the output.
+ * Returns NULL for empty output.
+ */
+static inline void *gmapped_output_get_data(struct gmapped_output *output);
+
+/*
+ * Unmaps the output. Flushes it to the file with msync() if is_sync
+ * is non-zero, otherwise the kernel writes it back in background.
+ *
+ * Returns zero on success or errno value on msync() error.
+ */
+static inline int gmapped_output_delete(struct gmapped_output *output,
+    int is_sync);
+
+#ifndef __cplusplus
+
+#include "galgorithm.h"  /* for galgorithm_nway_merge_input */
+
+/*
+ * Initializes input for galgorithm_nway_merge() with non-empty runs.
+ *
+ * galgorithm_nway_merge() mustn't be called if input->ctxs_count is zero
+ * after the call.
+ *
+ * The input remains valid until gmapped_runs_delete() call.
+ */
+static inline void gmapped_runs_init_nway_merge_input(
+    struct gmapped_runs *runs, struct galgorithm_nway_merge_input *input);
+
+/*
+ * Initializes output for galgorithm_nway_merge(), which writes items
+ * of the given size into the mapped output starting from its beginning.
+ *
+ * The output remains valid until gmapped_output_delete() call.
+ */
+static inline void gmapped_output_init_nway_merge_output(
+    struct gmapped_output *output, size_t item_size,
+    struct galgorithm_nway_merge_output *merge_output);
+
+#endif
+
+
+/*******************************************************************************
+ * Implementation.
+ ******************************************************************************/
+
+#include <assert.h>     /* for assert */
+#include <errno.h>      /* for errno, E* */
+#include <stdlib.h>     /* for malloc(), calloc(), free() */
+#include <string.h>     /* for memcpy(), memset() */
+#include <sys/mman.h>   /* for mmap(), munmap(), madvise(), msync() */
+#include <sys/stat.h>   /* for fstat() */
+#include <sys/types.h>  /* for off_t */
+#include <unistd.h>     /* for ftruncate(), sysconf() */
+
+struct gmapped_run
+{
+  struct gmapped_runs *runs;
+
+  const char *data;
+  size_t size;
+
+  /* The offset of the current item. */
+  size_t position;
+
+  /*
+   * The offset up to which background readahead has been requested.
+   * The next request is issued when the position crosses its half.
+   */
+  size_t readahead_offset;
+};
+
+struct gmapped_runs
+{
+  size_t item_size;
+  size_t readahead_size;
+  size_t page_size;
+
+  struct gmapped_run *runs;
+  size_t runs_count;
+
+  /* Pointers to non-empty runs for galgorithm_nway_merge() input. */
+  struct gmapped_run **run_ptrs;
+};
+
+struct gmapped_output
+{
+  char *data;
+  size_t size;
+
+  /* The offset of the next item for galgorithm_nway_merge() output. */
+  size_t position;
+  size_t item_size;
+};
+
+/*
+ * Requests background reads for the next readahead_size bytes
+ * of the run starting from readahead_offset.
+ */
+static inline void _gmapped_run_readahead(struct gmapped_run *const run)
+{
+  const struct gmapped_runs *const runs = run->runs;
+  size_t size = runs->readahead_size;
+
+  assert(size > 0);
+  /* madvise() requires page-aligned addresses. */
+  assert(run->readahead_offset % runs->page_size == 0);
+  if (size > run->size - run->readahead_offset) {
+    size = run->size - run->readahead_offset;
+  }
+  if (size > 0) {
+    madvise((void *)(run->data + run->readahead_offset), size,
+        MADV_WILLNEED);
+  }
+  run->readahead_offset += size;
+}
+
+/*
+ * Requests the next readahead window if the given offset crossed the half
+ * of the current window. Returns the offset for the next request.
+ */
+static inline size_t _gmapped_run_advance_readahead(
+    struct gmapped_run *const run, const size_t offset)
+{
+  const size_t half_window_size = run->runs->readahead_size / 2;
+
+  if (run->readahead_offset < run->size &&
+      offset >= run->readahead_offset - half_window_size) {
+    _gmapped_run_readahead(run);
+  }
+  return (run->readahead_offset < run->size) ?
+      run->readahead_offset - half_window_size : run->size;
+}
+
+static inline struct gmapped_runs *gmapped_runs_create(const int *const fds,
+    const size_t runs_count, const size_t item_size,
+    const size_t readahead_size)
+{
+  struct gmapped_runs *runs;
+  size_t i;
+
+  if (runs_count == 0 || item_size == 0) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  runs = (struct gmapped_runs *)malloc(sizeof(*runs));
+  if (runs == 0) {
+    errno = ENOMEM;
+    return 0;
+  }
+  memset(runs, 0, sizeof(*runs));
+  runs->item_size = item_size;
+  runs->page_size = (size_t)sysconf(_SC_PAGESIZE);
+  /* Round readahead up to the page size. */
+  runs->readahead_size = (readahead_size + runs->page_size - 1) /
+      runs->page_size * runs->page_size;
+  runs->runs = (struct gmapped_run *)calloc(runs_count,
+      sizeof(runs->runs[0]));
+  runs->run_ptrs = (struct gmapped_run **)calloc(runs_count,
+      sizeof(runs->run_ptrs[0]));
+  if (runs->runs == 0 || runs->run_ptrs == 0) {
+    free(runs->run_ptrs);
+    free(runs->runs);
+    free(runs);
+    errno = ENOMEM;
+    return 0;
+  }
+
+  for (i = 0; i < runs_count; ++i) {
+    struct gmapped_run *const run = &runs->runs[i];
+    struct stat st;
+    void *data;
+
+    run->runs = runs;
+    runs->runs_count = i + 1;
+    if (fstat(fds[i], &st) != 0) {
+      const int error = errno;
+      gmapped_runs_delete(runs);
+      errno = error;
+      return 0;
+    }
+    if ((size_t)st.st_size % item_size != 0) {
+      gmapped_runs_delete(runs);
+      errno = EINVAL;
+      return 0;
+    }
+    if (st.st_size == 0) {
+      continue;
+    }
+    data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fds[i], 0);
+    if (data == MAP_FAILED) {
+      const int error = errno;
+      gmapped_runs_delete(runs);
+      errno = error;
+      return 0;
+    }
+    run->data = (const char *)data;
+    run->size = (size_t)st.st_size;
+    madvise(data, run->size, MADV_SEQUENTIAL);
+    if (runs->readahead_size > 0) {
+      _gmapped_run_readahead(run);
+    }
+    else {
+      /* Leave readahead to the kernel. */
+      run->readahead_offset = run->size;
+    }
+  }
+
+  return runs;
+}
+
+static inline void gmapped_runs_delete(struct gmapped_runs *const runs)
+{
+  size_t i;
+
+  for (i = 0; i < runs->runs_count; ++i) {
+    const struct gmapped_run *const run = &runs->runs[i];
+    if (run->size > 0) {
+      munmap((void *)run->data, run->size);
+    }
+  }
+  free(runs->run_ptrs);
+  free(runs->runs);
+  free(runs);
+}
+
+static inline size_t gmapped_runs_get_count(
+    const struct gmapped_runs *const runs)
+{
+  return runs->runs_count;
+}
+
+static inline const void *gmapped_runs_get_data(
+    const struct gmapped_runs *const runs, const size_t run_index)
+{
+  assert(run_index < runs->runs_count);
+  return runs->runs[run_index].data;
+}
+
+static inline size_t gmapped_runs_get_items_count(
+    const struct gmapped_runs *const runs, const size_t run_index)
+{
+  assert(run_index < runs->runs_count);
+  return runs->runs[run_index].size / runs->item_size;
+}
+
+static inline size_t gmapped_runs_get_total_items_count(
+    const struct gmapped_runs *const runs)
+{
+  size_t items_count = 0;
+  size_t i;
+
+  for (i = 0; i < runs->runs_count; ++i) {
+    items_count += runs->runs[i].size / runs->item_size;
+  }
+  return items_count;
+}
+
+static inline size_t gmapped_runs_readahead(struct gmapped_runs *const runs,
+    const size_t run_index, const size_t offset)
+{
+  assert(run_index < runs->runs_count);
+  return _gmapped_run_advance_readahead(&runs->runs[run_index], offset);
+}
+
+static inline struct gmapped_output *gmapped_output_create(const int fd,
+    const size_t size)
+{
+  struct gmapped_output *output;
+
+  if (ftruncate(fd, (off_t)size) != 0) {
+    return 0;
+  }
+
+  output = (struct gmapped_output *)malloc(sizeof(*output));
+  if (output == 0) {
+    errno = ENOMEM;
+    return 0;
+  }
+  memset(output, 0, sizeof(*output));
+  if (size > 0) {
+    void *const data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0);
+    if (data == MAP_FAILED) {
+      const int error = errno;
+      free(output);
+      errno = error;
+      return 0;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    output->data = (char *)data;
+    output->size = size;
+  }
+  return output;
+}
+
+static inline void *gmapped_output_get_data(
+    struct gmapped_output *const output)
+{
+  return output->data;
+}
+
+static inline int gmapped_output_delete(struct gmapped_output *const output,
+    const int is_sync)
+{
+  int error = 0;
+
+  if (output->size > 0) {
+    if (is_sync && msync(output->data, output->size, MS_SYNC) != 0) {
+      error = errno;
+    }
+    munmap(output->data, output->size);
+  }
+  free(output);
+  return error;
+}
+
+#ifndef __cplusplus
+
+static inline int _gmapped_runs_nway_merge_input_next(void *const ctx)
+{
+  struct gmapped_run *const run = *(struct gmapped_run **)ctx;
+  const struct gmapped_runs *const runs = run->runs;
+
+  assert(run->position < run->size);
+  run->position += runs->item_size;
+  _gmapped_run_advance_readahead(run, run->position);
+  return (run->position < run->size);
+}
+
+static inline const void *_gmapped_runs_nway_merge_input_get(
+    const void *const ctx)
+{
+  const struct gmapped_run *const run = *(struct gmapped_run *const *)ctx;
+
+  assert(run->position < run->size);
+  return run->data + run->position;
+}
+
+static inline void _gmapped_runs_nway_merge_input_ctx_mover(void *const dst,
+    const void *const src)
+{
+  *(struct gmapped_run **)dst = *(struct gmapped_run *const *)src;
+}
+
+static const struct galgorithm_nway_merge_input_vtable
+    _gmapped_runs_nway_merge_input_vtable = {
+  .next = &_gmapped_runs_nway_merge_input_next,
+  .get = &_gmapped_runs_nway_merge_input_get,
+};
+
+static inline void gmapped_runs_init_nway_merge_input(
+    struct gmapped_runs *const runs,
+    struct galgorithm_nway_merge_input *const input)
+{
+  size_t ctxs_count = 0;
+
+  for (size_t i = 0; i < runs->runs_count; ++i) {
+    struct gmapped_run *const run = &runs->runs[i];
+    run->position = 0;
+    if (run->size > 0) {
+      runs->run_ptrs[ctxs_count] = run;
+      ++ctxs_count;
+    }
+  }
+
+  input->vtable = &_gmapped_runs_nway_merge_input_vtable;
+  input->ctxs = runs->run_ptrs;
+  input->ctxs_count = ctxs_count;
+  input->ctx_size = sizeof(runs->run_ptrs[0]);
+  input->ctx_mover = &_gmapped_runs_nway_merge_input_ctx_mover;
+}
+
+static inline void _gmapped_output_nway_merge_output_put(void *const ctx,
+    const void *const data)
+{
+  struct gmapped_output *const output = ctx;
+
+  assert(output->position + output->item_size <= output->size);
+  memcpy(output->data + output->position, data, output->item_size);
+  output->position += output->item_size;
+}
+
+static const struct galgorithm_nway_merge_output_vtable
+    _gmapped_output_nway_merge_output_vtable = {
+  .put = &_gmapped_output_nway_merge_output_put,
+};
+
+static inline void gmapped_output_init_nway_merge_output(
+    struct gmapped_output *const output, const size_t item_size,
+    struct galgorithm_nway_merge_output *const merge_output)
+{
+  assert(item_size > 0);
+
+  output->position = 0;
+  output->item_size = item_size;
+
+  merge_output->vtable = &_gmapped_output_nway_merge_output_vtable;
+  merge_output->ctx = output;
+}
+
+#endif
+
+#endif
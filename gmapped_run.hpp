@@ -0,0 +1,250 @@
+#ifndef GMAPPED_RUN_HPP
+#define GMAPPED_RUN_HPP
+
+// Zero-copy input ranges and output for galgorithm::nway_merge() over sorted
+// runs stored in files.
+//
+// gmapped_run_reader<T> maps runs via gmapped_run.h and exposes them as
+// input ranges of gmapped_run_iterator<T> over raw pointers, so the merge
+// reads items directly from page cache. Iterators advance MADV_WILLNEED
+// readahead of their runs like galgorithm_nway_merge() input in C.
+// gmapped_run_writer<T> maps the output file, so the merge writes items
+// directly into page cache. Each run is a file containing an array of items
+// of type T sorted in ascending order. Items must be trivially copyable.
+//
+// Usage:
+//
+//   gmapped_run_reader<int> reader(fds);
+//   std::vector<gmapped_run_reader<int>::input_range> input_ranges;
+//   reader.get_input_ranges(input_ranges);
+//   gmapped_run_writer<int> writer(output_fd, reader.get_total_items_count());
+//   if (!input_ranges.empty()) {
+//     galgorithm<Heap>::nway_merge(input_ranges.begin(), input_ranges.end(),
+//         writer.begin());
+//   }
+//   writer.finish();
+//
+// See gmapped_run.h for details.
+
+#include "gmapped_run.h"
+
+#include <cassert>
+#include <cerrno>      // for errno
+#include <cstddef>     // for size_t, ptrdiff_t
+#include <cstring>     // for strerror()
+#include <iterator>    // for std::input_iterator_tag
+#include <stdexcept>   // for std::runtime_error
+#include <string>      // for std::string
+#include <utility>     // for std::pair
+#include <vector>      // for std::vector
+
+// Input iterator over items of a mapped run, which advances readahead
+// of the run. The end iterator doesn't refer to any run.
+template <class T>
+class gmapped_run_iterator
+{
+public:
+
+  typedef std::input_iterator_tag iterator_category;
+  typedef T value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const T *pointer;
+  typedef const T &reference;
+
+private:
+
+  const T *_ptr;
+
+  // Readahead is advanced when _ptr reaches _readahead_ptr.
+  const T *_readahead_ptr;
+
+  gmapped_runs *_runs;
+  size_t _run_index;
+
+  void _advance_readahead()
+  {
+    const T *const first = static_cast<const T *>(
+        gmapped_runs_get_data(_runs, _run_index));
+    const size_t offset = gmapped_runs_readahead(_runs, _run_index,
+        (_ptr - first) * sizeof(T));
+    _readahead_ptr = first + offset / sizeof(T);
+  }
+
+public:
+
+  gmapped_run_iterator() : _ptr(0), _readahead_ptr(0), _runs(0),
+      _run_index(0) {}
+
+  // Creates the end iterator for the given pointer.
+  explicit gmapped_run_iterator(const T *const ptr) : _ptr(ptr),
+      _readahead_ptr(0), _runs(0), _run_index(0) {}
+
+  // Creates an iterator pointing to the first item of the given run.
+  gmapped_run_iterator(gmapped_runs *const runs, const size_t run_index) :
+      _ptr(static_cast<const T *>(gmapped_runs_get_data(runs, run_index))),
+      _runs(runs), _run_index(run_index)
+  {
+    _advance_readahead();
+  }
+
+  reference operator * () const
+  {
+    return *_ptr;
+  }
+
+  pointer operator -> () const
+  {
+    return _ptr;
+  }
+
+  gmapped_run_iterator &operator ++ ()
+  {
+    assert(_runs != 0);
+
+    ++_ptr;
+    if (_ptr >= _readahead_ptr) {
+      _advance_readahead();
+    }
+    return *this;
+  }
+
+  bool operator == (const gmapped_run_iterator &it) const
+  {
+    return (_ptr == it._ptr);
+  }
+
+  bool operator != (const gmapped_run_iterator &it) const
+  {
+    return (_ptr != it._ptr);
+  }
+};
+
+template <class T>
+class gmapped_run_reader
+{
+public:
+
+  typedef gmapped_run_iterator<T> iterator;
+  typedef std::pair<iterator, iterator> input_range;
+
+private:
+
+  gmapped_runs *_runs;
+
+  // Disable copying.
+  gmapped_run_reader(const gmapped_run_reader &);
+  gmapped_run_reader &operator = (const gmapped_run_reader &);
+
+public:
+
+  // Maps runs stored in files with the given descriptors into memory.
+  // See gmapped_runs_create() for arguments' description.
+  //
+  // Throws std::runtime_error on error.
+  explicit gmapped_run_reader(const std::vector<int> &fds,
+      const size_t readahead_size = 4 * 1024 * 1024)
+  {
+    if (fds.empty()) {
+      throw std::runtime_error("gmapped_run_reader: no runs");
+    }
+    _runs = gmapped_runs_create(&fds[0], fds.size(), sizeof(T),
+        readahead_size);
+    if (_runs == 0) {
+      throw std::runtime_error(std::string("gmapped_run_reader: ") +
+          strerror(errno));
+    }
+  }
+
+  ~gmapped_run_reader()
+  {
+    gmapped_runs_delete(_runs);
+  }
+
+  size_t get_total_items_count() const
+  {
+    return gmapped_runs_get_total_items_count(_runs);
+  }
+
+  // Appends input ranges for non-empty runs to input_ranges.
+  // Ranges remain valid until the reader is destroyed.
+  //
+  // Each run must be iterated by a single range, since ranges advance
+  // readahead of their runs.
+  void get_input_ranges(std::vector<input_range> &input_ranges)
+  {
+    const size_t runs_count = gmapped_runs_get_count(_runs);
+    for (size_t i = 0; i < runs_count; ++i) {
+      const size_t items_count = gmapped_runs_get_items_count(_runs, i);
+      if (items_count > 0) {
+        const iterator first(_runs, i);
+        input_ranges.push_back(input_range(first,
+            iterator(&*first + items_count)));
+      }
+    }
+  }
+};
+
+template <class T>
+class gmapped_run_writer
+{
+private:
+
+  gmapped_output *_output;
+  size_t _items_count;
+
+  // Disable copying.
+  gmapped_run_writer(const gmapped_run_writer &);
+  gmapped_run_writer &operator = (const gmapped_run_writer &);
+
+public:
+
+  // Resizes the file with the given descriptor to items_count items
+  // and maps it into memory for writing.
+  //
+  // Throws std::runtime_error on error.
+  gmapped_run_writer(const int fd, const size_t items_count) :
+      _items_count(items_count)
+  {
+    _output = gmapped_output_create(fd, items_count * sizeof(T));
+    if (_output == 0) {
+      throw std::runtime_error(std::string("gmapped_run_writer: ") +
+          strerror(errno));
+    }
+  }
+
+  // Unmaps the output without waiting for write back unless finish()
+  // has been called.
+  ~gmapped_run_writer()
+  {
+    if (_output != 0) {
+      gmapped_output_delete(_output, 0);
+    }
+  }
+
+  // Returns the output iterator for galgorithm::nway_merge().
+  T *begin()
+  {
+    return static_cast<T *>(gmapped_output_get_data(_output));
+  }
+
+  T *end()
+  {
+    return begin() + _items_count;
+  }
+
+  // Unmaps the output. Waits until the output is written to the file
+  // if is_sync is set.
+  //
+  // Throws std::runtime_error on error.
+  void finish(const bool is_sync = false)
+  {
+    gmapped_output *const output = _output;
+    _output = 0;
+    const int error = gmapped_output_delete(output, is_sync);
+    if (error != 0) {
+      throw std::runtime_error(std::string("gmapped_run_writer: ") +
+          strerror(error));
+    }
+  }
+};
+#endif
@@ -19,6 +19,29 @@ typedef void (*gpriority_queue_item_deleter_t)(void *);
  */
 struct gpriority_queue;
 
+/*
+ * Memory usage of a priority queue.
+ */
+struct gpriority_queue_memory_usage
+{
+  /* The number of items the queue may hold without reallocation. */
+  size_t capacity;
+
+  /* The number of bytes occupied by queue items. */
+  size_t items_bytes;
+
+  /*
+   * The number of bytes allocated for items, i.e. capacity * item_size.
+   * It includes unused capacity, but doesn't include the fixed-size queue
+   * header and memory owned by items themselves, so it matches
+   * gpriority_queue::memory_usage() in C++.
+   */
+  size_t allocated_bytes;
+
+  /* The number of allocated bytes, which aren't occupied by items. */
+  size_t overhead_bytes;
+};
+
 /*
  * Creates an empty priority queue.
  *
@@ -52,6 +75,12 @@ static inline int gpriority_queue_empty(struct gpriority_queue *q);
  */
 static inline size_t gpriority_queue_size(struct gpriority_queue *q);
 
+/*
+ * Returns memory usage of the given priority queue.
+ */
+static inline struct gpriority_queue_memory_usage gpriority_queue_memory_usage(
+    struct gpriority_queue *q);
+
 /*
  * Returns a pointer to the top element in the priority queue.
  */
@@ -148,6 +177,17 @@ static inline size_t gpriority_queue_size(struct gpriority_queue *const q)
   return q->size;
 }
 
+static inline struct gpriority_queue_memory_usage gpriority_queue_memory_usage(
+    struct gpriority_queue *const q)
+{
+  struct gpriority_queue_memory_usage usage;
+  usage.capacity = q->capacity;
+  usage.items_bytes = q->size * q->ctx->item_size;
+  usage.allocated_bytes = q->capacity * q->ctx->item_size;
+  usage.overhead_bytes = usage.allocated_bytes - usage.items_bytes;
+  return usage;
+}
+
 static inline const void *gpriority_queue_top(struct gpriority_queue *const q)
 {
   assert(q->size > 0);
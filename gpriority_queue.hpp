@@ -1,3 +1,6 @@
+#ifndef GPRIORITY_QUEUE_H
+#define GPRIORITY_QUEUE_H
+
 // Priority queue on top of Heap.
 //
 // Pass -DGHEAP_CPP11 to compiler for enabling C++11 optimization,
@@ -25,11 +28,43 @@ public:
   typedef typename Container::reference reference;
   typedef typename Container::const_reference const_reference;
 
+  // Memory usage of the queue. See memory_usage().
+  struct memory_usage_type
+  {
+    // The number of items the queue may hold without reallocation.
+    size_type capacity;
+
+    // The number of bytes occupied by queue items.
+    size_t items_bytes;
+
+    // The number of bytes allocated by the container for items, i.e.
+    // capacity * sizeof(value_type). It includes unused capacity, but doesn't
+    // include the queue object itself and memory owned by items themselves,
+    // so it matches gpriority_queue_memory_usage() in C.
+    size_t allocated_bytes;
+
+    // The number of allocated bytes, which aren't occupied by items.
+    size_t overhead_bytes;
+  };
+
   LessComparer comp;
   Container c;
 
 private:
 
+  // Containers without capacity() are assumed to have no spare capacity.
+  template <class AnyContainer>
+  static size_type _get_capacity(const AnyContainer &container)
+  {
+    return container.size();
+  }
+
+  template <class U, class Allocator>
+  static size_type _get_capacity(const std::vector<U, Allocator> &container)
+  {
+    return container.capacity();
+  }
+
   void _make_heap()
   {
     Heap::make_heap(c.begin(), c.end(), comp);
@@ -95,6 +130,16 @@ public:
     c.pop_back();
   }
 
+  memory_usage_type memory_usage() const
+  {
+    memory_usage_type usage;
+    usage.capacity = _get_capacity(c);
+    usage.items_bytes = c.size() * sizeof(value_type);
+    usage.allocated_bytes = usage.capacity * sizeof(value_type);
+    usage.overhead_bytes = usage.allocated_bytes - usage.items_bytes;
+    return usage;
+  }
+
   void swap(gpriority_queue &q)
   {
     std::swap(c, q.c);
@@ -122,3 +167,4 @@ namespace std
     a.swap(b);
   }
 }
+#endif
@@ -0,0 +1,688 @@
+// gsample_sort - sorts 64-bit unsigned integer keys across multiple worker
+// processes on a single host via sample sort on top of gheap algorithms.
+//
+// The coordinator process loads the input into shared memory and forks
+// workers. Sorting proceeds in phases:
+//
+// 1. sort: each worker sorts its partition of the input via
+//    galgorithm::nway_mergesort().
+// 2. sample: each worker sends regularly spaced samples of its sorted
+//    partition to the coordinator. The coordinator merges samples via
+//    galgorithm::nway_merge() and broadcasts splitters back.
+// 3. exchange: each worker splits its partition into buckets by splitters.
+//    Bucket j is redistributed to worker j either via shared memory
+//    or via Unix sockets, which serve as a local stand-in for network.
+// 4. merge: each worker merges the received runs via
+//    galgorithm::nway_merge() into its slice of the shared output.
+//
+// The coordinator communicates with workers only via messages over Unix
+// sockets, so it may be ported to network transport later.
+// Per-phase timings are reported after the output is verified.
+//
+// The implementation requires C++11 and POSIX, so pass -DGHEAP_CPP11
+// to compiler.
+
+#ifndef GHEAP_CPP11
+#  error "gsample_sort.cpp requires C++11 (-DGHEAP_CPP11)"
+#endif
+
+#include "galgorithm.hpp"
+#include "gheap.hpp"
+
+#include <algorithm>   // for std::upper_bound(), std::is_sorted()
+#include <cassert>
+#include <cerrno>      // for errno
+#include <chrono>      // for std::chrono::steady_clock
+#include <cstdint>     // for uint64_t
+#include <cstdio>      // for printf(), fprintf(), fopen(), ...
+#include <cstdlib>     // for strtoull(), exit()
+#include <cstring>     // for strcmp(), strerror()
+#include <thread>      // for std::thread
+#include <utility>     // for std::pair
+#include <vector>
+
+#include <getopt.h>      // for getopt()
+#include <sys/mman.h>    // for mmap(), munmap()
+#include <sys/socket.h>  // for socketpair()
+#include <sys/wait.h>    // for waitpid()
+#include <unistd.h>      // for fork(), read(), write(), close()
+
+using namespace std;
+
+namespace {
+
+typedef galgorithm<gheap<4, 1> > algorithm;
+typedef pair<const uint64_t *, const uint64_t *> input_range;
+
+enum phase
+{
+  PHASE_SORT,
+  PHASE_SAMPLE,
+  PHASE_EXCHANGE,
+  PHASE_MERGE,
+  PHASES_COUNT,
+};
+
+const char *const phase_names[PHASES_COUNT] = {
+  "sort", "sample", "exchange", "merge",
+};
+
+struct options
+{
+  size_t items_count = 10 * 1000 * 1000;
+  size_t workers_count = 4;
+
+  // The number of samples per worker is oversampling * workers_count.
+  size_t oversampling = 32;
+
+  bool is_socket_transport = false;
+  uint64_t seed = 1;
+  const char *input_path = nullptr;
+  const char *output_path = nullptr;
+};
+
+void die(const char *const message)
+{
+  fprintf(stderr, "gsample_sort: %s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+void die_errno(const char *const message)
+{
+  fprintf(stderr, "gsample_sort: %s: %s\n", message, strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+double get_time()
+{
+  return chrono::duration<double>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Anonymous memory shared between the coordinator and forked workers.
+template <class T>
+class shared_array
+{
+private:
+
+  T *_data;
+  size_t _size;
+
+public:
+
+  explicit shared_array(const size_t size) : _data(nullptr), _size(size)
+  {
+    if (size == 0) {
+      return;
+    }
+    void *const data = mmap(nullptr, size * sizeof(T),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+      die_errno("cannot allocate shared memory");
+    }
+    _data = static_cast<T *>(data);
+  }
+
+  shared_array(const shared_array &) = delete;
+  shared_array &operator = (const shared_array &) = delete;
+
+  ~shared_array()
+  {
+    if (_size > 0) {
+      munmap(_data, _size * sizeof(T));
+    }
+  }
+
+  T *data() const
+  {
+    return _data;
+  }
+
+  size_t size() const
+  {
+    return _size;
+  }
+};
+
+// Blocking message channel over a stream socket. Each message is prefixed
+// by its size, so the channel doesn't depend on socket buffer sizes.
+class channel
+{
+private:
+
+  int _fd;
+
+  void _write_all(const void *const data, const size_t size) const
+  {
+    const char *p = static_cast<const char *>(data);
+    size_t remaining = size;
+    while (remaining > 0) {
+      const ssize_t n = write(_fd, p, remaining);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        die_errno("cannot send message");
+      }
+      p += n;
+      remaining -= n;
+    }
+  }
+
+  void _read_all(void *const data, const size_t size) const
+  {
+    char *p = static_cast<char *>(data);
+    size_t remaining = size;
+    while (remaining > 0) {
+      const ssize_t n = read(_fd, p, remaining);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        die_errno("cannot receive message");
+      }
+      if (n == 0) {
+        die("unexpected end of channel");
+      }
+      p += n;
+      remaining -= n;
+    }
+  }
+
+public:
+
+  channel() : _fd(-1) {}
+
+  explicit channel(const int fd) : _fd(fd) {}
+
+  void close_fd()
+  {
+    if (_fd >= 0) {
+      close(_fd);
+      _fd = -1;
+    }
+  }
+
+  template <class T>
+  void send(const T *const items, const size_t items_count) const
+  {
+    const uint64_t size = items_count * sizeof(T);
+    _write_all(&size, sizeof(size));
+    _write_all(items, size);
+  }
+
+  template <class T>
+  void send(const vector<T> &items) const
+  {
+    send(items.data(), items.size());
+  }
+
+  // Appends the received items to items.
+  template <class T>
+  void receive(vector<T> &items) const
+  {
+    uint64_t size;
+    _read_all(&size, sizeof(size));
+    if (size % sizeof(T) != 0) {
+      die("unexpected message size");
+    }
+    const size_t offset = items.size();
+    items.resize(offset + size / sizeof(T));
+    _read_all(items.data() + offset, size);
+  }
+};
+
+// Creates a connected pair of channels.
+pair<channel, channel> create_channels()
+{
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    die_errno("cannot create socket pair");
+  }
+  return make_pair(channel(fds[0]), channel(fds[1]));
+}
+
+// State shared between the coordinator and workers. It is created before
+// forking workers.
+struct cluster
+{
+  const options &opts;
+
+  // The input. Worker i sorts the i-th partition in place.
+  shared_array<uint64_t> input;
+
+  // The output. Worker j writes the j-th bucket into its slice.
+  shared_array<uint64_t> output;
+
+  // bucket_offsets[i * (workers_count + 1) + j] is the offset of the j-th
+  // bucket in the sorted partition of the i-th worker. It is used
+  // for exchanging buckets via shared memory.
+  shared_array<size_t> bucket_offsets;
+
+  // Channels between the coordinator and workers.
+  vector<channel> coordinator_channels;
+  vector<channel> worker_channels;
+
+  // peer_channels[i * workers_count + j] is the channel from the i-th
+  // worker to the j-th worker. Used only by socket transport.
+  vector<channel> peer_channels;
+
+  explicit cluster(const options &options) :
+      opts(options), input(options.items_count),
+      output(options.items_count),
+      bucket_offsets(options.workers_count * (options.workers_count + 1))
+  {
+    const size_t workers_count = opts.workers_count;
+    for (size_t i = 0; i < workers_count; ++i) {
+      const pair<channel, channel> channels = create_channels();
+      coordinator_channels.push_back(channels.first);
+      worker_channels.push_back(channels.second);
+    }
+    if (opts.is_socket_transport) {
+      peer_channels.resize(workers_count * workers_count);
+      for (size_t i = 0; i < workers_count; ++i) {
+        for (size_t j = i + 1; j < workers_count; ++j) {
+          const pair<channel, channel> channels = create_channels();
+          peer_channels[i * workers_count + j] = channels.first;
+          peer_channels[j * workers_count + i] = channels.second;
+        }
+      }
+    }
+  }
+
+  size_t get_partition_offset(const size_t worker_index) const
+  {
+    return worker_index * opts.items_count / opts.workers_count;
+  }
+
+  // Closes channels not belonging to the given worker.
+  void close_foreign_channels(const size_t worker_index)
+  {
+    const size_t workers_count = opts.workers_count;
+    for (size_t i = 0; i < workers_count; ++i) {
+      coordinator_channels[i].close_fd();
+      if (i != worker_index) {
+        worker_channels[i].close_fd();
+      }
+    }
+    for (size_t i = 0; i < peer_channels.size(); ++i) {
+      if (i / workers_count != worker_index) {
+        peer_channels[i].close_fd();
+      }
+    }
+  }
+};
+
+// Sends the j-th bucket to the j-th worker while receiving the own bucket
+// from the other workers. Sends and receives run concurrently,
+// so peers never deadlock on full socket buffers.
+void exchange_buckets_via_sockets(cluster &c, const size_t worker_index,
+    const uint64_t *const partition, const vector<size_t> &offsets,
+    vector<vector<uint64_t> > &received_runs)
+{
+  const size_t workers_count = c.opts.workers_count;
+  const channel *const peers = &c.peer_channels[worker_index * workers_count];
+
+  thread sender([&]() {
+    for (size_t k = 1; k < workers_count; ++k) {
+      const size_t j = (worker_index + k) % workers_count;
+      peers[j].send(partition + offsets[j], offsets[j + 1] - offsets[j]);
+    }
+  });
+  for (size_t k = 1; k < workers_count; ++k) {
+    const size_t i = (worker_index + workers_count - k) % workers_count;
+    peers[i].receive(received_runs[i]);
+  }
+  sender.join();
+}
+
+void run_worker(cluster &c, const size_t worker_index)
+{
+  const options &opts = c.opts;
+  const size_t workers_count = opts.workers_count;
+  const channel &coordinator = c.worker_channels[worker_index];
+  double timings[PHASES_COUNT];
+
+  uint64_t *const partition = c.input.data() +
+      c.get_partition_offset(worker_index);
+  const size_t partition_size = c.get_partition_offset(worker_index + 1) -
+      c.get_partition_offset(worker_index);
+
+  // Sort the partition.
+  double start = get_time();
+  algorithm::nway_mergesort(partition, partition + partition_size);
+  double end = get_time();
+  timings[PHASE_SORT] = end - start;
+
+  // Send regularly spaced samples and receive splitters.
+  start = end;
+  vector<uint64_t> samples;
+  const size_t samples_count = (partition_size > 0) ?
+      opts.oversampling * workers_count : 0;
+  for (size_t i = 0; i < samples_count; ++i) {
+    samples.push_back(partition[i * partition_size / samples_count]);
+  }
+  coordinator.send(samples);
+  vector<uint64_t> splitters;
+  coordinator.receive(splitters);
+  assert(splitters.size() == workers_count - 1);
+  end = get_time();
+  timings[PHASE_SAMPLE] = end - start;
+
+  // Split the partition into buckets. The j-th bucket contains keys
+  // in the range (splitters[j - 1] ... splitters[j]].
+  start = end;
+  vector<size_t> offsets(workers_count + 1);
+  vector<size_t> bucket_sizes(workers_count);
+  offsets[0] = 0;
+  for (size_t j = 0; j + 1 < workers_count; ++j) {
+    offsets[j + 1] = upper_bound(partition + offsets[j],
+        partition + partition_size, splitters[j]) - partition;
+  }
+  offsets[workers_count] = partition_size;
+  for (size_t j = 0; j < workers_count; ++j) {
+    bucket_sizes[j] = offsets[j + 1] - offsets[j];
+    c.bucket_offsets.data()[worker_index * (workers_count + 1) + j] =
+        offsets[j];
+  }
+  c.bucket_offsets.data()[worker_index * (workers_count + 1) +
+      workers_count] = partition_size;
+
+  // Publish bucket sizes. The coordinator replies with the output offset
+  // after all the workers publish their buckets, so the reply also serves
+  // as a barrier for shared memory transport.
+  coordinator.send(bucket_sizes);
+  vector<size_t> output_offset;
+  coordinator.receive(output_offset);
+  assert(output_offset.size() == 1);
+
+  vector<vector<uint64_t> > received_runs(workers_count);
+  vector<input_range> input_ranges;
+  if (opts.is_socket_transport) {
+    exchange_buckets_via_sockets(c, worker_index, partition, offsets,
+        received_runs);
+    for (size_t i = 0; i < workers_count; ++i) {
+      const uint64_t *first = received_runs[i].data();
+      const uint64_t *last = first + received_runs[i].size();
+      if (i == worker_index) {
+        first = partition + offsets[worker_index];
+        last = partition + offsets[worker_index + 1];
+      }
+      if (first != last) {
+        input_ranges.push_back(input_range(first, last));
+      }
+    }
+  }
+  else {
+    for (size_t i = 0; i < workers_count; ++i) {
+      const size_t *const offsets_i = c.bucket_offsets.data() +
+          i * (workers_count + 1);
+      const uint64_t *const partition_i = c.input.data() +
+          c.get_partition_offset(i);
+      if (offsets_i[worker_index] != offsets_i[worker_index + 1]) {
+        input_ranges.push_back(input_range(
+            partition_i + offsets_i[worker_index],
+            partition_i + offsets_i[worker_index + 1]));
+      }
+    }
+  }
+  end = get_time();
+  timings[PHASE_EXCHANGE] = end - start;
+
+  // Merge the received runs into the output.
+  start = end;
+  if (!input_ranges.empty()) {
+    algorithm::nway_merge(input_ranges.begin(), input_ranges.end(),
+        c.output.data() + output_offset[0]);
+  }
+  end = get_time();
+  timings[PHASE_MERGE] = end - start;
+
+  coordinator.send(timings, PHASES_COUNT);
+}
+
+void load_input(const options &opts, uint64_t *const input)
+{
+  if (opts.input_path == nullptr) {
+    // xorshift64* generator.
+    uint64_t x = opts.seed | 1;
+    for (size_t i = 0; i < opts.items_count; ++i) {
+      x ^= x >> 12;
+      x ^= x << 25;
+      x ^= x >> 27;
+      input[i] = x * 2685821657736338717ULL;
+    }
+    return;
+  }
+  FILE *const file = fopen(opts.input_path, "rb");
+  if (file == nullptr) {
+    die_errno(opts.input_path);
+  }
+  if (fread(input, sizeof(input[0]), opts.items_count, file) !=
+      opts.items_count) {
+    die("cannot read input");
+  }
+  fclose(file);
+}
+
+// Returns the number of 64-bit records in the given file.
+size_t get_items_count(const char *const path)
+{
+  FILE *const file = fopen(path, "rb");
+  if (file == nullptr || fseek(file, 0, SEEK_END) != 0) {
+    die_errno(path);
+  }
+  const long size = ftell(file);
+  fclose(file);
+  if (size < 0 || size % sizeof(uint64_t) != 0) {
+    die("input size isn't multiple of 8 bytes");
+  }
+  return size / sizeof(uint64_t);
+}
+
+uint64_t get_checksum(const uint64_t *const items, const size_t items_count)
+{
+  uint64_t checksum = 0;
+  for (size_t i = 0; i < items_count; ++i) {
+    checksum += items[i];
+  }
+  return checksum;
+}
+
+void run_coordinator(cluster &c, const vector<pid_t> &pids,
+    const uint64_t input_checksum)
+{
+  const options &opts = c.opts;
+  const size_t workers_count = opts.workers_count;
+  const double start = get_time();
+
+  // Merge samples and choose regularly spaced splitters.
+  vector<vector<uint64_t> > samples(workers_count);
+  vector<input_range> input_ranges;
+  size_t samples_count = 0;
+  for (size_t i = 0; i < workers_count; ++i) {
+    c.coordinator_channels[i].receive(samples[i]);
+    if (!samples[i].empty()) {
+      input_ranges.push_back(input_range(samples[i].data(),
+          samples[i].data() + samples[i].size()));
+      samples_count += samples[i].size();
+    }
+  }
+  vector<uint64_t> merged_samples(samples_count);
+  if (!input_ranges.empty()) {
+    algorithm::nway_merge(input_ranges.begin(), input_ranges.end(),
+        merged_samples.begin());
+  }
+  vector<uint64_t> splitters;
+  for (size_t j = 1; j < workers_count; ++j) {
+    splitters.push_back(merged_samples.empty() ?
+        0 : merged_samples[j * samples_count / workers_count]);
+  }
+  for (size_t i = 0; i < workers_count; ++i) {
+    c.coordinator_channels[i].send(splitters);
+  }
+
+  // Assign output slices to buckets.
+  vector<size_t> bucket_sizes;
+  for (size_t i = 0; i < workers_count; ++i) {
+    c.coordinator_channels[i].receive(bucket_sizes);
+  }
+  size_t output_offset = 0;
+  size_t max_bucket_size = 0;
+  for (size_t j = 0; j < workers_count; ++j) {
+    c.coordinator_channels[j].send(&output_offset, 1);
+    size_t bucket_size = 0;
+    for (size_t i = 0; i < workers_count; ++i) {
+      bucket_size += bucket_sizes[i * workers_count + j];
+    }
+    output_offset += bucket_size;
+    max_bucket_size = max(max_bucket_size, bucket_size);
+  }
+  assert(output_offset == opts.items_count);
+
+  vector<double> timings;
+  for (size_t i = 0; i < workers_count; ++i) {
+    c.coordinator_channels[i].receive(timings);
+  }
+  const double end = get_time();
+
+  for (size_t i = 0; i < workers_count; ++i) {
+    int status;
+    if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      die("worker failed");
+    }
+  }
+
+  const uint64_t *const output = c.output.data();
+  if (!is_sorted(output, output + opts.items_count) ||
+      get_checksum(output, opts.items_count) != input_checksum) {
+    die("output verification failed");
+  }
+
+  printf("gsample_sort(items_count=%zu, workers_count=%zu, transport=%s)\n",
+      opts.items_count, workers_count,
+      opts.is_socket_transport ? "socket" : "shm");
+  for (size_t p = 0; p < PHASES_COUNT; ++p) {
+    double max_time = 0, sum_time = 0;
+    for (size_t i = 0; i < workers_count; ++i) {
+      max_time = max(max_time, timings[i * PHASES_COUNT + p]);
+      sum_time += timings[i * PHASES_COUNT + p];
+    }
+    printf("  %-9s max: %.3fs, avg: %.3fs\n", phase_names[p], max_time,
+        sum_time / workers_count);
+  }
+  printf("  total     %.3fs, %.0f Kitems/s\n", end - start,
+      opts.items_count / (end - start) / 1000);
+  printf("  imbalance %.3f (the max bucket size to the average)\n",
+      opts.items_count == 0 ? 1.0 :
+          double(max_bucket_size) * workers_count / opts.items_count);
+
+  if (opts.output_path != nullptr) {
+    FILE *const file = fopen(opts.output_path, "wb");
+    if (file == nullptr ||
+        fwrite(output, sizeof(output[0]), opts.items_count, file) !=
+            opts.items_count ||
+        fclose(file) != 0) {
+      die_errno(opts.output_path);
+    }
+  }
+}
+
+size_t parse_size(const char *const s)
+{
+  char *end;
+  errno = 0;
+  const size_t size = strtoull(s, &end, 10);
+  if (errno != 0 || end == s || *end != '\0') {
+    die("invalid number");
+  }
+  return size;
+}
+
+void print_usage()
+{
+  fprintf(stderr,
+      "Usage: gsample_sort [options] [input [output]]\n"
+      "Sorts native-endian 64-bit unsigned integers via sample sort\n"
+      "across worker processes. Generates random input if no input\n"
+      "is given.\n"
+      "\n"
+      "  -n COUNT  the number of generated items (default 10000000)\n"
+      "  -p N      the number of worker processes (default 4)\n"
+      "  -s N      samples per worker per bucket (default 32)\n"
+      "  -t NAME   transport for exchanging buckets: shm or socket\n"
+      "            (default shm)\n"
+      "  -S SEED   seed for generated input (default 1)\n");
+}
+
+}  // end of anonymous namespace.
+
+
+int main(int argc, char **argv)
+{
+  options opts;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:p:s:t:S:h")) != -1) {
+    switch (opt) {
+      case 'n': opts.items_count = parse_size(optarg); break;
+      case 'p': opts.workers_count = parse_size(optarg); break;
+      case 's': opts.oversampling = parse_size(optarg); break;
+      case 't':
+        if (strcmp(optarg, "socket") == 0) {
+          opts.is_socket_transport = true;
+        }
+        else if (strcmp(optarg, "shm") != 0) {
+          die("unknown transport");
+        }
+        break;
+      case 'S': opts.seed = parse_size(optarg); break;
+      default:
+        print_usage();
+        return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind + 2 < argc) {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+  if (opts.workers_count == 0 || opts.oversampling == 0) {
+    die("-p and -s must be positive");
+  }
+  if (optind < argc) {
+    opts.input_path = argv[optind];
+    opts.items_count = get_items_count(opts.input_path);
+  }
+  if (optind + 1 < argc) {
+    opts.output_path = argv[optind + 1];
+  }
+
+  cluster c(opts);
+  load_input(opts, c.input.data());
+  const uint64_t input_checksum = get_checksum(c.input.data(),
+      opts.items_count);
+
+  fflush(stdout);
+  vector<pid_t> pids;
+  for (size_t i = 0; i < opts.workers_count; ++i) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      die_errno("cannot fork worker");
+    }
+    if (pid == 0) {
+      c.close_foreign_channels(i);
+      run_worker(c, i);
+      _exit(EXIT_SUCCESS);
+    }
+    pids.push_back(pid);
+  }
+  for (size_t i = 0; i < opts.workers_count; ++i) {
+    c.worker_channels[i].close_fd();
+  }
+  for (size_t i = 0; i < c.peer_channels.size(); ++i) {
+    c.peer_channels[i].close_fd();
+  }
+
+  run_coordinator(c, pids, input_checksum);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+#ifndef GSHARED_PRIORITY_QUEUE_H
+#define GSHARED_PRIORITY_QUEUE_H
+
+// Thread-safe priority queue on top of Heap, which publishes the top item
+// for lock-free peeking.
+//
+// All the mutations are serialized by a mutex. After each mutation
+// the top item is copied into a seqlock-protected snapshot, which lives
+// on its own cache lines. See http://en.wikipedia.org/wiki/Seqlock .
+// So peek_top() doesn't take the mutex and doesn't touch heap items.
+// It retries only if it races with a mutation publishing a new top item.
+//
+// The snapshot is stored in atomic words, so items must be trivially
+// copyable.
+//
+// The implementation requires C++11, so pass -DGHEAP_CPP11 to compiler.
+//
+// Don't forget passing -DNDEBUG option to the compiler when creating optimized
+// builds. This significantly speeds up the code by removing debug assertions.
+
+#ifndef GHEAP_CPP11
+#  error "gshared_priority_queue.hpp requires C++11 (-DGHEAP_CPP11)"
+#endif
+
+#include "gpriority_queue.hpp"
+
+#include <atomic>       // for std::atomic
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint64_t
+#include <cstring>      // for memcpy()
+#include <functional>   // for std::less
+#include <mutex>        // for std::mutex, std::lock_guard
+#include <type_traits>  // for std::is_trivially_copyable
+#include <utility>      // for std::move()
+#include <vector>       // for std::vector
+
+// Seqlock-protected snapshot of a trivially copyable value.
+// Writers must be serialized by the caller.
+template <class T>
+class gseqlock_snapshot
+{
+private:
+
+  static_assert(std::is_trivially_copyable<T>::value,
+      "gseqlock_snapshot requires trivially copyable items");
+
+  static const size_t _WORDS_COUNT =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // The sequence number is odd while the snapshot is being updated.
+  alignas(64) std::atomic<size_t> _seq;
+  std::atomic<uint64_t> _has_value;
+  std::atomic<uint64_t> _words[_WORDS_COUNT];
+
+  // Padding prevents false sharing with subsequent data.
+  char _padding[64];
+
+public:
+
+  gseqlock_snapshot() : _seq(0), _has_value(0)
+  {
+    for (size_t i = 0; i < _WORDS_COUNT; ++i) {
+      _words[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  gseqlock_snapshot(const gseqlock_snapshot &) = delete;
+  gseqlock_snapshot &operator = (const gseqlock_snapshot &) = delete;
+
+  // Publishes the given value. Publishes an empty snapshot if v is 0.
+  void publish(const T *const v)
+  {
+    uint64_t buf[_WORDS_COUNT] = {};
+    if (v != 0) {
+      memcpy(buf, v, sizeof(T));
+    }
+
+    // Release stores for words prevent reordering them with the odd
+    // sequence number store, while acquire loads in read() prevent
+    // reordering them with the final sequence number load.
+    const size_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_relaxed);
+    _has_value.store(v != 0, std::memory_order_release);
+    for (size_t i = 0; i < _WORDS_COUNT; ++i) {
+      _words[i].store(buf[i], std::memory_order_release);
+    }
+    _seq.store(seq + 2, std::memory_order_release);
+  }
+
+  // Copies the published value into v.
+  // Returns false if the published snapshot is empty.
+  bool read(T &v) const
+  {
+    uint64_t buf[_WORDS_COUNT];
+    uint64_t has_value;
+    size_t seq;
+    do {
+      seq = _seq.load(std::memory_order_acquire);
+      has_value = _has_value.load(std::memory_order_acquire);
+      for (size_t i = 0; i < _WORDS_COUNT; ++i) {
+        buf[i] = _words[i].load(std::memory_order_acquire);
+      }
+    } while ((seq & 1) != 0 || _seq.load(std::memory_order_relaxed) != seq);
+
+    if (has_value == 0) {
+      return false;
+    }
+    memcpy(&v, buf, sizeof(T));
+    return true;
+  }
+};
+
+template <class Heap, class T, class Container = std::vector<T>,
+    class LessComparer = std::less<typename Container::value_type> >
+class gshared_priority_queue
+{
+public:
+
+  typedef typename Container::value_type value_type;
+  typedef typename Container::size_type size_type;
+
+private:
+
+  gseqlock_snapshot<value_type> _top;
+
+  mutable std::mutex _mutex;
+  gpriority_queue<Heap, T, Container, LessComparer> _q;
+
+  // Publishes the top item. Must be called under _mutex.
+  void _publish_top()
+  {
+    _top.publish(_q.empty() ? 0 : &_q.top());
+  }
+
+public:
+
+  explicit gshared_priority_queue(
+      const LessComparer &less_comparer = LessComparer(),
+      const Container &container = Container()) :
+          _q(less_comparer, container)
+  {
+    _publish_top();
+  }
+
+  template <class InputIterator>
+  gshared_priority_queue(const InputIterator &first,
+      const InputIterator &last,
+      const LessComparer &less_comparer = LessComparer(),
+      const Container &container = Container()) :
+          _q(first, last, less_comparer, container)
+  {
+    _publish_top();
+  }
+
+  gshared_priority_queue(const gshared_priority_queue &) = delete;
+  gshared_priority_queue &operator = (const gshared_priority_queue &) = delete;
+
+  bool empty() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _q.empty();
+  }
+
+  size_type size() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _q.size();
+  }
+
+  // Copies the top item into v without taking the lock.
+  // Returns false if the queue is empty.
+  //
+  // The copied item may be already popped by the time the function returns,
+  // as with any peeking at a concurrently modified queue.
+  bool peek_top(value_type &v) const
+  {
+    return _top.read(v);
+  }
+
+  void push(const T &v)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _q.push(v);
+    _publish_top();
+  }
+
+  void push(T &&v)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _q.push(std::move(v));
+    _publish_top();
+  }
+
+  // Moves the top item into v and pops it from the queue.
+  // Returns false if the queue is empty.
+  bool try_pop(value_type &v)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_q.empty()) {
+      return false;
+    }
+    v = std::move(_q.c.front());
+    _q.pop();
+    _publish_top();
+    return true;
+  }
+};
+#endif
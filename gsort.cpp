@@ -0,0 +1,793 @@
+// gsort - sorts large files of newline-delimited text or fixed-width binary
+// records using gheap algorithms.
+//
+// Records are sorted in memory via galgorithm::parallel_nway_mergesort().
+// Inputs exceeding the memory budget are split into chunks, which are sorted
+// and spilled to temporary run files. Runs are merged into the output
+// via galgorithm::nway_merge(). The input and runs are accessed via mmap().
+// Top-k mode selects the k smallest records via
+// galgorithm::parallel_partial_sort() without spilling.
+//
+// Records with equal keys are ordered by their bytes, so the output
+// for text input matches 'LC_ALL=C sort' with the same keys.
+//
+// The implementation requires C++11 and POSIX, so pass -DGHEAP_CPP11
+// to compiler.
+
+#ifndef GHEAP_CPP11
+#  error "gsort.cpp requires C++11 (-DGHEAP_CPP11)"
+#endif
+
+#include "galgorithm.hpp"
+#include "gheap.hpp"
+#include "gthread_pool.hpp"
+
+#include <cassert>
+#include <cerrno>      // for errno
+#include <cstdint>     // for uint32_t, uint64_t, int64_t
+#include <cstdio>      // for fprintf(), fwrite(), ...
+#include <cstdlib>     // for strtoull(), mkstemp(), exit()
+#include <cstring>     // for memchr(), memcmp(), strerror()
+#include <iterator>    // for std::input_iterator_tag
+#include <memory>      // for std::unique_ptr
+#include <string>
+#include <thread>      // for std::thread::hardware_concurrency()
+#include <utility>     // for std::pair
+#include <vector>
+
+#include <fcntl.h>     // for open()
+#include <getopt.h>    // for getopt()
+#include <sys/mman.h>  // for mmap(), munmap(), madvise()
+#include <sys/stat.h>  // for fstat()
+#include <unistd.h>    // for close(), read(), unlink()
+
+using namespace std;
+
+namespace {
+
+typedef galgorithm<gheap<4, 1> > algorithm;
+
+struct options
+{
+  // Record size for binary records. Zero means newline-delimited text.
+  size_t record_size = 0;
+
+  // 1-based key field for text records. Zero means the whole line.
+  size_t key_field = 0;
+
+  // Field separator for text records. -1 means the empty string between
+  // a non-blank and a blank character, so fields include leading blanks.
+  int field_separator = -1;
+
+  // Key offset and width inside the record or the key field.
+  // Zero width means up to the end of the record or the field.
+  size_t key_offset = 0;
+  size_t key_width = 0;
+
+  bool is_numeric = false;
+
+  // Zero means sorting all the records.
+  size_t top_k = 0;
+
+  size_t memory_budget = 256 * 1024 * 1024;
+  size_t threads_count = 0;
+  string tmp_dir = "/tmp";
+};
+
+void die(const char *const message)
+{
+  fprintf(stderr, "gsort: %s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+void die_errno(const char *const message)
+{
+  fprintf(stderr, "gsort: %s: %s\n", message, strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+// Read-only memory mapping of the whole file.
+class mapped_file
+{
+private:
+
+  const char *_data;
+  size_t _size;
+
+public:
+
+  explicit mapped_file(const int fd) : _data(nullptr), _size(0)
+  {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      die_errno("cannot stat file");
+    }
+    if (!S_ISREG(st.st_mode)) {
+      die("cannot map non-regular file");
+    }
+    _size = st.st_size;
+    if (_size == 0) {
+      return;
+    }
+    void *const data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      die_errno("cannot map file");
+    }
+    madvise(data, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char *>(data);
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator = (const mapped_file &) = delete;
+
+  ~mapped_file()
+  {
+    if (_size > 0) {
+      munmap(const_cast<char *>(_data), _size);
+    }
+  }
+
+  const char *data() const
+  {
+    return _data;
+  }
+
+  size_t size() const
+  {
+    return _size;
+  }
+};
+
+// Reference to a record with the cached key prefix.
+//
+// Records are compared by prefixes first. Then lexical keys are compared
+// by their bytes, and records with equal keys are compared by their bytes.
+struct record
+{
+  uint64_t prefix;
+  const char *data;
+  uint32_t size;
+  uint32_t key_offset;
+  uint32_t key_size;
+};
+
+// Extracts keys from records according to options.
+class key_extractor
+{
+private:
+
+  const options &_options;
+
+  static bool _is_blank(const char c)
+  {
+    return (c == ' ' || c == '\t');
+  }
+
+  // Narrows [first ... last) to the key field of a text record.
+  void _find_field(const char *&first, const char *&last) const
+  {
+    if (_options.key_field == 0) {
+      return;
+    }
+    for (size_t field = 1; ; ++field) {
+      const char *field_last = first;
+      if (_options.field_separator < 0) {
+        // Fields include leading blanks like in GNU sort.
+        while (field_last != last && _is_blank(*field_last)) {
+          ++field_last;
+        }
+        while (field_last != last && !_is_blank(*field_last)) {
+          ++field_last;
+        }
+      }
+      else {
+        field_last = static_cast<const char *>(memchr(first,
+            _options.field_separator, last - first));
+        if (field_last == nullptr) {
+          field_last = last;
+        }
+      }
+      if (field == _options.key_field) {
+        last = field_last;
+        return;
+      }
+      if (field_last == last) {
+        first = last;
+        return;
+      }
+      first = field_last + (_options.field_separator >= 0);
+    }
+  }
+
+  static uint64_t _parse_decimal(const char *first, const char *const last)
+  {
+    while (first != last && _is_blank(*first)) {
+      ++first;
+    }
+    const bool is_negative = (first != last && *first == '-');
+    if (is_negative) {
+      ++first;
+    }
+    // Numbers out of int64_t range are saturated like in strtoll().
+    const uint64_t sign_bit = static_cast<uint64_t>(1) << 63;
+    const uint64_t max_value = is_negative ? sign_bit : sign_bit - 1;
+    uint64_t value = 0;
+    while (first != last && *first >= '0' && *first <= '9') {
+      const unsigned digit = *first - '0';
+      value = (value > (max_value - digit) / 10) ?
+          max_value : value * 10 + digit;
+      ++first;
+    }
+
+    // Negate in two's complement and flip the sign bit, so unsigned
+    // comparison preserves the order.
+    return (is_negative ? 0 - value : value) ^ sign_bit;
+  }
+
+  static uint64_t _load_little_endian(const char *const first,
+      const size_t size)
+  {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+      value |= static_cast<uint64_t>(static_cast<unsigned char>(first[i])) <<
+          (8 * i);
+    }
+    return value;
+  }
+
+  static uint64_t _load_big_endian(const char *const first, const size_t size)
+  {
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      value <<= 8;
+      if (i < size) {
+        value |= static_cast<unsigned char>(first[i]);
+      }
+    }
+    return value;
+  }
+
+public:
+
+  explicit key_extractor(const options &options) : _options(options) {}
+
+  record get_record(const char *const data, const size_t size) const
+  {
+    const char *first = data;
+    const char *last = data + size;
+    if (_options.record_size == 0) {
+      _find_field(first, last);
+    }
+    first = (_options.key_offset < size_t(last - first)) ?
+        first + _options.key_offset : last;
+    if (_options.key_width != 0 && _options.key_width < size_t(last - first)) {
+      last = first + _options.key_width;
+    }
+
+    record r;
+    r.data = data;
+    r.size = uint32_t(size);
+    r.key_offset = uint32_t(first - data);
+    r.key_size = uint32_t(last - first);
+    if (!_options.is_numeric) {
+      r.prefix = _load_big_endian(first, last - first);
+    }
+    else if (_options.record_size == 0) {
+      r.prefix = _parse_decimal(first, last);
+    }
+    else {
+      r.prefix = _load_little_endian(first, last - first);
+    }
+    return r;
+  }
+};
+
+struct record_less_comparer
+{
+  bool is_numeric;
+
+  static int compare_bytes(const char *const a, const size_t a_size,
+      const char *const b, const size_t b_size)
+  {
+    const int result = memcmp(a, b, (a_size < b_size) ? a_size : b_size);
+    if (result != 0) {
+      return result;
+    }
+    return (a_size < b_size) ? -1 : (a_size > b_size);
+  }
+
+  bool operator () (const record &a, const record &b) const
+  {
+    if (a.prefix != b.prefix) {
+      return (a.prefix < b.prefix);
+    }
+    if (!is_numeric && (a.key_size > 8 || b.key_size > 8)) {
+      const int result = compare_bytes(a.data + a.key_offset, a.key_size,
+          b.data + b.key_offset, b.key_size);
+      if (result != 0) {
+        return (result < 0);
+      }
+    }
+    return (compare_bytes(a.data, a.size, b.data, b.size) < 0);
+  }
+};
+
+// Iterates over records stored in the given memory range.
+class record_parser
+{
+private:
+
+  const key_extractor *_key_extractor;
+  size_t _record_size;
+  const char *_next;
+  const char *_last;
+  record _record;
+
+  void _parse()
+  {
+    assert(_next != _last);
+
+    size_t size;
+    size_t skip;
+    if (_record_size != 0) {
+      size = _record_size;
+      skip = size;
+    }
+    else {
+      const char *const end = static_cast<const char *>(memchr(_next, '\n',
+          _last - _next));
+      size = (end == nullptr) ? _last - _next : end - _next;
+      skip = (end == nullptr) ? size : size + 1;
+    }
+    _record = _key_extractor->get_record(_next, size);
+    _next += skip;
+  }
+
+public:
+
+  record_parser() : _key_extractor(nullptr), _record_size(0), _next(nullptr),
+      _last(nullptr) {}
+
+  record_parser(const key_extractor &key_extractor, const size_t record_size,
+      const char *const first, const char *const last) :
+      _key_extractor(&key_extractor), _record_size(record_size),
+      _next(first), _last(last)
+  {
+    if (_next != _last) {
+      _parse();
+    }
+    else {
+      _key_extractor = nullptr;
+    }
+  }
+
+  // Returns false if there are no records.
+  bool is_valid() const
+  {
+    return (_key_extractor != nullptr);
+  }
+
+  const record &get() const
+  {
+    return _record;
+  }
+
+  // Returns the number of bytes following the current record.
+  size_t get_remaining_size() const
+  {
+    return _last - _next;
+  }
+
+  // Returns false after the last record.
+  bool next()
+  {
+    if (_next == _last) {
+      _key_extractor = nullptr;
+      return false;
+    }
+    _parse();
+    return true;
+  }
+};
+
+// Input iterator over records of a sorted run for nway_merge().
+// The end iterator doesn't refer to any record.
+class run_iterator
+{
+public:
+
+  typedef std::input_iterator_tag iterator_category;
+  typedef record value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const record *pointer;
+  typedef const record &reference;
+
+private:
+
+  record_parser _parser;
+
+public:
+
+  run_iterator() {}
+
+  explicit run_iterator(const record_parser &parser) : _parser(parser) {}
+
+  reference operator * () const
+  {
+    return _parser.get();
+  }
+
+  run_iterator &operator ++ ()
+  {
+    _parser.next();
+    return *this;
+  }
+
+  bool operator == (const run_iterator &it) const
+  {
+    if (!_parser.is_valid() || !it._parser.is_valid()) {
+      return (_parser.is_valid() == it._parser.is_valid());
+    }
+    return (_parser.get().data == it._parser.get().data);
+  }
+
+  bool operator != (const run_iterator &it) const
+  {
+    return !(*this == it);
+  }
+};
+
+// Buffered writer for records.
+class record_writer
+{
+private:
+
+  FILE *_file;
+  bool _is_text;
+
+public:
+
+  record_writer(FILE *const file, const bool is_text) :
+      _file(file), _is_text(is_text) {}
+
+  void write(const record &r)
+  {
+    if (fwrite(r.data, 1, r.size, _file) != r.size ||
+        (_is_text && fputc('\n', _file) == EOF)) {
+      die_errno("cannot write");
+    }
+  }
+
+  void write(const vector<record> &records)
+  {
+    for (const record &r : records) {
+      write(r);
+    }
+  }
+};
+
+// Output iterator writing records for nway_merge().
+class record_output_iterator
+{
+public:
+
+  typedef std::output_iterator_tag iterator_category;
+  typedef void value_type;
+  typedef void difference_type;
+  typedef void pointer;
+  typedef void reference;
+
+private:
+
+  record_writer *_writer;
+
+public:
+
+  explicit record_output_iterator(record_writer &writer) : _writer(&writer) {}
+
+  record_output_iterator &operator * ()
+  {
+    return *this;
+  }
+
+  record_output_iterator &operator = (const record &r)
+  {
+    _writer->write(r);
+    return *this;
+  }
+
+  record_output_iterator &operator ++ ()
+  {
+    return *this;
+  }
+
+  record_output_iterator operator ++ (int)
+  {
+    return *this;
+  }
+};
+
+FILE *open_tmp_file(const string &tmp_dir)
+{
+  string path = tmp_dir + "/gsort_XXXXXX";
+  const int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    die_errno("cannot create temporary file");
+  }
+  unlink(path.c_str());
+  FILE *const file = fdopen(fd, "w+");
+  if (file == nullptr) {
+    die_errno("cannot open temporary file");
+  }
+  return file;
+}
+
+// Returns the descriptor of a regular file with the contents of the given
+// input, so the input can be mapped. Non-regular inputs such as pipes
+// are copied into a temporary file, which is returned via tmp_file.
+int get_regular_input(const options &options, const int fd,
+    FILE **const tmp_file)
+{
+  *tmp_file = nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    die_errno("cannot stat input");
+  }
+  if (S_ISREG(st.st_mode)) {
+    return fd;
+  }
+
+  FILE *const file = open_tmp_file(options.tmp_dir);
+  static char buffer[1 << 16];
+  while (true) {
+    const ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      die_errno("cannot read input");
+    }
+    if (n == 0) {
+      break;
+    }
+    if (fwrite(buffer, 1, n, file) != static_cast<size_t>(n)) {
+      die_errno("cannot write temporary file");
+    }
+  }
+  if (fflush(file) != 0) {
+    die_errno("cannot write temporary file");
+  }
+  *tmp_file = file;
+  return fileno(file);
+}
+
+// Parses records from the input in chunks fitting the memory budget.
+// Calls chunk_handler for each chunk. Returns the number of chunks.
+template <class ChunkHandler>
+size_t for_each_chunk(const options &options, const key_extractor &extractor,
+    const mapped_file &input, vector<record> &records,
+    const ChunkHandler &chunk_handler)
+{
+  // Each record is referenced in memory while its chunk is being sorted.
+  // Merging requires a temporary copy of references.
+  const size_t bytes_per_record = 2 * sizeof(record);
+
+  record_parser parser(extractor, options.record_size, input.data(),
+      input.data() + input.size());
+  size_t chunks_count = 0;
+  while (parser.is_valid()) {
+    const size_t chunk_start = input.size() - parser.get_remaining_size();
+    records.clear();
+    do {
+      records.push_back(parser.get());
+      parser.next();
+    } while (parser.is_valid() &&
+        (input.size() - parser.get_remaining_size() - chunk_start) +
+            records.size() * bytes_per_record < options.memory_budget);
+
+    chunk_handler(records, !parser.is_valid());
+    ++chunks_count;
+  }
+  return chunks_count;
+}
+
+void sort_file(const options &options, const int input_fd, FILE *const output)
+{
+  const mapped_file input(input_fd);
+  const key_extractor extractor(options);
+  const record_less_comparer less_comparer = {options.is_numeric};
+  const bool is_text = (options.record_size == 0);
+  gthread_pool pool(options.threads_count == 0 ?
+      std::thread::hardware_concurrency() : options.threads_count);
+  record_writer output_writer(output, is_text);
+  vector<record> records;
+
+  if (options.record_size != 0 && input.size() % options.record_size != 0) {
+    die("input size isn't multiple of record size");
+  }
+
+  // Top-k mode keeps the k smallest records seen so far.
+  if (options.top_k != 0) {
+    vector<record> top;
+    for_each_chunk(options, extractor, input, records,
+        [&](const vector<record> &chunk, bool) {
+      top.insert(top.end(), chunk.begin(), chunk.end());
+      const size_t k = (options.top_k < top.size()) ?
+          options.top_k : top.size();
+      algorithm::parallel_partial_sort(pool, top.begin(), top.begin() + k,
+          top.end(), less_comparer);
+      top.resize(k);
+    });
+    output_writer.write(top);
+    return;
+  }
+
+  // Sort chunks and spill them to runs unless the whole input fits
+  // the memory budget.
+  vector<FILE *> runs;
+  for_each_chunk(options, extractor, input, records,
+      [&](vector<record> &chunk, const bool is_last) {
+    algorithm::parallel_nway_mergesort(pool, chunk.begin(), chunk.end(),
+        less_comparer);
+    if (is_last && runs.empty()) {
+      output_writer.write(chunk);
+      return;
+    }
+    FILE *const run = open_tmp_file(options.tmp_dir);
+    record_writer run_writer(run, is_text);
+    run_writer.write(chunk);
+    if (fflush(run) != 0) {
+      die_errno("cannot write run");
+    }
+    runs.push_back(run);
+  });
+  if (runs.empty()) {
+    return;
+  }
+
+  // Merge runs into the output.
+  vector<unique_ptr<mapped_file> > mapped_runs;
+  typedef pair<run_iterator, run_iterator> input_range;
+  vector<input_range> input_ranges;
+  for (FILE *const run : runs) {
+    mapped_runs.push_back(unique_ptr<mapped_file>(
+        new mapped_file(fileno(run))));
+    const mapped_file &mapped_run = *mapped_runs.back();
+    const record_parser parser(extractor, options.record_size,
+        mapped_run.data(), mapped_run.data() + mapped_run.size());
+    if (parser.is_valid()) {
+      input_ranges.push_back(input_range(run_iterator(parser),
+          run_iterator()));
+    }
+  }
+  algorithm::nway_merge(input_ranges.begin(), input_ranges.end(),
+      record_output_iterator(output_writer), less_comparer);
+
+  mapped_runs.clear();
+  for (FILE *const run : runs) {
+    fclose(run);
+  }
+}
+
+size_t parse_size(const char *const s)
+{
+  char *end;
+  errno = 0;
+  size_t size = strtoull(s, &end, 10);
+  if (errno != 0 || end == s) {
+    die("invalid number");
+  }
+  switch (*end) {
+    case 'K': size <<= 10; ++end; break;
+    case 'M': size <<= 20; ++end; break;
+    case 'G': size <<= 30; ++end; break;
+  }
+  if (*end != '\0') {
+    die("invalid number");
+  }
+  return size;
+}
+
+void print_usage()
+{
+  fprintf(stderr,
+      "Usage: gsort [options] [input [output]]\n"
+      "Sorts newline-delimited text or fixed-width binary records.\n"
+      "Reads stdin and writes stdout by default. Non-regular input such as\n"
+      "a pipe is copied to a temporary file in DIR first.\n"
+      "\n"
+      "  -r SIZE    sort binary records of SIZE bytes\n"
+      "  -k FIELD   use 1-based FIELD of text records as the key\n"
+      "  -t CHAR    use CHAR as field separator instead of runs of blanks\n"
+      "  -o OFFSET  the key starts at OFFSET bytes of the record or the field\n"
+      "  -w WIDTH   the key is WIDTH bytes wide\n"
+      "  -n         compare keys as numbers: decimal integers in text records\n"
+      "             or unsigned little-endian integers in binary records.\n"
+      "             Decimal integers out of 64-bit range are saturated.\n"
+      "  -T K       output only K smallest records\n"
+      "  -m SIZE    memory budget with optional K, M or G suffix\n"
+      "             (default 256M)\n"
+      "  -j N       use N threads (default: hardware concurrency)\n"
+      "  -d DIR     directory for temporary runs (default /tmp)\n");
+}
+
+}  // end of anonymous namespace.
+
+
+int main(int argc, char **argv)
+{
+  options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:k:t:o:w:nT:m:j:d:h")) != -1) {
+    switch (opt) {
+      case 'r': options.record_size = parse_size(optarg); break;
+      case 'k': options.key_field = parse_size(optarg); break;
+      case 't':
+        if (optarg[0] == '\0' || optarg[1] != '\0') {
+          die("field separator must be a single character");
+        }
+        options.field_separator = static_cast<unsigned char>(optarg[0]);
+        break;
+      case 'o': options.key_offset = parse_size(optarg); break;
+      case 'w': options.key_width = parse_size(optarg); break;
+      case 'n': options.is_numeric = true; break;
+      case 'T': options.top_k = parse_size(optarg); break;
+      case 'm': options.memory_budget = parse_size(optarg); break;
+      case 'j': options.threads_count = parse_size(optarg); break;
+      case 'd': options.tmp_dir = optarg; break;
+      default:
+        print_usage();
+        return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (options.record_size != 0 && options.key_field != 0) {
+    die("-k applies only to text records");
+  }
+  if (options.record_size != 0 && options.is_numeric &&
+      (options.key_width == 0 || options.key_width > 8)) {
+    die("numeric keys in binary records require -w from 1 to 8");
+  }
+  if (options.record_size != 0 &&
+      options.key_offset + options.key_width > options.record_size) {
+    die("the key doesn't fit the record");
+  }
+  if (optind + 2 < argc) {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+
+  int input_fd = STDIN_FILENO;
+  if (optind < argc) {
+    input_fd = open(argv[optind], O_RDONLY);
+    if (input_fd < 0) {
+      die_errno(argv[optind]);
+    }
+  }
+  FILE *output = stdout;
+  if (optind + 1 < argc) {
+    output = fopen(argv[optind + 1], "w");
+    if (output == nullptr) {
+      die_errno(argv[optind + 1]);
+    }
+  }
+  static char output_buffer[1 << 20];
+  setvbuf(output, output_buffer, _IOFBF, sizeof(output_buffer));
+
+  FILE *tmp_input;
+  sort_file(options, get_regular_input(options, input_fd, &tmp_input),
+      output);
+
+  if (fflush(output) != 0) {
+    die_errno("cannot write");
+  }
+  if (output != stdout) {
+    fclose(output);
+  }
+  if (tmp_input != nullptr) {
+    fclose(tmp_input);
+  }
+  if (input_fd != STDIN_FILENO) {
+    close(input_fd);
+  }
+  return EXIT_SUCCESS;
+}
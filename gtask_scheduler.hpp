@@ -0,0 +1,370 @@
+#ifndef GTASK_SCHEDULER_H
+#define GTASK_SCHEDULER_H
+
+// Priority-aware work-stealing task scheduler on top of Heap.
+//
+// Each worker thread owns a local priority queue of tasks built on Heap.
+// Tasks submitted by worker threads (i.e. tasks spawned by other tasks)
+// go to the local queue of the submitting worker, so they are likely
+// executed on the same CPU core. Tasks submitted by other threads go
+// to the global injector queue.
+//
+// Workers execute tasks from their local queues in priority order.
+// After executing inversion_tolerance local tasks in a row, a worker looks
+// for tasks with higher priorities in the injector queue and in other
+// workers' queues. If another worker holds a task with higher priority,
+// the top half of its queue is stolen. Idle workers steal the same way.
+//
+// So inversion_tolerance trades priority accuracy for locality:
+// - inversion_tolerance=0 makes workers choose the highest priority task
+//   among all the queues before each execution.
+// - Big inversion_tolerance makes workers execute local tasks
+//   until local queues drain.
+//
+// Tasks must not throw exceptions. Priority must be default constructible.
+//
+// The implementation requires C++11, so pass -DGHEAP_CPP11 to compiler.
+//
+// Don't forget passing -DNDEBUG option to the compiler when creating optimized
+// builds. This significantly speeds up the code by removing debug assertions.
+
+#ifndef GHEAP_CPP11
+#  error "gtask_scheduler.hpp requires C++11. Pass -DGHEAP_CPP11 to compiler"
+#endif
+
+#include "gheap.hpp"
+
+#include <atomic>              // for std::atomic
+#include <cassert>             // for assert
+#include <condition_variable>  // for std::condition_variable
+#include <cstddef>             // for size_t
+#include <functional>          // for std::function, std::less
+#include <memory>              // for std::unique_ptr
+#include <mutex>               // for std::mutex, std::lock_guard
+#include <thread>              // for std::thread
+#include <utility>             // for std::move()
+#include <vector>              // for std::vector
+
+template <class Heap = gheap<>, class Priority = int,
+    class LessComparer = std::less<Priority> >
+class gtask_scheduler
+{
+public:
+
+  typedef Priority priority_type;
+  typedef std::function<void ()> task_func;
+
+private:
+
+  struct _task
+  {
+    Priority priority = Priority();
+    task_func func;
+  };
+
+  class _task_less_comparer
+  {
+  private:
+    const LessComparer &_less_comparer;
+
+  public:
+    _task_less_comparer(const LessComparer &less_comparer) :
+        _less_comparer(less_comparer) {}
+
+    bool operator() (const _task &a, const _task &b) const
+    {
+      return _less_comparer(a.priority, b.priority);
+    }
+  };
+
+  struct _task_queue
+  {
+    std::mutex mutex;
+
+    // Max heap of tasks.
+    std::vector<_task> heap;
+  };
+
+  // The scheduler and the worker index of the current thread.
+  struct _thread_ctx
+  {
+    const gtask_scheduler *scheduler;
+    size_t worker_index;
+  };
+
+  const LessComparer _less_comparer;
+  const size_t _inversion_tolerance;
+
+  // Local queues for worker threads. The last queue is the injector queue.
+  std::vector<std::unique_ptr<_task_queue> > _queues;
+  std::vector<std::thread> _threads;
+
+  // The number of tasks in all the queues. It is incremented under _mutex,
+  // so sleeping workers don't miss wakeups.
+  std::atomic<size_t> _queued_tasks;
+
+  // The number of submitted tasks, which aren't finished yet.
+  std::atomic<size_t> _pending_tasks;
+
+  std::mutex _mutex;
+  std::condition_variable _worker_cond;
+  std::condition_variable _wait_cond;
+  bool _is_stopped;
+
+  static _thread_ctx &_get_thread_ctx()
+  {
+    static thread_local _thread_ctx ctx = {0, 0};
+    return ctx;
+  }
+
+  size_t _get_injector_index() const
+  {
+    return _queues.size() - 1;
+  }
+
+  // Returns the index of the queue for tasks submitted by the current thread.
+  size_t _get_queue_index() const
+  {
+    const _thread_ctx &ctx = _get_thread_ctx();
+    return (ctx.scheduler == this) ? ctx.worker_index : _get_injector_index();
+  }
+
+  void _push_task(_task_queue &q, _task &&t)
+  {
+    q.heap.push_back(std::move(t));
+    Heap::push_heap(q.heap.begin(), q.heap.end(),
+        _task_less_comparer(_less_comparer));
+  }
+
+  void _pop_task(_task_queue &q, _task &t)
+  {
+    assert(!q.heap.empty());
+
+    Heap::pop_heap(q.heap.begin(), q.heap.end(),
+        _task_less_comparer(_less_comparer));
+    t = std::move(q.heap.back());
+    q.heap.pop_back();
+    --_queued_tasks;
+  }
+
+  // Copies the top priority of the given queue into priority.
+  // Returns false if the queue is empty.
+  bool _peek_priority(_task_queue &q, Priority &priority)
+  {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.heap.empty()) {
+      return false;
+    }
+    priority = q.heap.front().priority;
+    return true;
+  }
+
+  // Moves the top half of tasks from the victim queue to the local queue
+  // of the given worker.
+  void _steal_tasks(const size_t worker_index, _task_queue &victim)
+  {
+    std::vector<_task> stolen;
+    {
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      const size_t n = (victim.heap.size() + 1) / 2;
+      stolen.reserve(n);
+      for (size_t i = 0; i < n; ++i) {
+        Heap::pop_heap(victim.heap.begin(), victim.heap.end(),
+            _task_less_comparer(_less_comparer));
+        stolen.push_back(std::move(victim.heap.back()));
+        victim.heap.pop_back();
+      }
+    }
+
+    _task_queue &q = *_queues[worker_index];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.heap.empty()) {
+      // Tasks are stolen in descending order of priorities, so they
+      // already form a valid max heap.
+      q.heap.swap(stolen);
+      return;
+    }
+    for (size_t i = 0; i < stolen.size(); ++i) {
+      _push_task(q, std::move(stolen[i]));
+    }
+  }
+
+  // Obtains the task with the highest priority among all the queues
+  // for the given worker. Returns false if there are no tasks.
+  bool _find_task(const size_t worker_index, _task &t)
+  {
+    _task_queue &q = *_queues[worker_index];
+    Priority best_priority = Priority();
+    bool has_best = _peek_priority(q, best_priority);
+    size_t best_index = worker_index;
+    Priority priority = Priority();
+    for (size_t i = 0; i < _queues.size(); ++i) {
+      if (i == worker_index || !_peek_priority(*_queues[i], priority)) {
+        continue;
+      }
+      if (!has_best || _less_comparer(best_priority, priority)) {
+        has_best = true;
+        best_index = i;
+        best_priority = priority;
+      }
+    }
+    if (!has_best) {
+      return false;
+    }
+
+    if (best_index == _get_injector_index()) {
+      // Take a single task from the injector queue, since it is shared
+      // among all the workers.
+      _task_queue &injector = *_queues[best_index];
+      std::lock_guard<std::mutex> lock(injector.mutex);
+      if (!injector.heap.empty()) {
+        _pop_task(injector, t);
+        return true;
+      }
+    }
+    else if (best_index != worker_index) {
+      _steal_tasks(worker_index, *_queues[best_index]);
+    }
+
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.heap.empty()) {
+      // Other workers took the task in the meantime.
+      return false;
+    }
+    _pop_task(q, t);
+    return true;
+  }
+
+  void _finish_task()
+  {
+    if (--_pending_tasks == 0) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _wait_cond.notify_all();
+    }
+  }
+
+  void _worker_loop(const size_t worker_index)
+  {
+    _thread_ctx &ctx = _get_thread_ctx();
+    ctx.scheduler = this;
+    ctx.worker_index = worker_index;
+
+    _task_queue &q = *_queues[worker_index];
+    size_t local_tasks_count = 0;
+    _task t;
+    while (true) {
+      bool has_task = false;
+      if (local_tasks_count < _inversion_tolerance) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.heap.empty()) {
+          _pop_task(q, t);
+          has_task = true;
+          ++local_tasks_count;
+        }
+      }
+      if (!has_task) {
+        local_tasks_count = 0;
+        has_task = _find_task(worker_index, t);
+      }
+      if (has_task) {
+        t.func();
+        t.func = task_func();
+        _finish_task();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (_queued_tasks == 0 && !_is_stopped) {
+        _worker_cond.wait(lock);
+      }
+      if (_queued_tasks == 0 && _is_stopped) {
+        break;
+      }
+    }
+  }
+
+public:
+
+  // Creates a scheduler with the given number of worker threads.
+  explicit gtask_scheduler(
+      const size_t threads_count = std::thread::hardware_concurrency(),
+      const size_t inversion_tolerance = 16,
+      const LessComparer &less_comparer = LessComparer()) :
+          _less_comparer(less_comparer),
+          _inversion_tolerance(inversion_tolerance),
+          _queued_tasks(0), _pending_tasks(0), _is_stopped(false)
+  {
+    const size_t workers_count = (threads_count == 0) ? 1 : threads_count;
+    for (size_t i = 0; i <= workers_count; ++i) {
+      _queues.push_back(std::unique_ptr<_task_queue>(new _task_queue()));
+    }
+    for (size_t i = 0; i < workers_count; ++i) {
+      _threads.push_back(std::thread(&gtask_scheduler::_worker_loop, this, i));
+    }
+  }
+
+  // Waits for all the submitted tasks and stops worker threads.
+  ~gtask_scheduler()
+  {
+    wait();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _is_stopped = true;
+    }
+    _worker_cond.notify_all();
+    for (size_t i = 0; i < _threads.size(); ++i) {
+      _threads[i].join();
+    }
+  }
+
+  gtask_scheduler(const gtask_scheduler &) = delete;
+  gtask_scheduler &operator = (const gtask_scheduler &) = delete;
+
+  size_t threads_count() const
+  {
+    return _threads.size();
+  }
+
+  size_t inversion_tolerance() const
+  {
+    return _inversion_tolerance;
+  }
+
+  // Submits the task with the given priority. Tasks with higher priorities
+  // are executed first.
+  //
+  // May be called from any thread including tasks.
+  void submit(const Priority &priority, task_func func)
+  {
+    _task t;
+    t.priority = priority;
+    t.func = std::move(func);
+    ++_pending_tasks;
+
+    _task_queue &q = *_queues[_get_queue_index()];
+    {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      _push_task(q, std::move(t));
+    }
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_queued_tasks;
+    }
+    _worker_cond.notify_one();
+  }
+
+  // Blocks until all the submitted tasks, including tasks submitted
+  // by other tasks, are finished.
+  //
+  // Must be called from threads outside the scheduler.
+  void wait()
+  {
+    assert(_get_thread_ctx().scheduler != this);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_pending_tasks != 0) {
+      _wait_cond.wait(lock);
+    }
+  }
+};
+#endif
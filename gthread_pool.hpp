@@ -0,0 +1,327 @@
+#ifndef GTHREAD_POOL_H
+#define GTHREAD_POOL_H
+
+// Executors for parallel algorithms from galgorithm.hpp.
+//
+// An executor is any class with the following methods:
+// - size_t concurrency() - returns the number of threads the executor
+//   may use for running parallel_for().
+// - void parallel_for(size_t n, const Func &func) - calls func(i)
+//   for each i in the range [0 ... n) and returns after all the calls
+//   are finished. Calls may run concurrently.
+//
+// The following executors are provided:
+// - gsequential_executor - runs all the calls in the current thread.
+// - gthread_pool - runs calls on a fixed set of threads with work stealing.
+//   Threads are started once in the constructor, so parallel algorithms
+//   don't create threads per call. Threads waiting for nested parallel_for()
+//   calls execute pending tasks and block only if there are no pending tasks,
+//   so nested parallel calls don't oversubscribe cores.
+//
+// The implementation requires C++11, so pass -DGHEAP_CPP11 to compiler.
+
+#ifndef GHEAP_CPP11
+#  error "gthread_pool.hpp requires C++11. Pass -DGHEAP_CPP11 to compiler"
+#endif
+
+#include <atomic>              // for std::atomic
+#include <cassert>             // for assert
+#include <condition_variable>  // for std::condition_variable
+#include <cstddef>             // for size_t
+#include <deque>               // for std::deque
+#include <exception>           // for std::exception_ptr
+#include <functional>          // for std::function
+#include <memory>              // for std::unique_ptr
+#include <mutex>               // for std::mutex, std::lock_guard
+#include <thread>              // for std::thread
+#include <utility>             // for std::move()
+#include <vector>              // for std::vector
+
+// Executor, which runs all the calls in the current thread.
+class gsequential_executor
+{
+public:
+
+  size_t concurrency() const
+  {
+    return 1;
+  }
+
+  template <class Func>
+  void parallel_for(const size_t n, const Func &func)
+  {
+    for (size_t i = 0; i < n; ++i) {
+      func(i);
+    }
+  }
+};
+
+// Work-stealing thread pool.
+//
+// Each worker thread owns a task queue. Workers push nested tasks to
+// the back of their own queues and pop them from the back, while idle workers
+// steal tasks from the front of other workers' queues. Tasks submitted
+// by threads outside the pool go to a shared injector queue.
+class gthread_pool
+{
+private:
+
+  typedef std::function<void ()> _task;
+
+  struct _task_queue
+  {
+    std::mutex mutex;
+    std::deque<_task> tasks;
+  };
+
+  // The pool and the queue index of the current thread.
+  struct _thread_ctx
+  {
+    gthread_pool *pool;
+    size_t queue_index;
+  };
+
+  // State of a single parallel_for() call shared among its tasks.
+  template <class Func>
+  struct _loop_ctx
+  {
+    const Func *func;
+    size_t n;
+    std::atomic<size_t> next_index;
+    std::atomic<size_t> pending_tasks;
+    std::mutex exception_mutex;
+    std::exception_ptr exception;
+  };
+
+  size_t _threads_count;
+
+  // Task queues for worker threads. The last queue is the injector queue
+  // for threads outside the pool.
+  std::vector<std::unique_ptr<_task_queue> > _queues;
+  std::vector<std::thread> _threads;
+
+  // The number of tasks in all the queues. It is incremented under _mutex,
+  // so sleeping workers don't miss wakeups. It is incremented before a task
+  // is published, so it never underflows when the task is popped.
+  std::atomic<size_t> _queued_tasks;
+  std::mutex _mutex;
+
+  // Signaled when a task is queued and when all the tasks of a parallel_for()
+  // call are finished.
+  std::condition_variable _cond;
+  bool _is_stopped;
+
+  static _thread_ctx &_get_thread_ctx()
+  {
+    static thread_local _thread_ctx ctx = {0, 0};
+    return ctx;
+  }
+
+  size_t _get_queue_index()
+  {
+    const _thread_ctx &ctx = _get_thread_ctx();
+    return (ctx.pool == this) ? ctx.queue_index : _queues.size() - 1;
+  }
+
+  void _push_task(_task &&task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_queued_tasks;
+    }
+    _task_queue &q = *_queues[_get_queue_index()];
+    {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    _cond.notify_one();
+  }
+
+  // Pops a task from the own queue or steals it from another queue.
+  // Returns false if there are no tasks.
+  bool _pop_task(_task &task)
+  {
+    if (_queued_tasks == 0) {
+      return false;
+    }
+
+    const size_t queues_count = _queues.size();
+    const size_t own_index = _get_queue_index();
+    for (size_t i = 0; i < queues_count; ++i) {
+      const size_t queue_index = (own_index + i) % queues_count;
+      _task_queue &q = *_queues[queue_index];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty()) {
+        continue;
+      }
+      if (queue_index == own_index) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+      }
+      else {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+      }
+      --_queued_tasks;
+      return true;
+    }
+    return false;
+  }
+
+  // Runs a single pending task. Returns false if there are no tasks.
+  bool _run_pending_task()
+  {
+    _task task;
+    if (!_pop_task(task)) {
+      return false;
+    }
+    task();
+    return true;
+  }
+
+  void _worker_loop(const size_t queue_index)
+  {
+    _thread_ctx &ctx = _get_thread_ctx();
+    ctx.pool = this;
+    ctx.queue_index = queue_index;
+
+    while (true) {
+      if (_run_pending_task()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (_queued_tasks == 0 && !_is_stopped) {
+        _cond.wait(lock);
+      }
+      if (_queued_tasks == 0 && _is_stopped) {
+        break;
+      }
+    }
+  }
+
+  // Calls loop function for indexes from the shared counter until
+  // the counter reaches the end of the loop.
+  template <class Func>
+  static void _run_loop(_loop_ctx<Func> &loop)
+  {
+    try {
+      while (true) {
+        const size_t i = loop.next_index++;
+        if (i >= loop.n) {
+          break;
+        }
+        (*loop.func)(i);
+      }
+    }
+    catch (...) {
+      // Skip the rest of the loop and rethrow the exception
+      // in parallel_for().
+      loop.next_index = loop.n;
+      std::lock_guard<std::mutex> lock(loop.exception_mutex);
+      if (!loop.exception) {
+        loop.exception = std::current_exception();
+      }
+    }
+  }
+
+public:
+
+  // Creates a pool, which runs parallel_for() calls on up to threads_count
+  // threads. The thread calling parallel_for() participates in the work,
+  // so the pool starts (threads_count - 1) worker threads.
+  explicit gthread_pool(
+      const size_t threads_count = std::thread::hardware_concurrency()) :
+          _threads_count((threads_count == 0) ? 1 : threads_count),
+          _queued_tasks(0), _is_stopped(false)
+  {
+    for (size_t i = 0; i < _threads_count; ++i) {
+      _queues.push_back(std::unique_ptr<_task_queue>(new _task_queue()));
+    }
+    for (size_t i = 0; i + 1 < _threads_count; ++i) {
+      _threads.push_back(std::thread(&gthread_pool::_worker_loop, this, i));
+    }
+  }
+
+  ~gthread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _is_stopped = true;
+    }
+    _cond.notify_all();
+    for (size_t i = 0; i < _threads.size(); ++i) {
+      _threads[i].join();
+    }
+  }
+
+  gthread_pool(const gthread_pool &) = delete;
+  gthread_pool &operator = (const gthread_pool &) = delete;
+
+  size_t concurrency() const
+  {
+    return _threads_count;
+  }
+
+  // Calls func(i) for each i in the range [0 ... n) on pool threads
+  // and returns after all the calls are finished.
+  //
+  // The calling thread runs pending tasks while waiting and sleeps only
+  // if there are no pending tasks, so parallel_for() may be called from
+  // inside func.
+  //
+  // Rethrows the first exception thrown by func. The remaining calls
+  // are skipped in this case.
+  template <class Func>
+  void parallel_for(const size_t n, const Func &func)
+  {
+    if (n == 0) {
+      return;
+    }
+    if (n == 1 || _threads_count == 1) {
+      for (size_t i = 0; i < n; ++i) {
+        func(i);
+      }
+      return;
+    }
+
+    _loop_ctx<Func> loop;
+    loop.func = &func;
+    loop.n = n;
+    loop.next_index = 0;
+
+    // The calling thread runs the loop too, so it needs one task less.
+    const size_t tasks_count = ((n < _threads_count) ? n : _threads_count) - 1;
+    loop.pending_tasks = tasks_count;
+    _loop_ctx<Func> *const loop_ptr = &loop;
+    for (size_t i = 0; i < tasks_count; ++i) {
+      _push_task([this, loop_ptr]() {
+        _run_loop(*loop_ptr);
+        // The waiter checks pending_tasks under _mutex, so it doesn't miss
+        // the wakeup and doesn't destroy the loop before notify_all().
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--loop_ptr->pending_tasks == 0) {
+          _cond.notify_all();
+        }
+      });
+    }
+
+    _run_loop(loop);
+
+    // Help other threads until all the tasks referring the loop
+    // are finished. Sleep while there are no tasks to help with.
+    while (loop.pending_tasks != 0) {
+      if (_run_pending_task()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (loop.pending_tasks != 0 && _queued_tasks == 0) {
+        _cond.wait(lock);
+      }
+    }
+
+    if (loop.exception) {
+      std::rethrow_exception(loop.exception);
+    }
+  }
+};
+#endif
@@ -0,0 +1,393 @@
+#ifndef GTRACE_H
+#define GTRACE_H
+
+// Compact binary traces of priority queue operations.
+//
+// Traces capture real push/pop mixes and key distributions, so they may be
+// replayed later against various queue implementations and heap
+// configurations. See trace_replay.cpp.
+//
+// gtraced_priority_queue wraps a priority queue and records its operations
+// via gtrace_writer. Records are encoded into in-memory buffer, which is
+// written to the file in large chunks, so recording overhead is small.
+// gtrace_reader reads the recorded operations back.
+//
+// Trace format:
+//
+//   header: u8 magic[8] ("GHEAPTRC"), u32 version (little-endian)
+//   record: u8 op, followed by op-specific data:
+//     push:  varint zigzag(key - previous pushed key)
+//     push with payload: the same as push, followed by varint payload size
+//     pop:   no data
+//     end:   varint records count
+//
+// Varints use 7 bits per byte starting from the least significant bits.
+// The high bit of each byte is set for all the bytes except the last one.
+// Traces without end record are treated as truncated.
+//
+// Keys are 64-bit integers. Queue items are converted to keys by KeyGetter,
+// which defaults to static_cast<uint64_t>(item).
+//
+// Pass -DGHEAP_CPP11 to compiler for enabling C++11 optimization,
+// otherwise C++03 optimization will be enabled.
+
+#include <cassert>
+#include <cstddef>     // for size_t
+#include <cstdio>      // for std::FILE, std::fwrite(), std::fread(), ...
+#include <cstring>     // for memcmp()
+#include <stdexcept>   // for std::runtime_error
+#include <stdint.h>    // for uint8_t, uint32_t, uint64_t
+#include <vector>      // for std::vector
+
+#ifdef GHEAP_CPP11
+#  include <utility>   // for std::move()
+#endif
+
+// Operation codes stored in traces.
+enum gtrace_op
+{
+  GTRACE_OP_PUSH = 0,
+  GTRACE_OP_PUSH_WITH_PAYLOAD = 1,
+  GTRACE_OP_POP = 2,
+  GTRACE_OP_END = 3
+};
+
+// A single decoded trace record.
+struct gtrace_record
+{
+  gtrace_op op;
+
+  // Valid only for push operations.
+  uint64_t key;
+
+  // Valid only for push operations. Zero if the payload size wasn't
+  // recorded.
+  uint64_t payload_size;
+};
+
+// Internal constants shared by the reader and the writer.
+struct _gtrace
+{
+  static const uint32_t version = 1;
+  static const size_t header_size = 12;
+
+  static const char *get_magic()
+  {
+    return "GHEAPTRC";
+  }
+};
+
+// Writes trace records to the given file.
+class gtrace_writer
+{
+private:
+
+  // Records are written to the file when the buffer exceeds this size.
+  static const size_t _flush_size = 64 * 1024;
+
+  std::FILE *_file;
+  std::vector<uint8_t> _buffer;
+  uint64_t _previous_key;
+  uint64_t _records_count;
+  bool _is_finished;
+
+  // Disable copying.
+  gtrace_writer(const gtrace_writer &);
+  gtrace_writer &operator = (const gtrace_writer &);
+
+  void _put_varint(uint64_t value)
+  {
+    while (value >= 0x80) {
+      _buffer.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    _buffer.push_back(static_cast<uint8_t>(value));
+  }
+
+  void _end_record()
+  {
+    ++_records_count;
+    if (_buffer.size() >= _flush_size) {
+      flush();
+    }
+  }
+
+public:
+
+  // Creates the writer, which writes to the given file starting from
+  // its current position. The file must be opened in binary mode.
+  explicit gtrace_writer(std::FILE *const file) :
+      _file(file), _previous_key(0), _records_count(0), _is_finished(false)
+  {
+    assert(file != 0);
+
+    _buffer.reserve(_flush_size + 32);
+    const char *const magic = _gtrace::get_magic();
+    _buffer.insert(_buffer.end(), magic, magic + 8);
+    for (unsigned i = 0; i < 4; ++i) {
+      _buffer.push_back(static_cast<uint8_t>(_gtrace::version >> (8 * i)));
+    }
+  }
+
+  // Records push operation. Pass non-zero payload_size for recording
+  // the size of data associated with the item.
+  void push(const uint64_t key, const uint64_t payload_size = 0)
+  {
+    assert(!_is_finished);
+
+    _buffer.push_back(static_cast<uint8_t>((payload_size == 0) ?
+        GTRACE_OP_PUSH : GTRACE_OP_PUSH_WITH_PAYLOAD));
+    // Zigzag encoding maps small negative and positive deltas
+    // to small varints.
+    const uint64_t delta = key - _previous_key;
+    _put_varint((delta << 1) ^ (0 - (delta >> 63)));
+    if (payload_size != 0) {
+      _put_varint(payload_size);
+    }
+    _previous_key = key;
+    _end_record();
+  }
+
+  void pop()
+  {
+    assert(!_is_finished);
+
+    _buffer.push_back(static_cast<uint8_t>(GTRACE_OP_POP));
+    _end_record();
+  }
+
+  // Writes buffered records to the file.
+  void flush()
+  {
+    if (!_buffer.empty() &&
+        std::fwrite(&_buffer[0], 1, _buffer.size(), _file) != _buffer.size()) {
+      throw std::runtime_error("gtrace_writer: cannot write");
+    }
+    _buffer.clear();
+  }
+
+  // Writes the end record and flushes the file.
+  void finish()
+  {
+    assert(!_is_finished);
+
+    _buffer.push_back(static_cast<uint8_t>(GTRACE_OP_END));
+    _put_varint(_records_count);
+    flush();
+    if (std::fflush(_file) != 0) {
+      throw std::runtime_error("gtrace_writer: cannot flush");
+    }
+    _is_finished = true;
+  }
+
+  uint64_t get_records_count() const
+  {
+    return _records_count;
+  }
+};
+
+// Reads trace records from the given file.
+class gtrace_reader
+{
+private:
+
+  static const size_t _read_size = 64 * 1024;
+
+  std::FILE *_file;
+  std::vector<uint8_t> _buffer;
+  size_t _position;
+  uint64_t _previous_key;
+  uint64_t _records_count;
+  bool _is_finished;
+
+  // Disable copying.
+  gtrace_reader(const gtrace_reader &);
+  gtrace_reader &operator = (const gtrace_reader &);
+
+  static void _throw_corrupted()
+  {
+    throw std::runtime_error("gtrace_reader: corrupted trace");
+  }
+
+  uint8_t _get_byte()
+  {
+    if (_position == _buffer.size()) {
+      _buffer.resize(_read_size);
+      const size_t n = std::fread(&_buffer[0], 1, _read_size, _file);
+      if (n == 0) {
+        _throw_corrupted();
+      }
+      _buffer.resize(n);
+      _position = 0;
+    }
+    return _buffer[_position++];
+  }
+
+  uint64_t _get_varint()
+  {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      const uint8_t b = _get_byte();
+      value |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        return value;
+      }
+    }
+    _throw_corrupted();
+    return 0;
+  }
+
+public:
+
+  // Creates the reader, which reads the trace from the current position
+  // of the given file. The file must be opened in binary mode.
+  //
+  // Throws std::runtime_error if the trace header is invalid.
+  explicit gtrace_reader(std::FILE *const file) :
+      _file(file), _position(0), _previous_key(0), _records_count(0),
+      _is_finished(false)
+  {
+    assert(file != 0);
+
+    uint8_t header[_gtrace::header_size];
+    for (size_t i = 0; i < _gtrace::header_size; ++i) {
+      header[i] = _get_byte();
+    }
+    uint32_t version = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+      version |= static_cast<uint32_t>(header[8 + i]) << (8 * i);
+    }
+    if (std::memcmp(header, _gtrace::get_magic(), 8) != 0 ||
+        version != _gtrace::version) {
+      _throw_corrupted();
+    }
+  }
+
+  // Reads the next record. Returns false after the end record.
+  //
+  // Throws std::runtime_error on truncated or corrupted traces.
+  bool next(gtrace_record &record)
+  {
+    if (_is_finished) {
+      return false;
+    }
+
+    const uint8_t op = _get_byte();
+    switch (op) {
+      case GTRACE_OP_PUSH:
+      case GTRACE_OP_PUSH_WITH_PAYLOAD: {
+        const uint64_t zigzag = _get_varint();
+        const uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+        record.key = _previous_key + delta;
+        record.payload_size = (op == GTRACE_OP_PUSH) ? 0 : _get_varint();
+        _previous_key = record.key;
+        break;
+      }
+      case GTRACE_OP_POP:
+        record.key = 0;
+        record.payload_size = 0;
+        break;
+      case GTRACE_OP_END:
+        if (_get_varint() != _records_count) {
+          _throw_corrupted();
+        }
+        _is_finished = true;
+        return false;
+      default:
+        _throw_corrupted();
+    }
+    record.op = static_cast<gtrace_op>(op);
+    ++_records_count;
+    return true;
+  }
+
+  uint64_t get_records_count() const
+  {
+    return _records_count;
+  }
+};
+
+// Default key getter for gtraced_priority_queue. It is suitable for integer
+// items only. Provide custom key getter for other item types.
+template <class T>
+struct gtrace_key_getter
+{
+  uint64_t operator() (const T &item) const
+  {
+    return static_cast<uint64_t>(item);
+  }
+};
+
+// Priority queue wrapper, which records push() and pop() calls
+// into the given trace writer. It exposes the interface of the wrapped
+// priority queue, i.e. gpriority_queue or std::priority_queue.
+template <class PriorityQueue,
+    class KeyGetter = gtrace_key_getter<typename PriorityQueue::value_type> >
+class gtraced_priority_queue
+{
+public:
+
+  typedef typename PriorityQueue::value_type value_type;
+  typedef typename PriorityQueue::size_type size_type;
+  typedef typename PriorityQueue::const_reference const_reference;
+
+private:
+
+  PriorityQueue _queue;
+  gtrace_writer *_writer;
+  KeyGetter _key_getter;
+
+public:
+
+  explicit gtraced_priority_queue(gtrace_writer &writer,
+      const PriorityQueue &queue = PriorityQueue(),
+      const KeyGetter &key_getter = KeyGetter()) :
+      _queue(queue), _writer(&writer), _key_getter(key_getter)
+  {
+    assert(_queue.empty());
+  }
+
+  bool empty() const
+  {
+    return _queue.empty();
+  }
+
+  size_type size() const
+  {
+    return _queue.size();
+  }
+
+  const_reference top() const
+  {
+    return _queue.top();
+  }
+
+  // Pushes the item and records its key and the given payload size.
+  void push(const value_type &v, const uint64_t payload_size = 0)
+  {
+    _writer->push(_key_getter(v), payload_size);
+    _queue.push(v);
+  }
+
+#ifdef GHEAP_CPP11
+  void push(value_type &&v, const uint64_t payload_size = 0)
+  {
+    _writer->push(_key_getter(v), payload_size);
+    _queue.push(std::move(v));
+  }
+#endif
+
+  void pop()
+  {
+    _writer->pop();
+    _queue.pop();
+  }
+
+  // Returns the wrapped queue. The queue is read-only, since operations
+  // on it bypass the trace.
+  const PriorityQueue &get_queue() const
+  {
+    return _queue;
+  }
+};
+#endif
@@ -1,11 +1,18 @@
+// gfile_run.h requires POSIX and Linux extensions.
+#define _GNU_SOURCE
+
 #include "galgorithm.h"
+#include "gfile_run.h"
 #include "gheap.h"
 #include "gpriority_queue.h"
+#include "perftests_memory.h"
 
 #include <assert.h>
+#include <fcntl.h>     // for open(), O_*
 #include <stdio.h>     // for printf()
-#include <stdlib.h>    // for rand(), srand()
-#include <time.h>      // for clock()
+#include <stdlib.h>    // for rand(), srand(), mkstemp()
+#include <time.h>      // for clock(), clock_gettime()
+#include <unistd.h>    // for write(), pread(), close(), unlink()
 
 typedef size_t T;
 
@@ -25,9 +32,39 @@ static double get_time(void)
   return (double)clock() / CLOCKS_PER_SEC;
 }
 
-static void print_performance(const double t, const size_t m)
+static double get_wall_time(void)
 {
-  printf(": %.0lf Kops/s\n", m / t / 1000);
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Resident set size at the start of the current benchmark in KB.
+static long baseline_rss = 0;
+
+// Starts collecting memory statistics for the next benchmark.
+static void reset_memory_stats(void)
+{
+  perftests_reset_peak_rss();
+  baseline_rss = perftests_get_rss();
+}
+
+// Prints performance and memory statistics of the benchmark processing
+// n items, then starts collecting memory statistics for the next benchmark.
+//
+// Memory allocated via malloc() cannot be counted without replacing libc
+// allocator, so the peak resident set size growth is reported instead.
+// Memory freed by previous benchmarks may be retained by the allocator
+// and reused without RSS growth, so the growth is a lower bound.
+static void print_performance(const double t, const size_t m, const size_t n)
+{
+  const long peak_rss = perftests_get_peak_rss();
+  const long rss_growth = (peak_rss > baseline_rss) ? peak_rss - baseline_rss :
+      0;
+  printf(": %.0lf Kops/s, peak_rss=%ld KB, peak_rss_growth=%ld KB "
+      "(%.2lf bytes/item)\n", m / t / 1000, peak_rss, rss_growth,
+      rss_growth * 1024.0 / n);
+  reset_memory_stats();
 }
 
 static void init_array(T *const a, const size_t n)
@@ -54,7 +91,7 @@ static void perftest_heapsort(const struct gheap_ctx *const ctx,
     total_time += end - start;
   }
 
-  print_performance(total_time, m);
+  print_performance(total_time, m, n);
 }
 
 static void perftest_partial_sort(const struct gheap_ctx *const ctx,
@@ -76,7 +113,7 @@ static void perftest_partial_sort(const struct gheap_ctx *const ctx,
     total_time += end - start;
   }
 
-  print_performance(total_time, m);
+  print_performance(total_time, m, n);
 }
 
 static void small_range_sorter(const void *const ctx, void *const a,
@@ -113,7 +150,7 @@ static void perftest_nway_mergesort(const struct gheap_ctx *const ctx,
     total_time += end - start;
   }
 
-  print_performance(total_time, m);
+  print_performance(total_time, m, n);
 }
 
 static void delete_item(void *item)
@@ -139,9 +176,225 @@ static void perftest_priority_queue(const struct gheap_ctx *const ctx,
   }
   double end = get_time();
 
+  const struct gpriority_queue_memory_usage usage =
+      gpriority_queue_memory_usage(q);
   gpriority_queue_delete(q);
 
-  print_performance(end - start, m);
+  print_performance(end - start, m, n);
+  printf("  memory_usage: capacity=%zu, allocated=%zu bytes "
+      "(%.2lf bytes/item), overhead=%zu bytes\n", usage.capacity,
+      usage.allocated_bytes, (double)usage.allocated_bytes / n,
+      usage.overhead_bytes);
+}
+
+// Input for the baseline merge, which reads the next block of a run
+// synchronously via pread() when the current block drains.
+struct sync_run_ctx
+{
+  int fd;
+  off_t offset;
+  T *block;
+  size_t block_items;
+  size_t items_count;
+  size_t position;
+};
+
+static int sync_run_refill(struct sync_run_ctx *const c)
+{
+  const ssize_t n = pread(c->fd, c->block, c->block_items * sizeof(T),
+      c->offset);
+  if (n <= 0) {
+    return 0;
+  }
+  c->offset += n;
+  c->items_count = n / sizeof(T);
+  c->position = 0;
+  return 1;
+}
+
+static int sync_run_next(void *const ctx)
+{
+  struct sync_run_ctx *const c = *(struct sync_run_ctx **)ctx;
+  ++c->position;
+  if (c->position < c->items_count) {
+    return 1;
+  }
+  if (c->items_count < c->block_items) {
+    return 0;
+  }
+  return sync_run_refill(c);
+}
+
+static const void *sync_run_get(const void *const ctx)
+{
+  const struct sync_run_ctx *const c = *(struct sync_run_ctx *const *)ctx;
+  return &c->block[c->position];
+}
+
+static void sync_run_ctx_mover(void *const dst, const void *const src)
+{
+  *(struct sync_run_ctx **)dst = *(struct sync_run_ctx *const *)src;
+}
+
+static const struct galgorithm_nway_merge_input_vtable sync_run_vtable = {
+  .next = &sync_run_next,
+  .get = &sync_run_get,
+};
+
+struct sum_output_ctx
+{
+  T sum;
+};
+
+static void sum_output_put(void *const ctx, const void *const data)
+{
+  ((struct sum_output_ctx *)ctx)->sum += *(const T *)data;
+}
+
+static const struct galgorithm_nway_merge_output_vtable sum_output_vtable = {
+  .put = &sum_output_put,
+};
+
+// Merges sorted runs stored in files opened with O_DIRECT, so reads
+// bypass page cache. Compares synchronous pread() refills with background
+// read-ahead via io_uring and via pread() threads.
+//
+// Results are labeled by the backend, which actually performed reads,
+// since gfile_runs falls back to pread() threads if io_uring is unavailable.
+// Modes, which cannot run, are reported as skipped.
+static void perftest_file_runs(const struct gheap_ctx *const ctx,
+    T *const a, const size_t n, const size_t runs_count)
+{
+  static const size_t block_size = 256 * 1024;
+  static const char *const modes[] = {"sync_pread", "io_uring",
+      "pread_threads"};
+  static const int flags[] = {0, 0, GFILE_RUNS_NO_IO_URING};
+
+  const size_t run_size = n / runs_count;
+  char paths[runs_count][32];
+  int fds[runs_count];
+
+  init_array(a, n);
+  for (size_t i = 0; i < runs_count; ++i) {
+    galgorithm_heapsort(ctx, a + i * run_size, run_size);
+    snprintf(paths[i], sizeof(paths[i]), "/tmp/gheap_perftests_XXXXXX");
+    const int fd = mkstemp(paths[i]);
+    const ssize_t size = run_size * sizeof(T);
+    if (fd < 0 || write(fd, a + i * run_size, size) != size) {
+      printf("perftest_file_runs: cannot write runs\n");
+      exit(EXIT_FAILURE);
+    }
+    fsync(fd);
+    close(fd);
+  }
+
+  for (size_t mode = 0; mode < 3; ++mode) {
+    size_t fds_count = 0;
+    while (fds_count < runs_count) {
+      fds[fds_count] = open(paths[fds_count], O_RDONLY | O_DIRECT);
+      if (fds[fds_count] < 0) {
+        break;
+      }
+      ++fds_count;
+    }
+    if (fds_count < runs_count) {
+      printf("perftest_file_runs(n=%zu, runs_count=%zu, mode=%s): "
+          "skipped, O_DIRECT isn't supported\n", n, runs_count, modes[mode]);
+      for (size_t i = 0; i < fds_count; ++i) {
+        close(fds[i]);
+      }
+      continue;
+    }
+
+    struct sum_output_ctx out_ctx = { .sum = 0 };
+    const struct galgorithm_nway_merge_output output = {
+      .vtable = &sum_output_vtable,
+      .ctx = &out_ctx,
+    };
+    struct galgorithm_nway_merge_input input;
+    const char *backend = modes[mode];
+
+    const double start = get_wall_time();
+    if (mode == 0) {
+      struct sync_run_ctx run_ctxs[runs_count];
+      struct sync_run_ctx *run_ptrs[runs_count];
+      for (size_t i = 0; i < runs_count; ++i) {
+        void *block;
+        if (posix_memalign(&block, GFILE_RUN_BUFFER_ALIGNMENT,
+            block_size) != 0) {
+          exit(EXIT_FAILURE);
+        }
+        run_ctxs[i].fd = fds[i];
+        run_ctxs[i].offset = 0;
+        run_ctxs[i].block = block;
+        run_ctxs[i].block_items = block_size / sizeof(T);
+        sync_run_refill(&run_ctxs[i]);
+        run_ptrs[i] = &run_ctxs[i];
+      }
+      input.vtable = &sync_run_vtable;
+      input.ctxs = run_ptrs;
+      input.ctxs_count = runs_count;
+      input.ctx_size = sizeof(run_ptrs[0]);
+      input.ctx_mover = &sync_run_ctx_mover;
+      galgorithm_nway_merge(ctx, &input, &output);
+      for (size_t i = 0; i < runs_count; ++i) {
+        free(run_ctxs[i].block);
+      }
+    }
+    else {
+      struct gfile_runs *const runs = gfile_runs_create(fds, runs_count,
+          sizeof(T), block_size, 4, flags[mode]);
+      if (runs == NULL) {
+        exit(EXIT_FAILURE);
+      }
+      if (mode == 1 && !gfile_runs_is_io_uring(runs)) {
+        backend = "pread_threads (io_uring fallback)";
+      }
+      gfile_runs_init_nway_merge_input(runs, &input);
+      galgorithm_nway_merge(ctx, &input, &output);
+      gfile_runs_delete(runs);
+    }
+    const double end = get_wall_time();
+
+    printf("perftest_file_runs(n=%zu, runs_count=%zu, mode=%s, sum=%zu)",
+        n, runs_count, backend, out_ctx.sum);
+    print_performance(end - start, n, n);
+
+    for (size_t i = 0; i < runs_count; ++i) {
+      close(fds[i]);
+    }
+  }
+
+  for (size_t i = 0; i < runs_count; ++i) {
+    unlink(paths[i]);
+  }
+}
+
+static int qsort_comparer(const void *const a, const void *const b)
+{
+  const T x = *((const T *)a);
+  const T y = *((const T *)b);
+  return (x > y) - (x < y);
+}
+
+// libc qsort() baseline for perftest_heapsort().
+static void perftest_qsort(T *const a, const size_t n, const size_t m)
+{
+  printf("perftest_qsort(n=%zu, m=%zu)", n, m);
+
+  double total_time = 0;
+
+  for (size_t i = 0; i < m / n; ++i) {
+    init_array(a, n);
+
+    const double start = get_time();
+    qsort(a, n, sizeof(a[0]), &qsort_comparer);
+    const double end = get_time();
+
+    total_time += end - start;
+  }
+
+  print_performance(total_time, m, n);
 }
 
 static void perftest(const struct gheap_ctx *const ctx, T *const a,
@@ -167,6 +420,174 @@ static const struct gheap_ctx ctx_v = {
   .item_mover = &move,
 };
 
+// Returns ctx with the given fanout and page_chunks constructed at runtime,
+// like ctx filled in by a plugin. Its fields are read via volatile variables,
+// so the compiler cannot fold them into heap code.
+static struct gheap_ctx create_runtime_ctx(const size_t fanout,
+    const size_t page_chunks)
+{
+  static volatile size_t fanout_v;
+  static volatile size_t page_chunks_v;
+  static gheap_less_comparer_t volatile less_comparer_v = &less;
+  static gheap_item_mover_t volatile item_mover_v = &move;
+
+  fanout_v = fanout;
+  page_chunks_v = page_chunks;
+
+  const struct gheap_ctx ctx = {
+    .fanout = fanout_v,
+    .page_chunks = page_chunks_v,
+    .item_size = sizeof(T),
+    .less_comparer = less_comparer_v,
+    .less_comparer_ctx = NULL,
+    .item_mover = item_mover_v,
+  };
+  return ctx;
+}
+
+#ifdef __GNUC__
+// Inlines all the calls made by the function, so heap code inside it
+// is specialized for the ctx the function passes to it.
+#  define PERFTEST_FLATTEN __attribute__((flatten))
+#else
+#  define PERFTEST_FLATTEN
+#endif
+
+// Defines kernels for the ctx sweep, which pass CtxPtr to heap code.
+// Kernels are flattened, so heap code is inlined into them. Then fields
+// and function pointers of CtxPtr are folded into the code if CtxPtr
+// points to a compile-time constant, while kernels for the runtime ctx
+// load them from the ctx argument. So both kinds of kernels contain
+// the same code except for ctx constness.
+#define PERFTEST_CTX_KERNELS(Name, CtxPtr) \
+  static PERFTEST_FLATTEN void Name##_heapsort( \
+      const struct gheap_ctx *const ctx, T *const a, const size_t n) \
+  { \
+    (void)ctx; \
+    galgorithm_heapsort(CtxPtr, a, n); \
+  } \
+  static PERFTEST_FLATTEN void Name##_swap_max_item( \
+      const struct gheap_ctx *const ctx, T *const a, const size_t n, \
+      const T *const items, const size_t m) \
+  { \
+    (void)ctx; \
+    for (size_t i = 0; i < m; ++i) { \
+      T tmp = items[i]; \
+      gheap_swap_max_item(CtxPtr, a, n, &tmp); \
+    } \
+  }
+
+// Defines constant_ctx_<Fanout>_<PageChunks> and kernels for it.
+#define PERFTEST_CONSTANT_CTX_KERNELS(Fanout, PageChunks) \
+  static const struct gheap_ctx constant_ctx_##Fanout##_##PageChunks = { \
+    .fanout = Fanout, \
+    .page_chunks = PageChunks, \
+    .item_size = sizeof(T), \
+    .less_comparer = &less, \
+    .less_comparer_ctx = NULL, \
+    .item_mover = &move, \
+  }; \
+  PERFTEST_CTX_KERNELS(constant_ctx_##Fanout##_##PageChunks, \
+      &constant_ctx_##Fanout##_##PageChunks)
+
+PERFTEST_CTX_KERNELS(runtime_ctx, ctx)
+PERFTEST_CONSTANT_CTX_KERNELS(2, 1)
+PERFTEST_CONSTANT_CTX_KERNELS(2, 16)
+PERFTEST_CONSTANT_CTX_KERNELS(4, 1)
+PERFTEST_CONSTANT_CTX_KERNELS(4, 16)
+PERFTEST_CONSTANT_CTX_KERNELS(8, 1)
+PERFTEST_CONSTANT_CTX_KERNELS(8, 16)
+PERFTEST_CONSTANT_CTX_KERNELS(16, 1)
+PERFTEST_CONSTANT_CTX_KERNELS(16, 16)
+
+typedef void (*heapsort_kernel_t)(const struct gheap_ctx *ctx, T *a,
+    size_t n);
+typedef void (*swap_max_item_kernel_t)(const struct gheap_ctx *ctx, T *a,
+    size_t n, const T *items, size_t m);
+
+static void perftest_ctx_heapsort(const heapsort_kernel_t kernel,
+    const struct gheap_ctx *const ctx, T *const a, const size_t n,
+    const size_t m)
+{
+  printf("perftest_heapsort(n=%zu, m=%zu)", n, m);
+
+  double total_time = 0;
+
+  for (size_t i = 0; i < m / n; ++i) {
+    init_array(a, n);
+
+    const double start = get_time();
+    kernel(ctx, a, n);
+    const double end = get_time();
+
+    total_time += end - start;
+  }
+
+  print_performance(total_time, m, n);
+}
+
+static void perftest_ctx_swap_max_item(const swap_max_item_kernel_t kernel,
+    const struct gheap_ctx *const ctx, T *const a, const size_t n,
+    const size_t m)
+{
+  printf("perftest_swap_max_item(n=%zu, m=%zu)", n, m);
+
+  init_array(a, n);
+  gheap_make_heap(ctx, a, n);
+
+  // Replacement items are generated in advance, so rand() calls aren't
+  // measured together with the kernel. Memory stats are reset afterwards,
+  // so the buffer isn't attributed to the heap.
+  T *const items = malloc(sizeof(items[0]) * m);
+  init_array(items, m);
+  reset_memory_stats();
+
+  const double start = get_time();
+  kernel(ctx, a, n, items, m);
+  const double end = get_time();
+
+  free(items);
+
+  print_performance(end - start, m, n);
+}
+
+// Compares compile-time-constant ctx with runtime-constructed ctx
+// for the given Fanout and PageChunks values.
+#define PERFTEST_CTX(Fanout, PageChunks, a, n, m) \
+  do { \
+    printf("* ctx=constant, fanout=%d, page_chunks=%d\n", Fanout, \
+        PageChunks); \
+    perftest_ctx_heapsort(&constant_ctx_##Fanout##_##PageChunks##_heapsort, \
+        &constant_ctx_##Fanout##_##PageChunks, a, n, m); \
+    perftest_ctx_swap_max_item( \
+        &constant_ctx_##Fanout##_##PageChunks##_swap_max_item, \
+        &constant_ctx_##Fanout##_##PageChunks, a, n, m); \
+    const struct gheap_ctx runtime_ctx = create_runtime_ctx(Fanout, \
+        PageChunks); \
+    printf("* ctx=runtime, fanout=%d, page_chunks=%d\n", Fanout, \
+        PageChunks); \
+    perftest_ctx_heapsort(&runtime_ctx_heapsort, &runtime_ctx, a, n, m); \
+    perftest_ctx_swap_max_item(&runtime_ctx_swap_max_item, &runtime_ctx, a, \
+        n, m); \
+  } while (0)
+
+// Measures libc qsort() baseline and indirection overhead
+// of runtime-constructed ctx across Fanout and PageChunks values.
+static void perftest_ctx_sweep(T *const a, const size_t n, const size_t m)
+{
+  printf("* libc qsort\n");
+  perftest_qsort(a, n, m);
+
+  PERFTEST_CTX(2, 1, a, n, m);
+  PERFTEST_CTX(2, 16, a, n, m);
+  PERFTEST_CTX(4, 1, a, n, m);
+  PERFTEST_CTX(4, 16, a, n, m);
+  PERFTEST_CTX(8, 1, a, n, m);
+  PERFTEST_CTX(8, 16, a, n, m);
+  PERFTEST_CTX(16, 1, a, n, m);
+  PERFTEST_CTX(16, 16, a, n, m);
+}
+
 int main(void)
 {
   static const size_t MAX_N = 32 * 1024 * 1024;
@@ -176,8 +597,13 @@ int main(void)
 
   srand(0);
   T *const a = malloc(sizeof(a[0]) * MAX_N);
+  // Touch the array, so its pages aren't attributed to the first benchmark.
+  init_array(a, MAX_N);
+  reset_memory_stats();
 
   perftest(&ctx_v, a, MAX_N);
+  perftest_file_runs(&ctx_v, a, MAX_N / 4, 16);
+  perftest_ctx_sweep(a, 256 * 1024, 1024 * 1024);
 
   free(a);
 
@@ -2,17 +2,38 @@
 // otherwise gheap_cpp03.hpp will be tested.
 
 #include "galgorithm.hpp"
+#include "gbucket_queue.hpp"
 #include "gheap.hpp"
+#include "gfused_priority_queue.hpp"
+#include "gheavy_hitters.hpp"
 #include "gpriority_queue.hpp"
-
-#include <algorithm>  // for *_heap(), copy()
-#include <cstdlib>    // for rand(), srand()
+#include "perftests_distributions.hpp"
+#include "perftests_memory.h"
+
+#ifdef GHEAP_CPP11
+#  include "gbatch_priority_queue.hpp"
+#  include "gshared_priority_queue.hpp"
+#  include "gtask_scheduler.hpp"
+#  include "gthread_pool.hpp"
+#endif
+
+#include <algorithm>  // for *_heap(), copy(), lower_bound()
+#include <cmath>      // for pow()
+#include <cstdlib>    // for rand(), srand(), malloc(), free()
 #include <ctime>      // for clock()
 #include <iostream>
+#include <new>        // for bad_alloc, nothrow_t
 #include <queue>      // for priority_queue
+#include <string>     // for string
 #include <utility>    // for pair
 #include <vector>     // for vector
 
+#ifdef GHEAP_CPP11
+#  include <atomic>   // for atomic
+#  include <chrono>   // for steady_clock
+#  include <thread>   // for thread
+#endif
+
 using namespace std;
 
 namespace {
@@ -22,9 +43,91 @@ double get_time()
   return (double)clock() / CLOCKS_PER_SEC;
 }
 
-void print_performance(const double t, const size_t m)
+#ifdef GHEAP_CPP11
+// Returns wall clock time. Unlike get_time() it doesn't sum up CPU time
+// spent by all the threads, so it is suitable for parallel perftests.
+double get_wall_time()
+{
+  const chrono::steady_clock::duration t =
+      chrono::steady_clock::now().time_since_epoch();
+  return chrono::duration_cast<chrono::duration<double> >(t).count();
+}
+#endif
+
+// Heap allocation statistics, which are collected by the replaced global
+// operator new and operator delete below.
+#ifdef GHEAP_CPP11
+atomic<size_t> allocations_count(0);
+atomic<size_t> live_bytes(0);
+atomic<size_t> peak_bytes(0);
+#else
+size_t allocations_count = 0;
+size_t live_bytes = 0;
+size_t peak_bytes = 0;
+#endif
+
+// Live bytes at the start of the current benchmark.
+size_t baseline_bytes = 0;
+
+// Allocation size is stored in front of each allocated block. The header
+// size preserves alignment guaranteed by malloc().
+const size_t ALLOCATION_HEADER_SIZE = 16;
+
+void *allocate(const size_t size)
+{
+  char *const p = static_cast<char *>(malloc(ALLOCATION_HEADER_SIZE + size));
+  if (p == 0) {
+    return 0;
+  }
+  *reinterpret_cast<size_t *>(p) = size;
+
+  ++allocations_count;
+  const size_t live = (live_bytes += size);
+#ifdef GHEAP_CPP11
+  size_t peak = peak_bytes;
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+  }
+#else
+  if (live > peak_bytes) {
+    peak_bytes = live;
+  }
+#endif
+  return p + ALLOCATION_HEADER_SIZE;
+}
+
+void deallocate(void *const ptr)
+{
+  if (ptr == 0) {
+    return;
+  }
+  char *const p = static_cast<char *>(ptr) - ALLOCATION_HEADER_SIZE;
+  live_bytes -= *reinterpret_cast<size_t *>(p);
+  free(p);
+}
+
+// Starts collecting memory statistics for the next benchmark.
+void reset_memory_stats()
+{
+  allocations_count = 0;
+  baseline_bytes = live_bytes;
+  peak_bytes = baseline_bytes;
+  perftests_reset_peak_rss();
+}
+
+// Prints performance and memory statistics of the benchmark processing
+// n items, then starts collecting memory statistics for the next benchmark.
+//
+// Peak heap is the maximum number of bytes allocated by the benchmark
+// on top of memory allocated before it, so it doesn't include input arrays
+// shared by all the benchmarks.
+void print_performance(const double t, const size_t m, const size_t n)
 {
-  cout << ": " << (m / t / 1000) << " Kops/s" << endl;
+  const size_t peak_heap = peak_bytes - baseline_bytes;
+  cout << ": " << (m / t / 1000) << " Kops/s, allocations=" <<
+      allocations_count << ", peak_heap=" << peak_heap << " bytes (" <<
+      ((double)peak_heap / n) << " bytes/item), peak_rss=" <<
+      perftests_get_peak_rss() << " KB" << endl;
+  reset_memory_stats();
 }
 
 template <class T>
@@ -35,6 +138,27 @@ void init_array(T *const a, const size_t n)
   }
 }
 
+// Fills the array with keys from the range [0 ... keys_count) following
+// Zipf distribution with the given exponent.
+// See http://en.wikipedia.org/wiki/Zipf%27s_law .
+template <class T>
+void init_zipf_array(T *const a, const size_t n, const size_t keys_count,
+    const double exponent)
+{
+  vector<double> cdf(keys_count);
+  double sum = 0;
+  for (size_t i = 0; i < keys_count; ++i) {
+    sum += 1 / pow((double)(i + 1), exponent);
+    cdf[i] = sum;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    const double u = (double)rand() / RAND_MAX * sum;
+    const size_t key = lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    a[i] = (key < keys_count) ? key : keys_count - 1;
+  }
+}
+
 // Dummy wrapper for STL heap.
 struct stl_heap
 {
@@ -83,7 +207,13 @@ void perftest_heapsort(T *const a, const size_t n, const size_t m)
     total_time += end - start;
   }
 
-  print_performance(total_time, m);
+  print_performance(total_time, m, n);
+}
+
+template <class T>
+bool less_comparer(const T &a, const T &b)
+{
+  return (a < b);
 }
 
 template <class T, class Algorithm>
@@ -105,13 +235,49 @@ void perftest_partial_sort(T *const a, const size_t n, const size_t m)
     total_time += end - start;
   }
 
-  print_performance(total_time, m);
+  print_performance(total_time, m, n);
 }
 
-template <class T>
-bool less_comparer(const T &a, const T &b)
+
+// Compares galgorithm::small_partial_sort() to heap-based partial_sort()
+// for small numbers of sorted integer items in order to find the crossover
+// point.
+template <class T, class Heap>
+void perftest_small_partial_sort(T *const a, const size_t n, const size_t m)
 {
-  return (a < b);
+  typedef galgorithm<Heap> algorithm;
+
+  for (size_t k = 1; k <= 2 * algorithm::SMALL_PARTIAL_SORT_MAX_ITEMS &&
+      k <= n; k *= 2) {
+    double small_time = 0;
+    double heap_time = 0;
+
+    for (size_t i = 0; i < m / n; ++i) {
+      init_array(a, n);
+      double start = get_time();
+      if (k <= algorithm::SMALL_PARTIAL_SORT_MAX_ITEMS) {
+        algorithm::small_partial_sort(a, a + k, a + n);
+      }
+      else {
+        algorithm::partial_sort(a, a + k, a + n);
+      }
+      double end = get_time();
+      small_time += end - start;
+
+      init_array(a, n);
+      start = get_time();
+      algorithm::partial_sort(a, a + k, a + n);
+      end = get_time();
+      heap_time += end - start;
+    }
+
+    cout << "perftest_small_partial_sort(n=" << n << ", m=" << m <<
+        ", k=" << k << ")";
+    print_performance(small_time, m, n);
+    cout << "perftest_heap_partial_sort(n=" << n << ", m=" << m <<
+        ", k=" << k << ")";
+    print_performance(heap_time, m, n);
+  }
 }
 
 template <class T>
@@ -147,9 +313,43 @@ void perftest_nway_mergesort(T *const a, const size_t n, const size_t m)
     total_time += end - start;
   }
 
-  print_performance(total_time, m);
+  print_performance(total_time, m, n);
 }
 
+#ifdef GHEAP_CPP11
+template <class T, class Heap>
+void perftest_parallel_algorithms(gthread_pool &pool, T *const a,
+    const size_t n, const size_t m)
+{
+  typedef galgorithm<Heap> algorithm;
+
+  const size_t k = n / 100;
+  double partial_sort_time = 0;
+  double mergesort_time = 0;
+
+  for (size_t i = 0; i < m / n; ++i) {
+    init_array(a, n);
+    double start = get_wall_time();
+    algorithm::parallel_partial_sort(pool, a, a + k, a + n);
+    double end = get_wall_time();
+    partial_sort_time += end - start;
+
+    init_array(a, n);
+    start = get_wall_time();
+    algorithm::parallel_nway_mergesort(pool, a, a + n);
+    end = get_wall_time();
+    mergesort_time += end - start;
+  }
+
+  cout << "perftest_parallel_partial_sort(n=" << n << ", m=" << m <<
+      ", k=" << k << ", threads=" << pool.concurrency() << ")";
+  print_performance(partial_sort_time, m, n);
+  cout << "perftest_parallel_nway_mergesort(n=" << n << ", m=" << m <<
+      ", threads=" << pool.concurrency() << ")";
+  print_performance(mergesort_time, m, n);
+}
+#endif
+
 template <class T, class PriorityQueue>
 void perftest_priority_queue(T *const a, const size_t n, const size_t m)
 {
@@ -165,23 +365,442 @@ void perftest_priority_queue(T *const a, const size_t n, const size_t m)
   }
   const double end = get_time();
 
-  print_performance(end - start, m);
+  print_performance(end - start, m, n);
+}
+
+#ifdef GHEAP_CPP11
+// Measures gbatch_priority_queue in bulk-synchronous rounds. Each round
+// inserts a batch of n items and extracts the n top items.
+template <class T, class Heap>
+void perftest_batch_priority_queue(gthread_pool &pool, T *const a,
+    const size_t n, const size_t m)
+{
+  cout << "perftest_batch_priority_queue(n=" << n << ", m=" << m <<
+      ", threads=" << pool.concurrency() << ")";
+
+  gbatch_priority_queue<Heap, T, gthread_pool> q(pool);
+  init_array(a, n);
+  q.insert_batch(a, a + n);
+
+  vector<T> top_items(n);
+  double total_time = 0;
+  for (size_t i = 0; i < m / n; ++i) {
+    init_array(a, n);
+    const double start = get_wall_time();
+    q.insert_batch(a, a + n);
+    q.extract_k(n, top_items.begin());
+    const double end = get_wall_time();
+    total_time += end - start;
+  }
+
+  print_performance(total_time, m, n);
+}
+
+// Measures gshared_priority_queue mutations performance while another thread
+// constantly peeks at the top item.
+template <class T, class Heap>
+void perftest_shared_priority_queue(T *const a, const size_t n, const size_t m)
+{
+  cout << "perftest_shared_priority_queue(n=" << n << ", m=" << m << ")";
+
+  init_array(a, n);
+  gshared_priority_queue<Heap, T> q(a, a + n);
+
+  atomic<bool> is_done(false);
+  size_t peeks_count = 0;
+  thread reader([&]() {
+    T item;
+    while (!is_done) {
+      q.peek_top(item);
+      ++peeks_count;
+    }
+  });
+
+  const double start = get_wall_time();
+  T item;
+  for (size_t i = 0; i < m; ++i) {
+    q.try_pop(item);
+    q.push(rand());
+  }
+  const double end = get_wall_time();
+  is_done = true;
+  reader.join();
+
+  print_performance(end - start, m, n);
+  cout << "  concurrent peek_top() calls: " << peeks_count << endl;
+}
+#endif
+
+template <class T, class Heap>
+void perftest_fused_priority_queue(T *const a, const size_t n, const size_t m)
+{
+  cout << "perftest_fused_priority_queue(n=" << n << ", m=" << m << ")";
+
+  init_array(a, n);
+  gfused_priority_queue<Heap, T> q(a, a + n);
+
+  const double start = get_time();
+  for (size_t i = 0; i < m; ++i) {
+    q.pop();
+    q.push(rand());
+  }
+  const double end = get_time();
+
+  print_performance(end - start, m, n);
+}
+
+// Returns priority queue performance in Kops/s for items with priorities
+// in the range [0 ... priority_levels).
+template <class T, class PriorityQueue>
+double perftest_small_priority_queue(T *const a, const size_t n,
+    const size_t m, const size_t priority_levels)
+{
+  cout << "perftest_small_priority_queue(n=" << n << ", m=" << m <<
+      ", priority_levels=" << priority_levels << ")";
+
+  for (size_t i = 0; i < n; ++i) {
+    a[i] = rand() % priority_levels;
+  }
+  PriorityQueue q(a, a + n);
+
+  const double start = get_time();
+  for (size_t i = 0; i < m; ++i) {
+    q.pop();
+    q.push(rand() % priority_levels);
+  }
+  const double end = get_time();
+
+  print_performance(end - start, m, n);
+  return m / (end - start) / 1000;
+}
+
+// Compares bucket queue to gheap-based priority queue for small priority
+// domains in order to find the queue size where one of them starts
+// outperforming another.
+template <class T, size_t PriorityLevels>
+void perftest_bucket_queue_crossover(T *const a, const size_t max_n)
+{
+  typedef gpriority_queue<gheap<4, 1>, T> heap_queue;
+  typedef gbucket_queue<PriorityLevels, T> bucket_queue;
+
+  size_t n = max_n;
+  while (n > 0) {
+    cout << "gpriority_queue<gheap<4, 1> > ";
+    const double heap_kops = perftest_small_priority_queue<T, heap_queue>(
+        a, n, max_n, PriorityLevels);
+    cout << "gbucket_queue ";
+    const double bucket_kops = perftest_small_priority_queue<T, bucket_queue>(
+        a, n, max_n, PriorityLevels);
+    cout << "gbucket_queue / gpriority_queue<gheap<4, 1> > speedup(n=" << n <<
+        ", priority_levels=" << PriorityLevels << "): " <<
+        (bucket_kops / heap_kops) << endl;
+
+    n >>= 1;
+  }
+}
+
+template <class T, class Heap>
+void perftest_heavy_hitters(T *const a, const size_t n, const size_t m)
+{
+  const size_t capacity = 1000;
+  const double zipf_exponent = 1;
+
+  cout << "perftest_heavy_hitters(n=" << n << ", m=" << m <<
+      ", capacity=" << capacity << ", zipf_exponent=" << zipf_exponent << ")";
+
+  init_zipf_array(a, n, n, zipf_exponent);
+  gheavy_hitters<Heap, T> h(capacity);
+
+  const double start = get_time();
+  for (size_t i = 0; i < m / n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      h.add(a[j]);
+    }
+  }
+  const double end = get_time();
+
+  print_performance(end - start, m, n);
+}
+
+#ifdef GHEAP_CPP11
+// Simulates task payload.
+size_t burn_cpu(const size_t iterations)
+{
+  size_t x = iterations;
+  for (size_t i = 0; i < iterations; ++i) {
+    x = x * 1103515245 + 12345;
+  }
+  return x;
 }
 
+// Runs synthetic DAG workload on the task scheduler. The DAG consists
+// of layers_count layers with the given width. Each task depends on two
+// tasks from the previous layer and has random priority.
+template <class Heap>
+void perftest_task_scheduler_dag(const size_t layers_count,
+    const size_t width, const size_t inversion_tolerance)
+{
+  typedef gtask_scheduler<Heap, size_t> task_scheduler;
+
+  const size_t tasks_count = layers_count * width;
+  cout << "perftest_task_scheduler_dag(tasks=" << tasks_count <<
+      ", width=" << width << ", inversion_tolerance=" <<
+      inversion_tolerance << ")";
+
+  vector<size_t> priorities(tasks_count);
+  for (size_t i = 0; i < tasks_count; ++i) {
+    priorities[i] = rand();
+  }
+  vector<atomic<size_t> > dependencies_left(tasks_count);
+  for (size_t i = 0; i < tasks_count; ++i) {
+    dependencies_left[i] = (i < width) ? 0 : 2;
+  }
+  atomic<size_t> checksum(0);
+
+  task_scheduler scheduler(thread::hardware_concurrency(),
+      inversion_tolerance);
+
+  // Children of the task i in the layer l are the tasks i and (i + 1)
+  // in the layer (l + 1), so each child has exactly two parents.
+  function<void (size_t)> run_task = [&](const size_t i) {
+    checksum += burn_cpu(100);
+    if (i + width >= tasks_count) {
+      return;
+    }
+    const size_t layer_first = i - i % width + width;
+    const size_t children[2] = {
+      i + width,
+      layer_first + (i % width + 1) % width,
+    };
+    for (size_t j = 0; j < 2; ++j) {
+      const size_t child = children[j];
+      if (--dependencies_left[child] == 0) {
+        scheduler.submit(priorities[child], [&run_task, child]() {
+          run_task(child);
+        });
+      }
+    }
+  };
+
+  const double start = get_wall_time();
+  for (size_t i = 0; i < width; ++i) {
+    scheduler.submit(priorities[i], [&run_task, i]() {
+      run_task(i);
+    });
+  }
+  scheduler.wait();
+  const double end = get_wall_time();
+
+  print_performance(end - start, tasks_count, tasks_count);
+}
+
+// Returns the number of inversions in the given range.
+size_t count_inversions(size_t *const first, size_t *const last,
+    size_t *const tmp)
+{
+  const size_t n = last - first;
+  if (n < 2) {
+    return 0;
+  }
+  size_t *const middle = first + n / 2;
+  size_t inversions = count_inversions(first, middle, tmp) +
+      count_inversions(middle, last, tmp);
+  size_t *a = first;
+  size_t *b = middle;
+  size_t *out = tmp;
+  while (a != middle && b != last) {
+    if (*b < *a) {
+      inversions += middle - a;
+      *out++ = *b++;
+    }
+    else {
+      *out++ = *a++;
+    }
+  }
+  out = copy(a, middle, out);
+  out = copy(b, last, out);
+  copy(tmp, out, first);
+  return inversions;
+}
+
+// Measures how close the order of task executions to the priority order.
+// A single task spawns tasks_count tasks with random priorities, so they
+// are spread among workers via work stealing.
+template <class Heap>
+void perftest_task_scheduler_accuracy(const size_t tasks_count,
+    const size_t inversion_tolerance)
+{
+  typedef gtask_scheduler<Heap, size_t> task_scheduler;
+
+  cout << "perftest_task_scheduler_accuracy(tasks=" << tasks_count <<
+      ", inversion_tolerance=" << inversion_tolerance << "): ";
+
+  vector<size_t> order(tasks_count);
+  atomic<size_t> executed_count(0);
+  {
+    task_scheduler scheduler(thread::hardware_concurrency(),
+        inversion_tolerance);
+    scheduler.submit(0, [&]() {
+      for (size_t i = 0; i < tasks_count; ++i) {
+        const size_t priority = rand();
+        scheduler.submit(priority, [&, priority]() {
+          burn_cpu(100);
+          // Store negated priorities, so the ideal order is ascending.
+          order[executed_count++] = ~priority;
+        });
+      }
+    });
+    scheduler.wait();
+  }
+
+  vector<size_t> tmp(tasks_count);
+  const size_t inversions = count_inversions(order.data(),
+      order.data() + tasks_count, tmp.data());
+  const double pairs_count = (double)tasks_count * (tasks_count - 1) / 2;
+  cout << "inversions=" << (inversions / pairs_count * 100) << "%" << endl;
+}
+
+template <class Heap>
+void perftest_task_scheduler()
+{
+  const size_t inversion_tolerances[] = {0, 16, 1024};
+  for (size_t i = 0; i < 3; ++i) {
+    perftest_task_scheduler_dag<Heap>(1000, 1000, inversion_tolerances[i]);
+    perftest_task_scheduler_accuracy<Heap>(100000, inversion_tolerances[i]);
+  }
+}
+#endif
+
 template <class T, class Heap>
 void perftest_gheap(T *const a, const size_t max_n)
 {
   size_t n = max_n;
+#ifdef GHEAP_CPP11
+  gthread_pool pool;
+#endif
   while (n > 0) {
     perftest_heapsort<T, Heap>(a, n, max_n);
     perftest_partial_sort<T, galgorithm<Heap> >(a, n, max_n);
+    perftest_small_partial_sort<T, Heap>(a, n, max_n);
     perftest_nway_mergesort<T, Heap>(a, n, max_n);
+#ifdef GHEAP_CPP11
+    perftest_parallel_algorithms<T, Heap>(pool, a, n, max_n);
+#endif
     perftest_priority_queue<T, gpriority_queue<Heap, T> >(a, n, max_n);
+    perftest_fused_priority_queue<T, Heap>(a, n, max_n);
+#ifdef GHEAP_CPP11
+    perftest_batch_priority_queue<T, Heap>(pool, a, n, max_n);
+    perftest_shared_priority_queue<T, Heap>(a, n, max_n);
+#endif
+    perftest_heavy_hitters<T, Heap>(a, n, max_n);
 
     n >>= 1;
   }
 }
 
+// Runners for perftest_distribution().
+template <class Heap>
+struct heapsort_runner
+{
+  static const char *get_name()
+  {
+    return "heapsort";
+  }
+
+  template <class T>
+  static void run(T *const a, const size_t n)
+  {
+    galgorithm<Heap>::heapsort(a, a + n);
+  }
+};
+
+// Sorts the first quarter of items.
+template <class Heap>
+struct partial_sort_runner
+{
+  static const char *get_name()
+  {
+    return "partial_sort";
+  }
+
+  template <class T>
+  static void run(T *const a, const size_t n)
+  {
+    galgorithm<Heap>::partial_sort(a, a + n / 4, a + n);
+  }
+};
+
+template <class Heap>
+struct nway_mergesort_runner
+{
+  static const char *get_name()
+  {
+    return "nway_mergesort";
+  }
+
+  template <class T>
+  static void run(T *const a, const size_t n)
+  {
+    galgorithm<Heap>::nway_mergesort(a, a + n);
+  }
+};
+
+// Measures the algorithm on the input, which is restored before each run.
+template <class Runner, class T>
+void perftest_distribution(const char *const type_name,
+    const perftests_distribution distribution, const vector<T> &input,
+    vector<T> &a, const size_t m)
+{
+  const size_t n = input.size();
+
+  cout << "perftest_" << Runner::get_name() << "(type=" << type_name <<
+      ", distribution=" << perftests_get_distribution_name(distribution) <<
+      ", n=" << n << ", m=" << m << ")";
+
+  double total_time = 0;
+  for (size_t i = 0; i < m / n; ++i) {
+    copy(input.begin(), input.end(), a.begin());
+
+    const double start = get_time();
+    Runner::run(&a[0], n);
+    const double end = get_time();
+
+    total_time += end - start;
+  }
+
+  print_performance(total_time, m, n);
+}
+
+// Reports every algorithm per input distribution for items of type T.
+template <class T, class Heap>
+void perftest_distributions(const char *const type_name, const size_t n,
+    const size_t m)
+{
+  vector<T> input(n), a(n);
+  for (size_t d = 0; d < PERFTESTS_DISTRIBUTIONS_COUNT; ++d) {
+    const perftests_distribution distribution =
+        static_cast<perftests_distribution>(d);
+    perftests_generate(&input[0], n, distribution, d);
+
+    perftest_distribution<heapsort_runner<Heap> >(type_name, distribution,
+        input, a, m);
+    perftest_distribution<partial_sort_runner<Heap> >(type_name,
+        distribution, input, a, m);
+    perftest_distribution<nway_mergesort_runner<Heap> >(type_name,
+        distribution, input, a, m);
+  }
+}
+
+template <class Heap>
+void perftest_all_distributions(const size_t n, const size_t m)
+{
+  perftest_distributions<int, Heap>("int", n, m);
+  perftest_distributions<size_t, Heap>("size_t", n, m);
+  perftest_distributions<double, Heap>("double", n, m);
+  perftest_distributions<string, Heap>("string", n, m);
+  perftest_distributions<perftests_struct_item, Heap>("struct", n, m);
+}
+
 template <class T>
 void perftest_stl_heap(T *const a, const size_t max_n)
 {
@@ -201,6 +820,47 @@ void perftest_stl_heap(T *const a, const size_t max_n)
 
 }  // end of anonymous namespace.
 
+// Global allocation functions are replaced for collecting memory statistics.
+#ifdef GHEAP_CPP11
+void *operator new(const size_t size)
+#else
+void *operator new(const size_t size) throw(bad_alloc)
+#endif
+{
+  void *const p = allocate(size);
+  if (p == 0) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+#ifdef GHEAP_CPP11
+void *operator new(const size_t size, const nothrow_t &) noexcept
+#else
+void *operator new(const size_t size, const nothrow_t &) throw()
+#endif
+{
+  return allocate(size);
+}
+
+#ifdef GHEAP_CPP11
+void operator delete(void *const p) noexcept
+#else
+void operator delete(void *const p) throw()
+#endif
+{
+  deallocate(p);
+}
+
+#ifdef GHEAP_CPP11
+void operator delete(void *const p, const nothrow_t &) noexcept
+#else
+void operator delete(void *const p, const nothrow_t &) throw()
+#endif
+{
+  deallocate(p);
+}
+
 
 int main(void)
 {
@@ -214,6 +874,9 @@ int main(void)
 
   srand(0);
   T *const a = new T[MAX_N];
+  // Touch the array, so its pages aren't attributed to the first benchmark.
+  init_array(a, MAX_N);
+  reset_memory_stats();
 
   cout << "* STL heap" << endl;
   perftest_stl_heap(a, MAX_N);
@@ -222,5 +885,17 @@ int main(void)
   typedef gheap<FANOUT, PAGE_CHUNKS> heap;
   perftest_gheap<T, heap>(a, MAX_N);
 
+  cout << "* gheap per input distribution" << endl;
+  perftest_all_distributions<heap>(256 * 1024, 1024 * 1024);
+
+  cout << "* bucket queue vs gheap<4, 1>" << endl;
+  perftest_bucket_queue_crossover<T, 256>(a, MAX_N);
+  perftest_bucket_queue_crossover<T, 4096>(a, MAX_N);
+
+#ifdef GHEAP_CPP11
+  cout << "* task scheduler on top of gheap<4, 1>" << endl;
+  perftest_task_scheduler<gheap<4, 1> >();
+#endif
+
   delete[] a;
 }
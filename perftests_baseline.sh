@@ -0,0 +1,208 @@
+#!/bin/sh
+# Saves perftests results as a baseline and compares later runs against it.
+#
+# Usage: ./perftests_baseline.sh save|compare <baseline_file>
+#
+# Each benchmark is run TRIALS times. Every output line with a result
+# in Kops/s (higher is better) or ns/call (lower is better) becomes a test
+# identified by the benchmark name, the last non-indented line without
+# a result (usually a section header) and the text before the result.
+#
+# 'save' writes per-trial results into the baseline file. 'compare' runs
+# the benchmarks again and reports per-test changes. A change is reported
+# as an improvement or a regression only if it exceeds MIN_CHANGE percent
+# and Welch's t-test over trials shows it with at least CONFIDENCE.
+# Other changes are reported as noise. The exit status is 1 if there are
+# regressions.
+#
+# Environment variables:
+# - PERFTESTS - benchmarks to run.
+#   "./perftests_c ./perftests_cpp03 ./perftests_cpp11" by default.
+# - TRIALS - the number of runs of each benchmark. 5 by default.
+# - MIN_CHANGE - the minimum reported change in percent. 2 by default.
+# - CONFIDENCE - the minimum confidence of reported changes. 0.95 by default.
+
+set -e
+
+PERFTESTS=${PERFTESTS:-./perftests_c ./perftests_cpp03 ./perftests_cpp11}
+TRIALS=${TRIALS:-5}
+MIN_CHANGE=${MIN_CHANGE:-2}
+CONFIDENCE=${CONFIDENCE:-0.95}
+
+if [ $# -ne 2 ] || { [ "$1" != save ] && [ "$1" != compare ]; }; then
+  echo "Usage: $0 save|compare <baseline_file>" >&2
+  exit 2
+fi
+MODE=$1
+BASELINE=$2
+
+TMP_DIR=$(mktemp -d /tmp/perftests_baseline_XXXXXX)
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+# Prints "test<TAB>unit<TAB>value" lines for results of the given benchmark.
+parse_results() {
+  awk -v benchmark="$1" '
+    {
+      if (match($0, /: [-+0-9.eE]+ (Kops\/s|ns\/call)/)) {
+        name = substr($0, 1, RSTART - 1)
+        sub(/^ +/, "", name)
+        split(substr($0, RSTART + 2, RLENGTH - 2), result, " ")
+        test = benchmark " | " section " | " name
+        # Tests with equal names within a section are numbered.
+        if (++names_count[test] > 1) {
+          test = test " #" names_count[test]
+        }
+        printf "%s\t%s\t%s\n", test, result[2], result[1]
+      } else if ($0 ~ /^[^ ]/) {
+        section = $0
+      }
+    }
+  '
+}
+
+# Runs benchmarks TRIALS times and writes "test<TAB>unit<TAB>values" lines
+# into the given file, where values are comma-separated per-trial results.
+run_trials() {
+  : > "$TMP_DIR/results.txt"
+  trial=1
+  while [ "$trial" -le "$TRIALS" ]; do
+    for benchmark in $PERFTESTS; do
+      echo "trial $trial/$TRIALS: $benchmark" >&2
+      "$benchmark" > "$TMP_DIR/output.txt"
+      parse_results "$benchmark" < "$TMP_DIR/output.txt" \
+          >> "$TMP_DIR/results.txt"
+    done
+    trial=$((trial + 1))
+  done
+  awk -F '\t' '
+    {
+      if (!($1 in values)) {
+        tests[++tests_count] = $1
+        units[$1] = $2
+        values[$1] = $3
+      } else {
+        values[$1] = values[$1] "," $3
+      }
+    }
+    END {
+      for (i = 1; i <= tests_count; i++) {
+        printf "%s\t%s\t%s\n", tests[i], units[tests[i]], values[tests[i]]
+      }
+    }
+  ' "$TMP_DIR/results.txt" > "$1"
+}
+
+if [ "$MODE" = save ]; then
+  run_trials "$BASELINE"
+  echo "perftests_baseline: saved $(wc -l < "$BASELINE") tests to $BASELINE"
+  exit 0
+fi
+
+if [ ! -f "$BASELINE" ]; then
+  echo "perftests_baseline: $BASELINE doesn't exist. Run 'save' first" >&2
+  exit 2
+fi
+run_trials "$TMP_DIR/current.txt"
+
+awk -F '\t' -v min_change="$MIN_CHANGE" -v min_confidence="$CONFIDENCE" '
+  function abs(x) {
+    return (x < 0) ? -x : x
+  }
+
+  # Parses comma-separated values and stores their count, mean and sample
+  # variance in stats[prefix "n"], stats[prefix "mean"] and stats[prefix "var"].
+  function get_stats(s, prefix,    values, n, i, sum, sum_of_squares) {
+    n = split(s, values, ",")
+    sum = 0
+    for (i = 1; i <= n; i++) {
+      sum += values[i]
+    }
+    stats[prefix "n"] = n
+    stats[prefix "mean"] = sum / n
+    sum_of_squares = 0
+    for (i = 1; i <= n; i++) {
+      sum_of_squares += (values[i] - sum / n) ^ 2
+    }
+    stats[prefix "var"] = (n > 1) ? sum_of_squares / (n - 1) : 0
+  }
+
+  # Abramowitz and Stegun approximation 7.1.26 with error below 1.5e-7.
+  function erf(x,    t, p) {
+    t = 1 / (1 + 0.3275911 * x)
+    p = t * (-1.453152027 + t * 1.061405429)
+    p = t * (0.254829592 + t * (-0.284496736 + t * (1.421413741 + p)))
+    return 1 - p * exp(-x * x)
+  }
+
+  # Returns the confidence that means of baseline and current trials differ
+  # according to Welch t-test. Returns -1 if it cannot be estimated.
+  function get_confidence(    bse2, cse2, se2, t, df, z) {
+    if (stats["bn"] < 2 || stats["cn"] < 2) {
+      return -1
+    }
+    bse2 = stats["bvar"] / stats["bn"]
+    cse2 = stats["cvar"] / stats["cn"]
+    se2 = bse2 + cse2
+    if (se2 == 0) {
+      return (stats["bmean"] == stats["cmean"]) ? 0 : 1
+    }
+    t = abs(stats["cmean"] - stats["bmean"]) / sqrt(se2)
+    df = se2 ^ 2 / (bse2 ^ 2 / (stats["bn"] - 1) + cse2 ^ 2 / (stats["cn"] - 1))
+    # Normal approximation of Student t distribution.
+    z = t * (1 - 1 / (4 * df)) / sqrt(1 + t * t / (2 * df))
+    return erf(z / sqrt(2))
+  }
+
+  FILENAME == ARGV[1] {
+    baseline_values[$1] = $3
+    next
+  }
+
+  {
+    if (!($1 in baseline_values)) {
+      printf "4\tnew          %s\n", $1
+      next
+    }
+    seen[$1] = 1
+    get_stats(baseline_values[$1], "b")
+    get_stats($3, "c")
+    change = (stats["cmean"] - stats["bmean"]) / stats["bmean"] * 100
+    if ($2 == "ns/call") {
+      change = -change
+    }
+    confidence = get_confidence()
+    if (abs(change) < min_change ||
+        (confidence >= 0 && confidence < min_confidence)) {
+      order = 3
+      status = "noise"
+    } else if (change < 0) {
+      order = 1
+      status = "REGRESSION"
+    } else {
+      order = 2
+      status = "improvement"
+    }
+    printf "%d\t%-12s %+6.1f%% (confidence %s) %s: %.4g -> %.4g %s\n",
+        order, status, change,
+        (confidence < 0) ? "n/a" : sprintf("%.1f%%", confidence * 100),
+        $1, stats["bmean"], stats["cmean"], $2
+  }
+
+  END {
+    for (test in baseline_values) {
+      if (!(test in seen)) {
+        printf "5\tmissing      %s\n", test
+      }
+    }
+  }
+' "$BASELINE" "$TMP_DIR/current.txt" > "$TMP_DIR/report.txt"
+sort -s -t "$(printf '\t')" -k 1,1 -o "$TMP_DIR/report.txt" \
+    "$TMP_DIR/report.txt"
+
+echo "perftests_compare(baseline=$BASELINE, trials=$TRIALS," \
+    "min_change=$MIN_CHANGE%, confidence=$CONFIDENCE)"
+cut -f 2- "$TMP_DIR/report.txt"
+regressions_count=$(grep -c '^1' "$TMP_DIR/report.txt" || true)
+improvements_count=$(grep -c '^2' "$TMP_DIR/report.txt" || true)
+echo "regressions: $regressions_count, improvements: $improvements_count"
+[ "$regressions_count" -eq 0 ]
@@ -0,0 +1,92 @@
+#ifndef PERFTESTS_COUNTERS_H
+#define PERFTESTS_COUNTERS_H
+
+/*
+ * Retired instructions counter for perftests.
+ *
+ * The counter is read via perf_event_open() on Linux. It counts only
+ * user-space instructions of the calling thread. The counter is unavailable
+ * on other systems, on virtual machines without PMU passthrough and when
+ * /proc/sys/kernel/perf_event_paranoid forbids access. In this case
+ * perftests_counter_open() returns -1 and instructions aren't reported.
+ */
+
+#include <stdint.h>   /* for uint64_t */
+
+#ifdef __linux__
+#  include <linux/perf_event.h>   /* for perf_event_attr, PERF_* */
+#  include <string.h>             /* for memset() */
+#  include <sys/ioctl.h>          /* for ioctl() */
+#  include <sys/syscall.h>        /* for SYS_perf_event_open */
+#  include <unistd.h>             /* for syscall(), read(), close() */
+#endif
+
+/*
+ * Opens stopped instructions counter for the calling thread.
+ * Returns counter descriptor or -1 if the counter is unavailable.
+ */
+static inline int perftests_counter_open(void)
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+/*
+ * Resets the counter to zero and starts it.
+ */
+static inline void perftests_counter_start(const int fd)
+{
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#else
+  (void)fd;
+#endif
+}
+
+/*
+ * Stops the counter and returns the number of instructions retired
+ * since perftests_counter_start().
+ */
+static inline uint64_t perftests_counter_stop(const int fd)
+{
+#ifdef __linux__
+  uint64_t count = 0;
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)) {
+      count = 0;
+    }
+  }
+  return count;
+#else
+  (void)fd;
+  return 0;
+#endif
+}
+
+static inline void perftests_counter_close(const int fd)
+{
+#ifdef __linux__
+  if (fd >= 0) {
+    close(fd);
+  }
+#else
+  (void)fd;
+#endif
+}
+
+#endif
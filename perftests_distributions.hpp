@@ -0,0 +1,244 @@
+#ifndef PERFTESTS_DISTRIBUTIONS_HPP
+#define PERFTESTS_DISTRIBUTIONS_HPP
+
+// Input distribution generators for perftests.
+//
+// Generators produce order-preserving 64-bit ranks, which are converted
+// to items by perftests_item_traits<T>::from_rank(). So every distribution
+// has the same shape for all the supported item types - int, size_t,
+// double, std::string and perftests_struct_item.
+//
+// All the generators are deterministic for the given seed.
+
+#include <cassert>
+#include <cstddef>    // for size_t
+#include <stdint.h>   // for uint64_t
+#include <string>     // for std::string
+#include <vector>     // for std::vector
+
+#include <algorithm>  // for std::lower_bound(), std::swap()
+
+enum perftests_distribution
+{
+  // Uniformly distributed 64-bit keys.
+  PERFTESTS_UNIFORM,
+
+  // Already sorted keys.
+  PERFTESTS_SORTED,
+
+  // Keys sorted in descending order.
+  PERFTESTS_REVERSE_SORTED,
+
+  // Ascending first half followed by descending second half.
+  PERFTESTS_ORGAN_PIPE,
+
+  // Only 16 distinct keys.
+  PERFTESTS_FEW_UNIQUE,
+
+  // Keys from [0 ... n) following Zipf distribution with exponent 1.
+  PERFTESTS_ZIPF,
+
+  // Repeated ascending runs of 1024 keys.
+  PERFTESTS_SAWTOOTH,
+
+  // Sorted keys with n / 100 random swaps.
+  PERFTESTS_NEARLY_SORTED,
+
+  PERFTESTS_DISTRIBUTIONS_COUNT
+};
+
+inline const char *perftests_get_distribution_name(
+    const perftests_distribution distribution)
+{
+  static const char *const names[PERFTESTS_DISTRIBUTIONS_COUNT] = {
+    "uniform", "sorted", "reverse_sorted", "organ_pipe", "few_unique",
+    "zipf", "sawtooth", "nearly_sorted",
+  };
+  assert(distribution < PERFTESTS_DISTRIBUTIONS_COUNT);
+  return names[distribution];
+}
+
+// xorshift64* pseudo-random generator. It is faster and has better
+// quality than rand(), which returns only 31 bits on common platforms.
+class perftests_rng
+{
+private:
+
+  uint64_t _state;
+
+public:
+
+  explicit perftests_rng(const uint64_t seed) :
+      _state(seed * 2 + 1) {}
+
+  uint64_t next()
+  {
+    _state ^= _state >> 12;
+    _state ^= _state << 25;
+    _state ^= _state >> 27;
+    // 2685821657736338717 multiplier. C++03 lacks 64-bit literals.
+    return _state * ((static_cast<uint64_t>(0x2545f491) << 32) | 0x4f6cdd1d);
+  }
+
+  // Returns a random number in the range [0 ... n).
+  uint64_t next(const uint64_t n)
+  {
+    return next() % n;
+  }
+};
+
+// Fills ranks with n values following the given distribution.
+// Ranks are spread over the whole 64-bit range, so their order is preserved
+// after conversion to narrower item types.
+inline void perftests_generate_ranks(std::vector<uint64_t> &ranks,
+    const size_t n, const perftests_distribution distribution,
+    const uint64_t seed)
+{
+  perftests_rng rng(seed);
+  const uint64_t step = ~static_cast<uint64_t>(0) / (n + 1);
+
+  ranks.resize(n);
+  switch (distribution) {
+    case PERFTESTS_UNIFORM:
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = rng.next();
+      }
+      break;
+    case PERFTESTS_SORTED:
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = i * step;
+      }
+      break;
+    case PERFTESTS_REVERSE_SORTED:
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = (n - 1 - i) * step;
+      }
+      break;
+    case PERFTESTS_ORGAN_PIPE:
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = ((i < n / 2) ? i : n - 1 - i) * step;
+      }
+      break;
+    case PERFTESTS_FEW_UNIQUE: {
+      const uint64_t unique_step = ~static_cast<uint64_t>(0) / 16;
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = rng.next(16) * unique_step;
+      }
+      break;
+    }
+    case PERFTESTS_ZIPF: {
+      std::vector<double> cdf(n);
+      double sum = 0;
+      for (size_t i = 0; i < n; ++i) {
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        const double u = static_cast<double>(rng.next() >> 11) /
+            (static_cast<uint64_t>(1) << 53) * sum;
+        size_t key = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+        if (key >= n) {
+          key = n - 1;
+        }
+        ranks[i] = key * step;
+      }
+      break;
+    }
+    case PERFTESTS_SAWTOOTH:
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = (i % 1024) * step;
+      }
+      break;
+    case PERFTESTS_NEARLY_SORTED:
+      for (size_t i = 0; i < n; ++i) {
+        ranks[i] = i * step;
+      }
+      for (size_t i = 0; i < n / 100; ++i) {
+        std::swap(ranks[rng.next(n)], ranks[rng.next(n)]);
+      }
+      break;
+    default:
+      assert(0);
+  }
+}
+
+// Item with the payload, which makes it bigger than a cache line fraction
+// typical for integer items.
+struct perftests_struct_item
+{
+  uint64_t key;
+  uint64_t payload[3];
+
+  bool operator < (const perftests_struct_item &item) const
+  {
+    return (key < item.key);
+  }
+};
+
+// Order-preserving conversion of ranks to items.
+template <class T>
+struct perftests_item_traits
+{
+  static T from_rank(const uint64_t rank)
+  {
+    // Keep the most significant bits, which fit T.
+    return static_cast<T>(rank >> (64 - 8 * sizeof(T) + 1));
+  }
+};
+
+template <>
+struct perftests_item_traits<size_t>
+{
+  static size_t from_rank(const uint64_t rank)
+  {
+    return static_cast<size_t>(rank >> (64 - 8 * sizeof(size_t)));
+  }
+};
+
+template <>
+struct perftests_item_traits<double>
+{
+  static double from_rank(const uint64_t rank)
+  {
+    return static_cast<double>(rank);
+  }
+};
+
+template <>
+struct perftests_item_traits<std::string>
+{
+  // Strings are 16-character hexadecimal ranks with common prefix,
+  // so comparisons are more expensive than for integers.
+  static std::string from_rank(const uint64_t rank)
+  {
+    static const char digits[] = "0123456789abcdef";
+    std::string s("key:");
+    for (int i = 60; i >= 0; i -= 4) {
+      s += digits[(rank >> i) & 0xf];
+    }
+    return s;
+  }
+};
+
+template <>
+struct perftests_item_traits<perftests_struct_item>
+{
+  static perftests_struct_item from_rank(const uint64_t rank)
+  {
+    const perftests_struct_item item = {rank, {rank, rank, rank}};
+    return item;
+  }
+};
+
+// Fills [a ... a + n) with items following the given distribution.
+template <class T>
+void perftests_generate(T *const a, const size_t n,
+    const perftests_distribution distribution, const uint64_t seed)
+{
+  std::vector<uint64_t> ranks;
+  perftests_generate_ranks(ranks, n, distribution, seed);
+  for (size_t i = 0; i < n; ++i) {
+    a[i] = perftests_item_traits<T>::from_rank(ranks[i]);
+  }
+}
+#endif
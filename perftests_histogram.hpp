@@ -0,0 +1,111 @@
+#ifndef PERFTESTS_HISTOGRAM_HPP
+#define PERFTESTS_HISTOGRAM_HPP
+
+// Low-overhead latency histogram for perftests.
+//
+// Buckets are log-linear like in HdrHistogram: values below 2^SubBucketBits
+// are recorded exactly, while bigger values are split into power-of-two
+// ranges, each subdivided into 2^SubBucketBits equal sub-buckets. So
+// the relative error of reported percentiles doesn't exceed
+// 1 / 2^SubBucketBits, while record() is a few arithmetic operations
+// and a single increment. The maximum value is tracked exactly.
+
+#include <cassert>
+#include <cstddef>    // for size_t
+#include <stdint.h>   // for uint64_t
+#include <vector>     // for std::vector
+
+template <unsigned SubBucketBits = 5>
+class perftests_histogram
+{
+private:
+
+  static const uint64_t _sub_buckets_count =
+      static_cast<uint64_t>(1) << SubBucketBits;
+  static const size_t _buckets_count =
+      (64 - SubBucketBits + 1) << SubBucketBits;
+
+  std::vector<uint64_t> _counts;
+  uint64_t _total_count;
+  uint64_t _max_value;
+
+  static unsigned _get_msb(uint64_t v)
+  {
+    assert(v != 0);
+
+    unsigned msb = 0;
+    while (v >>= 1) {
+      ++msb;
+    }
+    return msb;
+  }
+
+  static size_t _get_bucket_index(const uint64_t v)
+  {
+    if (v < _sub_buckets_count) {
+      return static_cast<size_t>(v);
+    }
+    const unsigned shift = _get_msb(v) - SubBucketBits;
+    return static_cast<size_t>((shift << SubBucketBits) + (v >> shift));
+  }
+
+  // Returns the maximum value, which maps to the given bucket.
+  static uint64_t _get_bucket_max_value(const size_t index)
+  {
+    if (index < _sub_buckets_count) {
+      return index;
+    }
+    const unsigned shift = static_cast<unsigned>(index >> SubBucketBits) - 1;
+    const uint64_t mantissa = index - (shift << SubBucketBits);
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+public:
+
+  perftests_histogram() :
+      _counts(_buckets_count), _total_count(0), _max_value(0) {}
+
+  void record(const uint64_t v)
+  {
+    ++_counts[_get_bucket_index(v)];
+    ++_total_count;
+    if (v > _max_value) {
+      _max_value = v;
+    }
+  }
+
+  uint64_t get_count() const
+  {
+    return _total_count;
+  }
+
+  uint64_t get_max() const
+  {
+    return _max_value;
+  }
+
+  // Returns the value, which isn't exceeded by the given fraction
+  // of recorded values. For instance, get_percentile(0.99) returns p99.
+  uint64_t get_percentile(const double fraction) const
+  {
+    assert(fraction >= 0 && fraction <= 1);
+
+    if (_total_count == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * _total_count + 0.5);
+    if (rank == 0) {
+      rank = 1;
+    }
+    uint64_t count = 0;
+    for (size_t i = 0; i < _buckets_count; ++i) {
+      count += _counts[i];
+      if (count >= rank) {
+        const uint64_t v = _get_bucket_max_value(i);
+        return (v < _max_value) ? v : _max_value;
+      }
+    }
+    return _max_value;
+  }
+};
+#endif
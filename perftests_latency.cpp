@@ -0,0 +1,149 @@
+// Measures per-operation latency percentiles of gpriority_queue
+// for various heap sizes and gheap configurations.
+//
+// Average throughput hides tail latencies caused by deep sifts and
+// container capacity doublings. So every push(), pop() and replace_top()
+// is timed individually and recorded into perftests_histogram.
+// Pushes, which grow container capacity, are recorded into a separate
+// histogram, since their latency is dominated by memory allocation
+// and items' copying.
+//
+// Latencies are in nanoseconds with the timer overhead subtracted.
+// Requires POSIX clock_gettime().
+//
+// Pass -DGHEAP_CPP11 to compiler for gheap_cpp11.hpp tests,
+// otherwise gheap_cpp03.hpp will be tested.
+
+#include "gheap.hpp"
+#include "gpriority_queue.hpp"
+#include "perftests_distributions.hpp"
+#include "perftests_histogram.hpp"
+
+#include <iomanip>    // for setw()
+#include <iostream>
+#include <stdint.h>   // for uint64_t
+#include <time.h>     // for clock_gettime()
+#include <vector>     // for vector
+
+using namespace std;
+
+namespace {
+
+typedef perftests_histogram<> histogram;
+
+// Returns monotonic time in nanoseconds.
+uint64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Returns the minimum duration of an empty timed region.
+uint64_t get_timer_overhead()
+{
+  uint64_t overhead = ~static_cast<uint64_t>(0);
+  for (size_t i = 0; i < 100000; ++i) {
+    const uint64_t start = get_time_ns();
+    const uint64_t end = get_time_ns();
+    if (end - start < overhead) {
+      overhead = end - start;
+    }
+  }
+  return overhead;
+}
+
+uint64_t timer_overhead;
+
+void record_latency(histogram &h, const uint64_t start, const uint64_t end)
+{
+  const uint64_t t = end - start;
+  h.record((t > timer_overhead) ? t - timer_overhead : 0);
+}
+
+void print_latencies(const char *const op_name, const histogram &h)
+{
+  cout << "  " << setw(12) << left << op_name << right <<
+      " count=" << setw(9) << h.get_count() <<
+      " p50=" << setw(6) << h.get_percentile(0.5) <<
+      " p99=" << setw(6) << h.get_percentile(0.99) <<
+      " p99.9=" << setw(7) << h.get_percentile(0.999) <<
+      " max=" << setw(9) << h.get_max() << endl;
+}
+
+template <class Heap>
+void perftest_latency(const char *const heap_name, const vector<size_t> &a,
+    const size_t n, const size_t m)
+{
+  cout << "perftest_latency(" << heap_name << ", n=" << n << ", m=" << m <<
+      ")" << endl;
+
+  typedef gpriority_queue<Heap, size_t> priority_queue;
+  histogram push_latencies, growth_latencies, pop_latencies,
+      replace_top_latencies;
+
+  // The container grows from scratch, so capacity doublings are recorded.
+  priority_queue q;
+  for (size_t i = 0; i < n; ++i) {
+    const size_t capacity = q.c.capacity();
+    const uint64_t start = get_time_ns();
+    q.push(a[i]);
+    const uint64_t end = get_time_ns();
+    record_latency((q.c.capacity() == capacity) ? push_latencies :
+        growth_latencies, start, end);
+  }
+
+  for (size_t i = 0; i < m; ++i) {
+    uint64_t start = get_time_ns();
+    q.pop();
+    uint64_t end = get_time_ns();
+    record_latency(pop_latencies, start, end);
+
+    start = get_time_ns();
+    q.push(a[n + i]);
+    end = get_time_ns();
+    record_latency(push_latencies, start, end);
+  }
+
+  for (size_t i = 0; i < m; ++i) {
+    size_t item = a[n + m + i];
+    const uint64_t start = get_time_ns();
+    Heap::swap_max_item(q.c.begin(), q.c.end(), item, q.comp);
+    const uint64_t end = get_time_ns();
+    record_latency(replace_top_latencies, start, end);
+  }
+
+  print_latencies("push", push_latencies);
+  print_latencies("push_growth", growth_latencies);
+  print_latencies("pop", pop_latencies);
+  print_latencies("replace_top", replace_top_latencies);
+}
+
+void perftest_latencies(const size_t n, const size_t m)
+{
+  vector<size_t> a(n + 2 * m);
+  perftests_generate(&a[0], a.size(), PERFTESTS_UNIFORM, 0);
+
+  perftest_latency<gheap<2, 1> >("gheap<2, 1>", a, n, m);
+  perftest_latency<gheap<4, 1> >("gheap<4, 1>", a, n, m);
+  perftest_latency<gheap<8, 1> >("gheap<8, 1>", a, n, m);
+  perftest_latency<gheap<16, 1> >("gheap<16, 1>", a, n, m);
+  perftest_latency<gheap<2, 16> >("gheap<2, 16>", a, n, m);
+  perftest_latency<gheap<4, 4> >("gheap<4, 4>", a, n, m);
+}
+
+}  // end of anonymous namespace.
+
+
+int main(void)
+{
+  static const size_t M = 1000 * 1000;
+
+  timer_overhead = get_timer_overhead();
+  cout << "latencies are in ns, timer overhead=" << timer_overhead <<
+      " ns is subtracted" << endl;
+
+  for (size_t n = 1024; n <= 4 * 1024 * 1024; n *= 32) {
+    perftest_latencies(n, M);
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef PERFTESTS_MEMORY_H
+#define PERFTESTS_MEMORY_H
+
+/*
+ * Peak resident set size sampling for perftests.c and perftests.cpp.
+ *
+ * The peak is read from VmHWM in /proc/self/status and is reset by writing
+ * "5" to /proc/self/clear_refs, so the peak may be measured for each
+ * benchmark separately. On systems without these files the peak
+ * is obtained via getrusage() and cannot be reset, so it covers
+ * the whole process lifetime.
+ *
+ * The difference between the peak and the resident set size at the reset
+ * approximates memory touched by the benchmark, including memory allocated
+ * via malloc(), so it is available for C benchmarks, which cannot replace
+ * the global allocator.
+ */
+
+#include <stdio.h>          /* for fopen(), fgets(), sscanf(), fclose() */
+#include <string.h>         /* for strlen(), strncmp() */
+#include <sys/resource.h>   /* for getrusage() */
+
+/*
+ * Resets the peak resident set size to the current resident set size.
+ * Returns non-zero on success.
+ */
+static inline int perftests_reset_peak_rss(void)
+{
+  FILE *const f = fopen("/proc/self/clear_refs", "w");
+  if (f == NULL) {
+    return 0;
+  }
+  const int is_written = (fputs("5", f) >= 0);
+  return (fclose(f) == 0) && is_written;
+}
+
+/*
+ * Returns the value in KB of the given field from /proc/self/status.
+ * Returns -1 if the field cannot be read.
+ */
+static inline long perftests_get_status_field(const char *const name)
+{
+  FILE *const f = fopen("/proc/self/status", "r");
+  if (f == NULL) {
+    return -1;
+  }
+  char line[256];
+  long value = -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    const size_t name_size = strlen(name);
+    if (strncmp(line, name, name_size) == 0 && line[name_size] == ':' &&
+        sscanf(line + name_size + 1, "%ld", &value) == 1) {
+      break;
+    }
+  }
+  fclose(f);
+  return value;
+}
+
+/*
+ * Returns the current resident set size in KB or -1 if it is unknown.
+ */
+static inline long perftests_get_rss(void)
+{
+  return perftests_get_status_field("VmRSS");
+}
+
+/*
+ * Returns the peak resident set size in KB.
+ */
+static inline long perftests_get_peak_rss(void)
+{
+  const long peak_rss = perftests_get_status_field("VmHWM");
+  if (peak_rss >= 0) {
+    return peak_rss;
+  }
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return usage.ru_maxrss;
+}
+
+#endif
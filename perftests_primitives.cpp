@@ -0,0 +1,424 @@
+// Micro-benchmarks for gheap primitives across Fanout and PageChunks values.
+//
+// End-to-end perftests hide the cost of index math and sift loops inside
+// algorithm timings. This program measures them in isolation:
+// - get_parent_index() and get_child_index(). Paged heaps are measured
+//   separately for indices taking the fast path (the parent or the child
+//   is on the same page) and the slow path (it is on another page).
+// - _sift_up(), _sift_down() and _move_up_max_child(). These are private,
+//   so they are measured via the thinnest public wrappers:
+//   * sift_up - restore_heap_after_item_increase() for a leaf item, which
+//     becomes the new maximum, so it is sifted up along the whole path;
+//   * sift_down - restore_heap_after_item_decrease() for a root's child,
+//     which becomes the new minimum, so it is sifted down to a leaf;
+//   * move_up_max_child - restore_heap_after_item_decrease() for an item
+//     with leaf children, so exactly one max child is moved up.
+//
+// Each primitive has two variants:
+// - throughput - arguments of consecutive calls are independent, so CPU
+//   may overlap calls;
+// - latency - the argument of each call depends on the result
+//   of the previous call, so calls are serialized.
+//
+// ns/call and instructions/call include loop overhead of a few instructions.
+// Instructions are counted via perf_event_open() on Linux and reported
+// as n/a if hardware counters are unavailable.
+//
+// Pass -DGHEAP_CPP11 to compiler for gheap_cpp11.hpp tests,
+// otherwise gheap_cpp03.hpp will be tested.
+
+#include "gheap.hpp"
+#include "perftests_counters.h"
+#include "perftests_distributions.hpp"
+
+#include <iostream>
+#include <stdint.h>   // for uint64_t
+#include <string>     // for string
+#include <time.h>     // for clock_gettime()
+#include <vector>     // for vector
+
+using namespace std;
+
+namespace {
+
+// The number of items in heaps for sift benchmarks. Such heap fits L2 cache,
+// so memory latency doesn't dominate timings.
+const size_t HEAP_SIZE = 64 * 1024;
+
+// The number of arguments for index math benchmarks. They fit L1 cache.
+const size_t INDEX_ARGS_COUNT = 4 * 1024;
+
+// The number of calls per index math benchmark.
+const size_t INDEX_CALLS_COUNT = 4 * 1024 * 1024;
+
+// The minimum number of calls per sift benchmark.
+const size_t SIFT_CALLS_COUNT = 1024 * 1024;
+
+// Prevents the compiler from optimizing out benchmark results.
+volatile size_t result_sink;
+
+uint64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Always 0, but the compiler cannot prove this, so adding
+// (result & dependency_mask) to the next call's argument serializes calls.
+volatile size_t dependency_mask = 0;
+
+void shuffle(vector<size_t> &a, perftests_rng &rng)
+{
+  for (size_t i = a.size(); i > 1; --i) {
+    const size_t j = rng.next(i);
+    const size_t tmp = a[i - 1];
+    a[i - 1] = a[j];
+    a[j] = tmp;
+  }
+}
+
+// Accumulates time and retired instructions over multiple timed regions.
+class measurement
+{
+private:
+
+  int _counter_fd;
+  uint64_t _start_time;
+  uint64_t _total_time;
+  uint64_t _instructions_count;
+  size_t _calls_count;
+
+public:
+
+  measurement() :
+      _counter_fd(perftests_counter_open()), _start_time(0), _total_time(0),
+      _instructions_count(0), _calls_count(0) {}
+
+  ~measurement()
+  {
+    perftests_counter_close(_counter_fd);
+  }
+
+  void start()
+  {
+    perftests_counter_start(_counter_fd);
+    _start_time = get_time_ns();
+  }
+
+  void stop(const size_t calls_count)
+  {
+    const uint64_t end_time = get_time_ns();
+    _instructions_count += perftests_counter_stop(_counter_fd);
+    _total_time += end_time - _start_time;
+    _calls_count += calls_count;
+  }
+
+  void print(const char *const name, const char *const args) const
+  {
+    cout << "  " << name << "(" << args << "): " <<
+        (double)_total_time / _calls_count << " ns/call, instructions/call=";
+    if (_counter_fd >= 0) {
+      cout << (double)_instructions_count / _calls_count;
+    }
+    else {
+      cout << "n/a";
+    }
+    cout << endl;
+  }
+
+private:
+
+  measurement(const measurement &);
+  void operator = (const measurement &);
+};
+
+struct get_parent_index_function
+{
+  static const char *get_name()
+  {
+    return "get_parent_index";
+  }
+
+  template <class Heap>
+  static size_t call(const size_t u)
+  {
+    return Heap::get_parent_index(u);
+  }
+
+  // Returns true if get_parent_index(u) takes the slow path.
+  template <class Heap>
+  static bool is_slow_path(const size_t u)
+  {
+    return (u - 1 >= Heap::FANOUT && (u - 1) % Heap::PAGE_SIZE < Heap::FANOUT);
+  }
+};
+
+struct get_child_index_function
+{
+  static const char *get_name()
+  {
+    return "get_child_index";
+  }
+
+  template <class Heap>
+  static size_t call(const size_t u)
+  {
+    return Heap::get_child_index(u);
+  }
+
+  // Returns true if get_child_index(u) takes the slow path.
+  template <class Heap>
+  static bool is_slow_path(const size_t u)
+  {
+    return ((u - 1) % Heap::PAGE_SIZE + 1 >= Heap::PAGE_CHUNKS);
+  }
+};
+
+template <class Heap, class Function>
+void measure_index_function(const vector<size_t> &args,
+    const char *const args_name)
+{
+  const size_t repeats_count = INDEX_CALLS_COUNT / args.size();
+
+  measurement throughput;
+  size_t sum = 0;
+  throughput.start();
+  for (size_t r = 0; r < repeats_count; ++r) {
+    for (size_t i = 0; i < args.size(); ++i) {
+      sum += Function::template call<Heap>(args[i]);
+    }
+  }
+  throughput.stop(repeats_count * args.size());
+
+  measurement latency;
+  const size_t mask = dependency_mask;
+  size_t result = 0;
+  latency.start();
+  for (size_t r = 0; r < repeats_count; ++r) {
+    for (size_t i = 0; i < args.size(); ++i) {
+      result = Function::template call<Heap>(args[i] + (result & mask));
+    }
+  }
+  latency.stop(repeats_count * args.size());
+
+  result_sink = sum + result;
+
+  const string throughput_name = string(args_name) + ", throughput";
+  throughput.print(Function::get_name(), throughput_name.c_str());
+  const string latency_name = string(args_name) + ", latency";
+  latency.print(Function::get_name(), latency_name.c_str());
+}
+
+template <class Heap, class Function>
+void perftest_index_function()
+{
+  perftests_rng rng(0);
+  vector<size_t> all_args;
+  while (all_args.size() < INDEX_ARGS_COUNT) {
+    all_args.push_back(rng.next(HEAP_SIZE - 1) + 1);
+  }
+
+  if (Heap::PAGE_CHUNKS == 1) {
+    // Non-paged heaps have no slow path.
+    measure_index_function<Heap, Function>(all_args, "all");
+    return;
+  }
+
+  vector<size_t> fast_args, slow_args;
+  while (fast_args.size() < INDEX_ARGS_COUNT ||
+      slow_args.size() < INDEX_ARGS_COUNT) {
+    const size_t u = rng.next(HEAP_SIZE - 1) + 1;
+    vector<size_t> &args = Function::template is_slow_path<Heap>(u) ?
+        slow_args : fast_args;
+    if (args.size() < INDEX_ARGS_COUNT) {
+      args.push_back(u);
+    }
+  }
+  measure_index_function<Heap, Function>(all_args, "mixed");
+  measure_index_function<Heap, Function>(fast_args, "fast");
+  measure_index_function<Heap, Function>(slow_args, "slow");
+}
+
+struct sift_up_operation
+{
+  static const char *get_name()
+  {
+    return "sift_up";
+  }
+
+  // Returns leaf indices.
+  template <class Heap>
+  static void get_args(vector<size_t> &args)
+  {
+    for (size_t u = 0; u < HEAP_SIZE; ++u) {
+      if (Heap::get_child_index(u) >= HEAP_SIZE) {
+        args.push_back(u);
+      }
+    }
+  }
+
+  // Returns the index of the item, which is read by the next call
+  // in the latency variant.
+  template <class Heap>
+  static size_t call(vector<size_t> &a, const size_t u, size_t &max_item)
+  {
+    a[u] = ++max_item;
+    Heap::restore_heap_after_item_increase(a.begin(), a.begin() + u);
+    return 0;
+  }
+};
+
+struct sift_down_operation
+{
+  static const char *get_name()
+  {
+    return "sift_down";
+  }
+
+  // Returns root's children indices. Their sub-heaps don't overlap,
+  // so consecutive calls are independent in the throughput variant.
+  template <class Heap>
+  static void get_args(vector<size_t> &args)
+  {
+    while (args.size() < HEAP_SIZE / 4) {
+      for (size_t u = 1; u <= Heap::FANOUT; ++u) {
+        args.push_back(u);
+      }
+    }
+  }
+
+  template <class Heap>
+  static size_t call(vector<size_t> &a, const size_t u, size_t &)
+  {
+    a[u] = 0;
+    Heap::restore_heap_after_item_decrease(a.begin(), a.begin() + u, a.end());
+    return u;
+  }
+};
+
+struct move_up_max_child_operation
+{
+  static const char *get_name()
+  {
+    return "move_up_max_child";
+  }
+
+  // Returns indices of items, which have Fanout leaf children.
+  template <class Heap>
+  static void get_args(vector<size_t> &args)
+  {
+    for (size_t u = 0; u < HEAP_SIZE; ++u) {
+      const size_t child_index = Heap::get_child_index(u);
+      if (child_index > HEAP_SIZE - Heap::FANOUT) {
+        continue;
+      }
+      bool has_leaf_children = true;
+      for (size_t i = 0; i < Heap::FANOUT; ++i) {
+        if (Heap::get_child_index(child_index + i) < HEAP_SIZE) {
+          has_leaf_children = false;
+        }
+      }
+      if (has_leaf_children) {
+        args.push_back(u);
+      }
+    }
+  }
+
+  template <class Heap>
+  static size_t call(vector<size_t> &a, const size_t u, size_t &)
+  {
+    a[u] = 0;
+    Heap::restore_heap_after_item_decrease(a.begin(), a.begin() + u, a.end());
+    return u;
+  }
+};
+
+template <class Heap, class Operation>
+void perftest_sift_operation(const vector<size_t> &heap)
+{
+  perftests_rng rng(0);
+  vector<size_t> args;
+  Operation::template get_args<Heap>(args);
+  shuffle(args, rng);
+
+  const size_t rounds_count = (SIFT_CALLS_COUNT + args.size() - 1) /
+      args.size();
+  vector<size_t> a;
+
+  // Items in the heap are smaller than 2^(bits_in_size_t - 2), while
+  // new max items are bigger, so they are sifted up to the root.
+  size_t max_item = ~static_cast<size_t>(0) >> 2;
+
+  measurement throughput;
+  for (size_t r = 0; r < rounds_count; ++r) {
+    a = heap;
+    throughput.start();
+    for (size_t i = 0; i < args.size(); ++i) {
+      Operation::template call<Heap>(a, args[i], max_item);
+    }
+    throughput.stop(args.size());
+  }
+
+  measurement latency;
+  const size_t mask = dependency_mask;
+  for (size_t r = 0; r < rounds_count; ++r) {
+    a = heap;
+    size_t result_index = 0;
+    latency.start();
+    for (size_t i = 0; i < args.size(); ++i) {
+      const size_t u = args[i] + (a[result_index] & mask);
+      result_index = Operation::template call<Heap>(a, u, max_item);
+    }
+    latency.stop(args.size());
+  }
+
+  result_sink = a[0];
+
+  throughput.print(Operation::get_name(), "throughput");
+  latency.print(Operation::get_name(), "latency");
+}
+
+template <class Heap>
+void perftest_primitives()
+{
+  cout << "perftest_primitives(fanout=" << Heap::FANOUT << ", page_chunks=" <<
+      Heap::PAGE_CHUNKS << ")" << endl;
+
+  perftest_index_function<Heap, get_parent_index_function>();
+  perftest_index_function<Heap, get_child_index_function>();
+
+  perftests_rng rng(1);
+  vector<size_t> heap(HEAP_SIZE);
+  for (size_t i = 0; i < HEAP_SIZE; ++i) {
+    heap[i] = rng.next() >> 2;
+  }
+  Heap::make_heap(heap.begin(), heap.end());
+
+  perftest_sift_operation<Heap, sift_up_operation>(heap);
+  perftest_sift_operation<Heap, sift_down_operation>(heap);
+  perftest_sift_operation<Heap, move_up_max_child_operation>(heap);
+}
+
+}  // end of anonymous namespace.
+
+
+int main(void)
+{
+  const int counter_fd = perftests_counter_open();
+  cout << "heap_size=" << HEAP_SIZE << ", instructions counter is " <<
+      (counter_fd >= 0 ? "available" : "unavailable") << endl;
+  perftests_counter_close(counter_fd);
+
+#define PRIMITIVES_CONFIGS(F) \
+  F(2, 1) F(2, 2) F(2, 16) \
+  F(4, 1) F(4, 2) F(4, 16) \
+  F(8, 1) F(8, 2) F(8, 16) \
+  F(16, 1) F(16, 2) F(16, 16)
+
+#define PRIMITIVES_RUN(Fanout, PageChunks) \
+  perftest_primitives<gheap<Fanout, PageChunks> >();
+  PRIMITIVES_CONFIGS(PRIMITIVES_RUN)
+#undef PRIMITIVES_RUN
+#undef PRIMITIVES_CONFIGS
+}
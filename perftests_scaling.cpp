@@ -0,0 +1,660 @@
+// Measures multi-core scaling of gheap-based workloads.
+//
+// Usage: perftests_scaling [max_threads]
+//
+// Each workload runs for a fixed time at 1, 2, 4 ... max_threads threads.
+// Threads are pinned to distinct CPUs if possible, so results don't depend
+// on the scheduler's thread migration. The following is reported for each
+// threads count:
+// - throughput of all the threads in Kops/s;
+// - speedup relative to a single thread;
+// - fairness - Jain's fairness index of per-thread operation counts,
+//   which is 1 when all the threads performed the same number
+//   of operations and 1 / threads when a single thread did all the work;
+// - the minimum and the maximum per-thread operation counts.
+//
+// New workloads are added by implementing a class with a constructor
+// accepting the number of threads and the following method:
+//
+//   // Runs the workload in the thread with the given index
+//   // until is_done becomes true. Returns the number of operations.
+//   size_t run(size_t thread_index, const std::atomic<bool> &is_done);
+//
+// Parallel algorithms, gbatch_priority_queue and gtask_scheduler are measured
+// by running a fixed amount of work on executors with the given number
+// of threads. Throughput and speedup are reported for them.
+//
+// Concurrent features must be measured with this harness against
+// thread_local_queues and locked_queue baselines.
+//
+// max_threads defaults to the number of CPUs. Requires C++11.
+
+#ifndef GHEAP_CPP11
+#  error "perftests_scaling.cpp requires C++11. Pass -DGHEAP_CPP11 to compiler"
+#endif
+
+#include "galgorithm.hpp"
+#include "gbatch_priority_queue.hpp"
+#include "gheap.hpp"
+#include "gpriority_queue.hpp"
+#include "gshared_priority_queue.hpp"
+#include "gtask_scheduler.hpp"
+#include "gthread_pool.hpp"
+#include "perftests_distributions.hpp"
+
+#include <algorithm>  // for sort()
+#include <atomic>     // for atomic
+#include <chrono>     // for steady_clock
+#include <cstdlib>    // for atoi()
+#include <iostream>
+#include <mutex>      // for mutex, lock_guard
+#include <thread>     // for thread
+#include <utility>    // for pair
+#include <vector>     // for vector
+
+#ifdef __linux__
+#  include <pthread.h>  // for pthread_setaffinity_np()
+#  include <sched.h>    // for cpu_set_t, CPU_ZERO(), CPU_SET()
+#endif
+
+using namespace std;
+
+namespace {
+
+typedef gheap<4, 1> heap;
+typedef gpriority_queue<heap, size_t> priority_queue;
+
+// The number of items in each queue.
+const size_t QUEUE_SIZE = 64 * 1024;
+
+// The duration of each workload run in seconds.
+const double RUN_DURATION = 0.5;
+
+double get_wall_time()
+{
+  const chrono::steady_clock::duration t =
+      chrono::steady_clock::now().time_since_epoch();
+  return chrono::duration_cast<chrono::duration<double> >(t).count();
+}
+
+// Pins the current thread to the given CPU. Returns false if pinning
+// isn't supported.
+bool pin_current_thread(const size_t cpu)
+{
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu % CPU_SETSIZE, &cpus);
+  return (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0);
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+// Wrapper, which prevents false sharing between adjacent items.
+// std::allocator ignores over-alignment before C++17, so the padding
+// is added after the value instead of relying on alignas().
+template <class T>
+struct padded
+{
+  T value;
+  char padding[64];
+};
+
+void init_queue(priority_queue &q, const size_t seed)
+{
+  vector<size_t> a(QUEUE_SIZE);
+  perftests_generate(&a[0], QUEUE_SIZE, PERFTESTS_UNIFORM, seed);
+  priority_queue(a.begin(), a.end()).swap(q);
+}
+
+// Each thread works with its own queue. This is the ideal scaling baseline
+// limited only by memory bandwidth and caches. If IsPadded is false,
+// queue objects are packed, so containers' bookkeeping of neighbor queues
+// shares cache lines, which are written on each push() and pop().
+template <bool IsPadded>
+class thread_local_queues
+{
+private:
+
+  vector<padded<priority_queue> > _padded_queues;
+  vector<priority_queue> _packed_queues;
+
+  priority_queue &_get_queue(const size_t thread_index)
+  {
+    return IsPadded ? _padded_queues[thread_index].value :
+        _packed_queues[thread_index];
+  }
+
+public:
+
+  static const char *get_name()
+  {
+    return IsPadded ? "thread_local_queues" : "false_sharing_queues";
+  }
+
+  explicit thread_local_queues(const size_t threads_count) :
+      _padded_queues(IsPadded ? threads_count : 0),
+      _packed_queues(IsPadded ? 0 : threads_count)
+  {
+    for (size_t i = 0; i < threads_count; ++i) {
+      init_queue(_get_queue(i), i);
+    }
+  }
+
+  size_t run(const size_t thread_index, const atomic<bool> &is_done)
+  {
+    priority_queue &q = _get_queue(thread_index);
+    perftests_rng rng(thread_index);
+    size_t ops_count = 0;
+    while (!is_done.load(memory_order_relaxed)) {
+      q.pop();
+      q.push(rng.next());
+      ++ops_count;
+    }
+    return ops_count;
+  }
+};
+
+// All the threads work with a single queue protected by a mutex.
+class locked_queue
+{
+private:
+
+  mutex _mutex;
+  priority_queue _q;
+
+public:
+
+  static const char *get_name()
+  {
+    return "locked_queue";
+  }
+
+  explicit locked_queue(size_t)
+  {
+    init_queue(_q, 0);
+  }
+
+  size_t run(const size_t thread_index, const atomic<bool> &is_done)
+  {
+    perftests_rng rng(thread_index);
+    size_t ops_count = 0;
+    while (!is_done.load(memory_order_relaxed)) {
+      const size_t item = rng.next();
+      lock_guard<mutex> lock(_mutex);
+      _q.pop();
+      _q.push(item);
+      ++ops_count;
+    }
+    return ops_count;
+  }
+};
+
+// All the threads work with a single gshared_priority_queue. Every thread
+// peeks at the top item before modifying the queue, like schedulers do.
+class shared_queue
+{
+private:
+
+  gshared_priority_queue<heap, size_t> _q;
+
+public:
+
+  static const char *get_name()
+  {
+    return "shared_queue";
+  }
+
+  explicit shared_queue(size_t)
+  {
+    vector<size_t> a(QUEUE_SIZE);
+    perftests_generate(&a[0], QUEUE_SIZE, PERFTESTS_UNIFORM, 0);
+    for (size_t i = 0; i < QUEUE_SIZE; ++i) {
+      _q.push(a[i]);
+    }
+  }
+
+  size_t run(const size_t thread_index, const atomic<bool> &is_done)
+  {
+    perftests_rng rng(thread_index);
+    size_t ops_count = 0;
+    size_t item;
+    while (!is_done.load(memory_order_relaxed)) {
+      _q.peek_top(item);
+      _q.try_pop(item);
+      _q.push(rng.next());
+      ++ops_count;
+    }
+    return ops_count;
+  }
+};
+
+// Each thread sorts its own array. Operations are sorted items.
+class thread_local_heapsort
+{
+private:
+
+  vector<padded<vector<size_t> > > _arrays;
+  vector<size_t> _input;
+
+public:
+
+  static const char *get_name()
+  {
+    return "thread_local_heapsort";
+  }
+
+  explicit thread_local_heapsort(const size_t threads_count) :
+      _arrays(threads_count), _input(QUEUE_SIZE)
+  {
+    perftests_generate(&_input[0], QUEUE_SIZE, PERFTESTS_UNIFORM, 0);
+  }
+
+  size_t run(const size_t thread_index, const atomic<bool> &is_done)
+  {
+    vector<size_t> &a = _arrays[thread_index].value;
+    size_t ops_count = 0;
+    while (!is_done.load(memory_order_relaxed)) {
+      a = _input;
+      galgorithm<heap>::heapsort(a.begin(), a.end());
+      ops_count += a.size();
+    }
+    return ops_count;
+  }
+};
+
+struct scaling_result
+{
+  double kops;
+  double fairness;
+  size_t min_ops_count;
+  size_t max_ops_count;
+};
+
+// Runs the workload on threads_count pinned threads for RUN_DURATION seconds.
+template <class Workload>
+scaling_result run_workload(const size_t threads_count)
+{
+  Workload workload(threads_count);
+  vector<padded<size_t> > ops_counts(threads_count);
+  atomic<size_t> ready_count(0);
+  atomic<bool> is_started(false);
+  atomic<bool> is_done(false);
+  const size_t cpus_count = thread::hardware_concurrency();
+
+  vector<thread> threads;
+  for (size_t i = 0; i < threads_count; ++i) {
+    threads.push_back(thread([&, i]() {
+      pin_current_thread((cpus_count == 0) ? 0 : i % cpus_count);
+      ++ready_count;
+      while (!is_started) {
+        this_thread::yield();
+      }
+      ops_counts[i].value = workload.run(i, is_done);
+    }));
+  }
+
+  while (ready_count < threads_count) {
+    this_thread::yield();
+  }
+  const double start = get_wall_time();
+  is_started = true;
+  this_thread::sleep_for(chrono::duration<double>(RUN_DURATION));
+  is_done = true;
+  for (size_t i = 0; i < threads_count; ++i) {
+    threads[i].join();
+  }
+  const double end = get_wall_time();
+
+  scaling_result result;
+  double sum = 0;
+  double sum_of_squares = 0;
+  result.min_ops_count = ops_counts[0].value;
+  result.max_ops_count = ops_counts[0].value;
+  for (size_t i = 0; i < threads_count; ++i) {
+    const size_t n = ops_counts[i].value;
+    sum += n;
+    sum_of_squares += (double)n * n;
+    if (n < result.min_ops_count) {
+      result.min_ops_count = n;
+    }
+    if (n > result.max_ops_count) {
+      result.max_ops_count = n;
+    }
+  }
+  result.kops = sum / (end - start) / 1000;
+  result.fairness = (sum_of_squares == 0) ? 1 :
+      sum * sum / (threads_count * sum_of_squares);
+  return result;
+}
+
+template <class Workload>
+void perftest_scaling(const size_t max_threads)
+{
+  double single_thread_kops = 0;
+  for (size_t threads_count = 1; ; threads_count *= 2) {
+    if (threads_count > max_threads) {
+      threads_count = max_threads;
+    }
+    const scaling_result r = run_workload<Workload>(threads_count);
+    if (threads_count == 1) {
+      single_thread_kops = r.kops;
+    }
+    cout << "perftest_scaling(" << Workload::get_name() << ", threads=" <<
+        threads_count << "): " << r.kops << " Kops/s, speedup=" <<
+        (r.kops / single_thread_kops) << ", fairness=" << r.fairness <<
+        ", per_thread_ops=[" << r.min_ops_count << " ... " <<
+        r.max_ops_count << "]" << endl;
+    if (threads_count == max_threads) {
+      break;
+    }
+  }
+}
+
+// The number of items processed by parallel algorithms in each run.
+const size_t PARALLEL_ITEMS_COUNT = 16 * 1024 * 1024;
+
+// The following workloads measure parallel algorithms and batch-parallel
+// containers running on executors with the given number of threads.
+// Executor threads aren't pinned, since executors don't expose their threads.
+//
+// Such workloads are implemented as classes with a constructor accepting
+// the number of threads, which prepares the input, and the following method:
+//
+//   // Runs the workload once. Returns the number of operations.
+//   size_t run();
+
+// Sorts the input via parallel_nway_mergesort(). Operations are sorted items.
+class parallel_nway_mergesort_workload
+{
+private:
+
+  gthread_pool _pool;
+  vector<size_t> _a;
+
+public:
+
+  static const char *get_name()
+  {
+    return "parallel_nway_mergesort";
+  }
+
+  explicit parallel_nway_mergesort_workload(const size_t threads_count) :
+      _pool(threads_count), _a(PARALLEL_ITEMS_COUNT)
+  {
+    perftests_generate(&_a[0], _a.size(), PERFTESTS_UNIFORM, 0);
+  }
+
+  size_t run()
+  {
+    galgorithm<heap>::parallel_nway_mergesort(_pool, _a.begin(), _a.end());
+    return _a.size();
+  }
+};
+
+// Creates a heap from the input via parallel_make_heap(). Operations
+// are heapified items.
+class parallel_make_heap_workload
+{
+private:
+
+  gthread_pool _pool;
+  vector<size_t> _a;
+
+public:
+
+  static const char *get_name()
+  {
+    return "parallel_make_heap";
+  }
+
+  explicit parallel_make_heap_workload(const size_t threads_count) :
+      _pool(threads_count), _a(PARALLEL_ITEMS_COUNT)
+  {
+    perftests_generate(&_a[0], _a.size(), PERFTESTS_UNIFORM, 0);
+  }
+
+  size_t run()
+  {
+    galgorithm<heap>::parallel_make_heap(_pool, _a.begin(), _a.end());
+    return _a.size();
+  }
+};
+
+// Selects the smallest 1/16 of the input via parallel_partial_sort().
+// Operations are input items.
+class parallel_partial_sort_workload
+{
+private:
+
+  gthread_pool _pool;
+  vector<size_t> _a;
+
+public:
+
+  static const char *get_name()
+  {
+    return "parallel_partial_sort";
+  }
+
+  explicit parallel_partial_sort_workload(const size_t threads_count) :
+      _pool(threads_count), _a(PARALLEL_ITEMS_COUNT)
+  {
+    perftests_generate(&_a[0], _a.size(), PERFTESTS_UNIFORM, 0);
+  }
+
+  size_t run()
+  {
+    galgorithm<heap>::parallel_partial_sort(_pool, _a.begin(),
+        _a.begin() + _a.size() / 16, _a.end());
+    return _a.size();
+  }
+};
+
+// Merges 64 sorted runs via parallel_nway_merge(). Operations are merged
+// items.
+class parallel_nway_merge_workload
+{
+private:
+
+  typedef vector<size_t>::const_iterator iterator;
+
+  static const size_t RUNS_COUNT = 64;
+
+  gthread_pool _pool;
+  vector<size_t> _input;
+  vector<size_t> _result;
+
+public:
+
+  static const char *get_name()
+  {
+    return "parallel_nway_merge";
+  }
+
+  explicit parallel_nway_merge_workload(const size_t threads_count) :
+      _pool(threads_count), _input(PARALLEL_ITEMS_COUNT),
+      _result(PARALLEL_ITEMS_COUNT)
+  {
+    perftests_generate(&_input[0], _input.size(), PERFTESTS_UNIFORM, 0);
+    const size_t run_size = _input.size() / RUNS_COUNT;
+    for (size_t i = 0; i < RUNS_COUNT; ++i) {
+      sort(_input.begin() + i * run_size, _input.begin() + (i + 1) * run_size);
+    }
+  }
+
+  size_t run()
+  {
+    const size_t run_size = _input.size() / RUNS_COUNT;
+    vector<pair<iterator, iterator> > input_ranges;
+    for (size_t i = 0; i < RUNS_COUNT; ++i) {
+      input_ranges.push_back(pair<iterator, iterator>(
+          _input.begin() + i * run_size, _input.begin() + (i + 1) * run_size));
+    }
+    galgorithm<heap>::parallel_nway_merge(_pool, input_ranges.begin(),
+        input_ranges.end(), _result.begin());
+    return RUNS_COUNT * run_size;
+  }
+};
+
+// Inserts batches into gbatch_priority_queue via insert_batch() and extracts
+// the same number of items via extract_k(). Batches are big enough,
+// so both operations run parallel algorithms. Operations are inserted
+// and extracted items.
+class gbatch_priority_queue_workload
+{
+private:
+
+  typedef gbatch_priority_queue<heap, size_t, gthread_pool> batch_queue;
+
+  static const size_t BATCHES_COUNT = 16;
+
+  gthread_pool _pool;
+  batch_queue _q;
+  vector<size_t> _batches;
+  vector<size_t> _result;
+
+public:
+
+  static const char *get_name()
+  {
+    return "gbatch_priority_queue";
+  }
+
+  explicit gbatch_priority_queue_workload(const size_t threads_count) :
+      _pool(threads_count), _q(_pool),
+      _batches(PARALLEL_ITEMS_COUNT / 2),
+      _result(_batches.size() / BATCHES_COUNT)
+  {
+    vector<size_t> a(PARALLEL_ITEMS_COUNT / 2);
+    perftests_generate(&a[0], a.size(), PERFTESTS_UNIFORM, 0);
+    _q.insert_batch(a.begin(), a.end());
+    perftests_generate(&_batches[0], _batches.size(), PERFTESTS_UNIFORM, 1);
+  }
+
+  size_t run()
+  {
+    const size_t batch_size = _result.size();
+    for (size_t i = 0; i < BATCHES_COUNT; ++i) {
+      _q.insert_batch(_batches.begin() + i * batch_size,
+          _batches.begin() + (i + 1) * batch_size);
+      _q.extract_k(batch_size, _result.begin());
+    }
+    return 2 * BATCHES_COUNT * batch_size;
+  }
+};
+
+// Runs tasks on gtask_scheduler. Root tasks are submitted from the current
+// thread, while each root task spawns child tasks with random priorities
+// on its worker, so workers steal tasks from each other. Each child task
+// heapsorts a small array. Operations are executed tasks.
+class gtask_scheduler_workload
+{
+private:
+
+  typedef gtask_scheduler<heap, size_t> task_scheduler;
+
+  static const size_t ROOT_TASKS_COUNT = 1024;
+  static const size_t CHILD_TASKS_COUNT = 256;
+  static const size_t TASK_ITEMS_COUNT = 64;
+
+  task_scheduler _scheduler;
+  vector<size_t> _results;
+
+  void _run_child_task(const size_t task_index)
+  {
+    size_t a[TASK_ITEMS_COUNT];
+    perftests_generate(a, TASK_ITEMS_COUNT, PERFTESTS_UNIFORM, task_index);
+    galgorithm<heap>::heapsort(&a[0], &a[0] + TASK_ITEMS_COUNT);
+    _results[task_index] = a[0];
+  }
+
+  void _run_root_task(const size_t root_index)
+  {
+    perftests_rng rng(root_index);
+    for (size_t i = 0; i < CHILD_TASKS_COUNT; ++i) {
+      const size_t task_index = root_index * CHILD_TASKS_COUNT + i;
+      _scheduler.submit(rng.next(), [this, task_index]() {
+        _run_child_task(task_index);
+      });
+    }
+  }
+
+public:
+
+  static const char *get_name()
+  {
+    return "gtask_scheduler";
+  }
+
+  explicit gtask_scheduler_workload(const size_t threads_count) :
+      _scheduler(threads_count),
+      _results(ROOT_TASKS_COUNT * CHILD_TASKS_COUNT) {}
+
+  size_t run()
+  {
+    for (size_t i = 0; i < ROOT_TASKS_COUNT; ++i) {
+      _scheduler.submit(0, [this, i]() {
+        _run_root_task(i);
+      });
+    }
+    _scheduler.wait();
+    return ROOT_TASKS_COUNT * (CHILD_TASKS_COUNT + 1);
+  }
+};
+
+template <class Workload>
+void perftest_executor_scaling(const size_t max_threads)
+{
+  double single_thread_kops = 0;
+  for (size_t threads_count = 1; ; threads_count *= 2) {
+    if (threads_count > max_threads) {
+      threads_count = max_threads;
+    }
+    Workload workload(threads_count);
+    const double start = get_wall_time();
+    const size_t ops_count = workload.run();
+    const double end = get_wall_time();
+    const double kops = ops_count / (end - start) / 1000;
+    if (threads_count == 1) {
+      single_thread_kops = kops;
+    }
+    cout << "perftest_scaling(" << Workload::get_name() << ", threads=" <<
+        threads_count << "): " << kops << " Kops/s, speedup=" <<
+        (kops / single_thread_kops) << endl;
+    if (threads_count == max_threads) {
+      break;
+    }
+  }
+}
+
+}  // end of anonymous namespace.
+
+
+int main(int argc, char **argv)
+{
+  size_t max_threads = thread::hardware_concurrency();
+  if (argc > 1) {
+    max_threads = atoi(argv[1]);
+  }
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+
+  cout << "max_threads=" << max_threads << ", queue_size=" << QUEUE_SIZE <<
+      ", run_duration=" << RUN_DURATION << "s" << endl;
+
+  perftest_scaling<thread_local_queues<true> >(max_threads);
+  perftest_scaling<thread_local_queues<false> >(max_threads);
+  perftest_scaling<locked_queue>(max_threads);
+  perftest_scaling<shared_queue>(max_threads);
+  perftest_scaling<thread_local_heapsort>(max_threads);
+  perftest_executor_scaling<parallel_nway_mergesort_workload>(max_threads);
+  perftest_executor_scaling<parallel_make_heap_workload>(max_threads);
+  perftest_executor_scaling<parallel_partial_sort_workload>(max_threads);
+  perftest_executor_scaling<parallel_nway_merge_workload>(max_threads);
+  perftest_executor_scaling<gbatch_priority_queue_workload>(max_threads);
+  perftest_executor_scaling<gtask_scheduler_workload>(max_threads);
+}
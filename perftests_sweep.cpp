@@ -0,0 +1,243 @@
+// Measures gheap performance for various item sizes and comparator costs
+// across Fanout and PageChunks values.
+//
+// d-heaps with bigger Fanout perform fewer item moves at the cost of more
+// comparisons, while B-heaps with bigger PageChunks improve memory locality
+// at the cost of more complex index math. So the best configuration depends
+// on item size and comparator cost. The output is a matrix with a row
+// per (operation, item size, comparator) and a column per configuration,
+// so the fastest configuration may be picked for the given workload.
+//
+// Pass -DGHEAP_CPP11 to compiler for gheap_cpp11.hpp tests,
+// otherwise gheap_cpp03.hpp will be tested.
+
+#include "galgorithm.hpp"
+#include "gheap.hpp"
+#include "gpriority_queue.hpp"
+#include "perftests_distributions.hpp"
+
+#include <cstdio>     // for snprintf()
+#include <cstring>    // for strcmp()
+#include <ctime>      // for clock()
+#include <iomanip>    // for setw()
+#include <iostream>
+#include <stdint.h>   // for uint32_t, uint64_t
+#include <vector>     // for vector
+
+using namespace std;
+
+namespace {
+
+// The number of distinct keys. Comparator tables are bigger than CPU
+// caches, so indirect comparators incur cache misses.
+const size_t KEYS_COUNT = 1 << 20;
+
+double get_time()
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// Item of the given size in bytes.
+template <size_t Size>
+struct sweep_item
+{
+  uint32_t key;
+  char payload[Size - sizeof(uint32_t)];
+};
+
+template <>
+struct sweep_item<sizeof(uint32_t)>
+{
+  uint32_t key;
+};
+
+// Compares keys inline. The cheapest comparator.
+struct inline_comparer
+{
+  static const char *get_name()
+  {
+    return "inline";
+  }
+
+  template <class Item>
+  bool operator () (const Item &a, const Item &b) const
+  {
+    return (a.key < b.key);
+  }
+};
+
+// Compares string representations of keys.
+struct string_comparer
+{
+  static vector<char> strings;
+  static const size_t string_size = 24;
+
+  static const char *get_name()
+  {
+    return "string";
+  }
+
+  static void init()
+  {
+    strings.resize(KEYS_COUNT * string_size);
+    for (size_t i = 0; i < KEYS_COUNT; ++i) {
+      snprintf(&strings[i * string_size], string_size, "key:%016lx",
+          static_cast<unsigned long>(i));
+    }
+  }
+
+  template <class Item>
+  bool operator () (const Item &a, const Item &b) const
+  {
+    return (strcmp(&strings[a.key * string_size],
+        &strings[b.key * string_size]) < 0);
+  }
+};
+
+vector<char> string_comparer::strings;
+
+// Compares priorities looked up by keys in a big table.
+struct indirect_comparer
+{
+  static vector<uint64_t> priorities;
+
+  static const char *get_name()
+  {
+    return "indirect";
+  }
+
+  static void init()
+  {
+    perftests_generate_ranks(priorities, KEYS_COUNT, PERFTESTS_UNIFORM, 0);
+  }
+
+  template <class Item>
+  bool operator () (const Item &a, const Item &b) const
+  {
+    return (priorities[a.key] < priorities[b.key]);
+  }
+};
+
+vector<uint64_t> indirect_comparer::priorities;
+
+template <class Item>
+void init_items(vector<Item> &a, const size_t n)
+{
+  vector<uint64_t> ranks;
+  perftests_generate_ranks(ranks, n, PERFTESTS_UNIFORM, 1);
+  a.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    a[i].key = static_cast<uint32_t>(ranks[i] % KEYS_COUNT);
+  }
+}
+
+// Returns heapsort performance in Kops/s.
+template <class Heap, class Item, class Comparer>
+double measure_heapsort(const size_t n, const size_t m)
+{
+  vector<Item> input, a;
+  init_items(input, n);
+
+  double total_time = 0;
+  for (size_t i = 0; i < m / n; ++i) {
+    a = input;
+    const double start = get_time();
+    galgorithm<Heap>::heapsort(a.begin(), a.end(), Comparer());
+    const double end = get_time();
+    total_time += end - start;
+  }
+  return m / total_time / 1000;
+}
+
+// Returns priority queue pop() + push() performance in Kops/s.
+template <class Heap, class Item, class Comparer>
+double measure_priority_queue(const size_t n, const size_t m)
+{
+  vector<Item> input;
+  init_items(input, n + m);
+
+  gpriority_queue<Heap, Item, vector<Item>, Comparer> q(input.begin(),
+      input.begin() + n);
+  const double start = get_time();
+  for (size_t i = 0; i < m; ++i) {
+    q.pop();
+    q.push(input[n + i]);
+  }
+  const double end = get_time();
+  return m / (end - start) / 1000;
+}
+
+// Fanout and PageChunks values for matrix columns.
+#define SWEEP_CONFIGS(F) \
+  F(2, 1) F(2, 2) F(2, 4) F(2, 16) \
+  F(3, 1) F(3, 2) F(3, 4) F(3, 16) \
+  F(4, 1) F(4, 2) F(4, 4) F(4, 16) \
+  F(8, 1) F(8, 2) F(8, 4) F(8, 16) \
+  F(16, 1) F(16, 2) F(16, 4) F(16, 16)
+
+const int COLUMN_WIDTH = 9;
+
+void print_header()
+{
+  cout << setw(40) << left << "Kops/s" << right;
+#define SWEEP_HEADER(Fanout, PageChunks) \
+  cout << setw(COLUMN_WIDTH) << (#Fanout "x" #PageChunks);
+  SWEEP_CONFIGS(SWEEP_HEADER)
+#undef SWEEP_HEADER
+  cout << endl;
+}
+
+template <size_t ItemSize, class Comparer>
+void sweep_row(const size_t n, const size_t m)
+{
+  typedef sweep_item<ItemSize> item;
+
+  cout << "heapsort(item_size=" << setw(3) << ItemSize << ", cmp=" <<
+      setw(8) << left << Comparer::get_name() << right << ")  ";
+#define SWEEP_HEAPSORT(Fanout, PageChunks) \
+  cout << setw(COLUMN_WIDTH) << (int)measure_heapsort< \
+      gheap<Fanout, PageChunks>, item, Comparer>(n, m) << flush;
+  SWEEP_CONFIGS(SWEEP_HEAPSORT)
+#undef SWEEP_HEAPSORT
+  cout << endl;
+
+  cout << "pqueue  (item_size=" << setw(3) << ItemSize << ", cmp=" <<
+      setw(8) << left << Comparer::get_name() << right << ")  ";
+#define SWEEP_PRIORITY_QUEUE(Fanout, PageChunks) \
+  cout << setw(COLUMN_WIDTH) << (int)measure_priority_queue< \
+      gheap<Fanout, PageChunks>, item, Comparer>(n, m) << flush;
+  SWEEP_CONFIGS(SWEEP_PRIORITY_QUEUE)
+#undef SWEEP_PRIORITY_QUEUE
+  cout << endl;
+}
+
+template <size_t ItemSize>
+void sweep_item_size(const size_t n, const size_t m)
+{
+  sweep_row<ItemSize, inline_comparer>(n, m);
+  sweep_row<ItemSize, string_comparer>(n, m);
+  sweep_row<ItemSize, indirect_comparer>(n, m);
+}
+
+}  // end of anonymous namespace.
+
+
+int main(void)
+{
+  static const size_t N = 64 * 1024;
+  static const size_t M = 4 * N;
+
+  string_comparer::init();
+  indirect_comparer::init();
+
+  cout << "n=" << N << ", m=" << M << ", columns are Fanout x PageChunks" <<
+      endl;
+  print_header();
+  sweep_item_size<4>(N, M);
+  sweep_item_size<8>(N, M);
+  sweep_item_size<16>(N, M);
+  sweep_item_size<32>(N, M);
+  sweep_item_size<64>(N, M);
+  sweep_item_size<128>(N, M);
+  sweep_item_size<256>(N, M);
+}
@@ -1,13 +1,23 @@
 /* Tests for C99 gheap, galgorithm and gpriority_queue */
 
+/* gfile_run.h requires POSIX and Linux extensions. */
+#define _GNU_SOURCE
+
 #include "galgorithm.h"
+#include "gfile_run.h"
 #include "gheap.h"
+#include "gkeyed_priority_queue.h"
+#include "gmapped_run.h"
 #include "gpriority_queue.h"
 
 #include <assert.h>
+#include <fcntl.h>     /* for open(), O_* */
 #include <stdint.h>    /* for uintptr_t, SIZE_MAX */
 #include <stdio.h>     /* for printf() */
-#include <stdlib.h>    /* for srand(), rand(), malloc(), free() */
+#include <signal.h>    /* for SIGABRT */
+#include <stdlib.h>    /* for srand(), rand(), malloc(), free(), mkstemp() */
+#include <sys/wait.h>  /* for waitpid(), W* */
+#include <unistd.h>    /* for write(), pread(), close(), unlink(), fork() */
 
 static int less_comparer(const void *const ctx, const void *const a,
     const void *const b)
@@ -528,6 +538,193 @@ static void test_nway_merge(const struct gheap_ctx *const ctx,
   printf("OK\n");
 }
 
+/*
+ * Writes n items into a temporary file and returns its descriptor opened
+ * for reading. Opens the file with O_DIRECT if is_direct is set.
+ * Returns -1 if the file system doesn't support O_DIRECT.
+ */
+static int create_run_file(const int *const a, const size_t n,
+    const int is_direct)
+{
+  char path[] = "/tmp/gheap_tests_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+
+  const ssize_t size = n * sizeof(a[0]);
+  const ssize_t written = write(fd, a, size);
+  assert(written == size);
+  (void)written;
+
+  if (is_direct) {
+    close(fd);
+    fd = open(path, O_RDONLY | O_DIRECT);
+  }
+  unlink(path);
+  return fd;
+}
+
+static void test_file_runs(const struct gheap_ctx *const ctx,
+    const size_t n, int *const a)
+{
+  printf("    test_file_runs(n=%zu) ", n);
+
+  /* The last run is empty. */
+  const size_t runs_count = n % 4 + 2;
+  const size_t parts_count = runs_count - 1;
+
+  int *const b = malloc(sizeof(*b) * n);
+  int *const fds = malloc(sizeof(*fds) * runs_count);
+
+  struct nway_merge_output_ctx out_ctx;
+
+  const struct galgorithm_nway_merge_output output = {
+    .vtable = &nway_merge_output_vtable,
+    .ctx = &out_ctx,
+  };
+
+  /*
+   * Verify io_uring reads, pread() fallback and O_DIRECT reads.
+   * Small blocks force frequent buffer switching.
+   */
+  static const int flags[] = {0, GFILE_RUNS_NO_IO_URING, 0};
+  static const int is_direct[] = {0, 0, 1};
+  static const size_t block_sizes[] = {
+    3 * sizeof(int), 3 * sizeof(int), GFILE_RUN_BUFFER_ALIGNMENT,
+  };
+  for (size_t mode = 0; mode < 3; ++mode) {
+    init_array(a, n);
+    size_t first = 0;
+    int is_supported = 1;
+    for (size_t i = 0; i < runs_count; ++i) {
+      const size_t last = (i < parts_count) ? (i + 1) * n / parts_count : n;
+      galgorithm_heapsort(ctx, a + first, last - first);
+      fds[i] = create_run_file(a + first, last - first, is_direct[mode]);
+      if (fds[i] < 0) {
+        is_supported = 0;
+      }
+      first = last;
+    }
+    if (!is_supported) {
+      /* The file system doesn't support O_DIRECT. */
+      for (size_t i = 0; i < runs_count; ++i) {
+        if (fds[i] >= 0) {
+          close(fds[i]);
+        }
+      }
+      continue;
+    }
+
+    struct gfile_runs *const runs = gfile_runs_create(fds, runs_count,
+        sizeof(int), block_sizes[mode], 2, flags[mode]);
+    assert(runs != NULL);
+    assert(gfile_runs_get_count(runs) == runs_count);
+    if (flags[mode] & GFILE_RUNS_NO_IO_URING) {
+      assert(!gfile_runs_is_io_uring(runs));
+    }
+
+    struct galgorithm_nway_merge_input input;
+    gfile_runs_init_nway_merge_input(runs, &input);
+    assert(input.ctxs_count <= parts_count);
+    out_ctx.next = b;
+    if (input.ctxs_count > 0) {
+      galgorithm_nway_merge(ctx, &input, &output);
+    }
+    assert(out_ctx.next == b + n);
+    assert(gfile_runs_get_error(runs) == 0);
+    galgorithm_heapsort(ctx, a, n);
+    for (size_t i = 0; i < n; ++i) {
+      assert(a[i] == b[i]);
+    }
+
+    gfile_runs_delete(runs);
+    for (size_t i = 0; i < runs_count; ++i) {
+      close(fds[i]);
+    }
+  }
+
+  free(fds);
+  free(b);
+
+  printf("OK\n");
+}
+
+static void test_mapped_runs(const struct gheap_ctx *const ctx,
+    const size_t n, int *const a)
+{
+  printf("    test_mapped_runs(n=%zu) ", n);
+
+  /* The last run is empty. */
+  const size_t runs_count = n % 4 + 2;
+  const size_t parts_count = runs_count - 1;
+
+  int *const fds = malloc(sizeof(*fds) * runs_count);
+
+  init_array(a, n);
+  size_t first = 0;
+  for (size_t i = 0; i < runs_count; ++i) {
+    const size_t last = (i < parts_count) ? (i + 1) * n / parts_count : n;
+    galgorithm_heapsort(ctx, a + first, last - first);
+    fds[i] = create_run_file(a + first, last - first, 0);
+    assert(fds[i] >= 0);
+    first = last;
+  }
+
+  /* Small readahead forces frequent readahead requests. */
+  struct gmapped_runs *const runs = gmapped_runs_create(fds, runs_count,
+      sizeof(int), 1);
+  assert(runs != NULL);
+  for (size_t i = 0; i < runs_count; ++i) {
+    close(fds[i]);
+  }
+  assert(gmapped_runs_get_count(runs) == runs_count);
+  assert(gmapped_runs_get_total_items_count(runs) == n);
+  assert(gmapped_runs_get_items_count(runs, runs_count - 1) == 0);
+
+  char path[] = "/tmp/gheap_tests_XXXXXX";
+  const int output_fd = mkstemp(path);
+  assert(output_fd >= 0);
+  unlink(path);
+  struct gmapped_output *const output = gmapped_output_create(output_fd,
+      n * sizeof(int));
+  assert(output != NULL);
+
+  struct galgorithm_nway_merge_input merge_input;
+  struct galgorithm_nway_merge_output merge_output;
+  gmapped_runs_init_nway_merge_input(runs, &merge_input);
+  gmapped_output_init_nway_merge_output(output, sizeof(int), &merge_output);
+  assert(merge_input.ctxs_count <= parts_count);
+  if (merge_input.ctxs_count > 0) {
+    galgorithm_nway_merge(ctx, &merge_input, &merge_output);
+  }
+  gmapped_runs_delete(runs);
+  const int error = gmapped_output_delete(output, 1);
+  assert(error == 0);
+  (void)error;
+
+  int *const b = malloc(sizeof(*b) * n);
+  const ssize_t size = n * sizeof(int);
+  const ssize_t read_size = pread(output_fd, b, size, 0);
+  assert(read_size == size);
+  (void)read_size;
+  galgorithm_heapsort(ctx, a, n);
+  for (size_t i = 0; i < n; ++i) {
+    assert(a[i] == b[i]);
+  }
+  close(output_fd);
+
+  /* File sizes must be multiples of item_size. */
+  if (n % 2 == 1) {
+    const int fd = create_run_file(a, n, 0);
+    assert(gmapped_runs_create(&fd, 1, 2 * sizeof(int), 0) == NULL);
+    close(fd);
+  }
+
+  free(b);
+  free(fds);
+
+  printf("OK\n");
+}
+
 static void item_deleter(void *item)
 {
   /* do nothing */
@@ -552,6 +749,13 @@ static void test_priority_queue(const struct gheap_ctx *const ctx,
   assert(!gpriority_queue_empty(q));
   assert(gpriority_queue_size(q) == n);
 
+  // Verify memory usage.
+  struct gpriority_queue_memory_usage usage = gpriority_queue_memory_usage(q);
+  assert(usage.capacity == n);
+  assert(usage.items_bytes == n * sizeof(int));
+  assert(usage.allocated_bytes == usage.capacity * sizeof(int));
+  assert(usage.overhead_bytes == usage.allocated_bytes - usage.items_bytes);
+
   // Pop all items from the priority queue.
   int max_item = *(int *)gpriority_queue_top(q);
   for (size_t i = 1; i < n; ++i) {
@@ -570,6 +774,9 @@ static void test_priority_queue(const struct gheap_ctx *const ctx,
     gpriority_queue_push(q, &tmp);
     assert(gpriority_queue_size(q) == i + 1);
   }
+  usage = gpriority_queue_memory_usage(q);
+  assert(usage.capacity >= n);
+  assert(usage.items_bytes == n * sizeof(int));
 
   // Interleave pushing and popping items in priority queue.
   max_item = *(int *)gpriority_queue_top(q);
@@ -587,6 +794,106 @@ static void test_priority_queue(const struct gheap_ctx *const ctx,
   printf("OK\n");
 }
 
+static size_t key_hasher(const void *const key)
+{
+  return *(const size_t *)key;
+}
+
+static int key_equal(const void *const a, const void *const b)
+{
+  return (*(const size_t *)a == *(const size_t *)b);
+}
+
+static void key_mover(void *const dst, const void *const src)
+{
+  *(size_t *)dst = *(const size_t *)src;
+}
+
+static void test_keyed_priority_queue(const struct gheap_ctx *const ctx,
+    const size_t n, int *const a)
+{
+  printf("    test_keyed_priority_queue(n=%zu) ", n);
+
+  static const struct gkeyed_priority_queue_key_ctx key_ctx = {
+      .key_size = sizeof(size_t),
+      .key_hasher = &key_hasher,
+      .key_equal = &key_equal,
+      .key_mover = &key_mover,
+  };
+
+  struct gkeyed_priority_queue *const q = gkeyed_priority_queue_create(ctx,
+      &key_ctx);
+  assert(q != NULL);
+  assert(gkeyed_priority_queue_empty(q));
+  assert(gkeyed_priority_queue_size(q) == 0);
+
+  /* a contains reference priorities for keys [0 ... n). */
+  char *const exists = malloc(n);
+  size_t size = 0;
+
+  /* Insert all the keys. */
+  init_array(a, n);
+  for (size_t key = 0; key < n; ++key) {
+    assert(gkeyed_priority_queue_upsert(q, &key, &a[key]) == 1);
+    exists[key] = 1;
+    ++size;
+    assert(gkeyed_priority_queue_size(q) == size);
+  }
+
+  /* Update priorities, erase and re-insert random keys. */
+  for (size_t i = 0; i < 4 * n; ++i) {
+    const size_t key = rand() % n;
+    if (rand() % 4 == 0) {
+      assert(gkeyed_priority_queue_erase(q, &key) == exists[key]);
+      if (exists[key]) {
+        exists[key] = 0;
+        --size;
+      }
+      assert(gkeyed_priority_queue_find(q, &key) == NULL);
+    }
+    else {
+      a[key] = rand();
+      if (exists[key]) {
+        /* The priority of the existing key is updated. */
+        assert(gkeyed_priority_queue_upsert(q, &key, &a[key]) == 0);
+      }
+      else {
+        /* The missing key is inserted. */
+        assert(gkeyed_priority_queue_upsert(q, &key, &a[key]) == 1);
+        exists[key] = 1;
+        ++size;
+      }
+      assert(*(int *)gkeyed_priority_queue_find(q, &key) == a[key]);
+    }
+    assert(gkeyed_priority_queue_size(q) == size);
+  }
+
+  /* Pop all the keys. */
+  if (size > 0) {
+    int max_priority = *(int *)gkeyed_priority_queue_top_priority(q);
+    while (!gkeyed_priority_queue_empty(q)) {
+      const size_t top_key = *(size_t *)gkeyed_priority_queue_top_key(q);
+      size_t key;
+      int priority;
+      gkeyed_priority_queue_pop(q, &key, &priority);
+      assert(key == top_key);
+      assert(priority <= max_priority);
+      assert(exists[key]);
+      assert(priority == a[key]);
+      exists[key] = 0;
+      max_priority = priority;
+      --size;
+      assert(gkeyed_priority_queue_size(q) == size);
+    }
+  }
+  assert(size == 0);
+
+  free(exists);
+  gkeyed_priority_queue_delete(q);
+
+  printf("OK\n");
+}
+
 static void run_all(const struct gheap_ctx *const ctx,
     void (*func)(const struct gheap_ctx *, size_t, int *))
 {
@@ -635,15 +942,66 @@ static void test_all(const size_t fanout, const size_t page_chunks)
   run_all(ctx, test_partial_sort);
   run_all(ctx, test_nway_merge);
   run_all(ctx, test_nway_mergesort);
+  run_all(ctx, test_file_runs);
+  run_all(ctx, test_mapped_runs);
   run_all(ctx, test_priority_queue);
+  run_all(ctx, test_keyed_priority_queue);
 
   printf("  test_all(fanout=%zu, page_chunks=%zu) OK\n", fanout, page_chunks);
 }
 
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_LOCAL && !defined(NDEBUG)
+/*
+ * Verifies GHEAP_CHECK_LOCAL checks the path the item has been sifted along
+ * rather than the path following max children after the sift.
+ */
+static void test_check_local(void)
+{
+  printf("  test_check_local() ");
+
+  const struct gheap_ctx ctx = {
+      .fanout = 2,
+      .page_chunks = 1,
+      .item_size = sizeof(int),
+      .less_comparer = &less_comparer,
+      .less_comparer_ctx = (void *)0,
+      .item_mover = &item_mover,
+  };
+
+  /*
+   * a[15] is bigger than its parent a[7], while the rest of the heap
+   * is valid. gheap_swap_max_item() sifts the item along 0, 1, 3, 7, 15,
+   * so a[3] becomes less than a[7]. Max children diverge from this path
+   * at a[1] after the sift, since a[4] becomes bigger than a[3].
+   */
+  int a[] = {100, 90, 80, 85, 10, 70, 60, 8, 5, 3, 2, 50, 40, 30, 20, 9, 2};
+  int item = 1;
+
+  fflush(stdout);
+  const pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    /* Suppress the assertion message. */
+    dup2(open("/dev/null", O_WRONLY), 2);
+    gheap_swap_max_item(&ctx, a, sizeof(a) / sizeof(a[0]), &item);
+    _exit(0);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+  printf("OK\n");
+}
+#endif
+
 static void main_test(void)
 {
   printf("main_test() start\n");
 
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_LOCAL && !defined(NDEBUG)
+  test_check_local();
+#endif
+
   test_all(1, 1);
   test_all(2, 1);
   test_all(3, 1);
@@ -4,22 +4,59 @@
 // otherwise gheap_cpp03.hpp will be tested.
 
 #include "galgorithm.hpp"
+#include "gbucket_queue.hpp"
+#include "gcompact_run.hpp"
+#include "gfile_run.hpp"
 #include "gheap.hpp"
+#include "gfused_priority_queue.hpp"
+#include "gheavy_hitters.hpp"
+#include "gmapped_run.hpp"
+#include "gkeyed_priority_queue.hpp"
 #include "gpriority_queue.hpp"
+#include "gtrace.hpp"
+
+#ifdef GHEAP_CPP11
+#  ifdef __cpp_impl_coroutine
+#    include "gasync_algorithm.hpp"
+#  endif
+#  include "gbatch_priority_queue.hpp"
+#  include "gshared_priority_queue.hpp"
+#  include "gtask_scheduler.hpp"
+#  include "gthread_pool.hpp"
+#endif
 
-#include <algorithm>  // for min_element()
+#include <algorithm>  // for min_element(), sort(), lower_bound()
 #include <cassert>
-#include <cstdlib>    // for srand(), rand()
+#include <cstdio>     // for tmpfile(), fclose(), ...
+#include <cstdlib>    // for srand(), rand(), mkstemp()
 #include <deque>
 #include <iostream>   // for cout
+#include <limits>     // for numeric_limits
+#include <stdexcept>  // for std::runtime_error
 #include <iterator>   // for back_inserter
 #include <vector>
 #include <utility>    // for pair
 
+#include <fcntl.h>    // for open()
+#include <signal.h>   // for SIGABRT
+#include <sys/wait.h> // for waitpid(), W*
+#include <unistd.h>   // for write(), pread(), close(), unlink(), fork()
+
 #ifndef GHEAP_CPP11
 #  include <algorithm>  // for swap()
 #endif
 
+#ifdef GHEAP_CPP11
+#  include <atomic>     // for atomic
+#  include <mutex>      // for mutex, lock_guard
+#  include <thread>     // for thread
+#endif
+
+#ifdef __cpp_impl_coroutine
+#  include <coroutine>  // for coroutine_handle, suspend_never
+#  include <exception>  // for terminate()
+#endif
+
 using namespace std;
 
 namespace {
@@ -202,8 +239,6 @@ void test_pop_heap(const size_t n)
 template <class Heap, class IntContainer>
 void test_swap_max_item(const size_t n)
 {
-  typedef typename IntContainer::iterator iterator;
-
   cout << "    test_swap_max_item(n=" << n << ") ";
 
   IntContainer a;
@@ -325,7 +360,6 @@ template <class Heap, class IntContainer>
 void test_partial_sort(const size_t n)
 {
   typedef galgorithm<Heap> algorithm;
-  typedef typename IntContainer::iterator iterator;
 
   cout << "    test_partial_sort(n=" << n << ") ";
 
@@ -370,6 +404,30 @@ void test_partial_sort(const size_t n)
     assert(min_element(a.end() - 3, a.end()) == a.end() - 3);
   }
 
+  // Check small partial sort up to its limit.
+  algorithm::small_partial_sort(a.begin(), a.begin(), a.end());
+  for (size_t k = 1; k <= n && k <= algorithm::SMALL_PARTIAL_SORT_MAX_ITEMS;
+      ++k) {
+    init_array(a, n);
+    IntContainer b = a;
+    algorithm::small_partial_sort(a.begin(), a.begin() + k, a.end());
+    assert_sorted_asc(a.begin(), a.begin() + k);
+    assert(min_element(a.begin() + k - 1, a.end()) == a.begin() + k - 1);
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    assert(a == b);
+
+    // Descending items are always accepted into the sorted range,
+    // so small partial sort switches to heap.
+    for (size_t i = 0; i < n; ++i) {
+      a[i] = n - i;
+    }
+    algorithm::small_partial_sort(a.begin(), a.begin() + k, a.end());
+    for (size_t i = 0; i < k; ++i) {
+      assert(a[i] == (int)(i + 1));
+    }
+  }
+
   cout << "OK" << endl;
 }
 
@@ -473,6 +531,847 @@ void test_nway_mergesort(const size_t n)
   cout << "OK" << endl;
 }
 
+// Writes items into a temporary file and returns its descriptor
+// opened for reading.
+int create_run_file(const vector<int> &a)
+{
+  char path[] = "/tmp/gheap_tests_XXXXXX";
+  const int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+
+  const ssize_t size = a.size() * sizeof(int);
+  const ssize_t written = (size > 0) ? write(fd, &a[0], size) : 0;
+  assert(written == size);
+  (void)written;
+  return fd;
+}
+
+template <class Heap, class IntContainer>
+void test_file_runs(const size_t n)
+{
+  typedef galgorithm<Heap> algorithm;
+  typedef gfile_run_reader<int> file_run_reader;
+
+  cout << "    test_file_runs(n=" << n << ") ";
+
+  // The last run is empty.
+  const size_t runs_count = n % 4 + 2;
+  const size_t parts_count = runs_count - 1;
+
+  IntContainer a, b;
+  init_array(a, n);
+  b = a;
+  sort(b.begin(), b.end());
+
+  // Verify io_uring reads and pread() fallback. Small blocks force
+  // frequent buffer switching.
+  static const int flags[] = {0, GFILE_RUNS_NO_IO_URING};
+  for (size_t mode = 0; mode < 2; ++mode) {
+    vector<int> fds;
+    size_t first = 0;
+    for (size_t i = 0; i < runs_count; ++i) {
+      const size_t last = (i < parts_count) ? (i + 1) * n / parts_count : n;
+      vector<int> run(a.begin() + first, a.begin() + last);
+      sort(run.begin(), run.end());
+      fds.push_back(create_run_file(run));
+      first = last;
+    }
+
+    IntContainer c(n);
+    {
+      file_run_reader reader(fds, 3 * sizeof(int), 2, flags[mode]);
+      if (flags[mode] & GFILE_RUNS_NO_IO_URING) {
+        assert(!reader.is_io_uring());
+      }
+      vector<file_run_reader::input_range> input_ranges;
+      reader.get_input_ranges(input_ranges);
+      assert(input_ranges.size() <= parts_count);
+      if (!input_ranges.empty()) {
+        const typename IntContainer::iterator output = algorithm::nway_merge(
+            input_ranges.begin(), input_ranges.end(), c.begin());
+        assert(output == c.end());
+      }
+      assert(reader.get_error() == 0);
+    }
+    assert(c == b);
+
+    for (size_t i = 0; i < runs_count; ++i) {
+      close(fds[i]);
+    }
+  }
+
+  // Verify invalid arguments are reported via exceptions.
+  bool is_thrown = false;
+  try {
+    file_run_reader reader(vector<int>(1, 0), sizeof(int) + 1);
+  }
+  catch (const std::runtime_error &) {
+    is_thrown = true;
+  }
+  assert(is_thrown);
+
+  cout << "OK" << endl;
+}
+
+template <class Heap, class IntContainer>
+void test_mapped_runs(const size_t n)
+{
+  typedef galgorithm<Heap> algorithm;
+  typedef gmapped_run_reader<int> mapped_run_reader;
+
+  cout << "    test_mapped_runs(n=" << n << ") ";
+
+  // The last run is empty.
+  const size_t runs_count = n % 4 + 2;
+  const size_t parts_count = runs_count - 1;
+
+  IntContainer a;
+  init_array(a, n);
+  vector<int> b(a.begin(), a.end());
+  sort(b.begin(), b.end());
+
+  vector<int> fds;
+  size_t first = 0;
+  for (size_t i = 0; i < runs_count; ++i) {
+    const size_t last = (i < parts_count) ? (i + 1) * n / parts_count : n;
+    vector<int> run(a.begin() + first, a.begin() + last);
+    sort(run.begin(), run.end());
+    fds.push_back(create_run_file(run));
+    first = last;
+  }
+
+  const int output_fd = create_run_file(vector<int>());
+  {
+    mapped_run_reader reader(fds, 1);
+    assert(reader.get_total_items_count() == n);
+    vector<mapped_run_reader::input_range> input_ranges;
+    reader.get_input_ranges(input_ranges);
+    assert(input_ranges.size() <= parts_count);
+
+    gmapped_run_writer<int> writer(output_fd, n);
+    if (!input_ranges.empty()) {
+      int *const output = algorithm::nway_merge(input_ranges.begin(),
+          input_ranges.end(), writer.begin());
+      assert(output == writer.end());
+    }
+    writer.finish(true);
+  }
+
+  vector<int> c(n);
+  const ssize_t size = n * sizeof(int);
+  const ssize_t read_size = (size > 0) ? pread(output_fd, &c[0], size, 0) : 0;
+  assert(read_size == size);
+  (void)read_size;
+  assert(c == b);
+
+  close(output_fd);
+  for (size_t i = 0; i < runs_count; ++i) {
+    close(fds[i]);
+  }
+
+  cout << "OK" << endl;
+}
+
+template <class Heap, class IntContainer>
+void test_compact_runs(const size_t n)
+{
+  typedef galgorithm<Heap> algorithm;
+  typedef gcompact_run_reader<int> compact_run_reader;
+  typedef typename compact_run_reader::input_range input_range;
+
+  cout << "    test_compact_runs(n=" << n << ") ";
+
+  const size_t runs_count = n % 4 + 1;
+
+  IntContainer a, b;
+  init_array(a, n);
+  b = a;
+  sort(b.begin(), b.end());
+
+  // Write runs merged from halves sorted by nway_mergesort().
+  // Small blocks verify crossing block boundaries.
+  typedef typename IntContainer::iterator iterator;
+  vector<FILE *> files;
+  size_t first = 0;
+  for (size_t i = 0; i < runs_count; ++i) {
+    const size_t last = (i + 1) * n / runs_count;
+    const iterator middle = a.begin() + (first + last) / 2;
+    algorithm::nway_mergesort(a.begin() + first, middle);
+    algorithm::nway_mergesort(middle, a.begin() + last);
+    vector<pair<iterator, iterator> > halves;
+    if (a.begin() + first != middle) {
+      halves.push_back(pair<iterator, iterator>(a.begin() + first, middle));
+    }
+    if (middle != a.begin() + last) {
+      halves.push_back(pair<iterator, iterator>(middle, a.begin() + last));
+    }
+
+    FILE *const file = tmpfile();
+    assert(file != 0);
+    gcompact_run_writer<int> writer(file, 5);
+    if (!halves.empty()) {
+      algorithm::nway_merge(halves.begin(), halves.end(),
+          back_inserter(writer));
+    }
+    writer.finish();
+    assert(writer.get_items_count() == last - first);
+    files.push_back(file);
+
+    // Sort the whole run for verifying seeking below.
+    sort(a.begin() + first, a.begin() + last);
+    first = last;
+  }
+
+  // Merge all the runs.
+  {
+    vector<compact_run_reader *> readers;
+    vector<input_range> input_ranges;
+    for (size_t i = 0; i < runs_count; ++i) {
+      readers.push_back(new compact_run_reader(files[i]));
+      const input_range input_range = readers[i]->get_input_range();
+      if (input_range.first != input_range.second) {
+        input_ranges.push_back(input_range);
+      }
+    }
+    IntContainer c(n);
+    if (!input_ranges.empty()) {
+      const typename IntContainer::iterator output = algorithm::nway_merge(
+          input_ranges.begin(), input_ranges.end(), c.begin());
+      assert(output == c.end());
+    }
+    assert(c == b);
+    for (size_t i = 0; i < runs_count; ++i) {
+      delete readers[i];
+    }
+  }
+
+  // Verify seeking.
+  if (n > 0) {
+    compact_run_reader reader(files[runs_count - 1]);
+    const size_t run_first = (runs_count - 1) * n / runs_count;
+    const int key = a[run_first + (n - run_first) / 2];
+    reader.seek(key);
+    assert(reader.begin() != reader.end());
+    assert(*reader.begin() == key);
+    size_t k = 0;
+    for (typename compact_run_reader::iterator it = reader.begin();
+        it != reader.end(); ++it) {
+      assert(*it >= key);
+      ++k;
+    }
+    assert(k == size_t(a.end() - lower_bound(a.begin() + run_first, a.end(),
+        key)));
+    const int max_key = reader.get_block_max(reader.get_blocks_count() - 1);
+    if (max_key < std::numeric_limits<int>::max()) {
+      reader.seek(max_key + 1);
+      assert(reader.begin() == reader.end());
+    }
+  }
+
+  // Verify small deltas are compressed.
+  {
+    FILE *const file = tmpfile();
+    assert(file != 0);
+    gcompact_run_writer<int> writer(file);
+    for (size_t i = 0; i < n; ++i) {
+      writer.push_back(int(i * 3));
+    }
+    writer.finish();
+    assert(writer.get_bytes_written() <= n / 2 + 100);
+    fclose(file);
+  }
+
+  // Verify corrupted runs are detected.
+  if (n > 0) {
+    FILE *const file = files[runs_count - 1];
+    fseek(file, 24, SEEK_SET);
+    const int c = fgetc(file);
+    fseek(file, 24, SEEK_SET);
+    fputc(c ^ 1, file);
+    fflush(file);
+    bool is_thrown = false;
+    try {
+      compact_run_reader reader(file);
+      for (typename compact_run_reader::iterator it = reader.begin();
+          it != reader.end(); ++it) {
+      }
+    }
+    catch (const std::runtime_error &) {
+      is_thrown = true;
+    }
+    assert(is_thrown);
+  }
+
+  for (size_t i = 0; i < runs_count; ++i) {
+    fclose(files[i]);
+  }
+
+  cout << "OK" << endl;
+}
+
+#ifdef GHEAP_CPP11
+template <class Heap, class IntContainer, class Executor>
+void test_parallel_algorithms_with_executor(Executor &executor,
+    const size_t n)
+{
+  typedef galgorithm<Heap> algorithm;
+  typedef typename IntContainer::iterator iterator;
+
+  // Small chunk size forces splitting ranges into chunks.
+  static const size_t min_chunk_size = 3;
+
+  IntContainer a, b, c;
+
+  // Verify parallel_make_heap().
+  init_array(a, n);
+  algorithm::parallel_make_heap(executor, a.begin(), a.end(),
+      less_comparer_desc, min_chunk_size);
+  assert(Heap::is_heap(a.begin(), a.end(), less_comparer_desc));
+  init_array(a, n);
+  algorithm::parallel_make_heap(executor, a.begin(), a.end());
+  assert(Heap::is_heap(a.begin(), a.end()));
+
+  // Verify parallel_partial_sort().
+  const size_t ks[] = {0, 1, 2, n / 4, n / 2, n};
+  for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i) {
+    const size_t k = (ks[i] < n) ? ks[i] : n;
+    init_array(a, n);
+    b = a;
+    sort(b.begin(), b.end());
+    algorithm::parallel_partial_sort(executor, a.begin(), a.begin() + k,
+        a.end(), std::less<int>(), min_chunk_size);
+    assert(equal(a.begin(), a.begin() + k, b.begin()));
+    sort(a.begin(), a.end());
+    assert(a == b);
+  }
+  init_array(a, n);
+  algorithm::parallel_partial_sort(executor, a.begin(), a.begin() + n / 2,
+      a.end());
+  if (n > 1) {
+    assert_sorted_asc(a.begin(), a.begin() + n / 2);
+  }
+
+  // Verify parallel_nway_merge() with empty input ranges.
+  init_array(a, n);
+  sort(a.begin(), a.end());
+  vector<pair<iterator, iterator> > input_ranges;
+  input_ranges.push_back(pair<iterator, iterator>(a.begin(), a.begin()));
+  for (size_t i = 0; i < n; i += 3) {
+    const size_t last = (i + 3 < n) ? i + 3 : n;
+    algorithm::heapsort(a.begin() + i, a.begin() + last);
+    input_ranges.push_back(pair<iterator, iterator>(a.begin() + i,
+        a.begin() + last));
+  }
+  input_ranges.push_back(pair<iterator, iterator>(a.end(), a.end()));
+  b.assign(n, 0);
+  const iterator output = algorithm::parallel_nway_merge(executor,
+      input_ranges.begin(), input_ranges.end(), b.begin(), std::less<int>(),
+      min_chunk_size);
+  assert(output == b.end());
+  assert_sorted_asc(b.begin(), b.end());
+  for (size_t i = 0; i < input_ranges.size(); ++i) {
+    assert(input_ranges[i].first == input_ranges[i].second);
+  }
+  sort(a.begin(), a.end());
+  assert(a == b);
+
+  // Verify parallel_nway_mergesort().
+  init_array(a, n);
+  b = a;
+  algorithm::parallel_nway_mergesort(executor, a.begin(), a.end(),
+      less_comparer_desc, min_chunk_size);
+  assert_sorted_desc(a.begin(), a.end());
+  sort(a.begin(), a.end());
+  sort(b.begin(), b.end());
+  assert(a == b);
+  init_array(a, n);
+  algorithm::parallel_nway_mergesort(executor, a.begin(), a.end());
+  assert_sorted_asc(a.begin(), a.end());
+
+  // Verify nested parallel calls.
+  init_array(a, n);
+  init_array(c, n);
+  executor.parallel_for(2, [&](const size_t i) {
+    IntContainer &x = (i == 0) ? a : c;
+    algorithm::parallel_nway_mergesort(executor, x.begin(), x.end(),
+        std::less<int>(), min_chunk_size);
+  });
+  assert_sorted_asc(a.begin(), a.end());
+  assert_sorted_asc(c.begin(), c.end());
+}
+
+template <class Heap, class IntContainer>
+void test_parallel_algorithms(const size_t n)
+{
+  cout << "    test_parallel_algorithms(n=" << n << ") ";
+
+  gsequential_executor sequential_executor;
+  test_parallel_algorithms_with_executor<Heap, IntContainer>(
+      sequential_executor, n);
+
+  static gthread_pool thread_pool(4);
+  assert(thread_pool.concurrency() == 4);
+  test_parallel_algorithms_with_executor<Heap, IntContainer>(thread_pool, n);
+
+  // Verify exceptions are propagated to the caller.
+  bool is_thrown = false;
+  try {
+    thread_pool.parallel_for(n, [](const size_t i) {
+      if (i == 0) {
+        throw std::runtime_error("test");
+      }
+    });
+  }
+  catch (const std::runtime_error &) {
+    is_thrown = true;
+  }
+  assert(is_thrown);
+
+  cout << "OK" << endl;
+}
+#endif
+
+#ifdef GHEAP_CPP11
+template <class Heap, class IntContainer>
+void test_batch_priority_queue(const size_t n)
+{
+  typedef typename IntContainer::value_type value_type;
+  typedef gbatch_priority_queue<Heap, value_type, gthread_pool, IntContainer>
+      batch_priority_queue;
+
+  cout << "    test_batch_priority_queue(n=" << n << ") ";
+
+  // Small chunk size forces splitting ranges into chunks.
+  static const size_t min_chunk_size = 3;
+
+  static gthread_pool thread_pool(4);
+  batch_priority_queue q(thread_pool, std::less<value_type>(), IntContainer(),
+      min_chunk_size);
+  assert(q.empty());
+
+  // Verify batches of various sizes, so both per-item heap operations
+  // and parallel algorithms are used.
+  IntContainer a, b, expected;
+  const size_t ks[] = {0, 1, 2, n / 4, n / 2, n};
+  for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i) {
+    init_array(a, ks[i]);
+    q.insert_batch(a.begin(), a.end());
+    expected.insert(expected.end(), a.begin(), a.end());
+    assert(q.size() == expected.size());
+    assert(Heap::is_heap(q.c.begin(), q.c.end()));
+  }
+  sort(expected.begin(), expected.end(), less_comparer_desc);
+  assert(q.top() == expected.front());
+
+  size_t offset = 0;
+  for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i) {
+    const size_t k = (ks[i] < q.size()) ? ks[i] : q.size();
+    b.clear();
+    q.extract_k(k, back_inserter(b));
+    assert(b.size() == k);
+    assert(equal(b.begin(), b.end(), expected.begin() + offset));
+    assert(Heap::is_heap(q.c.begin(), q.c.end()));
+    offset += k;
+  }
+  assert(q.size() == expected.size() - offset);
+
+  // Verify extracting all the remaining items.
+  b.clear();
+  q.extract_k(q.size(), back_inserter(b));
+  assert(q.empty());
+  assert(equal(b.begin(), b.end(), expected.begin() + offset));
+
+  // Verify per-item operations mixed with batch operations.
+  q.push(1);
+  q.push(3);
+  a.assign(1, 2);
+  q.insert_batch(a.begin(), a.end());
+  assert(q.top() == 3);
+  q.pop();
+  b.clear();
+  q.extract_k(2, back_inserter(b));
+  assert(b.size() == 2 && b[0] == 2 && b[1] == 1);
+  assert(q.empty());
+
+  cout << "OK" << endl;
+}
+
+#ifdef __cpp_impl_coroutine
+// Single-threaded event loop, which simulates asynchronous I/O completions
+// for gasync_algorithm tests.
+class async_event_loop
+{
+private:
+  deque<std::coroutine_handle<> > _ready;
+
+public:
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  void await_suspend(const std::coroutine_handle<> h)
+  {
+    _ready.push_back(h);
+  }
+
+  void await_resume() const noexcept {}
+
+  void run()
+  {
+    while (!_ready.empty()) {
+      const std::coroutine_handle<> h = _ready.front();
+      _ready.pop_front();
+      h.resume();
+    }
+  }
+};
+
+// Resumes each coroutine on a new thread for verifying the handoff between
+// gasync_generator and its consumer running on distinct threads.
+class async_thread_switcher
+{
+private:
+  std::mutex _mutex;
+  vector<std::thread> _threads;
+
+public:
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  void await_suspend(const std::coroutine_handle<> h)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _threads.push_back(std::thread([h] { h.resume(); }));
+  }
+
+  void await_resume() const noexcept {}
+
+  // Waits for all the threads including threads started by the resumed
+  // coroutines.
+  void join()
+  {
+    for (;;) {
+      std::thread t;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_threads.empty()) {
+          return;
+        }
+        t = std::move(_threads.back());
+        _threads.pop_back();
+      }
+      t.join();
+    }
+  }
+};
+
+// Coroutine, which starts immediately and destroys itself on completion.
+struct async_task
+{
+  struct promise_type
+  {
+    async_task get_return_object() const noexcept
+    {
+      return async_task();
+    }
+
+    std::suspend_never initial_suspend() const noexcept
+    {
+      return std::suspend_never();
+    }
+
+    std::suspend_never final_suspend() const noexcept
+    {
+      return std::suspend_never();
+    }
+
+    void return_void() const noexcept {}
+
+    void unhandled_exception() const noexcept
+    {
+      std::terminate();
+    }
+  };
+};
+
+// Yields the given sorted items in blocks of up to block_size items
+// interleaved with empty blocks. Suspends on the event loop before
+// each block. Throws after the first block if is_failing is set.
+template <class EventLoop>
+gasync_generator<vector<int> > async_sorted_blocks(EventLoop &loop,
+    const vector<int> items, const size_t block_size, const bool is_failing)
+{
+  for (size_t i = 0; i < items.size(); i += block_size) {
+    co_await loop;
+    const size_t last = (i + block_size < items.size()) ?
+        i + block_size : items.size();
+    co_yield vector<int>(items.begin() + i, items.begin() + last);
+    if (is_failing) {
+      throw std::runtime_error("test");
+    }
+    co_yield vector<int>();
+  }
+}
+
+async_task async_collect(gasync_generator<vector<int> > &g,
+    const size_t output_block_size, vector<int> &result, bool &is_done,
+    bool &is_thrown)
+{
+  try {
+    bool has_value = co_await g.next();
+    while (has_value) {
+      assert(!g.value().empty());
+      assert(g.value().size() <= output_block_size);
+      result.insert(result.end(), g.value().begin(), g.value().end());
+      has_value = co_await g.next();
+    }
+  }
+  catch (const std::runtime_error &) {
+    is_thrown = true;
+  }
+  is_done = true;
+}
+
+template <class Heap>
+void test_async_nway_merge(const size_t n)
+{
+  typedef gasync_algorithm<Heap> algorithm;
+  typedef gasync_generator<vector<int> > generator;
+
+  cout << "    test_async_nway_merge(n=" << n << ") ";
+
+  static const size_t input_block_size = 3;
+  static const size_t output_block_size = 4;
+
+  async_event_loop loop;
+  vector<int> a, result;
+  init_array(a, n);
+
+  // Verify merging of inputs with distinct sizes including empty inputs.
+  const size_t inputs_count = n % 5 + 2;
+  vector<vector<int> > items(inputs_count);
+  for (size_t i = 0; i < n; ++i) {
+    items[i % (inputs_count - 1)].push_back(a[i]);
+  }
+  vector<generator> inputs;
+  for (size_t i = 0; i < inputs_count; ++i) {
+    sort(items[i].begin(), items[i].end(), less_comparer_desc);
+    inputs.push_back(async_sorted_blocks(loop, items[i], input_block_size,
+        false));
+  }
+  generator output = algorithm::nway_merge(std::move(inputs),
+      less_comparer_desc, output_block_size);
+  bool is_done = false;
+  bool is_thrown = false;
+  async_collect(output, output_block_size, result, is_done, is_thrown);
+  loop.run();
+  assert(is_done);
+  assert(!is_thrown);
+  sort(a.begin(), a.end(), less_comparer_desc);
+  assert(result == a);
+
+  // Verify merging of inputs, which are resumed on other threads while
+  // being prefetched.
+  async_thread_switcher switcher;
+  inputs.clear();
+  for (size_t i = 0; i < inputs_count; ++i) {
+    inputs.push_back(async_sorted_blocks(switcher, items[i], input_block_size,
+        false));
+  }
+  output = algorithm::nway_merge(std::move(inputs), less_comparer_desc,
+      output_block_size);
+  result.clear();
+  is_done = false;
+  async_collect(output, output_block_size, result, is_done, is_thrown);
+  switcher.join();
+  assert(is_done);
+  assert(!is_thrown);
+  assert(result == a);
+
+  // Verify prefetch() starts producing the next block without waiting
+  // for the consumer.
+  generator g = async_sorted_blocks(loop, vector<int>(1, 0),
+      input_block_size, false);
+  g.prefetch();
+  assert(!g.is_ready());
+  loop.run();
+  assert(g.is_ready());
+
+  // Verify next() completes if the generator finishes during prefetch().
+  g = async_sorted_blocks(loop, vector<int>(), input_block_size, false);
+  g.prefetch();
+  assert(g.is_ready());
+  result.clear();
+  is_done = false;
+  async_collect(g, output_block_size, result, is_done, is_thrown);
+  assert(is_done);
+  assert(result.empty());
+
+  // Verify merging without inputs.
+  result.clear();
+  is_done = false;
+  output = algorithm::nway_merge(vector<generator>(), output_block_size);
+  async_collect(output, output_block_size, result, is_done, is_thrown);
+  loop.run();
+  assert(is_done);
+  assert(result.empty());
+
+  // Verify exceptions thrown by inputs are propagated to the consumer.
+  inputs.clear();
+  sort(a.begin(), a.end());
+  inputs.push_back(async_sorted_blocks(loop, a, input_block_size, false));
+  inputs.push_back(async_sorted_blocks(loop, a, input_block_size, true));
+  is_done = false;
+  output = algorithm::nway_merge(std::move(inputs), output_block_size);
+  async_collect(output, output_block_size, result, is_done, is_thrown);
+  loop.run();
+  assert(is_done);
+  assert(is_thrown);
+
+  cout << "OK" << endl;
+}
+#endif
+#endif
+
+#ifdef GHEAP_CPP11
+// Item for gshared_priority_queue tests. Torn reads break the relationship
+// between value and check.
+struct shared_queue_item
+{
+  size_t value;
+  size_t check;
+
+  bool operator < (const shared_queue_item &item) const
+  {
+    return (value < item.value);
+  }
+};
+
+shared_queue_item make_shared_queue_item(const size_t value)
+{
+  shared_queue_item item;
+  item.value = value;
+  item.check = ~value;
+  return item;
+}
+
+template <class Heap>
+void test_shared_priority_queue(const size_t n)
+{
+  typedef gshared_priority_queue<Heap, shared_queue_item> shared_priority_queue;
+
+  cout << "    test_shared_priority_queue(n=" << n << ") ";
+
+  shared_priority_queue q;
+  shared_queue_item item;
+  assert(q.empty());
+  assert(!q.peek_top(item));
+  assert(!q.try_pop(item));
+
+  // Verify the published top item follows mutations.
+  size_t max_value = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const size_t value = rand();
+    if (value > max_value) {
+      max_value = value;
+    }
+    q.push(make_shared_queue_item(value));
+    assert(q.size() == i + 1);
+    assert(q.peek_top(item));
+    assert(item.value == max_value);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    shared_queue_item top;
+    assert(q.peek_top(top));
+    assert(q.try_pop(item));
+    assert(item.value == top.value);
+    if (q.peek_top(top)) {
+      assert(top.value <= item.value);
+    }
+  }
+  assert(q.empty());
+  assert(!q.peek_top(item));
+
+  // Verify concurrent readers never observe torn items.
+  std::atomic<bool> is_done(false);
+  std::thread reader([&q, &is_done]() {
+    shared_queue_item item;
+    while (!is_done) {
+      if (q.peek_top(item)) {
+        assert(item.check == ~item.value);
+      }
+    }
+  });
+  for (size_t i = 0; i < 10 * n; ++i) {
+    q.push(make_shared_queue_item(rand()));
+    if (i % 2 == 0) {
+      q.try_pop(item);
+    }
+  }
+  is_done = true;
+  reader.join();
+
+  cout << "OK" << endl;
+}
+
+template <class Heap>
+void test_task_scheduler(const size_t n)
+{
+  typedef gtask_scheduler<Heap> task_scheduler;
+
+  cout << "    test_task_scheduler(n=" << n << ") ";
+
+  // Verify all the tasks including spawned tasks are executed.
+  {
+    task_scheduler scheduler(4, 2);
+    assert(scheduler.threads_count() == 4);
+    assert(scheduler.inversion_tolerance() == 2);
+
+    std::atomic<size_t> counter(0);
+    for (size_t i = 0; i < n; ++i) {
+      scheduler.submit(rand(), [&scheduler, &counter]() {
+        ++counter;
+        scheduler.submit(rand(), [&counter]() {
+          ++counter;
+        });
+      });
+    }
+    scheduler.wait();
+    assert(counter == 2 * n);
+
+    // Verify the scheduler may be reused after wait().
+    scheduler.submit(0, [&counter]() {
+      ++counter;
+    });
+    scheduler.wait();
+    assert(counter == 2 * n + 1);
+  }
+
+  // Verify local tasks are executed in priority order.
+  {
+    task_scheduler scheduler(1, n);
+    vector<int> priorities;
+    scheduler.submit(0, [&scheduler, &priorities, n]() {
+      for (size_t i = 0; i < n; ++i) {
+        const int priority = rand();
+        scheduler.submit(priority, [&priorities, priority]() {
+          priorities.push_back(priority);
+        });
+      }
+    });
+    scheduler.wait();
+    assert(priorities.size() == n);
+    assert_sorted_desc(priorities.begin(), priorities.end());
+  }
+
+  cout << "OK" << endl;
+}
+#endif
+
 template <class Heap, class IntContainer>
 void test_priority_queue(const size_t n)
 {
@@ -493,6 +1392,13 @@ void test_priority_queue(const size_t n)
   assert(!q.empty());
   assert(q.size() == n);
 
+  // Verify memory_usage().
+  typename priority_queue::memory_usage_type usage = q.memory_usage();
+  assert(usage.capacity >= n);
+  assert(usage.items_bytes == n * sizeof(value_type));
+  assert(usage.allocated_bytes == usage.capacity * sizeof(value_type));
+  assert(usage.overhead_bytes == usage.allocated_bytes - usage.items_bytes);
+
   // Verify swap().
   q.swap(q_empty);
   assert(q.empty());
@@ -537,6 +1443,438 @@ void test_priority_queue(const size_t n)
   cout << "OK" << endl;
 }
 
+template <class Heap, class IntContainer>
+void test_fused_priority_queue(const size_t n)
+{
+  typedef typename IntContainer::value_type value_type;
+  typedef gfused_priority_queue<Heap, value_type, IntContainer>
+      fused_priority_queue;
+  typedef gpriority_queue<Heap, value_type, IntContainer> priority_queue;
+
+  cout << "    test_fused_priority_queue(n=" << n << ") ";
+
+  // Verify default constructor.
+  fused_priority_queue q_empty;
+  assert(q_empty.empty());
+  assert(q_empty.size() == 0);
+
+  // Verify non-empty priority queue.
+  IntContainer a;
+  init_array(a, n);
+  fused_priority_queue q(a.begin(), a.end());
+  priority_queue q_ref(a.begin(), a.end());
+  assert(!q.empty());
+  assert(q.size() == n);
+
+  // Verify swap() on the queue with a hole.
+  q.pop();
+  q_ref.pop();
+  q.swap(q_empty);
+  assert(q.empty());
+  assert(q_empty.size() == n - 1);
+  swap(q, q_empty);
+  assert(q.size() == n - 1);
+  assert(q_empty.empty());
+  q.push(a[0]);
+  q_ref.push(a[0]);
+
+  // Interleave pop() + push() pairs, which fill holes, with sequences
+  // of pops and pushes, which require deferred sifts.
+  for (size_t i = 0; i < 4 * n; ++i) {
+    const int op = rand() % 4;
+    if (op == 0 && !q_ref.empty()) {
+      q.pop();
+      q_ref.pop();
+    }
+    else if (op == 1 && !q_ref.empty()) {
+      q.pop();
+      q_ref.pop();
+      const int tmp = rand();
+      q.push(tmp);
+      q_ref.push(tmp);
+    }
+    else {
+      const int tmp = rand();
+      q.push(tmp);
+      q_ref.push(tmp);
+    }
+    assert(q.size() == q_ref.size());
+    assert(q.empty() == q_ref.empty());
+    if (!q_ref.empty()) {
+      assert(q.top() == q_ref.top());
+    }
+  }
+
+  // Pop all items from the priority queue.
+  while (!q_ref.empty()) {
+    assert(q.top() == q_ref.top());
+    q.pop();
+    q_ref.pop();
+    assert(q.size() == q_ref.size());
+  }
+  assert(q.empty());
+
+  cout << "OK" << endl;
+}
+
+template <class Heap, class IntContainer>
+void test_traced_priority_queue(const size_t n)
+{
+  typedef typename IntContainer::value_type value_type;
+  typedef gpriority_queue<Heap, value_type, IntContainer> priority_queue;
+
+  cout << "    test_traced_priority_queue(n=" << n << ") ";
+
+  FILE *const file = tmpfile();
+  assert(file != 0);
+
+  // Record random mix of pushes and pops.
+  vector<gtrace_record> expected_records;
+  {
+    gtrace_writer writer(file);
+    gtraced_priority_queue<priority_queue> q(writer);
+    for (size_t i = 0; i < n; ++i) {
+      gtrace_record r;
+      if (rand() % 3 == 0 && !q.empty()) {
+        r.op = GTRACE_OP_POP;
+        r.key = 0;
+        r.payload_size = 0;
+        q.pop();
+      }
+      else {
+        const value_type v = rand() - RAND_MAX / 2;
+        r.op = (i % 2 == 0) ? GTRACE_OP_PUSH : GTRACE_OP_PUSH_WITH_PAYLOAD;
+        r.key = uint64_t(int64_t(v));
+        r.payload_size = (i % 2 == 0) ? 0 : i;
+        q.push(v, r.payload_size);
+        assert(q.top() == *max_element(q.get_queue().c.begin(),
+            q.get_queue().c.end()));
+      }
+      expected_records.push_back(r);
+    }
+    assert(writer.get_records_count() == n);
+    writer.finish();
+  }
+
+  // Read the trace back.
+  rewind(file);
+  {
+    gtrace_reader reader(file);
+    gtrace_record r;
+    for (size_t i = 0; i < n; ++i) {
+      assert(reader.next(r));
+      assert(r.op == expected_records[i].op);
+      assert(r.key == expected_records[i].key);
+      assert(r.payload_size == expected_records[i].payload_size);
+    }
+    assert(!reader.next(r));
+    assert(reader.get_records_count() == n);
+  }
+
+  // Verify truncated traces are detected.
+  fflush(file);
+  fseek(file, 0, SEEK_END);
+  const long size = ftell(file);
+  vector<char> data(size);
+  rewind(file);
+  const size_t read_size = fread(&data[0], 1, size, file);
+  assert(read_size == size_t(size));
+  (void)read_size;
+  fclose(file);
+
+  FILE *const truncated_file = tmpfile();
+  assert(truncated_file != 0);
+  fwrite(&data[0], 1, size - 1, truncated_file);
+  rewind(truncated_file);
+  bool is_thrown = false;
+  try {
+    gtrace_reader reader(truncated_file);
+    gtrace_record r;
+    while (reader.next(r)) {
+    }
+  }
+  catch (const std::runtime_error &) {
+    is_thrown = true;
+  }
+  assert(is_thrown);
+  fclose(truncated_file);
+
+  cout << "OK" << endl;
+}
+
+template <class Heap, class IntContainer>
+void test_heavy_hitters(const size_t n)
+{
+  typedef typename IntContainer::value_type value_type;
+  typedef gheavy_hitters<Heap, value_type> heavy_hitters;
+  typedef typename heavy_hitters::counter counter;
+
+  cout << "    test_heavy_hitters(n=" << n << ") ";
+
+  // Generate skewed stream, where small keys are more frequent
+  // than big keys.
+  IntContainer a;
+  vector<size_t> freqs(n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    const value_type key = rand() % (rand() % n + 1);
+    a.push_back(key);
+    ++freqs[key];
+  }
+
+  const size_t capacity = n / 4 + 1;
+  heavy_hitters h(capacity);
+  assert(h.empty());
+  assert(h.size() == 0);
+  assert(h.capacity() == capacity);
+  for (size_t i = 0; i < n; ++i) {
+    h.add(a[i]);
+  }
+  assert(!h.empty());
+  assert(h.size() <= capacity);
+  assert(h.total() == n);
+
+  // Verify counters.
+  vector<counter> counters;
+  h.top(n, back_inserter(counters));
+  assert(counters.size() == h.size());
+  size_t counts_sum = 0;
+  for (size_t i = 0; i < counters.size(); ++i) {
+    if (i > 0) {
+      assert(counters[i].count <= counters[i - 1].count);
+    }
+    counts_sum += counters[i].count;
+  }
+  assert(counts_sum == n);
+  assert(counters.back().count == h.min_count());
+
+  // Verify estimates for all keys.
+  for (size_t key = 0; key < n; ++key) {
+    const counter *const c = h.find(key);
+    if (c != 0) {
+      assert(c->key == (value_type)key);
+      assert(c->count >= freqs[key]);
+      assert(c->count - c->error <= freqs[key]);
+    }
+    else {
+      assert(freqs[key] * capacity <= n);
+    }
+    assert(h.estimate(key) >= freqs[key]);
+  }
+
+  // Verify merging of summaries for distinct stream parts.
+  heavy_hitters h1(capacity), h2(capacity);
+  for (size_t i = 0; i < n; ++i) {
+    if (i < n / 2) {
+      h1.add(a[i]);
+    }
+    else {
+      h2.add(a[i]);
+    }
+  }
+  h1.merge(h2);
+  assert(h1.total() == n);
+  assert(h1.size() <= capacity);
+  for (size_t key = 0; key < n; ++key) {
+    const counter *const c = h1.find(key);
+    if (c != 0) {
+      assert(c->count >= freqs[key]);
+      assert(c->count - c->error <= freqs[key]);
+    }
+    assert(h1.estimate(key) >= freqs[key]);
+  }
+
+  // Verify swap() and clear().
+  swap(h, h2);
+  assert(h.total() == n - n / 2);
+  assert(h2.total() == n);
+  h2.clear();
+  assert(h2.empty());
+  assert(h2.total() == 0);
+
+  cout << "OK" << endl;
+}
+
+template <class Heap, class IntContainer>
+void test_keyed_priority_queue(const size_t n)
+{
+  typedef typename IntContainer::value_type value_type;
+  typedef gkeyed_priority_queue<Heap, size_t, value_type>
+      keyed_priority_queue;
+
+  cout << "    test_keyed_priority_queue(n=" << n << ") ";
+
+  keyed_priority_queue q;
+  assert(q.empty());
+  assert(q.size() == 0);
+
+  // Reference priorities for keys [0 ... n).
+  IntContainer priorities;
+  vector<bool> exists(n, false);
+  size_t size = 0;
+
+  // Insert all the keys.
+  init_array(priorities, n);
+  for (size_t key = 0; key < n; ++key) {
+    assert(q.upsert(key, priorities[key]));
+    exists[key] = true;
+    ++size;
+    assert(q.size() == size);
+  }
+
+  // Update priorities, erase and re-insert random keys.
+  for (size_t i = 0; i < 4 * n; ++i) {
+    const size_t key = rand() % n;
+    if (rand() % 4 == 0) {
+      assert(q.erase(key) == exists[key]);
+      if (exists[key]) {
+        exists[key] = false;
+        --size;
+      }
+      assert(q.find(key) == 0);
+    }
+    else {
+      priorities[key] = rand();
+      assert(q.upsert(key, priorities[key]) == !exists[key]);
+      if (!exists[key]) {
+        exists[key] = true;
+        ++size;
+      }
+      assert(*q.find(key) == priorities[key]);
+    }
+    assert(q.size() == size);
+  }
+
+  // Pop all the keys.
+  if (size > 0) {
+    value_type max_priority = q.top_priority();
+    while (!q.empty()) {
+      const size_t top_key = q.top_key();
+      const pair<size_t, value_type> v = q.pop();
+      assert(v.first == top_key);
+      assert(v.second <= max_priority);
+      assert(exists[v.first]);
+      assert(v.second == priorities[v.first]);
+      exists[v.first] = false;
+      max_priority = v.second;
+      --size;
+      assert(q.size() == size);
+    }
+  }
+  assert(size == 0);
+
+  // Verify swap() and clear().
+  keyed_priority_queue q2;
+  q2.upsert(0, 1);
+  swap(q, q2);
+  assert(q.size() == 1);
+  assert(q2.empty());
+  q.clear();
+  assert(q.empty());
+  assert(q.find(0) == 0);
+
+  cout << "OK" << endl;
+}
+
+// Item for bucket queue tests. It contains sequence number for verifying
+// FIFO order of items with equal priorities. It isn't default constructible,
+// since gbucket_queue must not require this.
+struct bucket_queue_item
+{
+  size_t priority;
+  size_t seq;
+
+  bucket_queue_item(const size_t priority_, const size_t seq_) :
+      priority(priority_), seq(seq_) {}
+};
+
+struct bucket_queue_item_priority_getter
+{
+  size_t operator() (const bucket_queue_item &item) const
+  {
+    return item.priority;
+  }
+};
+
+template <size_t PriorityLevels>
+void test_bucket_queue(const size_t n)
+{
+  typedef gbucket_queue<PriorityLevels, bucket_queue_item,
+      bucket_queue_item_priority_getter> bucket_queue;
+
+  cout << "    test_bucket_queue(PriorityLevels=" << PriorityLevels <<
+      ", n=" << n << ") ";
+
+  // Verify default constructor.
+  bucket_queue q_empty;
+  assert(q_empty.empty());
+  assert(q_empty.size() == 0);
+
+  // Verify non-empty bucket queue.
+  vector<bucket_queue_item> a;
+  for (size_t i = 0; i < n; ++i) {
+    a.push_back(bucket_queue_item(rand() % PriorityLevels, i));
+  }
+  bucket_queue q(a.begin(), a.end());
+  assert(!q.empty());
+  assert(q.size() == n);
+
+  // Verify swap().
+  q.swap(q_empty);
+  assert(q.empty());
+  assert(q_empty.size() == n);
+  swap(q, q_empty);
+  assert(q.size() == n);
+  assert(q_empty.empty());
+
+  // Pop all items from the bucket queue.
+  bucket_queue_item prev_item = q.top();
+  q.pop();
+  for (size_t i = 1; i < n; ++i) {
+    const bucket_queue_item item = q.top();
+    assert(item.priority <= prev_item.priority);
+    if (item.priority == prev_item.priority) {
+      assert(item.seq > prev_item.seq);
+    }
+    q.pop();
+    assert(q.size() == n - i - 1);
+    prev_item = item;
+  }
+  assert(q.empty());
+
+  // Verify extreme priorities.
+  bucket_queue_item item(0, 0);
+  q.push(item);
+  item.priority = PriorityLevels - 1;
+  q.push(item);
+  assert(q.top().priority == PriorityLevels - 1);
+  q.pop();
+  assert(q.top().priority == 0);
+  q.pop();
+  assert(q.empty());
+
+  // Interleave pushing and popping items.
+  for (size_t i = 0; i < n; ++i) {
+    item.priority = rand() % PriorityLevels;
+    item.seq = i;
+    q.push(item);
+  }
+  size_t max_priority = q.top().priority;
+  for (size_t i = 1; i < n; ++i) {
+    q.pop();
+    assert(q.top().priority <= max_priority);
+    item.priority = rand() % PriorityLevels;
+    item.seq = n + i;
+    if (item.priority > max_priority) {
+      max_priority = item.priority;
+    }
+    q.push(item);
+    max_priority = q.top().priority;
+  }
+  assert(q.size() == n);
+
+  cout << "OK" << endl;
+}
+
 template <class Func>
 void test_func(const Func &func)
 {
@@ -573,17 +1911,71 @@ void test_all()
   test_func(test_partial_sort<heap, IntContainer>);
   test_func(test_nway_merge<heap, IntContainer>);
   test_func(test_nway_mergesort<heap, IntContainer>);
+  test_func(test_file_runs<heap, IntContainer>);
+  test_func(test_mapped_runs<heap, IntContainer>);
+  test_func(test_compact_runs<heap, IntContainer>);
+#ifdef GHEAP_CPP11
+  test_func(test_parallel_algorithms<heap, IntContainer>);
+  test_func(test_batch_priority_queue<heap, IntContainer>);
+#ifdef __cpp_impl_coroutine
+  test_func(test_async_nway_merge<heap>);
+#endif
+  test_func(test_task_scheduler<heap>);
+  test_func(test_shared_priority_queue<heap>);
+#endif
   test_func(test_priority_queue<heap, IntContainer>);
+  test_func(test_fused_priority_queue<heap, IntContainer>);
+  test_func(test_traced_priority_queue<heap, IntContainer>);
+  test_func(test_heavy_hitters<heap, IntContainer>);
+  test_func(test_keyed_priority_queue<heap, IntContainer>);
 
   cout << "  test_all(Fanout=" << Fanout << ", PageChunks=" << PageChunks <<
       ") OK" << endl;
 }
 
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_LOCAL && !defined(NDEBUG)
+// Verifies GHEAP_CHECK_LOCAL checks the path the item has been sifted along
+// rather than the path following max children after the sift.
+template <class IntContainer>
+void test_check_local()
+{
+  cout << "  test_check_local() ";
+
+  // a[15] is bigger than its parent a[7], while the rest of the heap
+  // is valid. swap_max_item() sifts the item along 0, 1, 3, 7, 15,
+  // so a[3] becomes less than a[7]. Max children diverge from this path
+  // at a[1] after the sift, since a[4] becomes bigger than a[3].
+  static const int items[] =
+      {100, 90, 80, 85, 10, 70, 60, 8, 5, 3, 2, 50, 40, 30, 20, 9, 2};
+  IntContainer a(items, items + sizeof(items) / sizeof(items[0]));
+  int item = 1;
+
+  cout.flush();
+  const pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    // Suppress the assertion message.
+    dup2(open("/dev/null", O_WRONLY), 2);
+    gheap<2, 1>::swap_max_item(a.begin(), a.end(), item);
+    _exit(0);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+  cout << "OK" << endl;
+}
+#endif
+
 template <class IntContainer>
 void main_test(const char *const container_name)
 {
   cout << "main_test(" << container_name << ") start" << endl;
 
+#if GHEAP_CHECK_LEVEL == GHEAP_CHECK_LOCAL && !defined(NDEBUG)
+  test_check_local<IntContainer>();
+#endif
+
   test_all<1, 1, IntContainer>();
   test_all<2, 1, IntContainer>();
   test_all<3, 1, IntContainer>();
@@ -614,6 +2006,12 @@ void main_test(const char *const container_name)
   test_all<4, 101, IntContainer>();
   test_all<101, 101, IntContainer>();
 
+  test_func(test_bucket_queue<1>);
+  test_func(test_bucket_queue<64>);
+  test_func(test_bucket_queue<256>);
+  test_func(test_bucket_queue<4096>);
+  test_func(test_bucket_queue<100000>);
+
   cout << "main_test(" << container_name << ") OK" << endl;
 }
 
@@ -0,0 +1,194 @@
+// Replays priority queue operation traces recorded via gtrace.hpp against
+// gpriority_queue with various gheap configurations and against
+// std::priority_queue.
+//
+// Usage: trace_replay [-r] [trace_file]
+//
+// Records a synthetic trace via gtraced_priority_queue if trace_file
+// isn't given. Pass -r for traces recorded from min-queues, i.e. queues
+// popping the smallest key first.
+//
+// Pass -DGHEAP_CPP11 to compiler for gheap_cpp11.hpp tests,
+// otherwise gheap_cpp03.hpp will be tested.
+
+#include "gheap.hpp"
+#include "gpriority_queue.hpp"
+#include "gtrace.hpp"
+
+#include <cstdio>     // for fopen(), tmpfile(), fclose()
+#include <cstdlib>    // for rand(), srand()
+#include <cstring>    // for strcmp()
+#include <ctime>      // for clock()
+#include <functional> // for less, greater
+#include <iostream>
+#include <queue>      // for priority_queue
+#include <stdexcept>  // for runtime_error
+#include <vector>     // for vector
+
+using namespace std;
+
+namespace {
+
+double get_time()
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// Replayed item. The payload size is moved together with the key, so
+// the item size is close to items in real queues.
+struct item
+{
+  uint64_t key;
+  uint64_t payload_size;
+
+  bool operator < (const item &x) const
+  {
+    return (key < x.key);
+  }
+
+  bool operator > (const item &x) const
+  {
+    return (key > x.key);
+  }
+};
+
+// Replays the trace against PriorityQueue and prints its performance.
+// Returns the checksum of popped keys, which must be identical for all
+// the queues. Throws runtime_error if the trace pops the empty queue.
+template <class PriorityQueue>
+uint64_t replay(const char *const name, const vector<gtrace_record> &records)
+{
+  cout << "replay(" << name << ", records=" << records.size() << ")";
+
+  PriorityQueue q;
+  uint64_t checksum = 0;
+
+  const double start = get_time();
+  for (size_t i = 0; i < records.size(); ++i) {
+    const gtrace_record &r = records[i];
+    if (r.op == GTRACE_OP_POP) {
+      if (q.empty()) {
+        throw runtime_error("replay: corrupted trace pops empty queue");
+      }
+      checksum = checksum * 31 + q.top().key;
+      q.pop();
+    }
+    else {
+      const item x = {r.key, r.payload_size};
+      q.push(x);
+    }
+  }
+  const double end = get_time();
+
+  cout << ": " << (records.size() / (end - start) / 1000) << " Kops/s" <<
+      endl;
+  return checksum;
+}
+
+template <class LessComparer>
+void replay_all(const vector<gtrace_record> &records)
+{
+  typedef vector<item> container;
+
+  const uint64_t checksum = replay<priority_queue<item, container,
+      LessComparer> >("std::priority_queue", records);
+
+  uint64_t checksums[] = {
+#define GTRACE_REPLAY(Fanout, PageChunks) \
+    replay<gpriority_queue<gheap<Fanout, PageChunks>, item, container, \
+        LessComparer> >("gheap<" #Fanout ", " #PageChunks ">", records)
+    GTRACE_REPLAY(2, 1),
+    GTRACE_REPLAY(3, 1),
+    GTRACE_REPLAY(4, 1),
+    GTRACE_REPLAY(8, 1),
+    GTRACE_REPLAY(16, 1),
+    GTRACE_REPLAY(2, 2),
+    GTRACE_REPLAY(2, 16),
+    GTRACE_REPLAY(4, 4),
+    GTRACE_REPLAY(4, 16),
+    GTRACE_REPLAY(8, 4),
+#undef GTRACE_REPLAY
+  };
+
+  for (size_t i = 0; i < sizeof(checksums) / sizeof(checksums[0]); ++i) {
+    if (checksums[i] != checksum) {
+      throw runtime_error("replay: popped keys mismatch");
+    }
+  }
+}
+
+// Records synthetic trace. The queue grows up to max_size items, then
+// random mix of pushes and pops follows, then the queue is drained.
+void record_synthetic_trace(FILE *const file, const size_t max_size,
+    const size_t ops_count)
+{
+  gtrace_writer writer(file);
+  gtraced_priority_queue<gpriority_queue<gheap<4, 1>, uint64_t> > q(writer);
+
+  for (size_t i = 0; i < max_size; ++i) {
+    q.push(rand());
+  }
+  for (size_t i = 0; i < ops_count; ++i) {
+    if (rand() % 2 == 0 && !q.empty()) {
+      q.pop();
+    }
+    else {
+      // Keys aren't smaller than the current maximum, so pushed items
+      // are sifted up to the root unlike random keys.
+      q.push(q.empty() ? 0 : q.top() + rand() % 1024);
+    }
+  }
+  while (!q.empty()) {
+    q.pop();
+  }
+  writer.finish();
+}
+
+}  // end of anonymous namespace.
+
+
+int main(int argc, char **argv)
+{
+  bool is_min_queue = false;
+  const char *path = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-r") == 0) {
+      is_min_queue = true;
+    }
+    else {
+      path = argv[i];
+    }
+  }
+
+  FILE *file;
+  if (path != 0) {
+    file = fopen(path, "rb");
+    if (file == 0) {
+      cerr << "cannot open " << path << endl;
+      return 1;
+    }
+  }
+  else {
+    srand(0);
+    file = tmpfile();
+    record_synthetic_trace(file, 1024 * 1024, 8 * 1024 * 1024);
+    rewind(file);
+  }
+
+  vector<gtrace_record> records;
+  {
+    gtrace_reader reader(file);
+    gtrace_record r;
+    while (reader.next(r)) {
+      records.push_back(r);
+    }
+  }
+  fclose(file);
+
+  if (is_min_queue) {
+    replay_all<greater<item> >(records);
+  }
+  else {
+    replay_all<less<item> >(records);
+  }
+}